@@ -145,6 +145,8 @@ else()
 			elseif(FF_GPU_BACKEND STREQUAL "hip_rocm")
 				set(Legion_HIP_TARGET "ROCM" CACHE STRING "Legion HIP_TARGET ROCM" FORCE)
 			endif()
+		elseif (FF_GPU_BACKEND STREQUAL "cpu")
+			set(Legion_USE_OpenMP ON CACHE BOOL "enable Legion_USE_OpenMP" FORCE)
 		endif()
 		set(Legion_REDOP_COMPLEX OFF CACHE BOOL "disable complex")
 		add_subdirectory(deps/legion)
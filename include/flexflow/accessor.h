@@ -9,12 +9,19 @@
 #include <cuda_fp16.h>
 #elif defined(FF_USE_HIP_ROCM)
 #include <hip/hip_fp16.h>
+#elif defined(FF_USE_CPU_ONLY)
+#include "mathtypes/half.h"
 #endif
 
 // using namespace Legion;
 
 namespace FlexFlow {
 
+#if defined(FF_USE_CPU_ONLY)
+// Legion's host implementation of __half stands in for cuda_fp16's half
+typedef __half half;
+#endif
+
 template <typename FT, int N, typename T = Legion::coord_t>
 using AccessorRO =
     Legion::FieldAccessor<READ_ONLY, FT, N, T, Realm::AffineAccessor<FT, N, T>>;
@@ -24,6 +24,8 @@
 #elif defined(FF_USE_HIP_ROCM)
 #include <hipblas.h>
 #include <miopen/miopen.h>
+#elif defined(FF_USE_CPU_ONLY)
+#include <cblas.h>
 #else
 #error "Unknown device"
 #endif
@@ -51,6 +53,8 @@ namespace FlexFlow {
 // Pre-assigned const flags
 #define MAP_TO_FB_MEMORY 0xABCD0000
 #define MAP_TO_ZC_MEMORY 0xABCE0000
+// Semantic tag of the activation memory slot attached to a region
+#define MEMORY_SLOT_SEMANTIC_TAG 0xABCF0000
 
 #ifdef FF_USE_NCCL
 constexpr ParameterSyncType CHOSEN_SYNC_TYPE = ParameterSyncType::NCCL;
@@ -58,15 +62,38 @@ constexpr ParameterSyncType CHOSEN_SYNC_TYPE = ParameterSyncType::NCCL;
 constexpr ParameterSyncType CHOSEN_SYNC_TYPE = ParameterSyncType::PS;
 #endif
 
+// Processors that run operator tasks, the memory holding their tensors, and
+// the host-visible memory used for staging. The cpu backend runs operator
+// tasks on Legion's OpenMP processors and keeps all tensors in system memory.
+#ifdef FF_USE_CPU_ONLY
+constexpr Legion::Processor::Kind DEVICE_PROC_KIND =
+    Legion::Processor::OMP_PROC;
+constexpr Legion::Memory::Kind DEVICE_MEM_KIND = Legion::Memory::SYSTEM_MEM;
+constexpr Legion::Memory::Kind HOST_MEM_KIND = Legion::Memory::SYSTEM_MEM;
+#else
+constexpr Legion::Processor::Kind DEVICE_PROC_KIND =
+    Legion::Processor::TOC_PROC;
+constexpr Legion::Memory::Kind DEVICE_MEM_KIND = Legion::Memory::GPU_FB_MEM;
+constexpr Legion::Memory::Kind HOST_MEM_KIND = Legion::Memory::Z_COPY_MEM;
+#endif
+
+// Host loops run on the OpenMP threads of the Legion processor executing the
+// task; loops below this size are not worth forking for. OpenMP is only
+// linked into the cpu backend, so other backends run these loops serially.
+#define CPU_PARALLEL_THRESHOLD 4096
+
 class FFConfig;
 
 struct FFHandler {
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   cudnnHandle_t dnn;
   cublasHandle_t blas;
-#else
+#elif defined(FF_USE_HIP_ROCM)
   miopenHandle_t dnn;
   hipblasHandle_t blas;
+#else
+  // Number of OpenMP threads of the processor that owns this handle
+  int num_threads;
 #endif
   void *workSpace;
   size_t workSpaceSize;
@@ -157,6 +184,22 @@ public:
   bool enable_control_replication;
   int python_data_loader_type;
   bool perform_memory_search{false};
+  bool multi_tensor_update;
+  // Estimated cost (in ms) of launching one task, which fusing two operators
+  // saves; weighed against the parallelism lost by fusion
+  float fusion_launch_overhead;
+  // Size (in MB) of the gradient buckets synchronized during backward;
+  // 0 disables overlapping gradient synchronization with backward
+  int grad_sync_bucket_size;
+  // Let the memory search choose which operators recompute their outputs
+  bool auto_recompute;
+  // Synchronize and update only the embedding rows looked up by a batch
+  bool sparse_embedding_grad;
+  // Cost model calibration
+  int calibration_iterations;
+  std::string calibration_report_file;
+  std::string export_cost_calibration_file;
+  std::string import_cost_calibration_file;
 };
 
 class FFIterationConfig {
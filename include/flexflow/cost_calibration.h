@@ -0,0 +1,125 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FLEXFLOW_COST_CALIBRATION_H_
+#define _FLEXFLOW_COST_CALIBRATION_H_
+
+#include "flexflow/ffconst.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FlexFlow {
+
+class FFModel;
+class Op;
+struct CostMetrics;
+struct MachineView;
+
+/**
+ * @brief Multiplicative factors applied to the simulated costs of one
+ * operator type. A factor of 1.0 leaves the simulated cost unchanged.
+ */
+struct CostCorrection {
+  float forward = 1.0f, backward = 1.0f, sync = 1.0f;
+};
+
+using CostCorrectionMap = std::unordered_map<int, CostCorrection>;
+
+/**
+ * @brief Load per-operator-type correction factors previously written by
+ * save_cost_corrections. Returns false if the file cannot be opened.
+ */
+bool load_cost_corrections(std::string const &filename,
+                           CostCorrectionMap &corrections);
+bool save_cost_corrections(std::string const &filename,
+                           CostCorrectionMap const &corrections);
+/**
+ * @brief Scale the times in cost_metrics by the factors registered for type.
+ */
+void apply_cost_correction(CostCorrectionMap const &corrections,
+                           OperatorType type,
+                           CostMetrics &cost_metrics);
+
+/**
+ * @brief Records measured per-operator forward/backward/sync times during the
+ * first few training iterations and compares them with the costs the
+ * Simulator predicted for the chosen MachineViews.
+ * @details Predictions are captured at the end of the graph search, keyed by
+ * the operator's parameter hash and its MachineView, so that they can be
+ * matched with the operators reconstructed by FFModel::compile. Each operator
+ * is timed in isolation between two execution fences, which serializes the
+ * iteration; calibration is therefore opt-in (--calibrate-iterations).
+ */
+class CostCalibrator {
+public:
+  CostCalibrator(int num_iterations, CostCorrectionMap const &applied);
+
+  bool is_active() const;
+  void record_prediction(Op const *op,
+                         MachineView const &view,
+                         CostMetrics const &cost_metrics);
+  void record_forward(Op const *op, float run_time);
+  void record_backward(Op const *op, float run_time);
+  /**
+   * @brief Add the time to update one parameter of op; an operator's
+   * parameters are summed into one sample per iteration.
+   */
+  void record_sync(Op const *op, float run_time);
+  /**
+   * @brief Mark the end of a training iteration. Once the configured number
+   * of iterations has been observed, the report and the correction factors
+   * are exported according to model->config.
+   */
+  void finish_iteration(FFModel const *model);
+  /**
+   * @brief Per-operator-type correction factors, composed with the factors
+   * that were already applied during the search.
+   */
+  CostCorrectionMap compute_corrections() const;
+  void export_report(std::string const &filename) const;
+
+  /**
+   * @brief Block until all previously issued operations have completed and
+   * return the current time in microseconds.
+   */
+  static double fenced_current_time(FFModel const *model);
+
+private:
+  struct OpTimes {
+    float forward = 0.0f, backward = 0.0f, sync = 0.0f;
+  };
+  struct OpRecord {
+    Op const *op;
+    bool has_prediction;
+    OpTimes predicted;
+    std::vector<float> forward_times, backward_times, sync_times;
+  };
+  OpRecord &get_record(Op const *op);
+  bool lookup_prediction(Op const *op, OpTimes &predicted) const;
+
+private:
+  int num_iterations, current_iteration;
+  CostCorrectionMap applied_corrections;
+  std::unordered_map<size_t, OpTimes> predictions;
+  std::unordered_map<Op const *, size_t> record_index;
+  std::vector<OpRecord> records;
+  // parameter update times of the current iteration, per operator
+  std::unordered_map<Op const *, float> iteration_sync_times;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_COST_CALIBRATION_H_
@@ -7,6 +7,8 @@
 #elif defined(FF_USE_HIP_ROCM)
 #include <hip/hip_runtime.h>
 #include <miopen/miopen.h>
+#elif defined(FF_USE_CPU_ONLY)
+#include <omp.h>
 #else
 #error "Unknown device"
 #endif
@@ -24,6 +26,11 @@ hipError_t get_legion_stream(hipStream_t *stream);
 typedef miopenTensorDescriptor_t ffTensorDescriptor_t;
 typedef miopenActivationDescriptor_t ffActivationDescriptor_t;
 typedef miopenPoolingDescriptor_t ffPoolingDescriptor_t;
+#elif defined(FF_USE_CPU_ONLY)
+// CPU kernels execute synchronously on the calling task's OpenMP threads, so
+// streams are placeholders that keep the kernel interfaces backend-agnostic
+typedef void *ffStream_t;
+int get_legion_stream(ffStream_t *stream);
 #else
 #error "Unknown device"
 #endif
@@ -476,8 +476,7 @@ bool flexflow_tensor_set_tensor_int64(flexflow_tensor_t handle,
                                       flexflow_model_t model,
                                       int num_dim,
                                       int *dims,
-                                      int64_t const *data,
-                                      enum ParameterSyncType comm_type);
+                                      int64_t const *data);
 
 bool flexflow_tensor_get_tensor_int64(flexflow_tensor_t handle,
                                       flexflow_model_t model,
@@ -123,6 +123,10 @@ struct GraphCostResultWithMemory {
   MemoryUsage mem_cost; ///< Memory usage
   ///< Corresponding machine views (device placement views)
   std::unordered_map<Node, MachineView> views;
+  ///< Part of the run time cost spent recomputing activations in backward
+  float recompute_cost = 0.0f;
+  ///< Nodes whose outputs are recomputed instead of kept until backward
+  std::unordered_set<Node> recomputed_nodes;
 
   /**
    * @brief Get the multi-objective cost that combines the run time and memory
@@ -310,6 +314,11 @@ public:
   float optimal_cost() const;
   float optimal_cost_with_memory(float run_time_cost_factor) const;
   std::unordered_map<Node, MachineView> optimal_views() const;
+  /**
+   * @brief Nodes whose outputs the memory-aware search chose to recompute in
+   * backward, under the current MemoryOptimConfig (see --auto-recompute).
+   */
+  std::unordered_set<Node> recomputed_nodes() const;
   void remove_input_nodes();
   void duplicate_input_node(Node const &);
   void duplicate_input_nodes();
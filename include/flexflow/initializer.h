@@ -30,6 +30,11 @@ public:
   virtual void init(FFModel const *ff, const ParallelTensor p) = 0;
 };
 
+// The CPU variants of the random initializers draw every element from its
+// index in the whole parameter, so the values do not depend on how the
+// parameter is partitioned. The cpu backend always uses them; with GPUs the
+// mapper picks them for weights of up to 4M elements and draws larger ones
+// with curand on each shard, whose values depend on the partitioning.
 class GlorotUniform : public Initializer {
 public:
   GlorotUniform(int _seed);
@@ -39,9 +44,14 @@ public:
                         std::vector<Legion::PhysicalRegion> const &regions,
                         Legion::Context ctx,
                         Legion::Runtime *runtime);
+  static void init_task_cpu(Legion::Task const *task,
+                            std::vector<Legion::PhysicalRegion> const &regions,
+                            Legion::Context ctx,
+                            Legion::Runtime *runtime);
   int seed;
   float scale;
   DataType data_type;
+  int num_replica_dims;
 };
 
 class Op;
@@ -76,9 +86,14 @@ public:
                         std::vector<Legion::PhysicalRegion> const &regions,
                         Legion::Context ctx,
                         Legion::Runtime *runtime);
+  static void init_task_cpu(Legion::Task const *task,
+                            std::vector<Legion::PhysicalRegion> const &regions,
+                            Legion::Context ctx,
+                            Legion::Runtime *runtime);
   int seed;
   float min_val, max_val;
   DataType data_type;
+  int num_replica_dims;
 };
 
 class NormInitializer : public Initializer {
@@ -90,9 +105,14 @@ public:
                         std::vector<Legion::PhysicalRegion> const &regions,
                         Legion::Context ctx,
                         Legion::Runtime *runtime);
+  static void init_task_cpu(Legion::Task const *task,
+                            std::vector<Legion::PhysicalRegion> const &regions,
+                            Legion::Context ctx,
+                            Legion::Runtime *runtime);
   int seed;
   float mean, stddev;
   DataType data_type;
+  int num_replica_dims;
 };
 
 class ConstantInitializer : public Initializer {
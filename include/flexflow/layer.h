@@ -52,6 +52,8 @@ public:
   bool trainableInputs[MAX_NUM_INPUTS];
   int numInputs, numWeights, numOutputs;
   bool profiling;
+  // Recompute the outputs in backward instead of keeping them alive
+  bool recompute{false};
 
 private:
   std::unordered_map<std::string, long long> int_properties;
@@ -3,10 +3,8 @@
 
 #include "legion.h"
 #include <vector>
-#ifdef FF_USE_NCCL
-#include <nccl.h>
-#endif
 #include "flexflow/config.h"
+#include "flexflow/utils/device_list.h"
 
 namespace FlexFlow {
 class FFConfig;
@@ -76,12 +74,7 @@ struct ParallelConfig {
         return false;
       }
     }
-    for (int i = 0; i < num_parts(); i++) {
-      if (device_ids[i] != rhs.device_ids[i]) {
-        return false;
-      }
-    }
-    return true;
+    return device_ids == rhs.device_ids;
   }
   int num_parts() const;
   bool is_data_parallel() const;
@@ -89,10 +82,9 @@ struct ParallelConfig {
       change_data_parallel_dimensionality(int new_dimensionality) const;
   DeviceType device_type;
   int nDims, dim[MAX_TENSOR_DIM];
-  int device_ids[MAX_NUM_WORKERS];
-#ifdef FF_USE_NCCL
-  ncclComm_t nccl_comms[MAX_NUM_WORKERS];
-#endif
+  // Kept compact since configs are copied by value throughout the search;
+  // NCCL communicators live in FFModel::view_hash_to_nccl_comms instead.
+  DeviceList device_ids;
 };
 
 }; // namespace FlexFlow
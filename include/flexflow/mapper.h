@@ -20,6 +20,8 @@
 #include "legion.h"
 #include "model.h"
 #include "null_mapper.h"
+#include <mutex>
+#include <tuple>
 
 namespace FlexFlow {
 
@@ -331,9 +333,37 @@ private: // Default helper functions
       Memory preferred_memory = Memory::NO_MEMORY);
 
 private:
+  // Activation memory slot planned for the tensor of req, or -1
+  int find_memory_slot(MapperContext ctx, RegionRequirement const &req);
+  // Make region the occupant of a slot in mem and let Legion reclaim the
+  // instances of the previous occupant first; returns whether it changed
+  bool claim_memory_slot(MapperContext ctx,
+                         Memory mem,
+                         int slot,
+                         LogicalRegion region);
+  // Remember the instances mapped for the occupant of a slot; instances
+  // reclaimed by a new occupant get back the default collection priority
+  void record_slot_instances(MapperContext ctx,
+                             Memory mem,
+                             int slot,
+                             std::vector<PhysicalInstance> const &instances,
+                             bool claimed);
+  // Forget the instances of every dead slot occupant in mem so that Legion
+  // can collect them; returns whether there were any
+  bool release_dead_slot_instances(MapperContext ctx, Memory mem);
+  // Reuse the cached mapping of task if all of its instances are alive
+  bool map_task_from_cache(MapperContext ctx,
+                           Task const &task,
+                           MapTaskOutput &output);
   unsigned long long compute_task_hash(Task const &task);
   bool is_parameter_server_update_task(TaskID tid);
   bool is_initializer_task(TaskID tid);
+  // Whether task randomly initializes a weight small enough for its CPU
+  // variant, whose values do not depend on how the weight is partitioned
+  bool initialize_on_cpu(MapperContext ctx, Task const &task);
+  // A CPU on the node of device that shares its zero-copy memory; idx
+  // spreads the callers over the CPUs of the node
+  Processor cpu_near_device(Processor device, size_t idx);
   std::vector<Processor> const &all_procs_by_kind(Processor::Kind kind);
 
 protected:
@@ -352,6 +382,30 @@ protected:
   std::map<std::pair<Memory::Kind, FieldSpace>, LayoutConstraintID>
       layout_constraint_cache;
   std::vector<InstanceCreationLog> created_instances;
+  // Tensor region occupying each activation memory slot of a memory, the
+  // instances it was mapped to and those of its previous occupants.
+  // Shared by the mappers of all local processors, since several of them
+  // place instances in the same system and zero-copy memories.
+  struct MemorySlot {
+    LogicalRegion region;
+    std::vector<PhysicalInstance> instances, dead_instances;
+  };
+  static std::mutex memory_slots_lock;
+  static std::map<std::pair<Memory, int>, MemorySlot> memory_slots;
+  // Complete map_task decisions, reused by later launches of the same task
+  // on the same regions as long as their instances are still alive
+  struct CachedMapping {
+    std::vector<LogicalRegion> regions;
+    VariantID chosen_variant;
+    std::vector<Processor> target_procs;
+    std::vector<std::vector<PhysicalInstance>> chosen_instances;
+    // memory slot taken by each region requirement, or -1
+    std::vector<std::pair<Memory, int>> slots;
+  };
+  // Keyed by the task hash, the index point and the target processor
+  std::map<std::tuple<unsigned long long, DomainPoint, Processor>,
+           CachedMapping>
+      cached_mappings;
 };
 
 }; // namespace FlexFlow
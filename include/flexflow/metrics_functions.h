@@ -41,6 +41,30 @@ public:
   double start_time;
 };
 
+#define PERF_METRICS_REDOP_ID 101
+
+/**
+ * @brief Legion reduction summing the PerfMetrics of the shards of a metrics
+ * launch, so their future map is reduced without waiting on it.
+ * @details Futures are reduced one at a time by the runtime, so apply and
+ * fold need not be atomic.
+ */
+class PerfMetricsReduction {
+public:
+  typedef PerfMetrics LHS;
+  typedef PerfMetrics RHS;
+  static const PerfMetrics identity;
+
+  template <bool EXCLUSIVE>
+  static void apply(LHS &lhs, RHS rhs) {
+    lhs.update(rhs);
+  }
+  template <bool EXCLUSIVE>
+  static void fold(RHS &rhs1, RHS rhs2) {
+    rhs1.update(rhs2);
+  }
+};
+
 class Metrics {
 public:
   Metrics(LossType _loss_type, std::vector<MetricsType> const &metrics);
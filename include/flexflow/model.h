@@ -34,7 +34,9 @@
 #include "tensor.h"
 #include "tl/optional.hpp"
 #include <functional>
+#include <memory>
 #include <unistd.h>
+#include <unordered_set>
 #include <utility>
 
 #include "ffconst.h"
@@ -151,6 +153,16 @@ enum TaskIDs {
   // Optimizer with NCCL
   SGD_UPD_NCCL_TASK_ID,
   ADAM_UPD_NCCL_TASK_ID,
+  // Multi-tensor optimizer updates
+  SGD_MULTI_UPD_PS_TASK_ID,
+  ADAM_MULTI_UPD_PS_TASK_ID,
+  SGD_MULTI_UPD_NCCL_TASK_ID,
+  ADAM_MULTI_UPD_NCCL_TASK_ID,
+  // Row-sparse optimizer updates
+  SGD_SPARSE_UPD_PS_TASK_ID,
+  ADAM_SPARSE_UPD_PS_TASK_ID,
+  SGD_SPARSE_UPD_NCCL_TASK_ID,
+  ADAM_SPARSE_UPD_NCCL_TASK_ID,
   // Initializer
   GLOROT_INIT_TASK_ID,
   ZERO_INIT_TASK_ID,
@@ -164,6 +176,12 @@ enum TaskIDs {
   STRATEGY_SEARCH_TASK_ID,
   // Graph
   GRAPH_OPTIMIZE_TASK_ID,
+  GRAPH_OPTIMIZE_BACKGROUND_TASK_ID,
+  MEASURE_OPERATOR_COST_TASK_ID,
+  // Checkpoint
+  CHECKPOINT_SNAPSHOT_TASK_ID,
+  CHECKPOINT_SAVE_TASK_ID,
+  CHECKPOINT_LOAD_TASK_ID,
   // Python data loader
   PY_DL_FLOAT_LOAD_ENTIRE_CPU_TASK_ID,
   PY_DL_INT32_LOAD_ENTIRE_CPU_TASK_ID,
@@ -187,6 +205,9 @@ enum TaskIDs {
   REDUCTION_INIT_TASK_ID,
   REDUCTION_FWD_TASK_ID,
   REDUCTION_BWD_TASK_ID,
+  ALLTOALL_INIT_TASK_ID,
+  ALLTOALL_FWD_TASK_ID,
+  ALLTOALL_BWD_TASK_ID,
   PIPELINE_INIT_TASK_ID,
   PIPELINE_FWD_TASK_ID,
   PIPELINE_BWD_TASK_ID,
@@ -230,6 +251,7 @@ namespace PCG {
 class SearchHelper;
 class GraphSearchHelper;
 class Graph;
+struct GraphOptimalViewSerialized;
 }; // namespace PCG
 
 class FFModel;
@@ -276,6 +298,7 @@ class Combine;
 class Repartition;
 class Reduction;
 class Replicate;
+class AllToAll;
 class FusedParallelOp;
 class ParallelOpInfo;
 
@@ -664,10 +687,20 @@ public:
   void deserialize_graph_optimal_view(
       Legion::Deserializer &dez,
       PCG::Graph *graph,
-      std::unordered_map<PCG::Node, MachineView> &optimal_views);
+      std::unordered_map<PCG::Node, MachineView> &optimal_views,
+      std::unordered_map<PCG::Node, CostMetrics> &predicted_costs,
+      std::vector<size_t> &recompute_layer_ids);
   bool convert_graph_to_operators(
       const PCG::Graph *graph,
       std::unordered_map<PCG::Node, MachineView> const &optimal_views);
+  // Replace operators with the PCG found by the graph optimize task
+  void apply_optimized_graph(PCG::GraphOptimalViewSerialized const &ret);
+  // Map the operators' outputs, collect their parameters, and apply the
+  // inplace and fusion optimizations
+  void finalize_operators();
+  // Create the optimizer states, update buckets and NCCL communicators of
+  // the parameters
+  void init_parameter_updates();
   static void register_all_machine_views(int num_nodes,
                                          int gpus_per_node,
                                          int cpus_per_node,
@@ -766,6 +799,39 @@ public:
                           Legion::Context ctx,
                           Legion::Runtime *runtime);
   void reset_metrics();
+  // Fold the buffered per-iteration metrics into current_metrics
+  void flush_metrics();
+  // Wait for and return the metrics accumulated since reset_metrics
+  PerfMetrics get_perf_metrics();
+  /**
+   * @brief Write every parameter shard to its own file under dir from the
+   * processor that owns it, without waiting for the files.
+   * @details Shards are snapshotted first, so training may update the
+   * parameters while the previous values are written; call
+   * wait_for_checkpoint before using the files.
+   */
+  void save_checkpoint(std::string const &dir);
+  void wait_for_checkpoint();
+  /**
+   * @brief Restore parameters saved by save_checkpoint with the same
+   * parallelization.
+   */
+  void load_checkpoint(std::string const &dir);
+  static void checkpoint_snapshot_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void
+      checkpoint_save_task(Legion::Task const *task,
+                           std::vector<Legion::PhysicalRegion> const &regions,
+                           Legion::Context ctx,
+                           Legion::Runtime *runtime);
+  static void
+      checkpoint_load_task(Legion::Task const *task,
+                           std::vector<Legion::PhysicalRegion> const &regions,
+                           Legion::Context ctx,
+                           Legion::Runtime *runtime);
   void init_operators();
   void prefetch();
   void forward(int seq_length = -1);
@@ -773,7 +839,38 @@ public:
   void get_metrics();
   void backward(int seq_length = -1);
   void update();
-  bool apply_fusion(std::vector<Op *> const &operators,
+  /**
+   * @brief Drop the outputs of the layer producing output after forward and
+   * recompute them during backward (activation checkpointing).
+   */
+  void set_recompute(const Tensor output, bool recompute = true);
+  /**
+   * @brief Mark the operators of recompute_layers and schedule when their
+   * outputs are dropped and recomputed (recompute_after).
+   */
+  void create_recompute_schedule();
+  // Let Legion reclaim the outputs of op until they are recomputed
+  void discard_outputs(Op const *op);
+  // Re-run the forward of operators[op_idx], and of the recomputed operators
+  // it depends on, unless already done in the current backward
+  void recompute_outputs(int op_idx, std::vector<bool> &recomputed);
+  /**
+   * @brief Assign activations that are never live at the same time to
+   * shared memory slots and tag their regions with the slot for FFMapper.
+   * @details Lifetimes follow the operator schedule: the forward of
+   * operators[l] is step l and, in training, its backward is step
+   * 2 * operators.size() - 1 - l.  Recomputed outputs are live twice.
+   */
+  void plan_activation_memory();
+  /**
+   * @brief Fuse operators into FusedOps in a single pass over the
+   * topologically sorted operators and store the result in new_operators.
+   * @details Each operator joins the first fusion group with the same
+   * MachineView that is placed after all its producers, unless the
+   * predicted cost of the parallelism lost (predicted_layer_costs) exceeds
+   * the task launches saved. Groups are tracked with a union-find.
+   */
+  void apply_fusion(std::vector<Op *> const &operators,
                     std::vector<Op *> &new_operators);
   Op *get_final_operator() const;
   void compile(LossType loss_type,
@@ -809,7 +906,36 @@ public:
   void rewrite(std::map<Op const *, ParallelConfig> const &current,
                std::map<Op const *, ParallelConfig> &next,
                bool use_propagation) const;
-  void recompile_on_condition(RecompileState &r);
+  /**
+   * @brief Search for a new strategy in the background when r's trigger
+   * fires and switch to it once the search is done.
+   * @details Call between training iterations. The first call after the
+   * trigger fires applies r's alter function and launches the graph
+   * optimize task on a CPU without waiting for it; it only occupies the
+   * first GPU while measuring an operator. Later calls return immediately
+   * until its result is ready. The model then switches to the new PCG and
+   * copies the weights and optimizer states over. Data loaders keep working
+   * since the new PCG must keep the parallelization of the input and label
+   * tensors; otherwise it is discarded.
+   * @return true if the model switched to a new PCG in this call
+   */
+  bool recompile_on_condition(RecompileState &r);
+  /**
+   * @brief Create the model a background search works on.
+   * @details The copy shares the layers and the operators the search starts
+   * from. It has its own config, guid counters, machine views, operator
+   * caches, search helpers and simulator, so a search running while this
+   * model trains writes none of this model's state. Free it with
+   * free_search_model once the search is done.
+   */
+  FFModel *create_search_model() const;
+  static void free_search_model(FFModel *search_model);
+  // Switch the running model to the PCG in ret; false if it is not
+  // compatible with the current input and label tensors
+  bool switch_to_optimized_graph(PCG::GraphOptimalViewSerialized const &ret);
+  // Copy the data of src to dst, which differ only in their parallelization
+  void copy_parallel_tensor(const ParallelTensor src,
+                            const ParallelTensor dst) const;
   void zero_gradients();
   void print_layers(int id);
 
@@ -847,15 +973,39 @@ public:
   Loss *loss_op;
   Metrics *metrics_op;
   Simulator *simulator;
+  // Cost corrections loaded from --import-cost-calibration
+  CostCorrectionMap cost_corrections;
+  // Non-null when --calibrate-iterations is set
+  std::unique_ptr<CostCalibrator> calibrator;
+  // ready_update_buckets[l]: indices of the optimizer's update buckets whose
+  // gradients are complete once operators[l]'s backward has been launched
+  std::vector<std::vector<size_t>> ready_update_buckets;
+  // Whether the last backward() already issued all parameter updates
+  bool update_issued_in_backward;
+  // Guids of the layers whose outputs are recomputed in backward, either set
+  // with set_recompute or chosen by the search (--auto-recompute)
+  std::unordered_set<size_t> recompute_layers;
+  // recompute_after[l]: operators whose outputs are dropped after the forward
+  // of operators[l] and recomputed before its backward
+  std::vector<std::vector<int>> recompute_after;
+  // Costs predicted by the search for each layer's operator under its chosen
+  // view, keyed by layer guid; used by apply_fusion
+  std::unordered_map<size_t, CostMetrics> predicted_layer_costs;
   int metrics_input;
   ParallelTensor parallel_label_tensor;
   Tensor label_tensor;
 
   std::vector<Layer *> layers;
   std::vector<Op *> operators;
+  // The PCG created from the layers, which every search starts from
+  std::vector<Op *> search_operators;
   std::vector<ParallelTensor> parameters;
   FFHandler handlers[MAX_NUM_WORKERS];
   Legion::Future current_metrics;
+  // Reduced metrics of the iterations not yet folded into current_metrics
+  std::vector<Legion::Future> pending_metrics;
+  // Save tasks of the checkpoint being written
+  std::vector<Legion::FutureMap> pending_checkpoint;
   // Cached operators: key: operator hash, value: operator pointer
   std::tuple<
       std::unordered_map<
@@ -921,6 +1071,8 @@ public:
                          Reduction *>,
       std::unordered_map<std::pair<ParallelTensorShape, CombineParams>,
                          Combine *>,
+      std::unordered_map<std::pair<ParallelTensorShape, AllToAllParams>,
+                         AllToAll *>,
       std::unordered_map<std::pair<ParallelTensorShape, FusedParallelOpParams>,
                          FusedParallelOp *>>
       cached_ops;
@@ -931,6 +1083,9 @@ public:
   std::unordered_map<size_t, ncclComm_t *> view_hash_to_nccl_comms;
 #endif
 private:
+  // See create_search_model
+  FFModel(FFModel const *model);
+
   bool debug;
   std::map<MachineView, Legion::IndexSpace, MachineViewDimCompare> all_task_is;
 
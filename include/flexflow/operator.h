@@ -178,6 +178,7 @@ public:
      int numWeights,
      int numOutputs,
      ParallelTensor const *tensors);
+  virtual ~Op() = default;
   // graph substitution related methods
   virtual bool get_int_parameter(PMParameter, int *) const;
   virtual bool get_tensor_parameter(TNParameter, DIMParameter, int *) const;
@@ -219,6 +220,9 @@ public:
   virtual bool has_inplace_output();
   virtual void do_inplace_output();
   virtual bool is_parallel_op() const;
+  // Whether the outputs can be dropped after forward and recomputed in
+  // backward without changing the results
+  bool is_recomputable() const;
   virtual void serialize(Legion::Serializer &) const;
   virtual Op *
       materialize(FFModel &ff, ParallelTensor inputs[], int num_inputs) const;
@@ -269,6 +273,8 @@ public:
   OpMeta *meta[MAX_NUM_WORKERS];
   int numInputs, numWeights, numOutputs;
   bool profiling;
+  // Drop the outputs after forward and recompute them in backward
+  bool recompute{false};
 #ifdef FF_USE_NCCL
   ncclUniqueId ncclId;
 #endif
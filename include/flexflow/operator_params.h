@@ -24,6 +24,7 @@
 #include "flexflow/ops/split_params.h"
 #include "flexflow/ops/topk_params.h"
 #include "flexflow/ops/transpose_params.h"
+#include "flexflow/parallel_ops/all_to_all_params.h"
 #include "flexflow/parallel_ops/combine_params.h"
 #include "flexflow/parallel_ops/fused_parallel_op_params.h"
 #include "flexflow/parallel_ops/partition_params.h"
@@ -62,6 +63,7 @@ using OperatorParameters = mp::variant<AggregateParams,
                                        ReplicateParams,
                                        ReductionParams,
                                        CombineParams,
+                                       AllToAllParams,
                                        FusedParallelOpParams>;
 
 tl::optional<OperatorParameters> get_op_parameters(Op const *op);
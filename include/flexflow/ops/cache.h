@@ -2,13 +2,22 @@
 #define _FLEXFLOW_CACHE_H_
 
 #include "flexflow/model.h"
+#include "flexflow/utils/batch_cache.h"
 
 namespace FlexFlow {
 
 class CacheMeta : public OpMeta {
 public:
-  CacheMeta(FFHandler handle);
+  CacheMeta(FFHandler handle, int num_batches);
   float cache_score;
+  // Host copies of the last num_batches distinct batches seen by this
+  // shard, found through their content fingerprints
+  BatchCache batches;
+  std::vector<char> slots;
+  std::vector<char> staging;
+  size_t batch_bytes;
+  // slot holding the batch of the current iteration
+  int last_slot;
 };
 
 class Cache : public Op {
@@ -55,20 +64,25 @@ public:
                              MachineView const &pc,
                              CostMetrics &cost_metrics) const override;
   void use_cached(bool cached);
+  // Look up a host copy of the current batch among the cached ones, insert
+  // it on a miss, and return the updated score
+  float update_batches(CacheMeta *m,
+                       void const *batch,
+                       int vol,
+                       size_t data_size) const;
 
 public:
-  void **batch_ptrs;
-  void *batch_cmp;
   bool load_cached;
+  // number of distinct batches kept per shard
   int num_batches;
+  // score_f(score, input, cached, vol) is called once per batch, with cached
+  // pointing at the matching cached batch or nullptr on a miss
   std::function<float(float *, void const *, void const *, int)> score_f;
   std::vector<Legion::Future> score_futures;
-  int batch_ctr;
 };
 
 struct Arg {
   Cache *cache;
-  int batch_ctr;
 };
 
 }; // namespace FlexFlow
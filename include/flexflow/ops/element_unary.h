@@ -17,7 +17,7 @@ public:
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   cudnnTensorDescriptor_t inputTensor, outputTensor;
   cudnnActivationDescriptor_t actiDesc;
-#else
+#elif defined(FF_USE_HIP_ROCM)
   miopenTensorDescriptor_t inputTensor, outputTensor;
   miopenActivationDescriptor_t actiDesc;
 #endif
@@ -18,7 +18,7 @@ public:
   cudnnConvolutionFwdAlgo_t fwdAlgo;
   cudnnConvolutionBwdFilterAlgo_t bwdFilterAlgo;
   cudnnConvolutionBwdDataAlgo_t bwdDataAlgo;
-#else
+#elif defined(FF_USE_HIP_ROCM)
   miopenTensorDescriptor_t inputTensor, biasTensor, outputTensor;
   miopenTensorDescriptor_t filterDesc;
   miopenActivationDescriptor_t actiDesc;
@@ -26,6 +26,11 @@ public:
   miopenConvFwdAlgorithm_t fwdAlgo;
   miopenConvBwdWeightsAlgorithm_t bwdFilterAlgo;
   miopenConvBwdDataAlgorithm_t bwdDataAlgo;
+#else
+  int input_w, input_h, input_c, input_n;
+  int output_w, output_h, output_c, output_n;
+  int kernel_h, kernel_w, groups;
+  int stride_h, stride_w, pad_h, pad_w;
 #endif
   bool relu, use_bias;
   char op_name[MAX_OPNAME];
@@ -129,7 +134,7 @@ cudnnConvolutionBwdFilterAlgo_t selectConvolutionBackwardFilterAlgorithm(
     const cudnnFilterDescriptor_t dwDesc,
     void *dw,
     float *time);
-#else
+#elif defined(FF_USE_HIP_ROCM)
 miopenConvFwdAlgorithm_t selectConvolutionForwardAlgorithm(
     miopenHandle_t handle,
     const miopenTensorDescriptor_t xDesc,
@@ -19,9 +19,15 @@ public:
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   cudnnTensorDescriptor_t inputTensor, outputTensor;
   cudnnDropoutDescriptor_t dropoutDesc;
-#else
+#elif defined(FF_USE_HIP_ROCM)
   miopenTensorDescriptor_t inputTensor, outputTensor;
   miopenDropoutDescriptor_t dropoutDesc;
+#else
+  float rate;
+  unsigned long long seed;
+  size_t num_elements;
+  // Number of forward passes so far, which selects a fresh mask per pass
+  unsigned long long num_forwards;
 #endif
   void *reserveSpace, *dropoutStates;
   size_t reserveSpaceSize, dropoutStateSize;
@@ -14,10 +14,12 @@ public:
   cudnnTensorDescriptor_t input1Tensor, input2Tensor, outputTensor;
   cudnnOpTensorDescriptor_t opDesc;
   cudnnReduceTensorDescriptor_t reduceAddDesc;
-#else
+#elif defined(FF_USE_HIP_ROCM)
   miopenTensorDescriptor_t input1Tensor, input2Tensor, outputTensor;
   miopenTensorOp_t opDesc;
   miopenReduceTensorDescriptor_t reduceAddDesc;
+#else
+  Legion::Domain input1_domain, input2_domain, output_domain;
 #endif
   OperatorType op_type;
   bool inplace_a, has_same_operands;
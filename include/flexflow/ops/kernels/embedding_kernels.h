@@ -57,8 +57,10 @@ void backward_kernel(TI const *input_ptr,
                      AggrMode aggr,
                      int outputSize,
                      ffStream_t stream);
+#ifndef FF_USE_CPU_ONLY
 template <typename TD>
 __global__ void rand_generate_int(TD *ptr, size_t size, TD p);
+#endif
 } // namespace Internal
 } // namespace Embedding
 } // namespace Kernels
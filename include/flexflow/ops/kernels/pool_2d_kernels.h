@@ -10,9 +10,16 @@ namespace FlexFlow {
 class Pool2DMeta : public OpMeta {
 public:
   Pool2DMeta(FFHandler handle);
+#if defined(FF_USE_CPU_ONLY)
+  int input_w, input_h, input_c, input_n;
+  int output_w, output_h, output_c, output_n;
+  int kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w;
+  PoolType pool_type;
+#else
   ffTensorDescriptor_t inputTensor, outputTensor;
   ffActivationDescriptor_t actiDesc;
   ffPoolingDescriptor_t poolDesc;
+#endif
   bool relu;
   char op_name[MAX_OPNAME];
 };
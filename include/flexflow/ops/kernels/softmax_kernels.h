@@ -15,8 +15,11 @@ public:
               Legion::Domain const &input_domain);
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   cudnnTensorDescriptor_t inputTensor;
-#else
+#elif defined(FF_USE_HIP_ROCM)
   miopenTensorDescriptor_t inputTensor;
+#else
+  // NCHW view of the input, softmax is computed along C
+  int outer_size, channel_size, inner_size;
 #endif
   bool profiling;
   int dim;
@@ -16,9 +16,11 @@ public:
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   cudnnTensorDescriptor_t inputTensor, outputTensor;
   cudnnReduceTensorDescriptor_t reduceDesc;
-#else
+#elif defined(FF_USE_HIP_ROCM)
   miopenTensorDescriptor_t inputTensor, outputTensor;
   miopenReduceTensorDescriptor_t reduceDesc;
+#else
+  Legion::Domain input_domain, output_domain;
 #endif
 };
 
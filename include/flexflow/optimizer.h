@@ -24,13 +24,82 @@ namespace FlexFlow {
 class FFModel;
 class OpMeta;
 
+#define MAX_NUM_MULTI_TENSORS 32
+
+// Pointers to the local shards of a bucket of parameters that are updated
+// by a single kernel launch; passed to the kernels by value
+struct MultiTensorUpdateArgs {
+  int num_tensors;
+  size_t sizes[MAX_NUM_MULTI_TENSORS];
+  int num_replicas[MAX_NUM_MULTI_TENSORS];
+  float const *w_grad_ptrs[MAX_NUM_MULTI_TENSORS];
+  float *w_ptrs[MAX_NUM_MULTI_TENSORS];
+  float *v_ptrs[MAX_NUM_MULTI_TENSORS];
+  float *m_ptrs[MAX_NUM_MULTI_TENSORS];
+};
+
+// Local shards of a parameter with a row-sparse gradient: only the rows
+// listed in row_ids, which may contain repeats, can be non-zero
+struct SparseUpdateArgs {
+  size_t size;
+  int row_size, num_replicas;
+  size_t num_ids;
+  DataType id_type;
+  void const *row_ids;
+  float *w_grad_ptr, *w_ptr, *v_ptr, *m_ptr;
+};
+
+// Host implementations of the updates, used by the LOC_PROC variants and by
+// the cpu backend; replicas of a gradient are laid out one after another
+void gather_replicas_cpu(float *w_grad, size_t size, int num_replicas);
+void sgd_update_cpu(size_t count,
+                    float lr,
+                    float weight_decay,
+                    float momentum,
+                    bool nesterov,
+                    float const *WGrad,
+                    float *V,
+                    float *W);
+void adam_update_cpu(size_t count,
+                     float alpha_t,
+                     float beta1,
+                     float beta2,
+                     float weight_decay,
+                     float epsilon,
+                     float const *WGrad,
+                     float *M,
+                     float *V,
+                     float *W);
+
 class Optimizer {
 public:
   Optimizer(FFModel const *_model);
   virtual void init(void) = 0;
   virtual void next(void) = 0;
   virtual void update(const ParallelTensor p) = 0;
+  // Update all parameters of a bucket with one task launch
+  virtual void multi_tensor_update(std::vector<ParallelTensor> const &ps) = 0;
+  // Move the state of old_p to new_p, which replaces it after recompilation;
+  // init must have created the state of new_p
+  virtual void migrate_state(const ParallelTensor old_p,
+                             const ParallelTensor new_p) = 0;
+  // Group parameters with the same sync type and MachineView into buckets of
+  // at most bucket_bytes (0 for no limit), in reverse topological order
+  void create_update_buckets(size_t bucket_bytes = 0);
+  // Launch a gradient all-reduce index task, ordered after the previous one
+  void launch_nccl_sync(Legion::IndexLauncher &launcher);
+  // Update a parameter whose gradient is row-sparse (see
+  // ParallelTensorBase::sparse_grad_rows); the tasks get the gradient, the
+  // parameter, the row ids and then the optimizer states
+  void sparse_update(const ParallelTensor p,
+                     Legion::TaskArgument const &optimizer_arg,
+                     Legion::TaskID ps_task_id,
+                     Legion::TaskID nccl_task_id,
+                     std::vector<ParallelTensor> const &states);
   FFModel const *model;
+  std::vector<std::vector<ParallelTensor>> update_buckets;
+  // Futures of the last NCCL sync launch when syncs are overlapped
+  std::vector<Legion::Future> last_sync_futures;
 };
 
 class SGDOptimizer : public Optimizer {
@@ -43,6 +112,8 @@ public:
   void init(void);
   void next(void);
   void update(const ParallelTensor p);
+  void multi_tensor_update(std::vector<ParallelTensor> const &ps);
+  void migrate_state(const ParallelTensor old_p, const ParallelTensor new_p);
   void set_weight_decay(double _weight_decay);
   static void ps_update_task(Legion::Task const *task,
                              std::vector<Legion::PhysicalRegion> const &regions,
@@ -54,6 +125,27 @@ public:
                                  int num_replicas,
                                  float *w_ptr,
                                  float *v_ptr);
+  static void ps_multi_tensor_update_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void ps_multi_tensor_update_task_cpu(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void multi_tensor_update_task_gpu(SGDOptimizer const *op,
+                                           MultiTensorUpdateArgs const &args);
+  static void multi_tensor_update_task_cpu(SGDOptimizer const *op,
+                                           MultiTensorUpdateArgs const &args);
+  static void
+      ps_sparse_update_task(Legion::Task const *task,
+                            std::vector<Legion::PhysicalRegion> const &regions,
+                            Legion::Context ctx,
+                            Legion::Runtime *runtime);
+  static void ps_sparse_update_task_gpu(SGDOptimizer const *op,
+                                        SparseUpdateArgs const &args);
 #ifdef FF_USE_NCCL
   static void
       nccl_update_task(Legion::Task const *task,
@@ -66,6 +158,23 @@ public:
                                    size_t size,
                                    float *w_ptr,
                                    float *v_ptr);
+  static void nccl_multi_tensor_update_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void
+      nccl_multi_tensor_update_task_gpu(SGDOptimizer const *op,
+                                        OpMeta const *meta,
+                                        MultiTensorUpdateArgs const &args);
+  static void nccl_sparse_update_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void nccl_sparse_update_task_gpu(SGDOptimizer const *op,
+                                          OpMeta const *meta,
+                                          SparseUpdateArgs const &args);
 #endif
   double lr, momentum;
   bool nesterov;
@@ -85,6 +194,8 @@ public:
   void init(void);
   void next(void);
   void update(const ParallelTensor p);
+  void multi_tensor_update(std::vector<ParallelTensor> const &ps);
+  void migrate_state(const ParallelTensor old_p, const ParallelTensor new_p);
   void set_weight_decay(double _weight_decay);
   static void ps_update_task(Legion::Task const *task,
                              std::vector<Legion::PhysicalRegion> const &regions,
@@ -97,6 +208,27 @@ public:
                                  float *w_ptr,
                                  float *v_ptr,
                                  float *m_ptr);
+  static void ps_multi_tensor_update_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void ps_multi_tensor_update_task_cpu(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void multi_tensor_update_task_gpu(AdamOptimizer const *op,
+                                           MultiTensorUpdateArgs const &args);
+  static void multi_tensor_update_task_cpu(AdamOptimizer const *op,
+                                           MultiTensorUpdateArgs const &args);
+  static void
+      ps_sparse_update_task(Legion::Task const *task,
+                            std::vector<Legion::PhysicalRegion> const &regions,
+                            Legion::Context ctx,
+                            Legion::Runtime *runtime);
+  static void ps_sparse_update_task_gpu(AdamOptimizer const *op,
+                                        SparseUpdateArgs const &args);
 #ifdef FF_USE_NCCL
   static void
       nccl_update_task(Legion::Task const *task,
@@ -110,6 +242,23 @@ public:
                                    float *w_ptr,
                                    float *v_ptr,
                                    float *m_ptr);
+  static void nccl_multi_tensor_update_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void
+      nccl_multi_tensor_update_task_gpu(AdamOptimizer const *op,
+                                        OpMeta const *meta,
+                                        MultiTensorUpdateArgs const &args);
+  static void nccl_sparse_update_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  static void nccl_sparse_update_task_gpu(AdamOptimizer const *op,
+                                          OpMeta const *meta,
+                                          SparseUpdateArgs const &args);
 #endif
   double alpha, beta1, beta2, weight_decay, epsilon;
   double alpha_t, beta1_t, beta2_t;
@@ -0,0 +1,80 @@
+#ifndef _FLEXFLOW_ALL_TO_ALL_H
+#define _FLEXFLOW_ALL_TO_ALL_H
+
+#include "flexflow/layer.h"
+#include "flexflow/node.h"
+#include "flexflow/operator.h"
+#include "flexflow/parallel_ops/all_to_all_params.h"
+#include "parallel_op.h"
+
+namespace FlexFlow {
+
+/**
+ * @brief Moves the partitioning of a tensor from one dim to another.
+ * @details Each of the degree pieces along concat_dim is split into degree
+ * slices along split_dim, and every device sends one slice to each of the
+ * others, as in the dispatch and combine steps of expert parallelism. The
+ * number of pieces does not change, so the output can stay on the devices
+ * of the input. This is equivalent to a Combine along concat_dim followed by
+ * a Repartition along split_dim without gathering the whole tensor.
+ */
+class AllToAll : public ParallelOp {
+public:
+  using Params = AllToAllParams;
+  using Input = ParallelTensor;
+
+  AllToAll(FFModel &model,
+           const ParallelTensor input,
+           int split_legion_dim,
+           int concat_legion_dim,
+           int degree,
+           char const *name = NULL);
+  AllToAll(FFModel &model,
+           Params const &params,
+           Input const input,
+           char const *name = nullptr);
+  void create_input_partition(FFModel &model) override;
+  void init(FFModel const &) override;
+  void forward(FFModel const &) override;
+  void backward(FFModel const &) override;
+  bool get_int_parameter(PMParameter, int *) const override;
+  bool append_parallel_op_info(
+      std::vector<ParallelOpInfo> &parallel_ops) const override;
+  static OpMeta *init_task(Legion::Task const *task,
+                           std::vector<Legion::PhysicalRegion> const &regions,
+                           Legion::Context ctx,
+                           Legion::Runtime *runtime);
+  static void forward_task(Legion::Task const *task,
+                           std::vector<Legion::PhysicalRegion> const &regions,
+                           Legion::Context ctx,
+                           Legion::Runtime *runtime);
+  static void backward_task(Legion::Task const *task,
+                            std::vector<Legion::PhysicalRegion> const &regions,
+                            Legion::Context ctx,
+                            Legion::Runtime *runtime);
+  template <typename T>
+  static void
+      forward_task_with_type(Legion::Task const *task,
+                             std::vector<Legion::PhysicalRegion> const &regions,
+                             Legion::Context ctx,
+                             Legion::Runtime *runtime);
+  template <typename T>
+  static void backward_task_with_type(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+  bool measure_operator_cost(Simulator *sim,
+                             MachineView const &mv,
+                             CostMetrics &cost_metrics) const override;
+
+  Params get_params() const;
+  tl::optional<RecordFormatter> as_dot() const override;
+
+public:
+  int split_dim, concat_dim, degree;
+};
+
+}; // namespace FlexFlow
+
+#endif // _FLEXFLOW_ALL_TO_ALL_H
@@ -0,0 +1,25 @@
+#ifndef _FLEXFLOW_ALL_TO_ALL_PARAMS_H
+#define _FLEXFLOW_ALL_TO_ALL_PARAMS_H
+
+namespace FlexFlow {
+
+struct AllToAllParams {
+  // The dim whose degree is multiplied by degree
+  int split_legion_dim;
+  // The dim whose degree is divided by degree
+  int concat_legion_dim;
+  int degree;
+  bool is_valid(ParallelTensorShape const &) const;
+};
+bool operator==(AllToAllParams const &, AllToAllParams const &);
+
+} // namespace FlexFlow
+
+namespace std {
+template <>
+struct hash<FlexFlow::AllToAllParams> {
+  size_t operator()(FlexFlow::AllToAllParams const &) const;
+};
+} // namespace std
+
+#endif // _FLEXFLOW_ALL_TO_ALL_PARAMS_H
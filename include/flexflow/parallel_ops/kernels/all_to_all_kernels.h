@@ -0,0 +1,33 @@
+#ifndef _FLEXFLOW_OPS_KERNELS_ALL_TO_ALL_KERNELS_H
+#define _FLEXFLOW_OPS_KERNELS_ALL_TO_ALL_KERNELS_H
+
+#include "flexflow/device.h"
+#include "flexflow/fftype.h"
+#include "flexflow/op_meta.h"
+
+namespace FlexFlow {
+
+class AllToAllMeta : public OpMeta {
+public:
+  AllToAllMeta(FFHandler handle);
+  DataType data_type;
+};
+
+namespace Kernels {
+namespace AllToAll {
+
+// Legion moves the slices between devices when mapping the regions; the
+// kernels only touch the local piece
+template <typename T>
+void forward_kernel(T const *input_ptr, T *output_ptr, size_t num_elements);
+
+template <typename T>
+void backward_kernel(T const *output_grad_ptr,
+                     T *input_grad_ptr,
+                     size_t num_elements);
+
+} // namespace AllToAll
+} // namespace Kernels
+} // namespace FlexFlow
+
+#endif // _FLEXFLOW_OPS_KERNELS_ALL_TO_ALL_KERNELS_H
@@ -186,6 +186,10 @@ public:
   Op const *owner_op = nullptr;
   int owner_idx = 0;
   bool create_gradients = false;
+  // Set for parameters with a row-sparse gradient (e.g., embedding tables):
+  // the tensor of row ids (along the second-innermost dim) whose gradient
+  // rows may be non-zero. All other rows are kept at zero by the optimizer
+  ParallelTensorBase *sparse_grad_rows = nullptr;
 
   // The following fields are initialized after model.compile
   MachineView machine_view = MachineView::NO_VIEW;
@@ -23,6 +23,12 @@ namespace FlexFlow {
 
 class FFModel;
 
+/**
+ * @brief Condition under which FFModel::recompile_on_condition searches for
+ * a new strategy, and how it alters the model before the search.
+ * @details _alter_func may be empty. It runs before each search and can,
+ * e.g., change the search budget in the model's config.
+ */
 class RecompileState {
 public:
   RecompileState(std::function<bool(FFModel *)> _trigger_func,
@@ -32,7 +38,14 @@ public:
   void alter();
 
 public:
+  // Number of times the model switched to a new PCG
   int recompilations;
+  // Whether a search has been launched and its result not yet applied
+  bool search_in_progress;
+  // Result of the graph optimize task launched by the last trigger
+  Legion::Future search_result;
+  // Model the search in progress works on, see create_search_model
+  FFModel *search_model;
 
 private:
   std::function<bool(FFModel *)> trigger_func;
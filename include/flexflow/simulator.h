@@ -16,6 +16,7 @@
 #define _FLEXFLOW_SIMULATOR_H_
 
 #include "config.h"
+#include "cost_calibration.h"
 #include "ffconst.h"
 #include "flexflow/operator_params.h"
 #include "flexflow/utils/hash_utils.h"
@@ -85,6 +86,21 @@ public:
   size_t inputs_memory = 0, outputs_memory = 0, weights_memory = 0;
   ///< Memory usage of Op* considering parallelization over devices
   size_t op_total_mem = 0;
+  ///< Part of op_total_mem used by the outputs, which recomputation frees
+  size_t op_output_mem = 0;
+};
+
+// Arguments of MEASURE_OPERATOR_COST_TASK_ID
+struct MeasureOperatorCostArgs {
+  FFModel const *model;
+  Op const *op;
+  MachineView view;
+};
+
+// Result of MEASURE_OPERATOR_COST_TASK_ID
+struct MeasuredOperatorCost {
+  bool is_implemented;
+  CostMetrics cost_metrics;
 };
 
 class Device {
@@ -691,9 +707,26 @@ using ProfilingRecordKey = std::tuple<OperatorParameters, MachineView>;
 class Simulator {
 public:
   static constexpr float MAXIMUM_TASK_RUN_TIME = 1e7;
+  /**
+   * @brief Create a simulator that measures operators in a work_space_size
+   * byte workspace allocated in memory.
+   * @details A simulator without a machine model only measures operators and
+   * has no task manager.
+   */
   Simulator(FFModel const *model,
             FFHandler handler,
             Legion::Memory memory,
+            MachineModel *machine,
+            size_t work_space_size);
+  /**
+   * @brief Create a simulator that owns no device state, for searches that
+   * run on a CPU processor.
+   * @details Operators are measured by launching MEASURE_OPERATOR_COST_TASK_ID
+   * from ctx, which must be the context of the task using the simulator.
+   */
+  Simulator(FFModel const *model,
+            Legion::Context ctx,
+            Legion::Runtime *runtime,
             MachineModel *machine);
   ~Simulator(void);
   void free_all();
@@ -718,6 +751,24 @@ public:
   float default_estimate_sync_cost(const ParallelTensor tensor,
                                    MachineView const &view,
                                    int num_replicate_dims);
+  /**
+   * @brief Estimate the time to all-reduce the gradients of all weights of
+   * op under parallel config pc with NCCL.
+   */
+  float estimate_nccl_sync_time(Op const *op, ParallelConfig const &pc);
+  /**
+   * @brief Simulate the bucketed gradient synchronization performed by the
+   * runtime when --grad-sync-bucket-size is set and return the time at
+   * which the last bucket finishes.
+   * @details Buckets are formed in reverse topological order per set of
+   * devices, the same way as Optimizer::create_update_buckets. A bucket
+   * starts once the backward tasks of all its operators have finished and
+   * buckets are synchronized one at a time.
+   */
+  float simulate_bucketed_sync(
+      FFModel const *model,
+      std::map<Op const *, ParallelConfig> const &global,
+      std::map<Op const *, float> const &backward_finish_times);
   float simulate_runtime(FFModel const *model,
                          std::map<Op const *, ParallelConfig> const &global,
                          CompMode comp_mode);
@@ -730,6 +781,11 @@ public:
                            std::vector<Legion::PhysicalRegion> const &regions,
                            Legion::Context ctx,
                            Legion::Runtime *runtime);
+  static MeasuredOperatorCost measure_operator_cost_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
 
 public:
   Realm::RegionInstance simulatorInst;
@@ -744,12 +800,20 @@ public:
   CompMode computationMode;
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   cudaEvent_t start_event, end_event;
-#else
+#elif defined(FF_USE_HIP_ROCM)
   hipEvent_t start_event, end_event;
 #endif
   std::unordered_map<size_t, CostMetrics> hash_to_operator_cost;
   std::unordered_map<ProfilingRecordKey, CostMetrics>
       strict_hash_to_operator_cost;
+  // Per-operator-type factors loaded via --import-cost-calibration
+  CostCorrectionMap cost_corrections;
+  // Embedding gradients are synchronized as rows (--sparse-embedding-grad)
+  bool sparse_embedding_grad = false;
+  // Set by the host-only constructor, whose measurements run as tasks
+  FFModel const *measure_model = nullptr;
+  Legion::Context measure_ctx;
+  Legion::Runtime *measure_runtime = nullptr;
 
 public:
   Conv2DMeta *conv2d_meta;
@@ -768,6 +832,9 @@ public:
   int max_num_segments; // simulation could be slow if the number of segments
                         // are too large
 private:
+  bool measure_on_device(Op const *op,
+                         MachineView const &view,
+                         CostMetrics &cost_metrics);
   float estimate_repartition_xfer_cost(
       int repartition_dim,
       int repartition_degree,
@@ -775,6 +842,14 @@ private:
       ParallelTensorShape const &output_tensor_shape,
       MachineView const &source_view,
       MachineView const &target_view) const;
+  float estimate_all_to_all_xfer_cost(
+      int split_dim,
+      int concat_dim,
+      int degree,
+      ParallelTensorShape const &input_tensor_shape,
+      ParallelTensorShape const &output_tensor_shape,
+      MachineView const &source_view,
+      MachineView const &sink_view) const;
 };
 
 /**
@@ -207,6 +207,10 @@ public:
   OpX *create_replicate(TensorX const &input, int replicate_dim, int num_parts);
   OpX *create_reduction(TensorX const &input, int reduction_dim, int num_parts);
   OpX *create_combine(TensorX const &input, int combine_dim, int num_parts);
+  OpX *create_all_to_all(TensorX const &input,
+                         int split_dim,
+                         int concat_dim,
+                         int num_parts);
   bool map_output(TensorX const &src, TensorX const &dst);
 
   Graph *create_new_graph(Graph const *graph,
@@ -268,6 +272,7 @@ public:
    * @brief Substitute the mem_config with new_config.
    */
   void update_mem_optim_config(MemoryOptimConfig const &new_config);
+  MemoryOptimConfig const &get_mem_optim_config() const;
 
   /**
    * @brief Clear the optimized graph cache of this helper.
@@ -35,6 +35,10 @@ NLOHMANN_JSON_SERIALIZE_ENUM(PMParameter,
                               {PM_COMBINE_DEGREE, "PM_COMBINE_DEGREE"},
                               {PM_REDUCTION_DIM, "PM_REDUCTION_DIM"},
                               {PM_REDUCTION_DEGREE, "PM_REDUCTION_DEGREE"},
+                              {PM_ALLTOALL_SPLIT_DIM, "PM_ALLTOALL_SPLIT_DIM"},
+                              {PM_ALLTOALL_CONCAT_DIM,
+                               "PM_ALLTOALL_CONCAT_DIM"},
+                              {PM_ALLTOALL_DEGREE, "PM_ALLTOALL_DEGREE"},
                               {PM_SOFTMAX_DIM, "PM_SOFTMAX_DIM"},
                               {PM_NUM_HEADS, "PM_NUM_HEADS"},
                               {PM_PARALLEL_DIM, "PM_PARALLEL_DIM"},
@@ -128,6 +132,7 @@ NLOHMANN_JSON_SERIALIZE_ENUM(OperatorType,
                               {OP_COMBINE, "OP_COMBINE"},
                               {OP_REPLICATE, "OP_REPLICATE"},
                               {OP_REDUCTION, "OP_REDUCE"},
+                              {OP_ALLTOALL, "OP_ALLTOALL"},
                               {OP_PIPELINE, "OP_PIPELINE"},
                               {OP_FUSED_PARALLEL, "OP_FUSED_PARALLEL"}})
 
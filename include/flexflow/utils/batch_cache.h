@@ -0,0 +1,186 @@
+#ifndef _FLEXFLOW_UTILS_BATCH_CACHE_H
+#define _FLEXFLOW_UTILS_BATCH_CACHE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace FlexFlow {
+
+namespace Internal {
+
+constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t xxh_rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t xxh_read64(unsigned char const *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t xxh_read32(unsigned char const *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+  acc += input * XXH_PRIME64_2;
+  acc = xxh_rotl(acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+inline uint64_t xxh_merge_round(uint64_t acc, uint64_t val) {
+  acc ^= xxh_round(0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+} // namespace Internal
+
+/**
+ * @brief 64-bit content fingerprint of a buffer (XXH64).
+ *
+ * @details The bulk of the input is consumed in 32-byte stripes by four
+ * independent accumulators, which keeps the loop free of cross-lane
+ * dependencies so compilers can pipeline and vectorize it.  Reads assume a
+ * little-endian host, which is fine for fingerprints that never leave the
+ * process.
+ */
+inline uint64_t fingerprint(void const *data, size_t size, uint64_t seed = 0) {
+  using namespace Internal;
+  unsigned char const *p = (unsigned char const *)data;
+  unsigned char const *end = p + size;
+  uint64_t h;
+  if (size >= 32) {
+    uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    uint64_t v2 = seed + XXH_PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - XXH_PRIME64_1;
+    unsigned char const *limit = end - 32;
+    do {
+      v1 = xxh_round(v1, xxh_read64(p));
+      v2 = xxh_round(v2, xxh_read64(p + 8));
+      v3 = xxh_round(v3, xxh_read64(p + 16));
+      v4 = xxh_round(v4, xxh_read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+    h = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) +
+        xxh_rotl(v4, 18);
+    h = xxh_merge_round(h, v1);
+    h = xxh_merge_round(h, v2);
+    h = xxh_merge_round(h, v3);
+    h = xxh_merge_round(h, v4);
+  } else {
+    h = seed + XXH_PRIME64_5;
+  }
+  h += (uint64_t)size;
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxh_round(0, xxh_read64(p));
+    h = xxh_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+    h = xxh_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (*p) * XXH_PRIME64_5;
+    h = xxh_rotl(h, 11) * XXH_PRIME64_1;
+  }
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+/**
+ * @brief Least-recently-used index over a fixed number of cache slots.
+ *
+ * @details Only fingerprints and slot numbers are tracked here; the owner
+ * keeps the slot payloads and should confirm a hit against the stored data
+ * through lookup's matches callback, since distinct batches may share a
+ * fingerprint.  Both lookup and insert
+ * are O(1).
+ */
+class BatchCache {
+public:
+  explicit BatchCache(int _capacity) : capacity(_capacity) {
+    assert(capacity > 0);
+  }
+  /** @brief Slot holding fingerprint fp (marked most recent), or -1. */
+  int lookup(uint64_t fp) {
+    return lookup(fp, [](int slot) { return true; });
+  }
+  /**
+   * @brief Like lookup(fp), but the hit only counts when matches(slot)
+   * confirms that the slot holds the batch; otherwise it is a miss.
+   */
+  template <typename F>
+  int lookup(uint64_t fp, F const &matches) {
+    auto it = index.find(fp);
+    if (it == index.end() || !matches(it->second->second)) {
+      misses++;
+      return -1;
+    }
+    hits++;
+    order.splice(order.begin(), order, it->second);
+    return it->second->second;
+  }
+  /**
+   * @brief Record fp as most recent and return the slot its batch should be
+   * written to: a free slot while the cache fills up, then the slot of the
+   * least recently used entry, which is evicted.
+   */
+  int insert(uint64_t fp) {
+    auto it = index.find(fp);
+    if (it != index.end()) {
+      order.splice(order.begin(), order, it->second);
+      return it->second->second;
+    }
+    int slot;
+    if ((int)order.size() < capacity) {
+      slot = (int)order.size();
+    } else {
+      slot = order.back().second;
+      index.erase(order.back().first);
+      order.pop_back();
+    }
+    order.emplace_front(fp, slot);
+    index[fp] = order.begin();
+    return slot;
+  }
+  int size() const {
+    return (int)order.size();
+  }
+  float hit_rate() const {
+    size_t total = hits + misses;
+    return total == 0 ? 0.0f : (float)hits / (float)total;
+  }
+
+public:
+  int const capacity;
+  size_t hits = 0, misses = 0;
+
+private:
+  // most recently used entries first
+  std::list<std::pair<uint64_t, int>> order;
+  std::unordered_map<uint64_t, std::list<std::pair<uint64_t, int>>::iterator>
+      index;
+};
+
+} // namespace FlexFlow
+
+#endif // _FLEXFLOW_UTILS_BATCH_CACHE_H
@@ -0,0 +1,114 @@
+#ifndef _FLEXFLOW_UTILS_BENCHMARK_STATS_H
+#define _FLEXFLOW_UTILS_BENCHMARK_STATS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace FlexFlow {
+
+// milliseconds
+struct LatencySummary {
+  int count = 0;
+  float mean = 0.0f, stddev = 0.0f;
+  float min = 0.0f, p50 = 0.0f, p90 = 0.0f, p99 = 0.0f, max = 0.0f;
+};
+
+/**
+ * @brief Summarize latency samples; percentiles use the nearest rank, so
+ * every reported value is one of the samples.
+ */
+inline LatencySummary summarize_latencies(std::vector<float> samples) {
+  LatencySummary summary;
+  if (samples.empty()) {
+    return summary;
+  }
+  std::sort(samples.begin(), samples.end());
+  int const n = (int)samples.size();
+  auto percentile = [&](float p) {
+    int rank = (int)std::ceil(p / 100.0f * n);
+    return samples[std::min(std::max(rank, 1), n) - 1];
+  };
+  double sum = 0.0, sum_sq = 0.0;
+  for (float s : samples) {
+    sum += s;
+    sum_sq += (double)s * s;
+  }
+  summary.count = n;
+  summary.mean = (float)(sum / n);
+  summary.stddev =
+      (float)std::sqrt(std::max(0.0, sum_sq / n - (sum / n) * (sum / n)));
+  summary.min = samples.front();
+  summary.p50 = percentile(50.0f);
+  summary.p90 = percentile(90.0f);
+  summary.p99 = percentile(99.0f);
+  summary.max = samples.back();
+  return summary;
+}
+
+// One benchmarked operator configuration, identified by name across runs
+struct BenchmarkResult {
+  std::string name;
+  LatencySummary forward, backward;
+};
+
+struct BenchmarkChange {
+  std::string name;
+  bool forward;
+  float baseline_ms, current_ms;
+};
+
+struct BenchmarkDiff {
+  std::vector<BenchmarkChange> regressions, improvements;
+  // in the baseline but not measured in this run
+  std::vector<std::string> missing;
+};
+
+/**
+ * @brief Compare a run against a baseline run of the same benchmarks.
+ *
+ * @details A phase regresses when its median grows by more than tolerance
+ * (a fraction) and even its fastest sample is slower than the baseline
+ * median, so that a few noisy samples cannot flag a benchmark on their own;
+ * improvements are detected symmetrically.
+ */
+inline BenchmarkDiff
+    diff_benchmarks(std::vector<BenchmarkResult> const &current,
+                    std::vector<BenchmarkResult> const &baseline,
+                    float tolerance) {
+  assert(tolerance >= 0.0f);
+  std::map<std::string, BenchmarkResult const *> measured;
+  for (BenchmarkResult const &r : current) {
+    measured[r.name] = &r;
+  }
+  BenchmarkDiff diff;
+  for (BenchmarkResult const &base : baseline) {
+    auto it = measured.find(base.name);
+    if (it == measured.end()) {
+      diff.missing.push_back(base.name);
+      continue;
+    }
+    for (bool forward : {true, false}) {
+      LatencySummary const &b = forward ? base.forward : base.backward;
+      LatencySummary const &c =
+          forward ? it->second->forward : it->second->backward;
+      if (b.count == 0 || c.count == 0) {
+        continue;
+      }
+      BenchmarkChange change{base.name, forward, b.p50, c.p50};
+      if (c.p50 > b.p50 * (1.0f + tolerance) && c.min > b.p50) {
+        diff.regressions.push_back(change);
+      } else if (c.p50 < b.p50 * (1.0f - tolerance) && c.max < b.p50) {
+        diff.improvements.push_back(change);
+      }
+    }
+  }
+  return diff;
+}
+
+} // namespace FlexFlow
+
+#endif // _FLEXFLOW_UTILS_BENCHMARK_STATS_H
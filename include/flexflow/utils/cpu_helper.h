@@ -0,0 +1,51 @@
+#ifndef _FLEXFLOW_CPU_HELPER_H_
+#define _FLEXFLOW_CPU_HELPER_H_
+#include "flexflow/config.h"
+#include "flexflow/ffconst.h"
+#include "legion.h"
+#include <cblas.h>
+#include <iostream>
+#include <omp.h>
+#include <sstream>
+
+#define FatalError(s)                                                          \
+  do {                                                                         \
+    std::stringstream _where, _message;                                        \
+    _where << __FILE__ << ':' << __LINE__;                                     \
+    _message << std::string(s) + "\n" << __FILE__ << ':' << __LINE__;          \
+    std::cerr << _message.str() << "\nAborting...\n";                          \
+    assert(false);                                                             \
+    exit(1);                                                                   \
+  } while (0)
+
+// Wall-clock time used by the profiling output of the CPU kernels
+inline double cpu_time_in_milliseconds() {
+  return Realm::Clock::current_time_in_microseconds() * 1e-3;
+}
+
+void relu_backward_kernel(DataType data_type,
+                          void *output_grad_ptr,
+                          void const *output_ptr,
+                          size_t output_size);
+
+void sigmoid_backward_kernel(DataType data_type,
+                             void *output_grad_ptr,
+                             void const *output_ptr,
+                             size_t output_size);
+
+// Use by concat and split
+void add_with_stride(float *output,
+                     float const *input,
+                     int num_blocks,
+                     int output_blk_size,
+                     int input_blk_size);
+void copy_with_stride(float *output,
+                      float const *input,
+                      int num_blocks,
+                      int output_blk_size,
+                      int input_blk_size);
+
+template <typename T>
+void print_tensor(T const *ptr, size_t num_elements, char const *prefix);
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef _FLEXFLOW_UTILS_DEVICE_LIST_H
+#define _FLEXFLOW_UTILS_DEVICE_LIST_H
+
+#include <cassert>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Compact list of device ids.
+ *
+ * @details The placements produced by the search and by strategy files are
+ * grids of up to MAX_TENSOR_DIM dimensions, so the ids are stored inline as
+ * a start id plus an (extent, stride) pair per dimension, the first dimension
+ * varying fastest, and computed on demand; the last dimension may be
+ * partially filled.  push_back grows the grid one id at a time and adds a
+ * dimension whenever an id starts a new block of the ids seen so far.  Only
+ * ids that fit no grid spill the list to a heap buffer.  Indexing is
+ * constant time either way.
+ */
+class DeviceList {
+public:
+  DeviceList() : start(0), count(0), ndims(0) {}
+  DeviceList(int start, int count, int stride = 1)
+      : start(start), count(count > 0 ? count : 0), ndims(1) {
+    this->stride[0] = stride;
+  }
+
+  int size() const {
+    return spilled() ? (int)ids.size() : count;
+  }
+  bool empty() const {
+    return size() == 0;
+  }
+  void clear() {
+    start = count = ndims = 0;
+    ids.clear();
+  }
+  void push_back(int id) {
+    if (spilled()) {
+      ids.push_back(id);
+      return;
+    }
+    if (count == 0) {
+      start = id;
+      count = 1;
+      ndims = 1;
+      stride[0] = 0;
+      return;
+    }
+    int inner = inner_size();
+    if (count == inner) {
+      // the first id of the second block fixes the stride of the last dim
+      stride[ndims - 1] = id - start;
+    } else if (id != grid_id(count)) {
+      if (count % inner == 0 && ndims < MAX_TENSOR_DIM) {
+        // the ids so far form a full grid, make it the block of a new dim
+        extent[ndims - 1] = count / inner;
+        stride[ndims] = id - start;
+        ndims++;
+      } else {
+        ids = to_vector();
+        ids.push_back(id);
+        count = 0;
+        return;
+      }
+    }
+    count++;
+  }
+  int operator[](int idx) const {
+    assert(idx >= 0 && idx < size());
+    return spilled() ? ids[idx] : grid_id(idx);
+  }
+  std::vector<int> to_vector() const {
+    if (spilled()) {
+      return ids;
+    }
+    std::vector<int> result(count);
+    for (int i = 0; i < count; i++) {
+      result[i] = grid_id(i);
+    }
+    return result;
+  }
+  bool operator==(DeviceList const &rhs) const {
+    if (size() != rhs.size()) {
+      return false;
+    }
+    for (int i = 0; i < size(); i++) {
+      if ((*this)[i] != rhs[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool operator!=(DeviceList const &rhs) const {
+    return !(*this == rhs);
+  }
+
+private:
+  bool spilled() const {
+    return !ids.empty();
+  }
+  int grid_id(int idx) const {
+    int id = start;
+    for (int i = 0; i < ndims - 1; i++) {
+      id += (idx % extent[i]) * stride[i];
+      idx /= extent[i];
+    }
+    return id + idx * stride[ndims - 1];
+  }
+  // number of ids in a block of the last dim
+  int inner_size() const {
+    int inner = 1;
+    for (int i = 0; i < ndims - 1; i++) {
+      inner *= extent[i];
+    }
+    return inner;
+  }
+  int start, count, ndims;
+  // extent of the last dim is implied by count
+  int extent[MAX_TENSOR_DIM] = {}, stride[MAX_TENSOR_DIM] = {};
+  // every id once the list fits no grid, empty otherwise
+  std::vector<int> ids;
+};
+
+} // namespace FlexFlow
+
+#endif // _FLEXFLOW_UTILS_DEVICE_LIST_H
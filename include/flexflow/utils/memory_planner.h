@@ -0,0 +1,105 @@
+#ifndef _FLEXFLOW_UTILS_MEMORY_PLANNER_H
+#define _FLEXFLOW_UTILS_MEMORY_PLANNER_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <map>
+#include <numeric>
+#include <vector>
+
+namespace FlexFlow {
+
+// steps first through last, inclusive, during which a tensor must be kept
+struct LiveInterval {
+  int first, last;
+};
+
+struct MemoryPlan {
+  // slot assigned to each tensor
+  std::vector<int> slot_of;
+  // bytes of each slot, i.e. of its largest tensor
+  std::vector<size_t> slot_sizes;
+  // most bytes live at any single step; no assignment can use less
+  size_t lower_bound = 0;
+
+  size_t planned_bytes() const {
+    return std::accumulate(slot_sizes.begin(), slot_sizes.end(), (size_t)0);
+  }
+};
+
+/**
+ * @brief Assign tensors whose lifetimes never overlap to shared memory slots.
+ *
+ * @details Each tensor has a size and one or more live intervals over a
+ * global step order (a tensor that is discarded and recomputed is live
+ * twice).  Tensors are placed largest first, each into the smallest slot
+ * none of whose tensors is live at the same time, or into a new slot; as a
+ * slot is sized by the first tensor it receives, later tensors always fit.
+ * This is greedy colouring of the interval conflict graph weighted by size,
+ * which stays within a small factor of the liveness lower bound for the
+ * chain-like graphs produced by operator schedules.
+ */
+inline MemoryPlan
+    plan_memory(std::vector<size_t> const &sizes,
+                std::vector<std::vector<LiveInterval>> const &lifetimes) {
+  assert(sizes.size() == lifetimes.size());
+  size_t const num_tensors = sizes.size();
+  MemoryPlan plan;
+  plan.slot_of.assign(num_tensors, -1);
+  std::vector<size_t> order(num_tensors);
+  std::iota(order.begin(), order.end(), (size_t)0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return sizes[a] > sizes[b];
+  });
+  // intervals held by the tensors of each slot
+  std::vector<std::vector<LiveInterval>> slot_intervals;
+  for (size_t t : order) {
+    for (LiveInterval const &i : lifetimes[t]) {
+      assert(i.first <= i.last);
+    }
+    int best = -1;
+    for (size_t s = 0; s < slot_intervals.size(); s++) {
+      if (best >= 0 && plan.slot_sizes[s] >= plan.slot_sizes[best]) {
+        continue;
+      }
+      bool conflict = false;
+      for (LiveInterval const &a : slot_intervals[s]) {
+        for (LiveInterval const &b : lifetimes[t]) {
+          if (a.first <= b.last && b.first <= a.last) {
+            conflict = true;
+          }
+        }
+      }
+      if (!conflict) {
+        best = (int)s;
+      }
+    }
+    if (best < 0) {
+      best = (int)slot_intervals.size();
+      slot_intervals.emplace_back();
+      plan.slot_sizes.push_back(sizes[t]);
+    }
+    plan.slot_of[t] = best;
+    slot_intervals[best].insert(
+        slot_intervals[best].end(), lifetimes[t].begin(), lifetimes[t].end());
+  }
+  // sweep allocation and release events to find the liveness peak
+  std::map<int, long long> delta;
+  for (size_t t = 0; t < num_tensors; t++) {
+    for (LiveInterval const &i : lifetimes[t]) {
+      delta[i.first] += (long long)sizes[t];
+      delta[i.last + 1] -= (long long)sizes[t];
+    }
+  }
+  long long live = 0;
+  for (auto const &it : delta) {
+    live += it.second;
+    plan.lower_bound = std::max(plan.lower_bound, (size_t)live);
+  }
+  return plan;
+}
+
+} // namespace FlexFlow
+
+#endif // _FLEXFLOW_UTILS_MEMORY_PLANNER_H
@@ -0,0 +1,58 @@
+#ifndef _FLEXFLOW_UTILS_PHILOX_H
+#define _FLEXFLOW_UTILS_PHILOX_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace FlexFlow {
+
+/**
+ * @brief Philox4x32-10 counter-based random number generator.
+ *
+ * @details Maps a 128-bit counter and a 64-bit key to four random 32-bit
+ * words with no state in between, so the value drawn for an element depends
+ * only on the seed and the element's index.  Initializers use the global
+ * index of each parameter element as the counter, which makes the result
+ * independent of how the parameter is split across shards and threads.
+ */
+inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter,
+                                          std::array<uint32_t, 2> key) {
+  for (int round = 0; round < 10; round++) {
+    if (round > 0) {
+      key[0] += 0x9E3779B9u;
+      key[1] += 0xBB67AE85u;
+    }
+    uint64_t const p0 = (uint64_t)0xD2511F53u * counter[0];
+    uint64_t const p1 = (uint64_t)0xCD9E8D57u * counter[2];
+    counter = {(uint32_t)(p1 >> 32) ^ counter[1] ^ key[0],
+               (uint32_t)p1,
+               (uint32_t)(p0 >> 32) ^ counter[3] ^ key[1],
+               (uint32_t)p0};
+  }
+  return counter;
+}
+
+inline std::array<uint32_t, 4> philox4x32(uint64_t seed, uint64_t index) {
+  return philox4x32({(uint32_t)index, (uint32_t)(index >> 32), 0u, 0u},
+                    {(uint32_t)seed, (uint32_t)(seed >> 32)});
+}
+
+/** @brief Uniform float in [0, 1) drawn for element index. */
+inline float philox_uniform(uint64_t seed, uint64_t index) {
+  return (philox4x32(seed, index)[0] >> 8) * (1.0f / 16777216.0f);
+}
+
+/** @brief Standard normal float drawn for element index (Box-Muller). */
+inline float philox_normal(uint64_t seed, uint64_t index) {
+  std::array<uint32_t, 4> const r = philox4x32(seed, index);
+  // u1 in (0, 1] keeps the logarithm finite
+  float const u1 = ((r[0] >> 8) + 1) * (1.0f / 16777216.0f);
+  float const u2 = (r[1] >> 8) * (1.0f / 16777216.0f);
+  return std::sqrt(-2.0f * std::log(u1)) *
+         std::cos(6.2831853071795864f * u2);
+}
+
+} // namespace FlexFlow
+
+#endif // _FLEXFLOW_UTILS_PHILOX_H
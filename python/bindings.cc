@@ -477,10 +477,7 @@ PYBIND11_MODULE(flexflow_pybind11_internal, m) {
            "create_grad"_a = true)
       .def("get_layer_by_id", [](FFModel &m, int id) { return m.layers[id]; })
       .def("get_last_layer", [](FFModel &m) { return m.layers.back(); })
-      .def("get_perf_metrics",
-           [](FFModel &m) {
-             return m.current_metrics.get_result<PerfMetrics>();
-           })
+      .def("get_perf_metrics", &FFModel::get_perf_metrics)
       //.def("init_layers", &FFModel::init_layers)
       .def("reset_metrics", &FFModel::reset_metrics)
       .def("compute_metrics", &FFModel::compute_metrics)
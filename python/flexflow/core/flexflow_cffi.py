@@ -51,6 +51,28 @@ def get_datatype_size(datatype):
     assert 0, "unknow datatype" + str(datatype)
     return 0
 
+def as_host_array(obj):
+  """Wrap a host buffer as a NumPy array without copying it.
+
+  Accepts NumPy arrays, objects exporting the buffer protocol and CPU
+  tensors exporting DLPack (e.g. torch.Tensor); the array shares memory
+  with obj.
+  """
+  if isinstance(obj, np.ndarray):
+    return obj
+  if hasattr(obj, '__dlpack__'):
+    assert hasattr(np, 'from_dlpack'), "DLPack import needs numpy >= 1.22"
+    return np.from_dlpack(obj)
+  return np.asarray(memoryview(obj))
+
+def check_host_array(np_array, dims):
+  assert np_array.flags['C_CONTIGUOUS'], "numpy array must be C-contiguous"
+  np_shape = np_array.shape
+  num_dims = len(np_shape)
+  assert num_dims == len(dims), "please check dims (%d == %d)" %(num_dims, len(dims))
+  for i in range(0, num_dims):
+    assert np_shape[i] == dims[i], "please check shape dim %d (%d == %d)" %(i, np_shape[i], dims[i])
+
 # -----------------------------------------------------------------------
 # Op
 # -----------------------------------------------------------------------
@@ -644,12 +666,8 @@ class Tensor(object):
     return array
 
   def attach_numpy_array(self, ffmodel, ffconfig, np_array):
-    assert np_array.__array_interface__['strides'] == None, "numpy array strides is not None"
-    np_shape = np_array.shape
-    num_dims = len(np_shape)
-    assert num_dims == self.num_dims, "please check dims (%d == %d)" %(num_dims, self.num_dims)
-    for i in range(0, num_dims):
-      assert np_shape[i] == self.dims[i], "please check shape dim %d (%d == %d)" %(i, np_shape[i], self.dims[i])
+    np_array = as_host_array(np_array)
+    check_host_array(np_array, self.dims)
     np_raw_ptr = np_array.__array_interface__['data']
     raw_ptr = ffi.cast("void*", np_raw_ptr[0])
     fflogger.debug("attach numpy array: %s, %s, %s" %( str(np_raw_ptr), str(raw_ptr), hex(np_raw_ptr[0])))
@@ -662,12 +680,15 @@ class Tensor(object):
     return ffc.flexflow_tensor_is_mapped(self.handle)
     
   def set_tensor(self, ffmodel, np_array):
-    assert np_array.__array_interface__['strides'] == None, "Parameter set_weights, numpy array strides is not None"
-    np_shape = np_array.shape
-    num_dims = len(np_shape)
-    assert num_dims == self.num_dims, "please check dims (%d == %d)" %(num_dims, self.num_dims)
-    for i in range(0, num_dims):
-      assert np_shape[i] == self.dims[i], "please check shape dim %d (%d == %d)" %(i, np_shape[i], self.dims[i])
+    """Load the tensor from host memory.
+
+    np_array may be any host buffer accepted by as_host_array. It is copied
+    straight into the tensor's instances (one copy per replica), without a
+    staging copy in host memory.
+    """
+    np_array = as_host_array(np_array)
+    check_host_array(np_array, self.dims)
+    num_dims = len(self.dims)
     c_dims = ffi.new("int[]", self.dims)
     np_raw_ptr = np_array.__array_interface__['data']
     if np_array.dtype == np.float32:
@@ -678,14 +699,28 @@ class Tensor(object):
       assert self.data_type == DataType.DT_INT32, "Wrong datatype"
       raw_ptr = ffi.cast("int*", np_raw_ptr[0])
       ret_val = ffc.flexflow_tensor_set_tensor_int(self.handle, ffmodel.handle, num_dims, c_dims, raw_ptr)
+    elif np_array.dtype == np.int64:
+      assert self.data_type == DataType.DT_INT64, "Wrong datatype"
+      raw_ptr = ffi.cast("int64_t*", np_raw_ptr[0])
+      ret_val = ffc.flexflow_tensor_set_tensor_int64(self.handle, ffmodel.handle, num_dims, c_dims, raw_ptr)
     else:
       assert 0, "Unsupported datatype"
-    fflogger.debug("set tensor raw_ptr: %s, %s, %s, %s" %( str(raw_ptr), str(np_raw_ptr[0]), hex(np_raw_ptr[0]), str(np_shape)))
+    fflogger.debug("set tensor raw_ptr: %s, %s, %s, %s" %( str(raw_ptr), str(np_raw_ptr[0]), hex(np_raw_ptr[0]), str(np_array.shape)))
     assert ret_val == True, ret_val
-    
-  def get_tensor(self, ffmodel):
+
+  def get_tensor(self, ffmodel, out=None):
+    """Read the tensor into host memory.
+
+    The data is copied directly into out, which may be any writable host
+    buffer accepted by as_host_array; a new NumPy array is returned when out
+    is None.
+    """
     shape = self.dims
-    if self.data_type == DataType.DT_FLOAT:
+    if out is not None:
+      np_array = as_host_array(out)
+      check_host_array(np_array, shape)
+      assert np_array.flags['WRITEABLE'], "output buffer is read-only"
+    elif self.data_type == DataType.DT_FLOAT:
       np_array = np.empty(shape, dtype=np.float32)
     elif self.data_type == DataType.DT_INT32:
       np_array = np.empty(shape, dtype=np.int32)
@@ -695,14 +730,19 @@ class Tensor(object):
       assert 0, f"Unsupported datatype: {self.data_type}"
     np_raw_ptr = np_array.__array_interface__['data']
     if np_array.dtype == np.float32:
+      assert self.data_type == DataType.DT_FLOAT, "Wrong datatype"
       raw_ptr = ffi.cast("float*", np_raw_ptr[0])
       ret_val = ffc.flexflow_tensor_get_tensor_float(self.handle, ffmodel.handle, raw_ptr, False)
     elif np_array.dtype == np.int32:
+      assert self.data_type == DataType.DT_INT32, "Wrong datatype"
       raw_ptr = ffi.cast("int*", np_raw_ptr[0])
       ret_val = ffc.flexflow_tensor_get_tensor_int(self.handle, ffmodel.handle, raw_ptr, False)
     elif np_array.dtype == np.int64:
+      assert self.data_type == DataType.DT_INT64, "Wrong datatype"
       raw_ptr = ffi.cast("int64_t*", np_raw_ptr[0])
       ret_val = ffc.flexflow_tensor_get_tensor_int64(self.handle, ffmodel.handle, raw_ptr, False)
+    else:
+      assert 0, "Unsupported datatype"
     fflogger.debug("get weights raw_ptr: %s, %s, %s, %s" %( str(raw_ptr), str(np_raw_ptr[0]), hex(np_raw_ptr[0]), str(shape)))
     assert ret_val == True
     return np_array
@@ -1042,7 +1042,7 @@ flexflow_perf_metrics_t
     flexflow_model_get_perf_metrics(flexflow_model_t handle_) {
   FFModel *handle = FFCObjectWrapper::unwrap(handle_);
   PerfMetrics *perf_metrics = new PerfMetrics();
-  *perf_metrics = handle->current_metrics.get_result<PerfMetrics>();
+  *perf_metrics = handle->get_perf_metrics();
   DEBUG_PRINT("[Model] create PerfMetrics %p, train_correct %d",
               perf_metrics,
               perf_metrics->train_correct);
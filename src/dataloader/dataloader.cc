@@ -579,7 +579,7 @@ void SingleDataLoader::register_gpu_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(PY_DL_FLOAT_LOAD_BATCH_GPU_TASK_ID,
                                    "Float Load Inputs");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<SingleDataLoader::load_input<float>>(
@@ -596,7 +596,7 @@ void SingleDataLoader::register_gpu_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(PY_DL_INT32_LOAD_BATCH_GPU_TASK_ID,
                                    "Int32 Load Inputs");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<SingleDataLoader::load_input<int32_t>>(
@@ -613,7 +613,7 @@ void SingleDataLoader::register_gpu_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(PY_DL_INT64_LOAD_BATCH_GPU_TASK_ID,
                                    "Int64 Load Inputs");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<SingleDataLoader::load_input<int64_t>>(
@@ -0,0 +1,94 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flexflow/model.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+
+using namespace Legion;
+
+static void scale_cpu(float *ptr, size_t size, float scale) {
+#pragma omp parallel for if (size > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < size; i++) {
+    ptr[i] *= scale;
+  }
+}
+
+// logit_grad = logit - label, shared by the categorical crossentropy and the
+// mean squared error losses
+static void subtract_label_cpu(float *logit_grad,
+                               float const *logit,
+                               float const *label,
+                               size_t num_elements) {
+#pragma omp parallel for if (num_elements > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < num_elements; i++) {
+    logit_grad[i] = logit[i] - label[i];
+  }
+}
+
+void Loss::sparse_categorical_crossentropy_loss_backward_kernel_wrapper(
+    float *logit_grad_ptr,
+    float const *logit_ptr,
+    int const *label_ptr,
+    size_t logit_volume,
+    size_t logit_grad_volume,
+    int num_samples,
+    int num_classes,
+    int k,
+    float scale_factor) {
+  std::copy(logit_ptr, logit_ptr + logit_volume, logit_grad_ptr);
+  for (int i = 0; i < num_samples; i++) {
+    int label_idx = label_ptr[i / k];
+    logit_grad_ptr[(size_t)i * num_classes + label_idx] -= 1.0f;
+  }
+  // Scale logit gradients by op->scale_factor
+  scale_cpu(logit_grad_ptr, logit_grad_volume, scale_factor * k);
+}
+
+void Loss::categorical_crossentropy_loss_backward_kernel_wrapper(
+    float *logit_grad_ptr,
+    float const *logit_ptr,
+    float const *label_ptr,
+    size_t logit_volume,
+    size_t logit_grad_volume,
+    float scale_factor) {
+  subtract_label_cpu(logit_grad_ptr, logit_ptr, label_ptr, logit_volume);
+  // Scale logit gradients by loss->scale_factor
+  scale_cpu(logit_grad_ptr, logit_grad_volume, scale_factor);
+}
+
+void Loss::mean_squared_error_avg_loss_backward_kernel_wrapper(
+    float *logit_grad_ptr,
+    float const *logit_ptr,
+    float const *label_ptr,
+    size_t logit_volume,
+    size_t logit_grad_volume,
+    float scale_factor) {
+  subtract_label_cpu(logit_grad_ptr, logit_ptr, label_ptr, logit_volume);
+  // Scale logit gradients by loss->scale_factor
+  scale_cpu(logit_grad_ptr, logit_grad_volume, scale_factor);
+}
+
+void Loss::identity_loss_backward_kernel_wrapper(float *loss_grad_ptr,
+                                                 float const *loss_ptr,
+                                                 size_t loss_volume,
+                                                 size_t loss_grad_volume,
+                                                 float scale_factor) {
+  std::fill(loss_grad_ptr, loss_grad_ptr + loss_volume, 1.0f);
+  // Scale logit gradients by loss->scale_factor
+  scale_cpu(loss_grad_ptr, loss_grad_volume, scale_factor);
+}
+
+}; // namespace FlexFlow
@@ -22,6 +22,10 @@ using namespace Mapping;
 
 LegionRuntime::Logger::Category log_ff_mapper("Mapper");
 
+// Random initializers draw weights of up to this many elements on CPUs,
+// see FFMapper::initialize_on_cpu
+static size_t const CPU_INIT_MAX_VOLUME = 1 << 22;
+
 FFShardingFunctor::FFShardingFunctor(int _gpus_per_node,
                                      int _cpus_per_node,
                                      int _num_nodes,
@@ -76,18 +80,20 @@ FFMapper::FFMapper(MapperRuntime *rt,
        it != proc_query.end();
        it++) {
     address_space_set.insert(it->address_space());
-    if (it->kind() == Processor::TOC_PROC) {
+    // all_gpus holds the processors running operator tasks, which are the
+    // OpenMP processors in the cpu backend
+    if (it->kind() == DEVICE_PROC_KIND) {
       all_gpus.push_back(*it);
       if (it->address_space() == node_id) {
         local_gpus.push_back(*it);
       }
       Machine::MemoryQuery fb_query(machine);
-      fb_query.only_kind(Memory::GPU_FB_MEM);
+      fb_query.only_kind(DEVICE_MEM_KIND);
       fb_query.best_affinity_to(*it);
       assert(fb_query.count() == 1);
       proc_fbmems[*it] = *(fb_query.begin());
       Machine::MemoryQuery zc_query(machine);
-      zc_query.only_kind(Memory::Z_COPY_MEM);
+      zc_query.only_kind(HOST_MEM_KIND);
       zc_query.has_affinity_to(*it);
       assert(zc_query.count() == 1);
       proc_zcmems[*it] = *(zc_query.begin());
@@ -97,7 +103,7 @@ FFMapper::FFMapper(MapperRuntime *rt,
         local_cpus.push_back(*it);
       }
       Machine::MemoryQuery zc_query(machine);
-      zc_query.only_kind(Memory::Z_COPY_MEM);
+      zc_query.only_kind(HOST_MEM_KIND);
       zc_query.has_affinity_to(*it);
       assert(zc_query.count() == 1);
       proc_zcmems[*it] = *(zc_query.begin());
@@ -107,7 +113,7 @@ FFMapper::FFMapper(MapperRuntime *rt,
         local_pys.push_back(*it);
       }
       Machine::MemoryQuery zc_query(machine);
-      zc_query.only_kind(Memory::Z_COPY_MEM);
+      zc_query.only_kind(HOST_MEM_KIND);
       zc_query.has_affinity_to(*it);
       assert(zc_query.count() == 1);
       proc_zcmems[*it] = *(zc_query.begin());
@@ -174,7 +180,7 @@ void FFMapper::register_sharding_functor(Runtime *runtime, Machine machine) {
   int num_nodes = machine.get_address_space_count();
   gpus_per_node = Machine::ProcessorQuery(machine)
                       .local_address_space()
-                      .only_kind(Processor::TOC_PROC)
+                      .only_kind(DEVICE_PROC_KIND)
                       .count();
   cpus_per_node = Machine::ProcessorQuery(machine)
                       .local_address_space()
@@ -251,6 +257,38 @@ bool FFMapper::is_initializer_task(TaskID tid) {
   }
 }
 
+bool FFMapper::initialize_on_cpu(MapperContext ctx, Task const &task) {
+#ifdef FF_USE_CPU_ONLY
+  // The device variants of the cpu backend already draw the same values
+  return false;
+#else
+  if (task.task_id != GLOROT_INIT_TASK_ID &&
+      task.task_id != UNIFORM_INIT_TASK_ID &&
+      task.task_id != NORMAL_INIT_TASK_ID) {
+    return false;
+  }
+  // Larger weights are drawn on their GPUs with curand instead of being
+  // staged in zero-copy memory
+  assert(task.regions.size() == 1);
+  Domain domain = runtime->get_index_space_domain(
+      ctx, task.regions[0].parent.get_index_space());
+  return domain.get_volume() <= CPU_INIT_MAX_VOLUME;
+#endif
+}
+
+Processor FFMapper::cpu_near_device(Processor device, size_t idx) {
+  Memory zcmem = proc_zcmems[device];
+  std::vector<Processor> near_cpus;
+  for (size_t i = 0; i < all_cpus.size(); i++) {
+    if (all_cpus[i].address_space() == device.address_space() &&
+        proc_zcmems[all_cpus[i]] == zcmem) {
+      near_cpus.push_back(all_cpus[i]);
+    }
+  }
+  assert(near_cpus.size() > 0);
+  return near_cpus[idx % near_cpus.size()];
+}
+
 char const *FFMapper::get_mapper_name(void) const {
   return mapper_name;
 }
@@ -271,10 +309,18 @@ void FFMapper::select_task_options(const MapperContext ctx,
     output.initial_proc = all_gpus[0];
     return;
   }
-  if (task.task_id == GRAPH_OPTIMIZE_TASK_ID) {
+  if (task.task_id == GRAPH_OPTIMIZE_TASK_ID ||
+      task.task_id == MEASURE_OPERATOR_COST_TASK_ID) {
     output.initial_proc = all_gpus[0];
     return;
   }
+  if (task.task_id == GRAPH_OPTIMIZE_BACKGROUND_TASK_ID) {
+    // Keep the search off the CPU running the top-level task when possible;
+    // the search works on a copy of the model made in its parent's address
+    // space, so it stays on this node
+    output.initial_proc = local_cpus.back();
+    return;
+  }
   if (task.task_id == NCCL_GETUNIQUEID_TASK_ID) {
     output.initial_proc = all_gpus[0];
     return;
@@ -297,6 +343,11 @@ void FFMapper::select_task_options(const MapperContext ctx,
     return;
   }
 
+  if (initialize_on_cpu(ctx, task)) {
+    output.initial_proc = local_cpus[task_hash % local_cpus.size()];
+    return;
+  }
+
   if (is_parameter_server_update_task(task.task_id) ||
       is_initializer_task(task.task_id)) {
     // For Parameter Server Update, pick a processor from config
@@ -337,6 +388,14 @@ void FFMapper::select_task_options(const MapperContext ctx,
     }
   }
 
+  if ((task.task_id >= CUSTOM_GPU_TASK_ID_FIRST) &&
+      (task.task_id <= CUSTOM_GPU_TASK_ID_LAST)) {
+    if (!task.is_index_space) {
+      output.initial_proc = all_gpus[0];
+      return;
+    }
+  }
+
   if ((task.task_id == PY_DL_FLOAT_LOAD_ENTIRE_CPU_TASK_ID) ||
       (task.task_id == PY_DL_INT32_LOAD_ENTIRE_CPU_TASK_ID) ||
       (task.task_id == PY_DL_INT64_LOAD_ENTIRE_CPU_TASK_ID) ||
@@ -400,7 +459,7 @@ void FFMapper::slice_task(const MapperContext ctx,
       // No strategy found, use default data parallelism
       std::vector<VariantID> variant_ids;
       runtime->find_valid_variants(
-          ctx, task.task_id, variant_ids, Processor::TOC_PROC);
+          ctx, task.task_id, variant_ids, DEVICE_PROC_KIND);
       if (variant_ids.size() > 0) {
         // Use GPU implementation
         // Currently assume there is exactly one variant
@@ -456,6 +515,17 @@ void FFMapper::slice_task(const MapperContext ctx,
     default:
       assert(false);
   }
+  if (task.task_id == CHECKPOINT_SAVE_TASK_ID ||
+      task.task_id == CHECKPOINT_LOAD_TASK_ID || initialize_on_cpu(ctx, task)) {
+    // Checkpoint file I/O and CPU initializers run on a CPU sharing the
+    // zero-copy memory of the device owning the shard
+    for (size_t i = 0; i < output.slices.size(); i++) {
+      Processor device = output.slices[i].proc;
+      if (device.kind() == DEVICE_PROC_KIND) {
+        output.slices[i].proc = cpu_near_device(device, i);
+      }
+    }
+  }
   // In control replication, each mapper should only receive task slices
   // that should be assigned to local proccessors
   // Violation of this assertion may result in severe runtime overheads
@@ -478,6 +548,12 @@ void FFMapper::map_task(const MapperContext ctx,
                         Task const &task,
                         MapTaskInput const &input,
                         MapTaskOutput &output) {
+  // Steady-state iterations launch the same tasks on the same regions, so
+  // reuse the previous decision unless some regions are already mapped
+  bool cacheable = input.premapped_regions.empty() && !task.must_epoch_task;
+  if (cacheable && map_task_from_cache(ctx, task, output)) {
+    return;
+  }
   std::vector<VariantID> variant_ids;
   runtime->find_valid_variants(
       ctx, task.task_id, variant_ids, task.target_proc.kind());
@@ -490,13 +566,17 @@ void FFMapper::map_task(const MapperContext ctx,
   if (task.target_proc.address_space() != node_id) {
     assert(false);
     output.target_procs.push_back(task.target_proc);
-  } else if (task.target_proc.kind() == Processor::TOC_PROC) {
+  } else if (task.target_proc.kind() == DEVICE_PROC_KIND) {
     output.target_procs.push_back(task.target_proc);
   } else if (task.target_proc.kind() == Processor::LOC_PROC) {
     // Put any of our CPU procs here
     // If we're part of a must epoch launch, our
     // target proc will be sufficient
-    if (!task.must_epoch_task) {
+    // Checkpoint save/load were already placed next to their shard
+    if (!task.must_epoch_task &&
+        task.task_id != GRAPH_OPTIMIZE_BACKGROUND_TASK_ID &&
+        task.task_id != CHECKPOINT_SAVE_TASK_ID &&
+        task.task_id != CHECKPOINT_LOAD_TASK_ID) {
       output.target_procs.insert(
           output.target_procs.end(), local_cpus.begin(), local_cpus.end());
     } else {
@@ -543,6 +623,8 @@ void FFMapper::map_task(const MapperContext ctx,
       done_regions[*it] = true;
     }
   }
+  std::vector<std::pair<Memory, int>> slots(
+      task.regions.size(), std::make_pair(Memory::NO_MEMORY, -1));
   // Now we need to go through and make instances for any of our
   // regions which do not have space for certain fields
   for (unsigned idx = 0; idx < task.regions.size(); idx++) {
@@ -560,6 +642,17 @@ void FFMapper::map_task(const MapperContext ctx,
         default_select_target_memory(ctx, task.target_proc, task.regions[idx]);
     // Assert no virtual mapping for now
     assert((task.regions[idx].tag & DefaultMapper::VIRTUAL_MAP) == 0);
+    // The producer of an activation takes over its planned memory slot
+    int slot = -1;
+    bool claimed = false;
+    if (task.regions[idx].privilege & LEGION_WRITE_PRIV) {
+      slot = find_memory_slot(ctx, task.regions[idx]);
+      if (slot >= 0) {
+        claimed = claim_memory_slot(
+            ctx, target_mem, slot, task.regions[idx].parent);
+        slots[idx] = std::make_pair(target_mem, slot);
+      }
+    }
     // Check to see if any of the valid instances satisfy the requirement
     {
       std::vector<PhysicalInstance> valid_instances;
@@ -590,6 +683,10 @@ void FFMapper::map_task(const MapperContext ctx,
       output.chosen_instances[idx] = valid_instances;
       missing_fields[idx] = valid_missing_fields;
       if (missing_fields[idx].empty()) {
+        if (slot >= 0) {
+          record_slot_instances(
+              ctx, target_mem, slot, output.chosen_instances[idx], claimed);
+        }
         continue;
       }
     }
@@ -601,14 +698,26 @@ void FFMapper::map_task(const MapperContext ctx,
     size_t footprint;
     PhysicalInstance result;
     bool created;
-    if (!default_make_instance(ctx,
-                               target_mem,
-                               constraint_set,
-                               result,
-                               true /*meet_constraints*/,
-                               task.regions[idx],
-                               created,
-                               &footprint)) {
+    bool made = default_make_instance(ctx,
+                                      target_mem,
+                                      constraint_set,
+                                      result,
+                                      true /*meet_constraints*/,
+                                      task.regions[idx],
+                                      created,
+                                      &footprint);
+    if (!made && release_dead_slot_instances(ctx, target_mem)) {
+      // Retry once the instances of dead activations can be collected
+      made = default_make_instance(ctx,
+                                   target_mem,
+                                   constraint_set,
+                                   result,
+                                   true /*meet_constraints*/,
+                                   task.regions[idx],
+                                   created,
+                                   &footprint);
+    }
+    if (!made) {
       if (log_instance_creation) {
         for (size_t idx = 0; idx < created_instances.size(); idx++) {
           log_ff_mapper.print("Instance[%zu]: memory:" IDFMT "	proc:" IDFMT
@@ -636,6 +745,10 @@ void FFMapper::map_task(const MapperContext ctx,
     } else {
       output.chosen_instances[idx].push_back(result);
     }
+    if (slot >= 0) {
+      record_slot_instances(
+          ctx, target_mem, slot, output.chosen_instances[idx], claimed);
+    }
     if (log_instance_creation && created) {
       // Log instance creation
       InstanceCreationLog clog;
@@ -646,6 +759,174 @@ void FFMapper::map_task(const MapperContext ctx,
       created_instances.push_back(clog);
     }
   } // for idx
+  if (cacheable) {
+    CachedMapping &cached = cached_mappings[std::make_tuple(
+        compute_task_hash(task), task.index_point, task.target_proc)];
+    cached.regions.clear();
+    for (unsigned idx = 0; idx < task.regions.size(); idx++) {
+      cached.regions.push_back(task.regions[idx].region);
+    }
+    cached.chosen_variant = output.chosen_variant;
+    cached.target_procs = output.target_procs;
+    cached.chosen_instances = output.chosen_instances;
+    cached.slots = slots;
+  }
+}
+
+bool FFMapper::map_task_from_cache(const MapperContext ctx,
+                                   Task const &task,
+                                   MapTaskOutput &output) {
+  auto const key = std::make_tuple(
+      compute_task_hash(task), task.index_point, task.target_proc);
+  auto const &it = cached_mappings.find(key);
+  if (it == cached_mappings.end()) {
+    return false;
+  }
+  // The hash covers the region trees but not the subregions of a partition
+  bool same_regions = it->second.regions.size() == task.regions.size();
+  for (unsigned idx = 0; same_regions && idx < task.regions.size(); idx++) {
+    same_regions = it->second.regions[idx] == task.regions[idx].region;
+  }
+  if (!same_regions) {
+    return false;
+  }
+  // Copy the decision first: acquiring may let other mapper calls run
+  CachedMapping cached = it->second;
+  if (!runtime->acquire_instances(ctx, cached.chosen_instances)) {
+    // Some instances were collected since, so map from scratch
+    cached_mappings.erase(key);
+    return false;
+  }
+  output.chosen_variant = cached.chosen_variant;
+  output.task_priority = 0;
+  output.postmap_task = false;
+  output.target_procs = cached.target_procs;
+  output.chosen_instances = cached.chosen_instances;
+  for (unsigned idx = 0; idx < cached.slots.size(); idx++) {
+    Memory mem = cached.slots[idx].first;
+    int slot = cached.slots[idx].second;
+    if (slot >= 0) {
+      bool claimed =
+          claim_memory_slot(ctx, mem, slot, task.regions[idx].parent);
+      record_slot_instances(
+          ctx, mem, slot, output.chosen_instances[idx], claimed);
+    }
+  }
+  return true;
+}
+
+int FFMapper::find_memory_slot(const MapperContext ctx,
+                               RegionRequirement const &req) {
+  void const *result;
+  size_t size;
+  if (!runtime->retrieve_semantic_information(ctx,
+                                              req.parent,
+                                              MEMORY_SLOT_SEMANTIC_TAG,
+                                              result,
+                                              size,
+                                              true /*can_fail*/,
+                                              false /*wait_until_ready*/)) {
+    return -1;
+  }
+  assert(size == sizeof(int));
+  return *(int const *)result;
+}
+
+std::mutex FFMapper::memory_slots_lock;
+std::map<std::pair<Memory, int>, FFMapper::MemorySlot> FFMapper::memory_slots;
+
+bool FFMapper::claim_memory_slot(const MapperContext ctx,
+                                 Memory mem,
+                                 int slot,
+                                 LogicalRegion region) {
+  std::vector<PhysicalInstance> dead_instances;
+  {
+    std::lock_guard<std::mutex> guard(memory_slots_lock);
+    MemorySlot &memory_slot = memory_slots[std::make_pair(mem, slot)];
+    if (memory_slot.region == region) {
+      return false;
+    }
+    dead_instances.swap(memory_slot.instances);
+    memory_slot.dead_instances.insert(memory_slot.dead_instances.end(),
+                                      dead_instances.begin(),
+                                      dead_instances.end());
+    memory_slot.region = region;
+  }
+  // The plan guarantees the previous occupant is dead by now, so its
+  // instances are the first to go when this memory runs out of space
+  for (PhysicalInstance const &instance : dead_instances) {
+    runtime->set_garbage_collection_priority(
+        ctx, instance, LEGION_GC_FIRST_PRIORITY);
+  }
+  return true;
+}
+
+void FFMapper::record_slot_instances(
+    const MapperContext ctx,
+    Memory mem,
+    int slot,
+    std::vector<PhysicalInstance> const &instances,
+    bool claimed) {
+  {
+    std::lock_guard<std::mutex> guard(memory_slots_lock);
+    MemorySlot &memory_slot = memory_slots[std::make_pair(mem, slot)];
+    for (PhysicalInstance const &instance : instances) {
+      if (std::find(memory_slot.instances.begin(),
+                    memory_slot.instances.end(),
+                    instance) == memory_slot.instances.end()) {
+        memory_slot.instances.push_back(instance);
+      }
+      // An instance of a previous occupant may be reused by this one
+      memory_slot.dead_instances.erase(
+          std::remove(memory_slot.dead_instances.begin(),
+                      memory_slot.dead_instances.end(),
+                      instance),
+          memory_slot.dead_instances.end());
+    }
+  }
+  if (claimed) {
+    for (PhysicalInstance const &instance : instances) {
+      runtime->set_garbage_collection_priority(
+          ctx, instance, LEGION_GC_DEFAULT_PRIORITY);
+    }
+  }
+}
+
+bool FFMapper::release_dead_slot_instances(const MapperContext ctx,
+                                           Memory mem) {
+  std::set<PhysicalInstance> dead_instances;
+  {
+    std::lock_guard<std::mutex> guard(memory_slots_lock);
+    for (auto &it : memory_slots) {
+      if (it.first.first == mem) {
+        dead_instances.insert(it.second.dead_instances.begin(),
+                              it.second.dead_instances.end());
+        it.second.dead_instances.clear();
+      }
+    }
+  }
+  if (dead_instances.empty()) {
+    return false;
+  }
+  // Cached mappings would acquire these instances again and keep them alive
+  for (auto it = cached_mappings.begin(); it != cached_mappings.end();) {
+    bool uses_dead_instance = false;
+    for (auto const &instances : it->second.chosen_instances) {
+      for (PhysicalInstance const &instance : instances) {
+        uses_dead_instance |= dead_instances.count(instance) > 0;
+      }
+    }
+    if (uses_dead_instance) {
+      it = cached_mappings.erase(it);
+    } else {
+      it++;
+    }
+  }
+  for (PhysicalInstance const &instance : dead_instances) {
+    runtime->set_garbage_collection_priority(
+        ctx, instance, LEGION_GC_FIRST_PRIORITY);
+  }
+  return true;
 }
 
 void FFMapper::map_replicate_task(const MapperContext ctx,
@@ -1270,7 +1551,7 @@ std::vector<Processor> const &
   switch (kind) {
     case Processor::LOC_PROC:
       return all_cpus;
-    case Processor::TOC_PROC:
+    case DEVICE_PROC_KIND:
       return all_gpus;
     case Processor::PY_PROC:
       return all_pys;
@@ -1283,7 +1564,7 @@ std::vector<Processor> const &
 Memory FFMapper::default_select_target_memory(MapperContext ctx,
                                               Processor target_proc,
                                               RegionRequirement const &req) {
-  if (target_proc.kind() == Processor::TOC_PROC) {
+  if (target_proc.kind() == DEVICE_PROC_KIND) {
     if (req.tag == MAP_TO_ZC_MEMORY) {
       assert(proc_zcmems.find(target_proc) != proc_zcmems.end());
       return proc_zcmems[target_proc];
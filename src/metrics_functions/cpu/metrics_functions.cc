@@ -0,0 +1,143 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flexflow/model.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <cmath>
+
+namespace FlexFlow {
+
+float const LOG_MIN_VALUE = 0.00000001f;
+
+// Metrics are accumulated serially since a batch only has a few samples per
+// processor, which avoids the atomics of the GPU kernels
+void Metrics::update_metrics_sparse_label_kernel_wrapper(
+    float const *logit_ptr,
+    int const *label_ptr,
+    Metrics const *me,
+    int num_effective_samples,
+    int num_classes,
+    PerfMetrics &perf) {
+  for (int b = 0; b < num_effective_samples; b++) {
+    float const *logits = logit_ptr + (size_t)b * num_classes;
+    if (me->measure_accuracy) {
+      float max_val = -1.0f;
+      int my_label = -1;
+      for (int i = 0; i < num_classes; i++) {
+        if (logits[i] > max_val) {
+          max_val = logits[i];
+          my_label = i;
+        }
+      }
+      assert(my_label >= 0);
+      perf.train_all += 1;
+      if (label_ptr[b] == my_label) {
+        perf.train_correct += 1;
+      }
+    }
+    if (me->measure_sparse_categorical_crossentropy) {
+      float my_logit = std::max(logits[label_ptr[b]], LOG_MIN_VALUE);
+      perf.sparse_cce_loss += -std::log(my_logit);
+    }
+    if (me->measure_mean_squared_error ||
+        me->measure_root_mean_squared_error ||
+        me->measure_mean_absolute_error) {
+      float mse = 0.0f, mae = 0.0f;
+      for (int i = 0; i < num_classes; i++) {
+        float my_label = (label_ptr[b] == i) ? 1.0f : 0.0f;
+        mse += (logits[i] - my_label) * (logits[i] - my_label);
+        mae += std::abs(logits[i] - my_label);
+      }
+      if (me->measure_mean_squared_error) {
+        perf.mse_loss += mse;
+      }
+      if (me->measure_root_mean_squared_error) {
+        perf.rmse_loss += std::sqrt(mse);
+      }
+      if (me->measure_mean_absolute_error) {
+        perf.mae_loss += mae;
+      }
+    }
+  }
+}
+
+void Metrics::update_metrics_label_kernel_wrapper(float const *logit_ptr,
+                                                  float const *label_ptr,
+                                                  Metrics const *me,
+                                                  int num_samples,
+                                                  int num_classes,
+                                                  PerfMetrics &perf) {
+  for (int b = 0; b < num_samples; b++) {
+    float const *logits = logit_ptr + (size_t)b * num_classes;
+    float const *labels = label_ptr + (size_t)b * num_classes;
+    perf.train_all += 1;
+    if (me->measure_accuracy) {
+      if (num_classes == 1) {
+        // accuracy does not make sense when num_classes = 1
+        // we just return 100%
+        perf.train_all += 1;
+        perf.train_correct += 1;
+      } else {
+        float max_val = 0.0f;
+        int my_label = -1, true_label = -1;
+        for (int i = 0; i < num_classes; i++) {
+          if (my_label == -1 || logits[i] > max_val) {
+            max_val = logits[i];
+            my_label = i;
+          }
+          if (labels[i] > 0.9f) {
+            assert(true_label == -1);
+            true_label = i;
+          }
+        }
+        assert(my_label >= 0);
+        assert(true_label >= 0);
+        if (true_label == my_label) {
+          perf.train_correct += 1;
+        }
+      }
+    }
+    if (me->measure_categorical_crossentropy) {
+      float cce = 0.0f;
+      for (int i = 0; i < num_classes; i++) {
+        if (labels[i] > 0.0f) {
+          float my_logit = std::max(logits[i], LOG_MIN_VALUE);
+          cce += labels[i] * -std::log(my_logit);
+        }
+      }
+      perf.cce_loss += cce;
+    }
+    if (me->measure_mean_squared_error ||
+        me->measure_root_mean_squared_error ||
+        me->measure_mean_absolute_error) {
+      float mse = 0.0f, mae = 0.0f;
+      for (int i = 0; i < num_classes; i++) {
+        float diff = logits[i] - labels[i];
+        mse += diff * diff;
+        mae += std::abs(diff);
+      }
+      if (me->measure_mean_squared_error) {
+        perf.mse_loss += mse;
+      }
+      if (me->measure_root_mean_squared_error) {
+        perf.rmse_loss += std::sqrt(mse);
+      }
+      if (me->measure_mean_absolute_error) {
+        perf.mae_loss += mae;
+      }
+    }
+  }
+}
+
+}; // namespace FlexFlow
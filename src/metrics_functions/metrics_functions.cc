@@ -97,14 +97,13 @@ void Metrics::compute(FFModel *model,
       label->part, 0 /*projection id*/, READ_ONLY, EXCLUSIVE, label->region));
   launcher.add_field(1, FID_DATA);
   FutureMap new_metrics = runtime->execute_index_space(ctx, launcher);
-  // Update metrics
-  TaskLauncher metrics_task(UPDATE_METRICS_TASK_ID,
-                            TaskArgument(this, sizeof(Metrics)));
-  metrics_task.add_future(model->current_metrics);
-  for (Domain::DomainPointIterator it(part_domain); it; it++) {
-    metrics_task.add_future(new_metrics[*it]);
+  // Reduce the shards without waiting on them and fold the result into
+  // current_metrics once every print-frequency iterations
+  model->pending_metrics.push_back(runtime->reduce_future_map(
+      ctx, new_metrics, PERF_METRICS_REDOP_ID, true /*deterministic*/));
+  if ((int)model->pending_metrics.size() >= model->config.printFreq) {
+    model->flush_metrics();
   }
-  model->current_metrics = runtime->execute_task(ctx, metrics_task);
 }
 
 PerfMetrics Metrics::compute_task(Task const *task,
@@ -181,6 +180,8 @@ PerfMetrics
   return perf_zc;
 }
 
+PerfMetrics const PerfMetricsReduction::identity;
+
 PerfMetrics::PerfMetrics(void)
     : train_all(0), train_correct(0), cce_loss(0.0f), sparse_cce_loss(0.0f),
       mse_loss(0.0f), rmse_loss(0.0f), mae_loss(0.0f) {
@@ -466,7 +466,7 @@ OpMeta *
   assert(attn->oProjSize == acc_output.rect.hi[0] - acc_output.rect.lo[0] + 1);
 
   Memory gpu_mem = Machine::MemoryQuery(Machine::get_machine())
-                       .only_kind(Memory::GPU_FB_MEM)
+                       .only_kind(DEVICE_MEM_KIND)
                        .best_affinity_to(task->target_proc)
                        .first();
   MultiHeadAttentionMeta *m =
@@ -35,22 +35,16 @@ using Legion::TaskArgument;
 using Legion::TaskLauncher;
 
 // Moving average over batches: 1 if batch is perfectly cached, 0 else.
-template <typename T>
+// Hits are already confirmed byte for byte by Cache::update_batches.
 float default_score(float *cached_score,
                     void const *input,
                     void const *cached,
                     int vol) {
   float gamma = 0.99f;
   *cached_score *= gamma;
-  float w = 1.0f - gamma;
-  T *cast_input = (T *)input;
-  T *cast_cached = (T *)cached;
-  for (int i = 0; i < vol; i++) {
-    if (cast_input[i] != cast_cached[i]) {
-      return *cached_score;
-    }
+  if (cached != nullptr) {
+    *cached_score += 1.0f - gamma;
   }
-  *cached_score += w;
   return *cached_score;
 }
 
@@ -62,17 +56,7 @@ Tensor FFModel::cache(
   assert(false);
 #ifdef DEADCODE
   if (!score_f) {
-    switch (input->data_type) {
-      case DT_FLOAT:
-        score_f = default_score<float>;
-        break;
-      case DT_INT32:
-        score_f = default_score<int32_t>;
-        break;
-      default:
-        assert(false && "unsupported data type");
-        break;
-    }
+    score_f = default_score;
   }
   Cache *cache = new Cache(*this, input, num_batches, score_f, name);
   layers.push_back(cache);
@@ -95,8 +79,8 @@ Cache::Cache(
          1 /*outptus*/,
          _input),
       num_batches(_num_batches), score_f(_score_f) {
+  assert(num_batches > 0);
   load_cached = false;
-  batch_ctr = 0;
 
   int num_dim = inputs[0]->num_dims;
   ParallelDim dims[MAX_TENSOR_DIM];
@@ -110,37 +94,9 @@ Cache::Cache(
   numWeights = 0;
 }
 
-Cache::~Cache() {
-  for (int i = 0; i < num_batches; i++) {
-    free(batch_ptrs[i]);
-  }
-  free(batch_ptrs);
-  free(batch_cmp);
-}
-
-template <typename T>
-void cache_init(Cache *cache, size_t vol) {
-  // init pointer array
-  cache->batch_ptrs = (void **)malloc(cache->num_batches * sizeof(T *));
-  for (int i = 0; i < cache->num_batches; i++) {
-    cache->batch_ptrs[i] = malloc(vol * sizeof(T));
-  }
-  cache->batch_cmp = malloc(vol * sizeof(T));
-}
+Cache::~Cache() {}
 
 void Cache::init(FFModel const &ff) {
-  size_t vol = inputs[0]->get_volume();
-  switch (inputs[0]->data_type) {
-    case DT_FLOAT:
-      cache_init<float>(this, vol);
-      break;
-    case DT_INT32:
-      cache_init<int32_t>(this, vol);
-      break;
-    default:
-      assert(false && "unsupported data type");
-      break;
-  }
   ArgumentMap argmap;
   Context ctx = ff.config.lg_ctx;
   Runtime *runtime = ff.config.lg_hlr;
@@ -165,8 +121,10 @@ OpMeta *Cache::init_task(Task const *task,
                          Runtime *runtime) {
   Cache *c = (Cache *)task->args;
   FFHandler handle = *((FFHandler const *)task->local_args);
-  CacheMeta *m = new CacheMeta(handle);
+  CacheMeta *m = new CacheMeta(handle, c->num_batches);
   m->cache_score = 0.0f;
+  m->batch_bytes = 0;
+  m->last_slot = -1;
   m->profiling = c->profiling;
   return m;
 }
@@ -177,7 +135,7 @@ void Cache::forward(FFModel const &ff) {
   Runtime *runtime = ff.config.lg_hlr;
   set_argumentmap_for_init(ff, argmap);
   parallel_is = outputs[0]->parallel_is;
-  Arg arg = {this, batch_ctr};
+  Arg arg = {this};
   // Launch update task
   IndexLauncher launcher_update(CACHE_UPDATE_TASK_ID,
                                 parallel_is,
@@ -226,9 +184,15 @@ void Cache::forward(FFModel const &ff) {
                                                           EXCLUSIVE,
                                                           outputs[0]->region));
     launcher_fwd.add_field(0, FID_DATA);
+    // Not read: only orders this task after the update of the same batch
+    launcher_fwd.add_region_requirement(RegionRequirement(inputs[0]->part,
+                                                          0 /*projection id*/,
+                                                          READ_ONLY,
+                                                          EXCLUSIVE,
+                                                          inputs[0]->region));
+    launcher_fwd.add_field(1, FID_DATA);
     runtime->execute_index_space(ctx, launcher_fwd);
   }
-  batch_ctr = (batch_ctr + 1) % num_batches;
 }
 
 void Cache::forward_task(Task const *task,
@@ -236,8 +200,8 @@ void Cache::forward_task(Task const *task,
                          Context ctx,
                          Runtime *runtime) {
   Cache *c = ((Arg *)(task->args))->cache;
-  assert((int)regions.size() == 1);
-  assert((int)task->regions.size() == 1);
+  assert((int)regions.size() == 2);
+  assert((int)task->regions.size() == 2);
 
   switch (c->inputs[0]->data_type) {
     case DT_FLOAT:
@@ -276,6 +240,32 @@ float Cache::update_task(Task const *task,
   }
 }
 
+float Cache::update_batches(CacheMeta *m,
+                            void const *batch,
+                            int vol,
+                            size_t data_size) const {
+  size_t bytes = vol * data_size;
+  if (m->slots.empty()) {
+    m->batch_bytes = bytes;
+    m->slots.resize(num_batches * bytes);
+  }
+  assert(bytes == m->batch_bytes);
+  uint64_t fp = fingerprint(batch, bytes);
+  // Distinct batches may share a fingerprint, so confirm the hit
+  int slot = m->batches.lookup(fp, [&](int s) {
+    return memcmp(m->slots.data() + s * bytes, batch, bytes) == 0;
+  });
+  char *cached = slot >= 0 ? m->slots.data() + slot * bytes : nullptr;
+  float score = score_f(&m->cache_score, batch, cached, vol);
+  if (cached == nullptr) {
+    // Evicts the least recently used batch, or overwrites a colliding one
+    slot = m->batches.insert(fp);
+    memcpy(m->slots.data() + slot * bytes, batch, bytes);
+  }
+  m->last_slot = slot;
+  return score;
+}
+
 bool Cache::measure_operator_cost(Simulator *sim,
                                   MachineView const &mv,
                                   CostMetrics &cost_metrics) const {
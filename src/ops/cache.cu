@@ -20,6 +20,7 @@ namespace FlexFlow {
 
 // declare Legion names
 using Legion::Context;
+using Legion::Domain;
 using Legion::PhysicalRegion;
 using Legion::Runtime;
 using Legion::Task;
@@ -29,12 +30,10 @@ void Cache::cache_forward(Task const *task,
                           std::vector<PhysicalRegion> const &regions,
                           Context ctx,
                           Runtime *runtime) {
-  Cache *c = ((Arg *)(task->args))->cache;
   CacheMeta const *m = *((CacheMeta **)task->local_args);
-  int batch_ctr = ((Arg *)(task->args))->batch_ctr;
-  T **batch_ptrs = (T **)c->batch_ptrs;
   T *output_ptr = helperGetTensorPointerWO<T>(
       regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  assert(m->last_slot >= 0);
 
   // TODO: Check why cublas/cudnn stream is needed here
   cudaStream_t stream;
@@ -43,8 +42,8 @@ void Cache::cache_forward(Task const *task,
   checkCUDNN(cudnnSetStream(m->handle.dnn, stream));
 
   cudaMemcpy(output_ptr,
-             batch_ptrs[batch_ctr],
-             c->inputs[0]->get_volume() * sizeof(T),
+             m->slots.data() + m->last_slot * m->batch_bytes,
+             m->batch_bytes,
              cudaMemcpyHostToDevice);
 }
 
@@ -54,27 +53,25 @@ float Cache::cache_update(Task const *task,
                           Context ctx,
                           Runtime *runtime) {
   Cache *c = ((Arg *)(task->args))->cache;
-  int batch_ctr = ((Arg *)(task->args))->batch_ctr;
   CacheMeta *m = *((CacheMeta **)task->local_args);
+  Domain domain = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  size_t vol = domain.get_volume();
 
+  // Fingerprints are computed on a host copy, which also becomes the cached
+  // batch on a miss
   T const *input_ptr = helperGetTensorPointerRW<T>(
       regions[0], task->regions[0], FID_DATA, ctx, runtime);
-  T *host_input = (T *)c->batch_cmp;
-  cudaMemcpy(host_input,
+  m->staging.resize(vol * sizeof(T));
+  cudaMemcpy(m->staging.data(),
              input_ptr,
-             c->inputs[0]->get_volume() * sizeof(T),
+             vol * sizeof(T),
              cudaMemcpyDeviceToHost);
-  float cache_score = c->score_f(&m->cache_score,
-                                 host_input,
-                                 c->batch_ptrs[batch_ctr],
-                                 c->inputs[0]->get_volume());
-  memcpy(c->batch_ptrs[batch_ctr],
-         host_input,
-         c->inputs[0]->get_volume() * sizeof(T));
-  return cache_score;
+  return c->update_batches(m, m->staging.data(), vol, sizeof(T));
 }
 
-CacheMeta::CacheMeta(FFHandler handler) : OpMeta(handler) {}
+CacheMeta::CacheMeta(FFHandler handler, int num_batches)
+    : OpMeta(handler), batches(num_batches) {}
 
 template void
     Cache::cache_forward<float>(Task const *task,
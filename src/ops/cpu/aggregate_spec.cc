@@ -0,0 +1,60 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/aggregate_spec.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+
+// TODO: the mixture-of-experts aggregation is not implemented by the cpu
+// backend yet
+
+/*static*/
+void AggregateSpec::forward_kernel_wrapper(AggregateSpecMeta const *m,
+                                           float **exp_preds,
+                                           int const *acc_gate_assign_ptr,
+                                           float *acc_output_ptr,
+                                           int n,
+                                           int const k,
+                                           int rows,
+                                           int const batch_size,
+                                           int out_dim) {
+  assert(false && "AggregateSpec is not supported by the cpu backend");
+}
+
+/*static*/
+void AggregateSpec::backward_kernel_wrapper(AggregateSpecMeta const *m,
+                                            float **exp_grads,
+                                            int const *acc_gate_assign_ptr,
+                                            int const *acc_true_gate_assign_ptr,
+                                            float const *acc_gate_pred_ptr,
+                                            float *acc_full_gate_grad_ptr,
+                                            float const *acc_output_grad_ptr,
+                                            int n,
+                                            int const k,
+                                            int rows,
+                                            float lambda_bal,
+                                            int const batch_size,
+                                            int out_dim) {
+  assert(false && "AggregateSpec is not supported by the cpu backend");
+}
+
+AggregateSpecMeta::AggregateSpecMeta(FFHandler handler, int n)
+    : OpMeta(handler) {
+  dev_region_ptrs = nullptr;
+}
+AggregateSpecMeta::~AggregateSpecMeta(void) {}
+
+}; // namespace FlexFlow
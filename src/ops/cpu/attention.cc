@@ -0,0 +1,104 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/attention.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+
+// declare Legion names
+using Legion::Memory;
+
+// TODO: the GPU backends rely on cuDNN's multi-head attention, which has no
+// counterpart on the cpu backend yet
+
+/*static*/
+void MultiHeadAttention::forward_kernel(MultiHeadAttentionMeta const *m,
+                                        float const *query_ptr,
+                                        float const *key_ptr,
+                                        float const *value_ptr,
+                                        float const *weight_ptr,
+                                        float *output_ptr,
+                                        ffStream_t stream) {
+  assert(false && "MultiHeadAttention is not supported by the cpu backend");
+}
+
+/*static*/
+void MultiHeadAttention::forward_kernel_wrapper(MultiHeadAttentionMeta const *m,
+                                                float const *query_ptr,
+                                                float const *key_ptr,
+                                                float const *value_ptr,
+                                                float const *weight_ptr,
+                                                float *output_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  MultiHeadAttention::forward_kernel(
+      m, query_ptr, key_ptr, value_ptr, weight_ptr, output_ptr, stream);
+}
+
+/*static*/
+void MultiHeadAttention::backward_kernel(MultiHeadAttentionMeta const *m,
+                                         float const *query_ptr,
+                                         float *query_grad_ptr,
+                                         float const *key_ptr,
+                                         float *key_grad_ptr,
+                                         float const *value_ptr,
+                                         float *value_grad_ptr,
+                                         float const *weight_ptr,
+                                         float *weight_grad_ptr,
+                                         float const *output_grad_ptr,
+                                         ffStream_t stream) {
+  assert(false && "MultiHeadAttention is not supported by the cpu backend");
+}
+
+/*static*/
+void MultiHeadAttention::backward_kernel_wrapper(
+    MultiHeadAttentionMeta const *m,
+    float const *query_ptr,
+    float *query_grad_ptr,
+    float const *key_ptr,
+    float *key_grad_ptr,
+    float const *value_ptr,
+    float *value_grad_ptr,
+    float const *weight_ptr,
+    float *weight_grad_ptr,
+    float const *output_grad_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  MultiHeadAttention::backward_kernel(m,
+                                      query_ptr,
+                                      query_grad_ptr,
+                                      key_ptr,
+                                      key_grad_ptr,
+                                      value_ptr,
+                                      value_grad_ptr,
+                                      weight_ptr,
+                                      weight_grad_ptr,
+                                      output_grad_ptr,
+                                      stream);
+}
+
+MultiHeadAttentionMeta::MultiHeadAttentionMeta(FFHandler handler,
+                                               MultiHeadAttention const *attn,
+                                               Memory gpu_mem,
+                                               int num_samples,
+                                               int num_heads)
+    : OpMeta(handler) {
+  assert(false && "MultiHeadAttention is not supported by the cpu backend");
+}
+
+MultiHeadAttentionMeta::~MultiHeadAttentionMeta(void) {}
+
+}; // namespace FlexFlow
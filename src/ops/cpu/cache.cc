@@ -0,0 +1,84 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/cache.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+
+// declare Legion names
+using Legion::Context;
+using Legion::Domain;
+using Legion::PhysicalRegion;
+using Legion::Runtime;
+using Legion::Task;
+
+template <typename T>
+void Cache::cache_forward(Task const *task,
+                          std::vector<PhysicalRegion> const &regions,
+                          Context ctx,
+                          Runtime *runtime) {
+  CacheMeta const *m = *((CacheMeta **)task->local_args);
+  T *output_ptr = helperGetTensorPointerWO<T>(
+      regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  assert(m->last_slot >= 0);
+
+  memcpy(output_ptr,
+         m->slots.data() + m->last_slot * m->batch_bytes,
+         m->batch_bytes);
+}
+
+template <typename T>
+float Cache::cache_update(Task const *task,
+                          std::vector<PhysicalRegion> const &regions,
+                          Context ctx,
+                          Runtime *runtime) {
+  Cache *c = ((Arg *)(task->args))->cache;
+  CacheMeta *m = *((CacheMeta **)task->local_args);
+  Domain domain = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+
+  // The input already lives in host memory, so it is hashed in place
+  T const *input_ptr = helperGetTensorPointerRW<T>(
+      regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  return c->update_batches(m, input_ptr, domain.get_volume(), sizeof(T));
+}
+
+CacheMeta::CacheMeta(FFHandler handler, int num_batches)
+    : OpMeta(handler), batches(num_batches) {}
+
+template void
+    Cache::cache_forward<float>(Task const *task,
+                                std::vector<PhysicalRegion> const &regions,
+                                Context ctx,
+                                Runtime *runtime);
+template void
+    Cache::cache_forward<int32_t>(Task const *task,
+                                  std::vector<PhysicalRegion> const &regions,
+                                  Context ctx,
+                                  Runtime *runtime);
+
+template float
+    Cache::cache_update<float>(Task const *task,
+                               std::vector<PhysicalRegion> const &regions,
+                               Context ctx,
+                               Runtime *runtime);
+template float
+    Cache::cache_update<int32_t>(Task const *task,
+                                 std::vector<PhysicalRegion> const &regions,
+                                 Context ctx,
+                                 Runtime *runtime);
+
+}; // namespace FlexFlow
@@ -0,0 +1,128 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/groupby.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+namespace FlexFlow {
+
+// Map each of the k * batch_size (sample, expert) assignments to its row in
+// the output tensor of the chosen expert, or to nullptr if the expert has
+// no capacity left and the sample is dropped
+static void get_expert_rows(float **tensors,
+                            int const *exp_assign,
+                            int n,
+                            int k,
+                            float alpha,
+                            int batch_size,
+                            int data_dim,
+                            std::vector<float *> &rows) {
+  int exp_tensor_rows = ceil(alpha * k / n * batch_size);
+  std::vector<int> expert_idx(n, 0);
+  rows.resize(k * batch_size);
+  for (int i = 0; i < k * batch_size; i++) {
+    int expert = exp_assign[i];
+    if (expert_idx[expert] >= exp_tensor_rows) {
+      // dropped sample
+      rows[i] = nullptr;
+      continue;
+    }
+    rows[i] = tensors[expert] + expert_idx[expert] * data_dim;
+    expert_idx[expert]++;
+  }
+}
+
+/*static*/
+void Group_by::forward_kernel_wrapper(
+    GroupByMeta const *m,
+    float const *input,
+    int const *exp_assign,
+    float **outputs,
+    int n,       // num experts
+    int k,       // chosen experts
+    float alpha, // factor additional memory assigned
+    int batch_size,
+    int data_dim) {
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  std::vector<float *> chosen_exp_preds;
+  get_expert_rows(
+      outputs, exp_assign, n, k, alpha, batch_size, data_dim, chosen_exp_preds);
+#pragma omp parallel for if (k * batch_size * data_dim > CPU_PARALLEL_THRESHOLD)
+  for (int i = 0; i < k * batch_size; i++) {
+    if (chosen_exp_preds[i] != nullptr) {
+      float const *a = input + (i / k) * data_dim;
+      std::copy(a, a + data_dim, chosen_exp_preds[i]);
+    }
+  }
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("[GroupBy] forward time = %.2lfms\n", elapsed);
+  }
+}
+
+void Group_by::backward_kernel_wrapper(
+    GroupByMeta const *m,
+    float *input_grad,
+    int const *exp_assign,
+    float **output_grads,
+    int n,       // num experts
+    int k,       // chosen experts
+    float alpha, // factor additional memory assigned
+    int batch_size,
+    int data_dim) {
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  std::vector<float *> chosen_exp_grads;
+  get_expert_rows(output_grads,
+                  exp_assign,
+                  n,
+                  k,
+                  alpha,
+                  batch_size,
+                  data_dim,
+                  chosen_exp_grads);
+  // Same as the GPU kernels, the gradient of a sample is overwritten by each
+  // of its chosen experts; samples are split across threads
+#pragma omp parallel for if (k * batch_size * data_dim > CPU_PARALLEL_THRESHOLD)
+  for (int b = 0; b < batch_size; b++) {
+    for (int j = 0; j < k; j++) {
+      float const *grad = chosen_exp_grads[b * k + j];
+      if (grad != nullptr) {
+        std::copy(grad, grad + data_dim, input_grad + b * data_dim);
+      }
+    }
+  }
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("[GroupBy] backward time = %.2lfms\n", elapsed);
+  }
+}
+
+GroupByMeta::GroupByMeta(FFHandler handler, int n) : OpMeta(handler) {
+  // Expert tensors are addressed directly from the host on CPUs
+  dev_region_ptrs = nullptr;
+}
+GroupByMeta::~GroupByMeta(void) {}
+
+}; // namespace FlexFlow
@@ -0,0 +1,186 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/layer_norm.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <algorithm>
+#include <cmath>
+
+namespace FlexFlow {
+
+LayerNormMeta::LayerNormMeta(FFHandler handle, LayerNorm const *ln)
+    : OpMeta(handle) {
+  elementwise_affine = ln->elementwise_affine;
+  effective_batch_size = ln->effective_batch_size;
+  effective_num_elements = ln->effective_num_elements;
+  profiling = ln->profiling;
+  eps = ln->eps;
+  // Only the row statistics are kept between forward and backward, the
+  // other GPU scratch buffers are folded into the per-row loops below
+  mean_ptr = (float *)malloc(sizeof(float) * effective_batch_size);
+  rstd_ptr = (float *)malloc(sizeof(float) * effective_batch_size);
+  ds_ptr = db_ptr = scale_ptr = bias_ptr = nullptr;
+}
+
+/*static*/
+template <typename T>
+void LayerNorm::forward_kernel(LayerNormMeta const *m,
+                               T const *in_ptr,
+                               T *out_ptr,
+                               T *gamma_ptr,
+                               T *beta_ptr,
+                               ffStream_t stream) {
+  const int64_t M = m->effective_batch_size;
+  const int64_t N = m->effective_num_elements;
+#pragma omp parallel for if (M * N > CPU_PARALLEL_THRESHOLD)
+  for (int64_t i = 0; i < M; i++) {
+    T const *X = in_ptr + i * N;
+    T *Y = out_ptr + i * N;
+    T sum1 = 0;
+    T sum2 = 0;
+    for (int64_t j = 0; j < N; j++) {
+      sum1 += X[j];
+      sum2 += X[j] * X[j];
+    }
+    const T scale = T(1) / static_cast<T>(N);
+    sum1 *= scale;
+    sum2 = std::max(sum2 * scale - sum1 * sum1, T(0));
+    const T rstd = T(1) / std::sqrt(sum2 + static_cast<T>(m->eps));
+    m->mean_ptr[i] = sum1;
+    m->rstd_ptr[i] = rstd;
+    for (int64_t j = 0; j < N; j++) {
+      const T gamma_v = gamma_ptr == nullptr ? T(1) : gamma_ptr[j];
+      const T beta_v = beta_ptr == nullptr ? T(0) : beta_ptr[j];
+      Y[j] = (X[j] - sum1) * rstd * gamma_v + beta_v;
+    }
+  }
+}
+
+/*static*/
+template <typename T>
+void LayerNorm::forward_kernel_wrapper(LayerNormMeta const *m,
+                                       T const *in_ptr,
+                                       T *out_ptr,
+                                       T *gamma_ptr,
+                                       T *beta_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  LayerNorm::forward_kernel<float>(
+      m, in_ptr, out_ptr, gamma_ptr, beta_ptr, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("[LayerNorm] forward time (CF) = %.2fms\n", elapsed);
+    print_tensor<T>(in_ptr, 32, "[LayerNorm:forward:input]");
+    print_tensor<T>(out_ptr, 32, "[LayerNorm:forward:output]");
+  }
+}
+
+/*static*/
+template <typename T>
+void LayerNorm::backward_kernel(LayerNormMeta const *m,
+                                T const *output_grad_ptr,
+                                T const *input_ptr,
+                                T *input_grad_ptr,
+                                T const *gamma_ptr,
+                                T *gamma_grad_ptr,
+                                T *beta_grad_ptr,
+                                ffStream_t stream) {
+  // NOTE: all gradients are accumulated
+  const int64_t M = m->effective_batch_size;
+  const int64_t N = m->effective_num_elements;
+  T const *mean = m->mean_ptr;
+  T const *rstd = m->rstd_ptr;
+  // Input gradients: rows are independent
+#pragma omp parallel for if (M * N > CPU_PARALLEL_THRESHOLD)
+  for (int64_t i = 0; i < M; i++) {
+    T const *dY = output_grad_ptr + i * N;
+    T const *X = input_ptr + i * N;
+    T *dX = input_grad_ptr + i * N;
+    T ds = 0;
+    T db = 0;
+    for (int64_t j = 0; j < N; j++) {
+      const T gamma_v = gamma_ptr == nullptr ? T(1) : gamma_ptr[j];
+      ds += dY[j] * X[j] * gamma_v;
+      db += dY[j] * gamma_v;
+    }
+    const T s = T(1) / static_cast<T>(N);
+    const T a = (db * mean[i] - ds) * rstd[i] * rstd[i] * rstd[i] * s;
+    const T b = -(a * mean[i] + db * rstd[i] * s);
+    for (int64_t j = 0; j < N; j++) {
+      const T gamma_v = gamma_ptr == nullptr ? T(1) : gamma_ptr[j];
+      dX[j] += rstd[i] * dY[j] * gamma_v + a * X[j] + b;
+    }
+  }
+  // Gamma and beta gradients: columns are independent
+  if (gamma_grad_ptr != NULL || beta_grad_ptr != NULL) {
+#pragma omp parallel for if (M * N > CPU_PARALLEL_THRESHOLD)
+    for (int64_t j = 0; j < N; j++) {
+      T sum1 = 0;
+      T sum2 = 0;
+      for (int64_t i = 0; i < M; i++) {
+        const int64_t index = i * N + j;
+        sum1 += output_grad_ptr[index] * (input_ptr[index] - mean[i]) * rstd[i];
+        sum2 += output_grad_ptr[index];
+      }
+      if (gamma_grad_ptr != NULL) {
+        gamma_grad_ptr[j] += sum1;
+      }
+      if (beta_grad_ptr != NULL) {
+        beta_grad_ptr[j] += sum2;
+      }
+    }
+  }
+}
+
+/*static*/
+template <typename T>
+void LayerNorm::backward_kernel_wrapper(LayerNormMeta const *m,
+                                        T const *output_grad_ptr,
+                                        T const *input_ptr,
+                                        T *input_grad_ptr,
+                                        T const *gamma_ptr,
+                                        T *gamma_grad_ptr,
+                                        T *beta_grad_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  LayerNorm::backward_kernel<float>(m,
+                                    output_grad_ptr,
+                                    input_ptr,
+                                    input_grad_ptr,
+                                    gamma_ptr,
+                                    gamma_grad_ptr,
+                                    beta_grad_ptr,
+                                    stream);
+}
+
+template void LayerNorm::forward_kernel_wrapper<float>(LayerNormMeta const *m,
+                                                       float const *in_ptr,
+                                                       float *out_ptr,
+                                                       float *gamma_ptr,
+                                                       float *beta_ptr);
+template void
+    LayerNorm::backward_kernel_wrapper<float>(LayerNormMeta const *m,
+                                              float const *output_grad_ptr,
+                                              float const *input_ptr,
+                                              float *input_grad_ptr,
+                                              float const *gamma_ptr,
+                                              float *gamma_grad_ptr,
+                                              float *beta_grad_ptr);
+
+}; // namespace FlexFlow
@@ -0,0 +1,119 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/reduce.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <vector>
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::coord_t;
+using Legion::Domain;
+
+ReduceMeta::ReduceMeta(FFHandler handler,
+                       Reduce const *rd,
+                       Domain const &input_domain)
+    : OpMeta(handler) {
+  Domain output_domain = input_domain;
+  for (size_t i = 0; i < rd->num_axes; i++) {
+    assert(input_domain.dim > rd->axes[i]);
+    output_domain.rect_data[rd->axes[i] + output_domain.dim] =
+        output_domain.rect_data[rd->axes[i]];
+  }
+  this->input_domain = input_domain;
+  this->output_domain = output_domain;
+}
+
+ReduceMeta::~ReduceMeta(void) {}
+
+// Split the input into the offsets of the kept dimensions, one per output
+// element, and the offsets of the reduced dimensions, so that each output
+// element is the sum of input[kept[o] + reduced[r]] over all r
+static void get_reduce_offsets(ReduceMeta const *m,
+                               std::vector<coord_t> &kept,
+                               std::vector<coord_t> &reduced) {
+  kept.assign(1, 0);
+  reduced.assign(1, 0);
+  coord_t stride = 1;
+  for (int d = 0; d < m->input_domain.get_dim(); d++) {
+    coord_t in_extent = m->input_domain.hi()[d] - m->input_domain.lo()[d] + 1;
+    coord_t out_extent =
+        m->output_domain.hi()[d] - m->output_domain.lo()[d] + 1;
+    std::vector<coord_t> &offsets = out_extent == in_extent ? kept : reduced;
+    size_t num_offsets = offsets.size();
+    for (coord_t i = 1; i < in_extent; i++) {
+      for (size_t j = 0; j < num_offsets; j++) {
+        offsets.push_back(offsets[j] + i * stride);
+      }
+    }
+    stride *= in_extent;
+  }
+}
+
+void Reduce::forward_kernel(ReduceMeta const *m,
+                            float const *input_ptr,
+                            float *output_ptr,
+                            ffStream_t stream) {
+  std::vector<coord_t> kept, reduced;
+  get_reduce_offsets(m, kept, reduced);
+  coord_t num_outputs = kept.size();
+  coord_t num_reduced = reduced.size();
+#pragma omp parallel for if (num_outputs * num_reduced > CPU_PARALLEL_THRESHOLD)
+  for (coord_t o = 0; o < num_outputs; o++) {
+    float sum = 0.0f;
+    for (coord_t r = 0; r < num_reduced; r++) {
+      sum += input_ptr[kept[o] + reduced[r]];
+    }
+    output_ptr[o] = sum;
+  }
+};
+
+/*static*/
+void Reduce::forward_kernel_wrapper(ReduceMeta const *m,
+                                    GenericTensorAccessorR const &input,
+                                    GenericTensorAccessorW const &output) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  Reduce::forward_kernel(
+      m, input.get_float_ptr(), output.get_float_ptr(), stream);
+}
+
+void Reduce::backward_kernel(ReduceMeta const *m,
+                             float const *output_grad_ptr,
+                             float *input_grad_ptr,
+                             ffStream_t stream) {
+  // NOTE: gradients are accumulated into input_grad
+  std::vector<coord_t> kept, reduced;
+  get_reduce_offsets(m, kept, reduced);
+  coord_t num_outputs = kept.size();
+  coord_t num_reduced = reduced.size();
+#pragma omp parallel for if (num_outputs * num_reduced > CPU_PARALLEL_THRESHOLD)
+  for (coord_t o = 0; o < num_outputs; o++) {
+    for (coord_t r = 0; r < num_reduced; r++) {
+      input_grad_ptr[kept[o] + reduced[r]] += output_grad_ptr[o];
+    }
+  }
+}
+
+void Reduce::backward_kernel_wrapper(ReduceMeta const *m,
+                                     GenericTensorAccessorR const &output_grad,
+                                     GenericTensorAccessorW const &input_grad) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  Reduce::backward_kernel(
+      m, output_grad.get_float_ptr(), input_grad.get_float_ptr(), stream);
+}
+
+}; // namespace FlexFlow
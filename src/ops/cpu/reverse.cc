@@ -0,0 +1,101 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/reverse.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <algorithm>
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::coord_t;
+
+static void reverse_forward_kernel(float const *in_ptr,
+                                   float *out_ptr,
+                                   coord_t num_out_blks,
+                                   coord_t reverse_dim_size,
+                                   coord_t in_blk_size) {
+  coord_t num_rows = num_out_blks * reverse_dim_size;
+#pragma omp parallel for if (num_rows * in_blk_size > CPU_PARALLEL_THRESHOLD)
+  for (coord_t row = 0; row < num_rows; row++) {
+    coord_t blk_idx = row / reverse_dim_size;
+    coord_t reverse_dim_idx = row % reverse_dim_size;
+    float const *in = in_ptr + (blk_idx * reverse_dim_size +
+                                (reverse_dim_size - 1 - reverse_dim_idx)) *
+                                   in_blk_size;
+    std::copy(in, in + in_blk_size, out_ptr + row * in_blk_size);
+  }
+}
+
+/*static*/
+void Reverse::forward_kernel(float const *in_ptr,
+                             float *out_ptr,
+                             coord_t num_out_blks,
+                             coord_t reverse_dim_size,
+                             coord_t in_blk_size,
+                             coord_t output_size,
+                             ffStream_t stream) {
+  reverse_forward_kernel(
+      in_ptr, out_ptr, num_out_blks, reverse_dim_size, in_blk_size);
+}
+
+/*static*/
+void Reverse::forward_kernel_wrapper(float const *in_ptr,
+                                     float *out_ptr,
+                                     coord_t num_out_blks,
+                                     coord_t reverse_dim_size,
+                                     coord_t in_blk_size,
+                                     coord_t output_size) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  Reverse::forward_kernel(in_ptr,
+                          out_ptr,
+                          num_out_blks,
+                          reverse_dim_size,
+                          in_blk_size,
+                          output_size,
+                          stream);
+}
+
+/*static*/
+void Reverse::backward_kernel(float const *out_grad_ptr,
+                              float *in_grad_ptr,
+                              coord_t num_out_blks,
+                              coord_t reverse_dim_size,
+                              coord_t in_blk_size,
+                              coord_t input_size,
+                              ffStream_t stream) {
+  reverse_forward_kernel(
+      out_grad_ptr, in_grad_ptr, num_out_blks, reverse_dim_size, in_blk_size);
+}
+
+/*static*/
+void Reverse::backward_kernel_wrapper(float const *out_grad_ptr,
+                                      float *in_grad_ptr,
+                                      coord_t num_out_blks,
+                                      coord_t reverse_dim_size,
+                                      coord_t in_blk_size,
+                                      coord_t input_size) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  Reverse::backward_kernel(out_grad_ptr,
+                           in_grad_ptr,
+                           num_out_blks,
+                           reverse_dim_size,
+                           in_blk_size,
+                           input_size,
+                           stream);
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,140 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/topk.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::coord_t;
+
+/*static*/
+void TopK::forward_kernel(TopKMeta const *m,
+                          float const *input_ptr,
+                          float *output_ptr,
+                          int *indices_ptr,
+                          size_t batch_size,
+                          int length,
+                          int k,
+                          bool sorted,
+                          ffStream_t stream) {
+  // Like TensorFlow's TopK, ties are broken in favor of lower indices and
+  // the results are always sorted in descending order
+  assert(k <= length);
+#pragma omp parallel for if (batch_size * length > CPU_PARALLEL_THRESHOLD)
+  for (size_t b = 0; b < batch_size; b++) {
+    float const *in = input_ptr + b * length;
+    std::vector<int> order(length);
+    std::iota(order.begin(), order.end(), 0);
+    std::partial_sort(
+        order.begin(), order.begin() + k, order.end(), [&](int x, int y) {
+          return in[x] > in[y] || (in[x] == in[y] && x < y);
+        });
+    for (int i = 0; i < k; i++) {
+      output_ptr[b * k + i] = in[order[i]];
+      indices_ptr[b * k + i] = order[i];
+    }
+  }
+}
+
+/*static*/
+void TopK::forward_kernel_wrapper(TopKMeta const *m,
+                                  float const *input_ptr,
+                                  float *output_ptr,
+                                  int *indices_ptr,
+                                  size_t batch_size,
+                                  int length,
+                                  int k,
+                                  bool sorted) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+
+  TopK::forward_kernel(m,
+                       input_ptr,
+                       output_ptr,
+                       indices_ptr,
+                       batch_size,
+                       length,
+                       k,
+                       sorted,
+                       stream);
+
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("[TopK] forward time = %.2lfms\n", elapsed);
+  }
+}
+
+/*static*/
+void TopK::backward_kernel(TopKMeta const *m,
+                           float const *value_grad_ptr,
+                           int const *indices_ptr,
+                           float *in_grad_ptr,
+                           size_t batch_size,
+                           int length,
+                           int k,
+                           ffStream_t stream) {
+  // NOTE: gradients are accumulated into in_grad; each row is owned by one
+  // thread since its k indices are distinct
+#pragma omp parallel for if (batch_size * k > CPU_PARALLEL_THRESHOLD)
+  for (size_t b = 0; b < batch_size; b++) {
+    for (int i = 0; i < k; i++) {
+      in_grad_ptr[b * length + indices_ptr[b * k + i]] +=
+          value_grad_ptr[b * k + i];
+    }
+  }
+}
+
+/*static*/
+void TopK::backward_kernel_wrapper(TopKMeta const *m,
+                                   float const *value_grad_ptr,
+                                   int const *indices_ptr,
+                                   float *in_grad_ptr,
+                                   size_t batch_size,
+                                   int length,
+                                   int k) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+
+  TopK::backward_kernel(m,
+                        value_grad_ptr,
+                        indices_ptr,
+                        in_grad_ptr,
+                        batch_size,
+                        length,
+                        k,
+                        stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("[TopK] backward time = %.2lfms\n", elapsed);
+  }
+}
+
+TopKMeta::TopKMeta(FFHandler handler) : OpMeta(handler) {}
+
+}; // namespace FlexFlow
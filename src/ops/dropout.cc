@@ -165,7 +165,7 @@ OpMeta *Dropout::init_task(Task const *task,
   Domain output_domain = runtime->get_index_space_domain(
       ctx, task->regions[1].region.get_index_space());
   Memory gpu_mem = Machine::MemoryQuery(Machine::get_machine())
-                       .only_kind(Memory::GPU_FB_MEM)
+                       .only_kind(DEVICE_MEM_KIND)
                        .best_affinity_to(task->target_proc)
                        .first();
   assert(input_domain == output_domain);
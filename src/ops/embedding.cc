@@ -315,6 +315,10 @@ Embedding::Embedding(FFModel &model,
                                                      true /*create_grad*/,
                                                      weight_initializer,
                                                      CHOSEN_SYNC_TYPE);
+    if (model.config.sparse_embedding_grad && dtype == DT_FLOAT) {
+      // Backward only accumulates into the rows looked up by the input
+      weights[0]->sparse_grad_rows = _input;
+    }
   }
 
   outputs[0] = model.create_parallel_tensor_legion_ordering(
@@ -367,6 +371,31 @@ void Embedding::init(FFModel const &ff) {
   FutureMap fm = runtime->execute_index_space(ctx, launcher);
   fm.wait_all_results();
   set_opmeta_from_futuremap(ff, fm);
+  if (weights[0]->sparse_grad_rows != nullptr &&
+      ff.config.computationMode == COMP_MODE_TRAINING) {
+    // zero_grad skips row-sparse gradients, which the optimizer resets row
+    // by row after each update; they only need to be cleared once here
+    ZeroInitMeta meta;
+    meta.op_ptr = this;
+    meta.num_regions = 1;
+    meta.data_types[0] = weights[0]->data_type;
+    IndexLauncher zero_launcher(ZERO_INIT_TASK_ID,
+                                parallel_is,
+                                TaskArgument(&meta, sizeof(ZeroInitMeta)),
+                                argmap,
+                                Predicate::TRUE_PRED,
+                                false /*must*/,
+                                0 /*mapper_id*/,
+                                outputs[0]->machine_view.hash());
+    zero_launcher.add_region_requirement(
+        RegionRequirement(weights[0]->part_grad,
+                          0 /*projection id*/,
+                          WRITE_ONLY,
+                          EXCLUSIVE,
+                          weights[0]->region_grad));
+    zero_launcher.add_field(0, FID_DATA);
+    runtime->execute_index_space(ctx, zero_launcher);
+  }
 }
 
 OpMeta *Embedding::init_task(Task const *task,
@@ -157,6 +157,63 @@ bool FusedOp::add_operator(FFModel &model, Op *op) {
         "Reach to the fusion limit. Consider increase MAX_NUM_FUSED_OPERATORS");
     return false;
   }
+  // Check the tensor limits before changing any state, so that a rejected
+  // operator leaves this FusedOp unchanged
+  int new_inputs = 0, new_weights = 0, new_outputs = 0;
+  for (int i = 0; i < op->numInputs; i++) {
+    LogicalRegion region = op->inputs[i]->region;
+    bool found = false;
+    for (int j = 0; j < numInputs && !found; j++) {
+      found = inputs[j]->region == region;
+    }
+    for (int j = 0; j < numOutputs && !found; j++) {
+      found = outputs[j]->region == region;
+    }
+    for (int j = 0; j < i && !found; j++) {
+      found = op->inputs[j]->region == region;
+    }
+    new_inputs += found ? 0 : 1;
+  }
+  for (int i = 0; i < op->numWeights; i++) {
+    LogicalRegion region = op->weights[i]->region;
+    bool found = false;
+    for (int j = 0; j < numWeights && !found; j++) {
+      found = weights[j]->region == region;
+    }
+    for (int j = 0; j < i && !found; j++) {
+      found = op->weights[j]->region == region;
+    }
+    new_weights += found ? 0 : 1;
+  }
+  for (int i = 0; i < op->numOutputs; i++) {
+    LogicalRegion region = op->outputs[i]->region;
+    bool found = false;
+    for (int j = 0; j < numOutputs && !found; j++) {
+      found = outputs[j]->region == region;
+    }
+    for (int j = 0; j < i && !found; j++) {
+      found = op->outputs[j]->region == region;
+    }
+    new_outputs += found ? 0 : 1;
+  }
+  if (numInputs + new_inputs > MAX_NUM_INPUTS) {
+    fprintf(stderr,
+            "Reach to the #inputs limit during fusion.\n"
+            "Consider increase MAX_NUM_INPUTS to allow more fusions.\n");
+    return false;
+  }
+  if (numWeights + new_weights > MAX_NUM_WEIGHTS) {
+    fprintf(stderr,
+            "Reach to the #weights limit during fusion.\n"
+            "Consider increase MAX_NUM_WEIGHTS to allow more fusions.\n");
+    return false;
+  }
+  if (numOutputs + new_outputs > MAX_NUM_OUTPUTS) {
+    fprintf(stderr,
+            "Reach to the #outputs limit during fusion.\n"
+            "Consider increase MAX_NUM_OUTPUTS to allow more fusions.\n");
+    return false;
+  }
   // Set inputs
   for (int i = 0; i < op->numInputs; i++) {
     bool found = false;
@@ -251,23 +308,9 @@ bool FusedOp::add_operator(FFModel &model, Op *op) {
   operators[numOperators] = op;
   numOperators += 1;
   assert(numOperators <= MAX_NUM_FUSED_OPERATORS);
-  if (numInputs > MAX_NUM_INPUTS) {
-    fprintf(stderr,
-            "Reach to the #inputs limit during fusion.\n"
-            "Consider increase MAX_NUM_INPUTS to allow more fusions.\n");
-    return false;
-  }
-  if (numWeights > MAX_NUM_WEIGHTS) {
-    fprintf(stderr,
-            "Reach to the #weights limit during fusion.\n"
-            "Consider increase MAX_NUM_WEIGHTS to allow more fusions.\n");
-    return false;
-  }
-  if (numOutputs > MAX_NUM_OUTPUTS) {
-    fprintf(stderr,
-            "Reach to the #outputs limit during fusion.\n"
-            "Consider increase MAX_NUM_OUTPUTS to allow more fusions.\n");
-  }
+  assert(numInputs <= MAX_NUM_INPUTS);
+  assert(numWeights <= MAX_NUM_WEIGHTS);
+  assert(numOutputs <= MAX_NUM_OUTPUTS);
   return true;
 }
 
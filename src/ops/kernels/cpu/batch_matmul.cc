@@ -0,0 +1,279 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/kernels/batch_matmul_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+
+BatchMatmulMeta::BatchMatmulMeta(FFHandler handler) : OpMeta(handler) {}
+
+namespace Kernels {
+namespace BatchMatmul {
+
+void forward_kernel_wrapper(BatchMatmulMeta const *meta,
+                            float *o_ptr,
+                            float const *a_ptr,
+                            float const *b_ptr,
+                            float const *c_ptr,
+                            int m,
+                            int n,
+                            int k,
+                            int batch,
+                            int a_seq_length_dim,
+                            int b_seq_length_dim,
+                            int seq_length) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+
+  double t_start = 0;
+  if (meta->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::forward_kernel(meta,
+                           o_ptr,
+                           a_ptr,
+                           b_ptr,
+                           c_ptr,
+                           m,
+                           n,
+                           k,
+                           batch,
+                           stream,
+                           a_seq_length_dim,
+                           b_seq_length_dim,
+                           seq_length);
+  if (meta->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("BatchMatmul forward time = %.2lfms\n", elapsed);
+  }
+}
+
+void backward_kernel_wrapper(BatchMatmulMeta const *meta,
+                             float const *o_ptr,
+                             float const *o_grad_ptr,
+                             float const *a_ptr,
+                             float *a_grad_ptr,
+                             float const *b_ptr,
+                             float *b_grad_ptr,
+                             float *c_grad_ptr,
+                             int m,
+                             int n,
+                             int k,
+                             int batch) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+
+  double t_start = 0;
+  if (meta->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::backward_kernel(meta,
+                            o_ptr,
+                            o_grad_ptr,
+                            a_ptr,
+                            a_grad_ptr,
+                            b_ptr,
+                            b_grad_ptr,
+                            c_grad_ptr,
+                            m,
+                            n,
+                            k,
+                            batch,
+                            stream);
+  if (meta->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("BatchMatmul backward time = %.2lfms\n", elapsed);
+  }
+}
+
+namespace Internal {
+
+// Column-major strided batched GEMM with the semantics of
+// cublasSgemmStridedBatched, parallelized across the batch
+static void sgemm_strided_batched(CBLAS_TRANSPOSE trans_a,
+                                  CBLAS_TRANSPOSE trans_b,
+                                  int m,
+                                  int n,
+                                  int k,
+                                  float alpha,
+                                  float const *a_ptr,
+                                  int lda,
+                                  long long int stride_a,
+                                  float const *b_ptr,
+                                  int ldb,
+                                  long long int stride_b,
+                                  float beta,
+                                  float *c_ptr,
+                                  int ldc,
+                                  long long int stride_c,
+                                  int batch) {
+#pragma omp parallel for if (batch > 1)
+  for (int i = 0; i < batch; i++) {
+    cblas_sgemm(CblasColMajor,
+                trans_a,
+                trans_b,
+                m,
+                n,
+                k,
+                alpha,
+                a_ptr + i * stride_a,
+                lda,
+                b_ptr + i * stride_b,
+                ldb,
+                beta,
+                c_ptr + i * stride_c,
+                ldc);
+  }
+}
+
+/*
+A: (batch, n, k)
+B: (batch, k, m)
+O: (batch, n, m)
+O = A * B
+*/
+
+void forward_kernel(BatchMatmulMeta const *meta,
+                    float *o_ptr,
+                    float const *a_ptr,
+                    float const *b_ptr,
+                    float const *c_ptr,
+                    int m,
+                    int n,
+                    int k,
+                    int batch,
+                    ffStream_t stream,
+                    int a_seq_length_dim,
+                    int b_seq_length_dim,
+                    int seq_length) {
+  // int a_stride = n * k;
+  // int b_stride = m * k;
+  // int o_stride = n * m;
+  int lda = k;
+  int ldb = m;
+  int ldo = m;
+  long long int strideA = (long long int)n * k;
+  long long int strideB = (long long int)k * m;
+  long long int strideO = (long long int)n * m;
+  if ((a_seq_length_dim == 0) && (seq_length >= 0)) {
+    assert(seq_length <= k);
+    k = seq_length;
+    assert(b_seq_length_dim == 1);
+  } else if ((a_seq_length_dim == 1) && (seq_length >= 0)) {
+    assert(seq_length <= n);
+    n = seq_length;
+  } else {
+    // currently only support a_seq_length_dim = 0 or 1
+    assert((a_seq_length_dim < 0) || (seq_length < 0));
+  }
+  if ((b_seq_length_dim == 0) && (seq_length >= 0)) {
+    assert(seq_length <= m);
+    m = seq_length;
+  } else if ((b_seq_length_dim == 1) && (seq_length >= 0)) {
+    assert(a_seq_length_dim == 0);
+    assert(k == seq_length);
+  } else {
+    // currently only support a_seq_length_dim = 0 or 1
+    assert((b_seq_length_dim < 0) || (seq_length < 0));
+  }
+
+  float alpha = 1.0f, beta = 0.0f;
+  sgemm_strided_batched(CblasNoTrans,
+                        CblasNoTrans,
+                        m,
+                        n,
+                        k,
+                        alpha,
+                        b_ptr,
+                        ldb,
+                        strideB,
+                        a_ptr,
+                        lda,
+                        strideA,
+                        beta,
+                        o_ptr,
+                        ldo,
+                        strideO,
+                        batch);
+  // current assume c is null
+  assert(c_ptr == NULL);
+}
+
+/*
+A, AGrad: (batch, n, k)
+B, BGrad: (batch, k, m)
+O, OGrad: (batch, n, m)
+AGrad = OGrad * B^T
+BGrad = A^T * OGrad
+*/
+void backward_kernel(BatchMatmulMeta const *meta,
+                     float const *o_ptr,
+                     float const *o_grad_ptr,
+                     float const *a_ptr,
+                     float *a_grad_ptr,
+                     float const *b_ptr,
+                     float *b_grad_ptr,
+                     float *c_grad_ptr,
+                     int m,
+                     int n,
+                     int k,
+                     int batch,
+                     ffStream_t stream) {
+  int a_stride = n * k;
+  int b_stride = m * k;
+  int o_stride = n * m;
+  float alpha = 1.0f;
+  sgemm_strided_batched(CblasTrans,
+                        CblasNoTrans,
+                        k,
+                        n,
+                        m,
+                        alpha,
+                        b_ptr,
+                        m,
+                        b_stride,
+                        o_grad_ptr,
+                        m,
+                        o_stride,
+                        alpha,
+                        a_grad_ptr,
+                        k,
+                        a_stride,
+                        batch);
+  sgemm_strided_batched(CblasNoTrans,
+                        CblasTrans,
+                        m,
+                        k,
+                        n,
+                        alpha,
+                        o_grad_ptr,
+                        m,
+                        o_stride,
+                        a_ptr,
+                        k,
+                        a_stride,
+                        alpha,
+                        b_grad_ptr,
+                        m,
+                        b_stride,
+                        batch);
+  assert(c_grad_ptr == NULL);
+}
+
+} // namespace Internal
+} // namespace BatchMatmul
+} // namespace Kernels
+} // namespace FlexFlow
@@ -0,0 +1,200 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/kernels/cast_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+
+CastMeta::CastMeta(FFHandler handle) : OpMeta(handle) {}
+
+namespace Kernels {
+namespace Cast {
+
+template <typename IDT, typename ODT>
+void forward_kernel_wrapper(CastMeta const *m,
+                            IDT const *input_ptr,
+                            ODT *output_ptr,
+                            size_t volume) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::forward_kernel<IDT, ODT>(input_ptr, output_ptr, volume, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("[%s] forward time (CF) = %.2fms\n", "Cast", elapsed);
+    print_tensor<IDT>(input_ptr, 32, "[Cast:forward:input]");
+    print_tensor<ODT>(output_ptr, 32, "[Cast:forward:output]");
+  }
+}
+
+template void forward_kernel_wrapper<float, float>(CastMeta const *m,
+                                                   float const *input_ptr,
+                                                   float *output_ptr,
+                                                   size_t volume);
+template void forward_kernel_wrapper<float, double>(CastMeta const *m,
+                                                    float const *input_ptr,
+                                                    double *output_ptr,
+                                                    size_t volume);
+template void forward_kernel_wrapper<float, int32_t>(CastMeta const *m,
+                                                     float const *input_ptr,
+                                                     int32_t *output_ptr,
+                                                     size_t volume);
+template void forward_kernel_wrapper<float, int64_t>(CastMeta const *m,
+                                                     float const *input_ptr,
+                                                     int64_t *output_ptr,
+                                                     size_t volume);
+
+template void forward_kernel_wrapper<double, float>(CastMeta const *m,
+                                                    double const *input_ptr,
+                                                    float *output_ptr,
+                                                    size_t volume);
+template void forward_kernel_wrapper<double, double>(CastMeta const *m,
+                                                     double const *input_ptr,
+                                                     double *output_ptr,
+                                                     size_t volume);
+template void forward_kernel_wrapper<double, int32_t>(CastMeta const *m,
+                                                      double const *input_ptr,
+                                                      int32_t *output_ptr,
+                                                      size_t volume);
+template void forward_kernel_wrapper<double, int64_t>(CastMeta const *m,
+                                                      double const *input_ptr,
+                                                      int64_t *output_ptr,
+                                                      size_t volume);
+
+template void forward_kernel_wrapper<int32_t, float>(CastMeta const *m,
+                                                     int32_t const *input_ptr,
+                                                     float *output_ptr,
+                                                     size_t volume);
+template void forward_kernel_wrapper<int32_t, double>(CastMeta const *m,
+                                                      int32_t const *input_ptr,
+                                                      double *output_ptr,
+                                                      size_t volume);
+template void forward_kernel_wrapper<int32_t, int32_t>(CastMeta const *m,
+                                                       int32_t const *input_ptr,
+                                                       int32_t *output_ptr,
+                                                       size_t volume);
+template void forward_kernel_wrapper<int32_t, int64_t>(CastMeta const *m,
+                                                       int32_t const *input_ptr,
+                                                       int64_t *output_ptr,
+                                                       size_t volume);
+
+template void forward_kernel_wrapper<int64_t, float>(CastMeta const *m,
+                                                     int64_t const *input_ptr,
+                                                     float *output_ptr,
+                                                     size_t volume);
+template void forward_kernel_wrapper<int64_t, double>(CastMeta const *m,
+                                                      int64_t const *input_ptr,
+                                                      double *output_ptr,
+                                                      size_t volume);
+template void forward_kernel_wrapper<int64_t, int32_t>(CastMeta const *m,
+                                                       int64_t const *input_ptr,
+                                                       int32_t *output_ptr,
+                                                       size_t volume);
+template void forward_kernel_wrapper<int64_t, int64_t>(CastMeta const *m,
+                                                       int64_t const *input_ptr,
+                                                       int64_t *output_ptr,
+                                                       size_t volume);
+
+template <typename IDT, typename ODT>
+void backward_kernel_wrapper(IDT const *src_ptr, ODT *dst_ptr, size_t volume) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  Internal::backward_kernel<IDT, ODT>(src_ptr, dst_ptr, volume, stream);
+}
+
+template void backward_kernel_wrapper<float, float>(float const *src_ptr,
+                                                    float *dst_ptr,
+                                                    size_t volume);
+template void backward_kernel_wrapper<float, double>(float const *src_ptr,
+                                                     double *dst_ptr,
+                                                     size_t volume);
+template void backward_kernel_wrapper<float, int32_t>(float const *src_ptr,
+                                                      int32_t *dst_ptr,
+                                                      size_t volume);
+template void backward_kernel_wrapper<float, int64_t>(float const *src_ptr,
+                                                      int64_t *dst_ptr,
+                                                      size_t volume);
+
+template void backward_kernel_wrapper<double, float>(double const *src_ptr,
+                                                     float *dst_ptr,
+                                                     size_t volume);
+template void backward_kernel_wrapper<double, double>(double const *src_ptr,
+                                                      double *dst_ptr,
+                                                      size_t volume);
+template void backward_kernel_wrapper<double, int32_t>(double const *src_ptr,
+                                                       int32_t *dst_ptr,
+                                                       size_t volume);
+template void backward_kernel_wrapper<double, int64_t>(double const *src_ptr,
+                                                       int64_t *dst_ptr,
+                                                       size_t volume);
+
+template void backward_kernel_wrapper<int32_t, float>(int32_t const *src_ptr,
+                                                      float *dst_ptr,
+                                                      size_t volume);
+template void backward_kernel_wrapper<int32_t, double>(int32_t const *src_ptr,
+                                                       double *dst_ptr,
+                                                       size_t volume);
+template void backward_kernel_wrapper<int32_t, int32_t>(int32_t const *src_ptr,
+                                                        int32_t *dst_ptr,
+                                                        size_t volume);
+template void backward_kernel_wrapper<int32_t, int64_t>(int32_t const *src_ptr,
+                                                        int64_t *dst_ptr,
+                                                        size_t volume);
+
+template void backward_kernel_wrapper<int64_t, float>(int64_t const *src_ptr,
+                                                      float *dst_ptr,
+                                                      size_t volume);
+template void backward_kernel_wrapper<int64_t, double>(int64_t const *src_ptr,
+                                                       double *dst_ptr,
+                                                       size_t volume);
+template void backward_kernel_wrapper<int64_t, int32_t>(int64_t const *src_ptr,
+                                                        int32_t *dst_ptr,
+                                                        size_t volume);
+template void backward_kernel_wrapper<int64_t, int64_t>(int64_t const *src_ptr,
+                                                        int64_t *dst_ptr,
+                                                        size_t volume);
+
+namespace Internal {
+
+template <typename IDT, typename ODT>
+void forward_kernel(IDT const *input_ptr,
+                    ODT *output_ptr,
+                    size_t volume,
+                    ffStream_t stream) {
+#pragma omp parallel for if (volume > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < volume; i++) {
+    output_ptr[i] = (ODT)input_ptr[i];
+  }
+}
+
+template <typename IDT, typename ODT>
+void backward_kernel(IDT const *src_ptr,
+                     ODT *dst_ptr,
+                     size_t volume,
+                     ffStream_t stream) {
+#pragma omp parallel for if (volume > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < volume; i++) {
+    dst_ptr[i] = (ODT)src_ptr[i] + dst_ptr[i];
+  }
+}
+
+} // namespace Internal
+} // namespace Cast
+} // namespace Kernels
+} // namespace FlexFlow
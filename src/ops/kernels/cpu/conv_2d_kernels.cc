@@ -0,0 +1,327 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/kernels/conv_2d_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <vector>
+
+namespace FlexFlow {
+
+Conv2DMeta::Conv2DMeta(FFHandler handler) : OpMeta(handler) {}
+
+namespace Kernels {
+namespace Conv2D {
+
+void init_kernel(Conv2DMeta *m,
+                 int input_w,
+                 int input_h,
+                 int input_c,
+                 int input_n,
+                 int output_w,
+                 int output_h,
+                 int output_c,
+                 int output_n,
+                 int kernel_h,
+                 int kernel_w,
+                 int groups,
+                 int stride_h,
+                 int stride_w,
+                 int pad_h,
+                 int pad_w,
+                 float const *input_ptr,
+                 float *output_ptr,
+                 float const *kernel_ptr,
+                 float *kernel_grad_ptr,
+                 float *forward_time,
+                 float *backward_time) {
+  // Require that input_c is divisible by conv->groups
+  assert(input_c % groups == 0);
+  assert(output_c % groups == 0);
+  assert(output_h == (input_h + 2 * pad_h - kernel_h) / stride_h + 1);
+  assert(output_w == (input_w + 2 * pad_w - kernel_w) / stride_w + 1);
+  assert(output_n == input_n);
+  m->input_w = input_w;
+  m->input_h = input_h;
+  m->input_c = input_c;
+  m->input_n = input_n;
+  m->output_w = output_w;
+  m->output_h = output_h;
+  m->output_c = output_c;
+  m->output_n = output_n;
+  m->kernel_h = kernel_h;
+  m->kernel_w = kernel_w;
+  m->groups = groups;
+  m->stride_h = stride_h;
+  m->stride_w = stride_w;
+  m->pad_h = pad_h;
+  m->pad_w = pad_w;
+}
+
+void forward_kernel_wrapper(Conv2DMeta const *m,
+                            float const *input_ptr,
+                            float *output_ptr,
+                            float const *filter_ptr,
+                            float const *bias_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::forward_kernel(
+      m, input_ptr, output_ptr, filter_ptr, bias_ptr, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    print_tensor<float>(input_ptr, 16, "[Conv2D:forward:input]");
+    print_tensor<float>(filter_ptr, 16, "[Conv2D:forward:kernel]");
+    print_tensor<float>(output_ptr, 16, "[Conv2D:forward:output]");
+    printf("%s [Conv2D] forward time (CF) = %.2fms\n", m->op_name, elapsed);
+  }
+}
+
+void backward_kernel_wrapper(Conv2DMeta const *m,
+                             float const *input_ptr,
+                             float *input_grad_ptr,
+                             float const *output_ptr,
+                             float *output_grad_ptr,
+                             float const *kernel_ptr,
+                             float *kernel_grad_ptr,
+                             float *bias_grad_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::backward_kernel(m,
+                            input_ptr,
+                            input_grad_ptr,
+                            output_ptr,
+                            output_grad_ptr,
+                            kernel_ptr,
+                            kernel_grad_ptr,
+                            bias_grad_ptr,
+                            stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("%s [Conv2D] backward time = %.2fms\n", m->op_name, elapsed);
+  }
+}
+
+namespace Internal {
+
+// Unfold the receptive fields of one sample into a
+// (channels * kernel_h * kernel_w) x (output_h * output_w) matrix
+static void im2col(Conv2DMeta const *m,
+                   float const *input,
+                   int channels,
+                   float *col) {
+  int const out_hw = m->output_h * m->output_w;
+  int const num_rows = channels * m->kernel_h * m->kernel_w;
+#pragma omp parallel for if ((size_t)num_rows * out_hw > CPU_PARALLEL_THRESHOLD)
+  for (int row = 0; row < num_rows; row++) {
+    int kw = row % m->kernel_w;
+    int kh = (row / m->kernel_w) % m->kernel_h;
+    int c = row / (m->kernel_w * m->kernel_h);
+    float const *in = input + (size_t)c * m->input_h * m->input_w;
+    float *dst = col + (size_t)row * out_hw;
+    for (int oh = 0; oh < m->output_h; oh++) {
+      int ih = oh * m->stride_h - m->pad_h + kh;
+      for (int ow = 0; ow < m->output_w; ow++) {
+        int iw = ow * m->stride_w - m->pad_w + kw;
+        bool inside =
+            ih >= 0 && ih < m->input_h && iw >= 0 && iw < m->input_w;
+        dst[oh * m->output_w + ow] = inside ? in[ih * m->input_w + iw] : 0.0f;
+      }
+    }
+  }
+}
+
+// Inverse of im2col: accumulate a column matrix back into one sample
+static void col2im(Conv2DMeta const *m,
+                   float const *col,
+                   int channels,
+                   float *input_grad) {
+  int const out_hw = m->output_h * m->output_w;
+  // Parallelize over channels so that no two threads update the same element
+#pragma omp parallel for if ((size_t)channels * out_hw > CPU_PARALLEL_THRESHOLD)
+  for (int c = 0; c < channels; c++) {
+    float *in = input_grad + (size_t)c * m->input_h * m->input_w;
+    for (int kh = 0; kh < m->kernel_h; kh++) {
+      for (int kw = 0; kw < m->kernel_w; kw++) {
+        size_t row = ((size_t)c * m->kernel_h + kh) * m->kernel_w + kw;
+        float const *src = col + row * out_hw;
+        for (int oh = 0; oh < m->output_h; oh++) {
+          int ih = oh * m->stride_h - m->pad_h + kh;
+          if (ih < 0 || ih >= m->input_h) {
+            continue;
+          }
+          for (int ow = 0; ow < m->output_w; ow++) {
+            int iw = ow * m->stride_w - m->pad_w + kw;
+            if (iw >= 0 && iw < m->input_w) {
+              in[ih * m->input_w + iw] += src[oh * m->output_w + ow];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void forward_kernel(Conv2DMeta const *m,
+                    float const *input_ptr,
+                    float *output_ptr,
+                    float const *filter_ptr,
+                    float const *bias_ptr,
+                    ffStream_t stream) {
+  int const in_c_per_group = m->input_c / m->groups;
+  int const out_c_per_group = m->output_c / m->groups;
+  int const out_hw = m->output_h * m->output_w;
+  int const col_rows = in_c_per_group * m->kernel_h * m->kernel_w;
+  size_t const in_sample = (size_t)m->input_c * m->input_h * m->input_w;
+  size_t const out_sample = (size_t)m->output_c * out_hw;
+  std::vector<float> col((size_t)col_rows * out_hw);
+  for (int n = 0; n < m->input_n; n++) {
+    for (int g = 0; g < m->groups; g++) {
+      im2col(m,
+             input_ptr + n * in_sample +
+                 (size_t)g * in_c_per_group * m->input_h * m->input_w,
+             in_c_per_group,
+             col.data());
+      cblas_sgemm(CblasRowMajor,
+                  CblasNoTrans,
+                  CblasNoTrans,
+                  out_c_per_group,
+                  out_hw,
+                  col_rows,
+                  1.0f,
+                  filter_ptr + (size_t)g * out_c_per_group * col_rows,
+                  col_rows,
+                  col.data(),
+                  out_hw,
+                  0.0f,
+                  output_ptr + n * out_sample +
+                      (size_t)g * out_c_per_group * out_hw,
+                  out_hw);
+    }
+  }
+  if (bias_ptr != NULL || m->relu) {
+    size_t num_planes = (size_t)m->output_n * m->output_c;
+#pragma omp parallel for if (num_planes * out_hw > CPU_PARALLEL_THRESHOLD)
+    for (size_t plane = 0; plane < num_planes; plane++) {
+      float bias = bias_ptr != NULL ? bias_ptr[plane % m->output_c] : 0.0f;
+      float *out = output_ptr + plane * out_hw;
+      for (int i = 0; i < out_hw; i++) {
+        float value = out[i] + bias;
+        out[i] = (m->relu && value < 0.0f) ? 0.0f : value;
+      }
+    }
+  }
+}
+
+void backward_kernel(Conv2DMeta const *m,
+                     float const *input_ptr,
+                     float *input_grad_ptr,
+                     float const *output_ptr,
+                     float *output_grad_ptr,
+                     float const *kernel_ptr,
+                     float *kernel_grad_ptr,
+                     float *bias_grad_ptr,
+                     ffStream_t stream) {
+  int const in_c_per_group = m->input_c / m->groups;
+  int const out_c_per_group = m->output_c / m->groups;
+  int const out_hw = m->output_h * m->output_w;
+  int const col_rows = in_c_per_group * m->kernel_h * m->kernel_w;
+  size_t const in_plane = (size_t)m->input_h * m->input_w;
+  size_t const in_sample = (size_t)m->input_c * in_plane;
+  size_t const out_sample = (size_t)m->output_c * out_hw;
+  if (m->relu) {
+    relu_backward_kernel(DT_FLOAT,
+                         output_grad_ptr,
+                         output_ptr,
+                         (size_t)m->output_n * out_sample);
+  }
+  std::vector<float> col((size_t)col_rows * out_hw);
+  for (int n = 0; n < m->input_n; n++) {
+    for (int g = 0; g < m->groups; g++) {
+      float const *out_grad = output_grad_ptr + n * out_sample +
+                              (size_t)g * out_c_per_group * out_hw;
+      // Compute filter gradiant
+      // NOTE: we use beta=1 for kernel_grad to accumulate gradients
+      im2col(m,
+             input_ptr + n * in_sample + (size_t)g * in_c_per_group * in_plane,
+             in_c_per_group,
+             col.data());
+      cblas_sgemm(CblasRowMajor,
+                  CblasNoTrans,
+                  CblasTrans,
+                  out_c_per_group,
+                  col_rows,
+                  out_hw,
+                  1.0f,
+                  out_grad,
+                  out_hw,
+                  col.data(),
+                  out_hw,
+                  1.0f,
+                  kernel_grad_ptr + (size_t)g * out_c_per_group * col_rows,
+                  col_rows);
+      // Compute data gradiant
+      // NOTE: col2im accumulates into input_grad
+      if (input_grad_ptr != NULL) {
+        cblas_sgemm(CblasRowMajor,
+                    CblasTrans,
+                    CblasNoTrans,
+                    col_rows,
+                    out_hw,
+                    out_c_per_group,
+                    1.0f,
+                    kernel_ptr + (size_t)g * out_c_per_group * col_rows,
+                    col_rows,
+                    out_grad,
+                    out_hw,
+                    0.0f,
+                    col.data(),
+                    out_hw);
+        col2im(m,
+               col.data(),
+               in_c_per_group,
+               input_grad_ptr + n * in_sample +
+                   (size_t)g * in_c_per_group * in_plane);
+      }
+    }
+  }
+  // Compute bias gradiant
+  // NOTE: bias_grad accumulates gradients
+  if (bias_grad_ptr != NULL) {
+#pragma omp parallel for if (m->output_c > 1)
+    for (int c = 0; c < m->output_c; c++) {
+      float sum = 0.0f;
+      for (int n = 0; n < m->output_n; n++) {
+        float const *out_grad =
+            output_grad_ptr + n * out_sample + (size_t)c * out_hw;
+        for (int i = 0; i < out_hw; i++) {
+          sum += out_grad[i];
+        }
+      }
+      bias_grad_ptr[c] += sum;
+    }
+  }
+}
+
+} // namespace Internal
+} // namespace Conv2D
+} // namespace Kernels
+} // namespace FlexFlow
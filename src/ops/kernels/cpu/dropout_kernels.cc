@@ -0,0 +1,123 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flexflow/ops/kernels/dropout_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+
+// declare Legion names
+using Legion::coord_t;
+using Legion::Domain;
+using Legion::Memory;
+
+DropoutMeta::DropoutMeta(FFHandler handler,
+                         Dropout const *dropout,
+                         Memory gpu_mem,
+                         Domain const &output_domain)
+    : OpMeta(handler) {
+  profiling = dropout->profiling;
+  rate = dropout->rate;
+  seed = dropout->seed;
+  num_elements = output_domain.get_volume();
+  num_forwards = 0;
+  dropoutStates = nullptr;
+  dropoutStateSize = 0;
+  reserveSpaceSize = num_elements * sizeof(unsigned char);
+  {
+    // allocate memory for the dropout mask
+    Realm::Rect<1, coord_t> bounds(
+        Realm::Point<1, coord_t>(0),
+        Realm::Point<1, coord_t>(reserveSpaceSize - 1));
+    std::vector<size_t> field_sizes;
+    field_sizes.push_back(sizeof(char));
+    Realm::RegionInstance::create_instance(reserveInst,
+                                           gpu_mem,
+                                           bounds,
+                                           field_sizes,
+                                           0,
+                                           Realm::ProfilingRequestSet())
+        .wait();
+    reserveSpace = reserveInst.pointer_untyped(0, sizeof(char));
+  }
+}
+
+DropoutMeta::~DropoutMeta(void) {
+  reserveInst.destroy();
+}
+
+namespace Kernels {
+namespace Dropout {
+
+void forward_kernel_wrapper(DropoutMeta *m,
+                            float const *input_ptr,
+                            float *output_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  Internal::forward_kernel(m, input_ptr, output_ptr, stream);
+}
+
+void backward_kernel_wrapper(DropoutMeta *m,
+                             float const *output_grad_ptr,
+                             float *input_grad_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  Internal::backward_kernel(m, output_grad_ptr, input_grad_ptr, stream);
+}
+
+namespace Internal {
+
+// SplitMix64 finalizer: the keep decision of element i only depends on
+// (seed, pass, i), so the mask does not depend on the number of threads
+static inline unsigned long long
+    mix_bits(unsigned long long seed, unsigned long long pass, size_t i) {
+  unsigned long long z =
+      seed + 0x9e3779b97f4a7c15ULL * (pass * 0x100000001b3ULL + i + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void forward_kernel(DropoutMeta *m,
+                    float const *input_ptr,
+                    float *output_ptr,
+                    ffStream_t stream) {
+  unsigned char *mask = (unsigned char *)m->reserveSpace;
+  float scale = m->rate < 1.0f ? 1.0f / (1.0f - m->rate) : 0.0f;
+  unsigned long long pass = m->num_forwards++;
+#pragma omp parallel for if (m->num_elements > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < m->num_elements; i++) {
+    // 53 random bits give a uniform value in [0, 1)
+    double u = (mix_bits(m->seed, pass, i) >> 11) * 0x1.0p-53;
+    mask[i] = u >= m->rate;
+    output_ptr[i] = mask[i] ? input_ptr[i] * scale : 0.0f;
+  }
+}
+
+void backward_kernel(DropoutMeta *m,
+                     float const *output_grad_ptr,
+                     float *input_grad_ptr,
+                     ffStream_t stream) {
+  unsigned char const *mask = (unsigned char const *)m->reserveSpace;
+  float scale = m->rate < 1.0f ? 1.0f / (1.0f - m->rate) : 0.0f;
+#pragma omp parallel for if (m->num_elements > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < m->num_elements; i++) {
+    input_grad_ptr[i] = mask[i] ? output_grad_ptr[i] * scale : 0.0f;
+  }
+}
+
+} // namespace Internal
+} // namespace Dropout
+} // namespace Kernels
+} // namespace FlexFlow
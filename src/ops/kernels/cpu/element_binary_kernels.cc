@@ -0,0 +1,264 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flexflow/ops/kernels/element_binary_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <algorithm>
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::coord_t;
+using Legion::Domain;
+
+ElementBinaryMeta::ElementBinaryMeta(FFHandler handler) : OpMeta(handler) {
+  op_type = OP_NOOP;
+  profiling = false;
+  inplace_a = false;
+  has_same_operands = false;
+  broadcast_input1 = false;
+  broadcast_input2 = false;
+}
+
+namespace Kernels {
+namespace ElementBinary {
+
+/*static*/
+void init_kernel(ElementBinaryMeta *m,
+                 Domain const &input1_domain,
+                 Domain const &input2_domain,
+                 Domain const &output_domain) {
+  switch (m->op_type) {
+    case OP_EW_ADD:
+    case OP_EW_SUB:
+    case OP_EW_MUL:
+    case OP_EW_DIV:
+    case OP_EW_MAX:
+    case OP_EW_MIN:
+      break;
+    default:
+      assert(false);
+  }
+  m->input1_domain = input1_domain;
+  m->input2_domain = input2_domain;
+  m->output_domain = output_domain;
+}
+
+static char const *get_op_name(OperatorType op_type) {
+  switch (op_type) {
+    case OP_EW_ADD:
+      return "Add";
+    case OP_EW_SUB:
+      return "Sub";
+    case OP_EW_MUL:
+      return "Mul";
+    case OP_EW_DIV:
+      return "Div";
+    case OP_EW_MAX:
+      return "Max";
+    case OP_EW_MIN:
+      return "Min";
+    default:
+      assert(false);
+  }
+  return nullptr;
+}
+
+/*static*/
+void forward_kernel_wrapper(ElementBinaryMeta const *m,
+                            float const *in1_ptr,
+                            float const *in2_ptr,
+                            float *out_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::forward_kernel(m, in1_ptr, in2_ptr, out_ptr, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("[%s] forward time (CF) = %.2fms\n",
+           get_op_name(m->op_type),
+           elapsed);
+  }
+}
+
+/*static*/
+void backward_kernel_wrapper(ElementBinaryMeta const *m,
+                             float const *out_grad_ptr,
+                             float const *in1_ptr,
+                             float const *in2_ptr,
+                             float *in1_grad_ptr,
+                             float *in2_grad_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::backward_kernel(
+      m, out_grad_ptr, in1_ptr, in2_ptr, in1_grad_ptr, in2_grad_ptr, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("[%s] backward time (CB) = %.2fms\n",
+           get_op_name(m->op_type),
+           elapsed);
+  }
+}
+
+namespace Internal {
+
+// Map an output element to the element of an input that is broadcast
+// along the dimensions where the input has an extent of one
+struct BroadcastIndexer {
+  int num_dims;
+  coord_t out_extents[MAX_TENSOR_DIM], in_strides[MAX_TENSOR_DIM];
+
+  BroadcastIndexer(Domain const &in_domain, Domain const &out_domain) {
+    num_dims = out_domain.get_dim();
+    assert(in_domain.get_dim() == num_dims);
+    coord_t stride = 1;
+    for (int d = 0; d < num_dims; d++) {
+      coord_t in_extent = in_domain.hi()[d] - in_domain.lo()[d] + 1;
+      out_extents[d] = out_domain.hi()[d] - out_domain.lo()[d] + 1;
+      assert(in_extent == out_extents[d] || in_extent == 1);
+      in_strides[d] = in_extent == 1 ? 0 : stride;
+      stride *= in_extent;
+    }
+  }
+
+  coord_t operator()(coord_t out_idx) const {
+    coord_t in_idx = 0;
+    for (int d = 0; d < num_dims; d++) {
+      in_idx += (out_idx % out_extents[d]) * in_strides[d];
+      out_idx /= out_extents[d];
+    }
+    return in_idx;
+  }
+};
+
+static inline float binary_op(OperatorType type, float a, float b) {
+  switch (type) {
+    case OP_EW_ADD:
+      return a + b;
+    case OP_EW_SUB:
+      return a - b;
+    case OP_EW_MUL:
+      return a * b;
+    case OP_EW_DIV:
+      return a / b;
+    case OP_EW_MAX:
+      return std::max(a, b);
+    case OP_EW_MIN:
+      return std::min(a, b);
+    default:
+      assert(false);
+  }
+  return 0.0f;
+}
+
+/*static*/
+void forward_kernel(ElementBinaryMeta const *m,
+                    float const *in1_ptr,
+                    float const *in2_ptr,
+                    float *out_ptr,
+                    ffStream_t stream) {
+  coord_t volume = m->output_domain.get_volume();
+  if (!m->broadcast_input1 && !m->broadcast_input2) {
+#pragma omp parallel for if (volume > CPU_PARALLEL_THRESHOLD)
+    for (coord_t i = 0; i < volume; i++) {
+      out_ptr[i] = binary_op(m->op_type, in1_ptr[i], in2_ptr[i]);
+    }
+    return;
+  }
+  BroadcastIndexer idx1(m->input1_domain, m->output_domain);
+  BroadcastIndexer idx2(m->input2_domain, m->output_domain);
+#pragma omp parallel for if (volume > CPU_PARALLEL_THRESHOLD)
+  for (coord_t i = 0; i < volume; i++) {
+    out_ptr[i] = binary_op(m->op_type, in1_ptr[idx1(i)], in2_ptr[idx2(i)]);
+  }
+}
+
+// Gradients of both operands for one output element
+static inline void binary_grad(OperatorType type,
+                               float out_grad,
+                               float a,
+                               float b,
+                               float &a_grad,
+                               float &b_grad) {
+  switch (type) {
+    case OP_EW_ADD:
+      a_grad = out_grad;
+      b_grad = out_grad;
+      break;
+    case OP_EW_SUB:
+      a_grad = out_grad;
+      b_grad = -out_grad;
+      break;
+    case OP_EW_MUL:
+      a_grad = out_grad * b;
+      b_grad = out_grad * a;
+      break;
+    case OP_EW_DIV:
+      a_grad = out_grad / b;
+      b_grad = -out_grad * a / (b * b);
+      break;
+    case OP_EW_MAX:
+      a_grad = a >= b ? out_grad : 0.0f;
+      b_grad = b >= a ? out_grad : 0.0f;
+      break;
+    case OP_EW_MIN:
+      a_grad = a <= b ? out_grad : 0.0f;
+      b_grad = b <= a ? out_grad : 0.0f;
+      break;
+    default:
+      assert(false && "Unsupported ElementWise Binary Type");
+  }
+}
+
+/*static*/
+void backward_kernel(ElementBinaryMeta const *m,
+                     float const *out_grad_ptr,
+                     float const *in1_ptr,
+                     float const *in2_ptr,
+                     float *in1_grad_ptr,
+                     float *in2_grad_ptr,
+                     ffStream_t stream) {
+  // NOTE: gradients are accumulated into in1_grad and in2_grad
+  coord_t volume = m->output_domain.get_volume();
+  BroadcastIndexer idx1(m->input1_domain, m->output_domain);
+  BroadcastIndexer idx2(m->input2_domain, m->output_domain);
+  // A broadcast input receives the gradients of several output elements, so
+  // only the element-wise case can update gradients in parallel
+  bool parallel = !m->broadcast_input1 && !m->broadcast_input2 &&
+                  volume > CPU_PARALLEL_THRESHOLD;
+#pragma omp parallel for if (parallel)
+  for (coord_t i = 0; i < volume; i++) {
+    coord_t j1 = idx1(i), j2 = idx2(i);
+    float a_grad, b_grad;
+    binary_grad(
+        m->op_type, out_grad_ptr[i], in1_ptr[j1], in2_ptr[j2], a_grad, b_grad);
+    if (in1_grad_ptr != nullptr) {
+      in1_grad_ptr[j1] += a_grad;
+    }
+    if (in2_grad_ptr != nullptr) {
+      in2_grad_ptr[j2] += b_grad;
+    }
+  }
+}
+
+} // namespace Internal
+} // namespace ElementBinary
+} // namespace Kernels
+}; // namespace FlexFlow
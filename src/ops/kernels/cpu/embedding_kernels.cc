@@ -0,0 +1,268 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/kernels/embedding_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <algorithm>
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::coord_t;
+
+namespace Kernels {
+namespace Embedding {
+
+/*static*/
+void forward_kernel_wrapper(EmbeddingMeta const *m,
+                            GenericTensorAccessorR const &input,
+                            GenericTensorAccessorW const &output,
+                            GenericTensorAccessorR const &weight,
+                            int in_dim,
+                            int out_dim,
+                            int batch_size) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  // The cpu backend has no native half arithmetic, so only float and double
+  // tables are supported
+  if (input.data_type == DT_INT32) {
+    if (weight.data_type == DT_FLOAT) {
+      Internal::forward_kernel(input.get_int32_ptr(),
+                               output.get_float_ptr(),
+                               weight.get_float_ptr(),
+                               in_dim,
+                               out_dim,
+                               batch_size,
+                               m->aggr,
+                               output.domain.get_volume(),
+                               stream);
+    } else if (weight.data_type == DT_DOUBLE) {
+      Internal::forward_kernel(input.get_int32_ptr(),
+                               output.get_double_ptr(),
+                               weight.get_double_ptr(),
+                               in_dim,
+                               out_dim,
+                               batch_size,
+                               m->aggr,
+                               output.domain.get_volume(),
+                               stream);
+    } else {
+      assert(false && "Unsupported DataType in Embedding");
+    }
+  } else if (input.data_type == DT_INT64) {
+    if (weight.data_type == DT_FLOAT) {
+      Internal::forward_kernel(input.get_int64_ptr(),
+                               output.get_float_ptr(),
+                               weight.get_float_ptr(),
+                               in_dim,
+                               out_dim,
+                               batch_size,
+                               m->aggr,
+                               output.domain.get_volume(),
+                               stream);
+    } else if (weight.data_type == DT_DOUBLE) {
+      Internal::forward_kernel(input.get_int64_ptr(),
+                               output.get_double_ptr(),
+                               weight.get_double_ptr(),
+                               in_dim,
+                               out_dim,
+                               batch_size,
+                               m->aggr,
+                               output.domain.get_volume(),
+                               stream);
+    } else {
+      assert(false && "Unsupported DataType in Embedding");
+    }
+  } else {
+    assert(false && "Unsupported DataType in Embedding");
+  }
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("%s [Embedding] forward time = %.2lfms\n", m->op_name, elapsed);
+  }
+}
+
+/*static*/
+void backward_kernel_wrapper(EmbeddingMeta const *m,
+                             GenericTensorAccessorR const &input,
+                             GenericTensorAccessorR const &output,
+                             GenericTensorAccessorW const &weight_grad,
+                             int in_dim,
+                             int out_dim,
+                             int batch_size) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  if (m->input_type[0] == DT_INT32) {
+    if (m->output_type[0] == DT_FLOAT) {
+      Internal::backward_kernel(input.get_int32_ptr(),
+                                output.get_float_ptr(),
+                                weight_grad.get_float_ptr(),
+                                in_dim,
+                                out_dim,
+                                batch_size,
+                                m->aggr,
+                                output.domain.get_volume(),
+                                stream);
+    } else if (m->output_type[0] == DT_DOUBLE) {
+      Internal::backward_kernel(input.get_int32_ptr(),
+                                output.get_double_ptr(),
+                                weight_grad.get_double_ptr(),
+                                in_dim,
+                                out_dim,
+                                batch_size,
+                                m->aggr,
+                                output.domain.get_volume(),
+                                stream);
+    } else {
+      assert(false && "Unsupported DataType in Embedding");
+    }
+  } else if (m->input_type[0] == DT_INT64) {
+    if (m->output_type[0] == DT_FLOAT) {
+      Internal::backward_kernel(input.get_int64_ptr(),
+                                output.get_float_ptr(),
+                                weight_grad.get_float_ptr(),
+                                in_dim,
+                                out_dim,
+                                batch_size,
+                                m->aggr,
+                                output.domain.get_volume(),
+                                stream);
+    } else if (m->output_type[0] == DT_DOUBLE) {
+      Internal::backward_kernel(input.get_int64_ptr(),
+                                output.get_double_ptr(),
+                                weight_grad.get_double_ptr(),
+                                in_dim,
+                                out_dim,
+                                batch_size,
+                                m->aggr,
+                                output.domain.get_volume(),
+                                stream);
+    } else {
+      assert(false && "Unsupported DataType in Embedding");
+    }
+  } else {
+    assert(false && "Unsupported DataType in Embedding");
+  }
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("%s [Embedding] backward time = %.2lfms\n", m->op_name, elapsed);
+  }
+}
+
+template <typename TD>
+static void rand_generate_int(TD *ptr, size_t size, TD p) {
+#pragma omp parallel for if (size > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < size; i++) {
+    ptr[i] = i % p;
+  }
+}
+
+void rand_generate_int64_wrapper(int64_t *ptr, size_t size, int64_t p) {
+  // Randomly initialize the intput tensor to avoid out of index range issues
+  rand_generate_int(ptr, size, p);
+}
+
+void rand_generate_int32_wrapper(int32_t *ptr, size_t size, int32_t p) {
+  // Randomly initialize the intput tensor to avoid out of index range issues
+  rand_generate_int(ptr, size, p);
+}
+
+namespace Internal {
+
+/*static*/
+template <typename TI, typename TD>
+void forward_kernel(TI const *input_ptr,
+                    TD *output_ptr,
+                    TD const *weight_ptr,
+                    int in_dim,
+                    int out_dim,
+                    int batch_size,
+                    AggrMode aggr,
+                    int outputSize,
+                    ffStream_t stream) {
+  assert(input_ptr != nullptr);
+  assert(output_ptr != nullptr);
+  assert(weight_ptr != nullptr);
+  if (aggr == AGGR_MODE_NONE) {
+    in_dim = 1;
+  } else {
+    assert(aggr == AGGR_MODE_AVG || aggr == AGGR_MODE_SUM);
+  }
+  TD scale = aggr == AGGR_MODE_AVG ? TD(1) / in_dim : TD(1);
+  // Each sample owns one output row, so samples are processed in parallel
+#pragma omp parallel for if (outputSize > CPU_PARALLEL_THRESHOLD)
+  for (int idx = 0; idx < batch_size; idx++) {
+    TD *out = output_ptr + (size_t)idx * out_dim;
+    std::fill(out, out + out_dim, TD(0));
+    for (int j = 0; j < in_dim; j++) {
+      TI wordIdx = input_ptr[idx * in_dim + j];
+      TD const *row = weight_ptr + (size_t)wordIdx * out_dim;
+      for (int off = 0; off < out_dim; off++) {
+        out[off] += row[off];
+      }
+    }
+    if (scale != TD(1)) {
+      for (int off = 0; off < out_dim; off++) {
+        out[off] *= scale;
+      }
+    }
+  }
+}
+
+/*static*/
+template <typename TI, typename TD>
+void backward_kernel(TI const *input_ptr,
+                     TD const *output_ptr,
+                     TD *weight_grad_ptr,
+                     int in_dim,
+                     int out_dim,
+                     int batch_size,
+                     AggrMode aggr,
+                     int outputSize,
+                     ffStream_t stream) {
+  assert(input_ptr != nullptr);
+  assert(output_ptr != nullptr);
+  assert(weight_grad_ptr != nullptr);
+  if (aggr == AGGR_MODE_NONE) {
+    in_dim = 1;
+  } else {
+    assert(aggr == AGGR_MODE_AVG || aggr == AGGR_MODE_SUM);
+  }
+  TD scale = aggr == AGGR_MODE_AVG ? TD(1) / in_dim : TD(1);
+  // Several samples may look up the same row, so threads split the embedding
+  // columns instead of the samples to avoid conflicting updates
+#pragma omp parallel for if (outputSize > CPU_PARALLEL_THRESHOLD)
+  for (int off = 0; off < out_dim; off++) {
+    for (int idx = 0; idx < batch_size; idx++) {
+      TD gradient = output_ptr[(size_t)idx * out_dim + off] * scale;
+      for (int j = 0; j < in_dim; j++) {
+        TI wordIdx = input_ptr[idx * in_dim + j];
+        weight_grad_ptr[(size_t)wordIdx * out_dim + off] += gradient;
+      }
+    }
+  }
+}
+
+} // namespace Internal
+} // namespace Embedding
+} // namespace Kernels
+}; // namespace FlexFlow
@@ -0,0 +1,273 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/kernels/linear_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+
+LinearMeta::LinearMeta(FFHandler handler, int batch_size) : OpMeta(handler) {
+  // Bias is broadcast with a loop on CPUs, so no all-one's vector is needed
+  one_ptr = nullptr;
+}
+
+namespace Kernels {
+namespace Linear {
+
+bool use_activation(ActiMode mode) {
+  switch (mode) {
+    case AC_MODE_RELU:
+    case AC_MODE_SIGMOID:
+    case AC_MODE_TANH:
+      return true;
+    case AC_MODE_NONE:
+      return false;
+    default:
+      assert(0);
+      break;
+  }
+  return false;
+}
+
+void init_kernel(LinearMeta *m, int batch_size, int channel) {
+  assert(m->input_type == DT_FLOAT && m->weight_type == DT_FLOAT &&
+         m->output_type == DT_FLOAT &&
+         "The cpu backend only supports float Linear");
+}
+
+void forward_kernel_wrapper(LinearMeta const *m,
+                            void const *input_ptr,
+                            void *output_ptr,
+                            void const *weight_ptr,
+                            void const *bias_ptr,
+                            int in_dim,
+                            int out_dim,
+                            int batch_size) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::forward_kernel(m,
+                           input_ptr,
+                           output_ptr,
+                           weight_ptr,
+                           bias_ptr,
+                           in_dim,
+                           out_dim,
+                           batch_size,
+                           stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("%s [Linear] forward time = %.2lfms\n", m->op_name, elapsed);
+  }
+}
+
+void backward_kernel_wrapper(LinearMeta const *m,
+                             void const *input_ptr,
+                             void *input_grad_ptr,
+                             void const *output_ptr,
+                             void *output_grad_ptr,
+                             void const *kernel_ptr,
+                             void *kernel_grad_ptr,
+                             void *bias_grad_ptr,
+                             int in_dim,
+                             int out_dim,
+                             int batch_size) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::backward_kernel(m,
+                            input_ptr,
+                            input_grad_ptr,
+                            output_ptr,
+                            output_grad_ptr,
+                            kernel_ptr,
+                            kernel_grad_ptr,
+                            bias_grad_ptr,
+                            in_dim,
+                            out_dim,
+                            batch_size,
+                            stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("%s Linear backward time = %.2lfms\n", m->op_name, elapsed);
+  }
+}
+
+namespace Internal {
+
+// The GEMMs below use the same column-major formulation as the cuBLAS calls
+// of the GPU backends, so that weights share one layout across backends
+void forward_kernel(LinearMeta const *m,
+                    void const *input_ptr,
+                    void *output_ptr,
+                    void const *weight_ptr,
+                    void const *bias_ptr,
+                    int in_dim,
+                    int out_dim,
+                    int batch_size,
+                    ffStream_t stream) {
+  float const *input = (float const *)input_ptr;
+  float const *weight = (float const *)weight_ptr;
+  float const *bias = (float const *)bias_ptr;
+  float *output = (float *)output_ptr;
+  cblas_sgemm(CblasColMajor,
+              CblasTrans,
+              CblasNoTrans,
+              out_dim,
+              batch_size,
+              in_dim,
+              1.0f,
+              weight,
+              in_dim,
+              input,
+              in_dim,
+              0.0f,
+              output,
+              out_dim);
+  size_t elements = (size_t)out_dim * (size_t)batch_size;
+  // Fuse the bias broadcast with the activation in a single pass
+#pragma omp parallel for if (elements > CPU_PARALLEL_THRESHOLD)
+  for (int b = 0; b < batch_size; b++) {
+    float *out = output + (size_t)b * out_dim;
+    for (int o = 0; o < out_dim; o++) {
+      float value = out[o];
+      // use_bias = True
+      if (bias != nullptr) {
+        value += bias[o];
+      }
+      switch (m->activation) {
+        case AC_MODE_RELU:
+          value = value > 0.0f ? value : 0.0f;
+          break;
+        case AC_MODE_SIGMOID:
+          value = 1.0f / (1.0f + expf(-value));
+          break;
+        case AC_MODE_TANH:
+          value = tanhf(value);
+          break;
+        case AC_MODE_GELU: {
+          // B = sqrt(2.0/M_PI), C = 0.044715 * sqrt(2.0/M_PI)
+          constexpr float B = 0.7978845608028654f;
+          constexpr float C = 0.035677408136300125f;
+          value *= 0.5f + 0.5f * tanhf(value * (C * value * value + B));
+          break;
+        }
+        default:
+          break;
+      }
+      out[o] = value;
+    }
+  }
+}
+
+void backward_kernel(LinearMeta const *m,
+                     void const *input_ptr,
+                     void *input_grad_ptr,
+                     void const *output_ptr,
+                     void *output_grad_ptr,
+                     void const *kernel_ptr,
+                     void *kernel_grad_ptr,
+                     void *bias_grad_ptr,
+                     int in_dim,
+                     int out_dim,
+                     int batch_size,
+                     ffStream_t stream) {
+  float const *input = (float const *)input_ptr;
+  float const *kernel = (float const *)kernel_ptr;
+  float *output_grad = (float *)output_grad_ptr;
+  float *kernel_grad = (float *)kernel_grad_ptr;
+  int output_size = out_dim * batch_size;
+  if (m->activation == AC_MODE_RELU) {
+    relu_backward_kernel(
+        m->output_type, output_grad_ptr, output_ptr, output_size);
+  } else if (m->activation == AC_MODE_SIGMOID) {
+    sigmoid_backward_kernel(
+        m->output_type, output_grad_ptr, output_ptr, output_size);
+  } else {
+    // TODO: only support relu and sigmoid for now
+    assert(m->activation == AC_MODE_NONE);
+  }
+  // Compute weight gradiant
+  // NOTE: we use beta=1 for kernel_grad to accumulate gradients
+  cblas_sgemm(CblasColMajor,
+              CblasNoTrans,
+              CblasTrans,
+              in_dim,
+              out_dim,
+              batch_size,
+              1.0f,
+              input,
+              in_dim,
+              output_grad,
+              out_dim,
+              1.0f,
+              kernel_grad,
+              in_dim);
+  if (m->kernel_reg_type == REG_MODE_NONE) {
+    // do nothing
+  } else if (m->kernel_reg_type == REG_MODE_L2) {
+    cblas_saxpy((size_t)in_dim * out_dim,
+                m->kernel_reg_lambda,
+                kernel,
+                1,
+                kernel_grad,
+                1);
+  } else {
+    assert(false && "Only L2 regularization is supported");
+  }
+
+  // Compute bias gradiant
+  // NOTE: bias_grad accumulates gradients
+  if (bias_grad_ptr != NULL) {
+    float *bias_grad = (float *)bias_grad_ptr;
+#pragma omp parallel for if (output_size > CPU_PARALLEL_THRESHOLD)
+    for (int o = 0; o < out_dim; o++) {
+      float sum = 0.0f;
+      for (int b = 0; b < batch_size; b++) {
+        sum += output_grad[(size_t)b * out_dim + o];
+      }
+      bias_grad[o] += sum;
+    }
+  }
+  // Compute data gradiant
+  // NOTE: we use beta=1 for input_grad to accumulate gradients
+  if (input_grad_ptr != NULL) {
+    cblas_sgemm(CblasColMajor,
+                CblasNoTrans,
+                CblasNoTrans,
+                in_dim,
+                batch_size,
+                out_dim,
+                1.0f,
+                kernel,
+                in_dim,
+                output_grad,
+                out_dim,
+                1.0f,
+                (float *)input_grad_ptr,
+                in_dim);
+  }
+}
+
+} // namespace Internal
+} // namespace Linear
+} // namespace Kernels
+} // namespace FlexFlow
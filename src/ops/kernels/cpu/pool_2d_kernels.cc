@@ -0,0 +1,205 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/kernels/pool_2d_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace FlexFlow {
+
+Pool2DMeta::Pool2DMeta(FFHandler handler) : OpMeta(handler) {}
+
+namespace Kernels {
+namespace Pool2D {
+
+void init_kernel(Pool2DMeta *m,
+                 int input_w,
+                 int input_h,
+                 int input_c,
+                 int input_n,
+                 int output_w,
+                 int output_h,
+                 int output_c,
+                 int output_n,
+                 int pad_h,
+                 int pad_w,
+                 int kernel_h,
+                 int kernel_w,
+                 int stride_h,
+                 int stride_w,
+                 PoolType pool_type) {
+  assert(pool_type == POOL_MAX || pool_type == POOL_AVG);
+  assert(output_n == input_n);
+  assert(output_c == input_c);
+  assert(output_h == (input_h + 2 * pad_h - kernel_h) / stride_h + 1);
+  assert(output_w == (input_w + 2 * pad_w - kernel_w) / stride_w + 1);
+  m->input_w = input_w;
+  m->input_h = input_h;
+  m->input_c = input_c;
+  m->input_n = input_n;
+  m->output_w = output_w;
+  m->output_h = output_h;
+  m->output_c = output_c;
+  m->output_n = output_n;
+  m->kernel_h = kernel_h;
+  m->kernel_w = kernel_w;
+  m->stride_h = stride_h;
+  m->stride_w = stride_w;
+  m->pad_h = pad_h;
+  m->pad_w = pad_w;
+  m->pool_type = pool_type;
+}
+
+void forward_kernel_wrapper(Pool2DMeta const *m,
+                            void const *input_ptr,
+                            void *output_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::forward_kernel(m, input_ptr, output_ptr, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("%s [Pool2D] forward time = %.2fms\n", m->op_name, elapsed);
+  }
+}
+
+void backward_kernel_wrapper(Pool2DMeta const *m,
+                             void const *input_ptr,
+                             void *input_grad_ptr,
+                             void const *output_ptr,
+                             void const *output_grad_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::backward_kernel(
+      m, input_ptr, input_grad_ptr, output_ptr, output_grad_ptr, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    printf("Pool2D backward time = %.2fms\n", elapsed);
+  }
+}
+
+namespace Internal {
+
+// Clip a pooling window to the input, which gives the same results as
+// cuDNN's CUDNN_POOLING_AVERAGE_COUNT_EXCLUDE_PADDING for average pooling
+struct PoolWindow {
+  int h_start, h_end, w_start, w_end;
+
+  PoolWindow(Pool2DMeta const *m, int oh, int ow) {
+    h_start = oh * m->stride_h - m->pad_h;
+    w_start = ow * m->stride_w - m->pad_w;
+    h_end = std::min(h_start + m->kernel_h, m->input_h);
+    w_end = std::min(w_start + m->kernel_w, m->input_w);
+    h_start = std::max(h_start, 0);
+    w_start = std::max(w_start, 0);
+  }
+
+  int count() const {
+    return (h_end - h_start) * (w_end - w_start);
+  }
+};
+
+void forward_kernel(Pool2DMeta const *m,
+                    void const *input_ptr,
+                    void *output_ptr,
+                    ffStream_t stream) {
+  float const *input = (float const *)input_ptr;
+  float *output = (float *)output_ptr;
+  size_t num_planes = (size_t)m->output_n * m->output_c;
+  size_t in_plane = (size_t)m->input_h * m->input_w;
+  size_t out_plane = (size_t)m->output_h * m->output_w;
+#pragma omp parallel for if (num_planes * out_plane > CPU_PARALLEL_THRESHOLD)
+  for (size_t p = 0; p < num_planes; p++) {
+    float const *in = input + p * in_plane;
+    float *out = output + p * out_plane;
+    for (int oh = 0; oh < m->output_h; oh++) {
+      for (int ow = 0; ow < m->output_w; ow++) {
+        PoolWindow win(m, oh, ow);
+        float value = m->pool_type == POOL_MAX ? -FLT_MAX : 0.0f;
+        for (int ih = win.h_start; ih < win.h_end; ih++) {
+          for (int iw = win.w_start; iw < win.w_end; iw++) {
+            float x = in[ih * m->input_w + iw];
+            value = m->pool_type == POOL_MAX ? std::max(value, x) : value + x;
+          }
+        }
+        if (m->pool_type == POOL_AVG) {
+          value /= win.count();
+        }
+        out[oh * m->output_w + ow] = value;
+      }
+    }
+  }
+}
+
+void backward_kernel(Pool2DMeta const *m,
+                     void const *input_ptr,
+                     void *input_grad_ptr,
+                     void const *output_ptr,
+                     void const *output_grad_ptr,
+                     ffStream_t stream) {
+  // NOTE: gradients are accumulated into input_grad
+  float const *input = (float const *)input_ptr;
+  float const *output = (float const *)output_ptr;
+  float const *output_grad = (float const *)output_grad_ptr;
+  float *input_grad = (float *)input_grad_ptr;
+  size_t num_planes = (size_t)m->output_n * m->output_c;
+  size_t in_plane = (size_t)m->input_h * m->input_w;
+  size_t out_plane = (size_t)m->output_h * m->output_w;
+  // Overlapping windows only share elements within a plane, so planes are
+  // processed in parallel
+#pragma omp parallel for if (num_planes * out_plane > CPU_PARALLEL_THRESHOLD)
+  for (size_t p = 0; p < num_planes; p++) {
+    float const *in = input + p * in_plane;
+    float *in_grad = input_grad + p * in_plane;
+    for (int oh = 0; oh < m->output_h; oh++) {
+      for (int ow = 0; ow < m->output_w; ow++) {
+        PoolWindow win(m, oh, ow);
+        size_t o = p * out_plane + oh * m->output_w + ow;
+        if (m->pool_type == POOL_MAX) {
+          // Route the gradient to the first element equal to the maximum
+          bool routed = false;
+          for (int ih = win.h_start; ih < win.h_end && !routed; ih++) {
+            for (int iw = win.w_start; iw < win.w_end && !routed; iw++) {
+              if (in[ih * m->input_w + iw] == output[o]) {
+                in_grad[ih * m->input_w + iw] += output_grad[o];
+                routed = true;
+              }
+            }
+          }
+        } else {
+          float grad = output_grad[o] / win.count();
+          for (int ih = win.h_start; ih < win.h_end; ih++) {
+            for (int iw = win.w_start; iw < win.w_end; iw++) {
+              in_grad[ih * m->input_w + iw] += grad;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace Internal
+} // namespace Pool2D
+} // namespace Kernels
+} // namespace FlexFlow
@@ -0,0 +1,133 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/kernels/softmax_kernels.h"
+#include "flexflow/utils/cpu_helper.h"
+#include "flexflow/utils/hash_utils.h"
+#include <algorithm>
+#include <cmath>
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::Domain;
+
+SoftmaxMeta::SoftmaxMeta(FFHandler handler,
+                         Softmax const *softmax,
+                         Domain const &input_domain)
+    : OpMeta(handler) {
+  // Use the same NCHW view as cudnnSetTensorDescriptorFromDomain, in which
+  // the second outermost Legion dimension is the channel dimension
+  int num_dims = input_domain.get_dim();
+  if (num_dims == 5) {
+    assert(input_domain.hi()[4] == input_domain.lo()[4]);
+    num_dims = 4;
+  }
+  outer_size = 1;
+  channel_size = 1;
+  inner_size = 1;
+  for (int i = 0; i < num_dims; i++) {
+    int size = input_domain.hi()[i] - input_domain.lo()[i] + 1;
+    if (i == num_dims - 1) {
+      outer_size = size;
+    } else if (i == num_dims - 2) {
+      channel_size = size;
+    } else {
+      inner_size *= size;
+    }
+  }
+  dim = softmax->dim;
+  profiling = softmax->profiling;
+  std::strcpy(op_name, softmax->name);
+}
+
+namespace Kernels {
+namespace Softmax {
+
+void forward_kernel_wrapper(SoftmaxMeta const *m,
+                            float const *input_ptr,
+                            float *output_ptr) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::forward_kernel(m, input_ptr, output_ptr, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    log_measure.debug(
+        "%s [Softmax] forward time = %.2fms\n", m->op_name, elapsed);
+  }
+}
+
+void backward_kernel_wrapper(SoftmaxMeta const *m,
+                             float *input_grad_ptr,
+                             float const *output_grad_ptr,
+                             size_t num_elements) {
+  ffStream_t stream;
+  get_legion_stream(&stream);
+  double t_start = 0;
+  if (m->profiling) {
+    t_start = cpu_time_in_milliseconds();
+  }
+  Internal::backward_kernel(
+      input_grad_ptr, output_grad_ptr, num_elements, stream);
+  if (m->profiling) {
+    double elapsed = cpu_time_in_milliseconds() - t_start;
+    log_measure.debug("Softmax backward time = %.2fms\n", elapsed);
+  }
+}
+
+namespace Internal {
+
+void forward_kernel(SoftmaxMeta const *m,
+                    float const *input_ptr,
+                    float *output_ptr,
+                    ffStream_t stream) {
+  int const channels = m->channel_size;
+  int const inner = m->inner_size;
+  size_t const num_rows = (size_t)m->outer_size * inner;
+#pragma omp parallel for if (num_rows * channels > CPU_PARALLEL_THRESHOLD)
+  for (size_t r = 0; r < num_rows; r++) {
+    size_t base = (r / inner) * channels * inner + r % inner;
+    float const *in = input_ptr + base;
+    float *out = output_ptr + base;
+    // Subtract the maximum for numerical stability
+    float max_val = in[0];
+    for (int c = 1; c < channels; c++) {
+      max_val = std::max(max_val, in[(size_t)c * inner]);
+    }
+    float sum = 0.0f;
+    for (int c = 0; c < channels; c++) {
+      out[(size_t)c * inner] = expf(in[(size_t)c * inner] - max_val);
+      sum += out[(size_t)c * inner];
+    }
+    for (int c = 0; c < channels; c++) {
+      out[(size_t)c * inner] /= sum;
+    }
+  }
+}
+
+void backward_kernel(float *input_grad_ptr,
+                     float const *output_grad_ptr,
+                     size_t num_elements,
+                     ffStream_t stream) {
+  std::copy(output_grad_ptr, output_grad_ptr + num_elements, input_grad_ptr);
+}
+
+} // namespace Internal
+} // namespace Softmax
+} // namespace Kernels
+} // namespace FlexFlow
@@ -756,9 +756,7 @@ ParallelConfig Linear::get_random_parallel_config(FFModel const &ff) const {
   }
   int start_idx = std::rand() % (total_devices - num_par_c * num_par_b + 1);
   start_idx = start_idx - start_idx % num_par_c;
-  for (int i = 0; i < num_par_c * num_par_b; i++) {
-    pc.device_ids[i] = start_idx + i;
-  }
+  pc.device_ids = DeviceList(start_idx, num_par_c * num_par_b);
   return pc;
 }
 
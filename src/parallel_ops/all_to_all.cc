@@ -0,0 +1,364 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/parallel_ops/all_to_all.h"
+#include "flexflow/model.h"
+#include "flexflow/parallel_ops/kernels/all_to_all_kernels.h"
+#include "flexflow/utils/hash_utils.h"
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::ArgumentMap;
+using Legion::Context;
+using Legion::coord_t;
+using Legion::Domain;
+using Legion::FutureMap;
+using Legion::IndexLauncher;
+using Legion::LogicalPartition;
+using Legion::LogicalRegion;
+using Legion::Machine;
+using Legion::Memory;
+using Legion::PhysicalRegion;
+using Legion::Predicate;
+using Legion::Rect;
+using Legion::RegionRequirement;
+using Legion::Runtime;
+using Legion::Task;
+using Legion::TaskArgument;
+using Legion::TaskLauncher;
+
+using namespace FlexFlow::Kernels::AllToAll;
+
+/* Params */
+bool operator==(AllToAllParams const &lhs, AllToAllParams const &rhs) {
+  return lhs.split_legion_dim == rhs.split_legion_dim &&
+         lhs.concat_legion_dim == rhs.concat_legion_dim &&
+         lhs.degree == rhs.degree;
+}
+
+bool AllToAllParams::is_valid(ParallelTensorShape const &input) const {
+  bool valid = input.is_valid();
+  valid &= (this->split_legion_dim != this->concat_legion_dim);
+  valid &= (this->degree > 1);
+  ParallelDim const &split = input.dims[this->split_legion_dim];
+  ParallelDim const &concat = input.dims[this->concat_legion_dim];
+  valid &= (!split.is_replica_dim && !concat.is_replica_dim);
+  valid &= (concat.degree % this->degree == 0);
+  valid &= (split.size % (split.degree * this->degree) == 0);
+  return valid;
+}
+
+AllToAllParams AllToAll::get_params() const {
+  AllToAllParams params;
+  params.split_legion_dim = this->split_dim;
+  params.concat_legion_dim = this->concat_dim;
+  params.degree = this->degree;
+  return params;
+}
+
+AllToAll::AllToAll(FFModel &model,
+                   AllToAllParams const &params,
+                   ParallelTensor const input,
+                   char const *name)
+    : AllToAll(model,
+               input,
+               params.split_legion_dim,
+               params.concat_legion_dim,
+               params.degree,
+               name) {}
+
+AllToAll::AllToAll(FFModel &model,
+                   const ParallelTensor _input,
+                   int _split_legion_dim,
+                   int _concat_legion_dim,
+                   int _degree,
+                   char const *name)
+    : ParallelOp(model, OP_ALLTOALL, name, _input),
+      split_dim(_split_legion_dim), concat_dim(_concat_legion_dim),
+      degree(_degree) {
+  int numdim = _input->num_dims;
+  ParallelDim dims[MAX_TENSOR_DIM];
+  for (int i = 0; i < numdim; i++) {
+    dims[i] = _input->dims[i];
+  }
+  assert(degree > 1 && "Must use degree > 1");
+  assert(split_dim != concat_dim);
+  assert(dims[concat_dim].degree % degree == 0);
+  dims[concat_dim].degree /= degree;
+  dims[split_dim].degree *= degree;
+  assert(dims[split_dim].size % dims[split_dim].degree == 0);
+  ParallelTensorBase::update_parallel_ids(numdim, dims);
+  outputs[0] = model.create_parallel_tensor_legion_ordering(
+      numdim, dims, _input->data_type, this);
+}
+
+OpMeta *AllToAll::init_task(Task const *task,
+                            std::vector<PhysicalRegion> const &regions,
+                            Context ctx,
+                            Runtime *runtime) {
+  return nullptr;
+}
+
+void AllToAll::init(FFModel const &ff) {
+  parallel_is = outputs[0]->parallel_is;
+  ArgumentMap argmap;
+  Context ctx = ff.config.lg_ctx;
+  Runtime *runtime = ff.config.lg_hlr;
+  assert(numOutputs == 1);
+  assert(numInputs == 1);
+  IndexLauncher launcher(ALLTOALL_INIT_TASK_ID,
+                         parallel_is,
+                         TaskArgument(this, sizeof(AllToAll)),
+                         argmap,
+                         Predicate::TRUE_PRED,
+                         false /*must*/,
+                         0 /*mapper_id*/,
+                         outputs[0]->machine_view.hash());
+  launcher.add_region_requirement(RegionRequirement(
+      input_lp, 0 /*projection id*/, READ_ONLY, EXCLUSIVE, inputs[0]->region));
+  launcher.add_field(0, FID_DATA);
+  launcher.add_region_requirement(RegionRequirement(outputs[0]->part,
+                                                    0 /*projection id*/,
+                                                    WRITE_ONLY,
+                                                    EXCLUSIVE,
+                                                    outputs[0]->region));
+  launcher.add_field(1, FID_DATA);
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+  fm.wait_all_results();
+}
+
+void AllToAll::create_input_partition(FFModel &ff) {
+  assert(outputs[0]->part != LogicalPartition::NO_PART);
+  assert(inputs[0]->part != LogicalPartition::NO_PART);
+  // Every output piece reads one slice of each of degree input pieces, and
+  // every input gradient piece one slice of each of degree output pieces
+  ff.create_disjoint_partition(outputs[0]->num_dims,
+                               outputs[0]->dims,
+                               outputs[0]->parallel_is,
+                               inputs[0]->region,
+                               input_lp);
+  ff.create_disjoint_partition(inputs[0]->num_dims,
+                               inputs[0]->dims,
+                               inputs[0]->parallel_is,
+                               outputs[0]->region_grad,
+                               output_grad_lp);
+}
+
+void AllToAll::forward(FFModel const &ff) {
+  ArgumentMap argmap;
+  Context ctx = ff.config.lg_ctx;
+  Runtime *runtime = ff.config.lg_hlr;
+  assert(numOutputs == 1);
+  assert(numInputs == 1);
+  assert(inputs[0]->data_type == outputs[0]->data_type);
+  DataType data_type = inputs[0]->data_type;
+  IndexLauncher launcher(ALLTOALL_FWD_TASK_ID,
+                         outputs[0]->parallel_is,
+                         TaskArgument(&data_type, sizeof(data_type)),
+                         argmap,
+                         Predicate::TRUE_PRED,
+                         false /*must*/,
+                         0 /*mapper_id*/,
+                         outputs[0]->machine_view.hash());
+  launcher.add_region_requirement(RegionRequirement(
+      input_lp, 0 /*projection id*/, READ_ONLY, EXCLUSIVE, inputs[0]->region));
+  launcher.add_field(0, FID_DATA);
+  launcher.add_region_requirement(RegionRequirement(outputs[0]->part,
+                                                    0 /*projection id*/,
+                                                    WRITE_ONLY,
+                                                    EXCLUSIVE,
+                                                    outputs[0]->region));
+  launcher.add_field(1, FID_DATA);
+  runtime->execute_index_space(ctx, launcher);
+}
+
+void AllToAll::backward(FFModel const &ff) {
+  ArgumentMap argmap;
+  Context ctx = ff.config.lg_ctx;
+  Runtime *runtime = ff.config.lg_hlr;
+  assert(numOutputs == 1);
+  assert(numInputs == 1);
+  assert(inputs[0]->data_type == outputs[0]->data_type);
+  DataType data_type = inputs[0]->data_type;
+  IndexLauncher launcher(ALLTOALL_BWD_TASK_ID,
+                         inputs[0]->parallel_is,
+                         TaskArgument(&data_type, sizeof(DataType)),
+                         argmap,
+                         Predicate::TRUE_PRED,
+                         false /*must*/,
+                         0 /*mapper_id*/,
+                         inputs[0]->machine_view.hash());
+  launcher.add_region_requirement(RegionRequirement(output_grad_lp,
+                                                    0 /*projection id*/,
+                                                    READ_ONLY,
+                                                    EXCLUSIVE,
+                                                    outputs[0]->region_grad));
+  launcher.add_field(0, FID_DATA);
+  launcher.add_region_requirement(RegionRequirement(inputs[0]->part_grad,
+                                                    0 /*projection id*/,
+                                                    READ_WRITE,
+                                                    EXCLUSIVE,
+                                                    inputs[0]->region_grad));
+  launcher.add_field(1, FID_DATA);
+  runtime->execute_index_space(ctx, launcher);
+}
+
+bool AllToAll::measure_operator_cost(Simulator *sim,
+                                     MachineView const &mv,
+                                     CostMetrics &cost_metrics) const {
+  // The exchange is charged by Simulator::estimate_xfer_cost; the tasks
+  // themselves only copy the local piece
+  cost_metrics = CostMetrics();
+  cost_metrics.forward_time = 0.05f;
+  cost_metrics.backward_time = 0.05f;
+  return true;
+}
+
+bool AllToAll::get_int_parameter(PMParameter para, int *value) const {
+  switch (para) {
+    case PM_ALLTOALL_SPLIT_DIM:
+      *value = split_dim;
+      return true;
+    case PM_ALLTOALL_CONCAT_DIM:
+      *value = concat_dim;
+      return true;
+    case PM_ALLTOALL_DEGREE:
+      *value = degree;
+      return true;
+    default:
+      return Op::get_int_parameter(para, value);
+  }
+}
+
+bool AllToAll::append_parallel_op_info(
+    std::vector<ParallelOpInfo> &parallel_ops) const {
+  // A ParallelOpInfo describes a single dim, so an AllToAll can neither be
+  // joined with nor fused into other parallel ops
+  return false;
+}
+
+tl::optional<RecordFormatter> AllToAll::as_dot() const {
+  RecordFormatter rf;
+  {
+    std::ostringstream oss;
+    oss << "split(" << this->split_dim << ")";
+    rf << oss.str();
+  }
+  {
+    std::ostringstream oss;
+    oss << "concat(" << this->concat_dim << ")";
+    rf << oss.str();
+  }
+  {
+    std::ostringstream oss;
+    oss << "deg(" << this->degree << ")";
+    rf << oss.str();
+  }
+  return rf;
+}
+
+/*static*/
+void AllToAll::forward_task(Task const *task,
+                           std::vector<PhysicalRegion> const &regions,
+                           Context ctx,
+                           Runtime *runtime) {
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  DataType data_type = *((DataType *)task->args);
+  if (data_type == DT_FLOAT) {
+    forward_task_with_type<float>(task, regions, ctx, runtime);
+  } else if (data_type == DT_DOUBLE) {
+    forward_task_with_type<double>(task, regions, ctx, runtime);
+  } else if (data_type == DT_INT32) {
+    forward_task_with_type<int32_t>(task, regions, ctx, runtime);
+  } else if (data_type == DT_INT64) {
+    forward_task_with_type<int64_t>(task, regions, ctx, runtime);
+  } else {
+    assert(false && "Unsupported data type in AllToAll forward");
+  }
+}
+
+template <typename DT>
+void AllToAll::forward_task_with_type(Task const *task,
+                                     std::vector<PhysicalRegion> const &regions,
+                                     Context ctx,
+                                     Runtime *runtime) {
+  Domain input_domain = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  Domain output_domain = runtime->get_index_space_domain(
+      ctx, task->regions[1].region.get_index_space());
+  assert(output_domain == input_domain);
+
+  const DT *input_ptr = helperGetTensorPointerRO<DT>(
+      regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  DT *output_ptr = helperGetTensorPointerWO<DT>(
+      regions[1], task->regions[1], FID_DATA, ctx, runtime);
+
+  forward_kernel<DT>(input_ptr, output_ptr, output_domain.get_volume());
+}
+
+void AllToAll::backward_task(Task const *task,
+                            std::vector<PhysicalRegion> const &regions,
+                            Context ctx,
+                            Runtime *runtime) {
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  DataType data_type = *((DataType *)task->args);
+  if (data_type == DT_FLOAT) {
+    backward_task_with_type<float>(task, regions, ctx, runtime);
+  } else if (data_type == DT_DOUBLE) {
+    backward_task_with_type<double>(task, regions, ctx, runtime);
+  } else if (data_type == DT_INT32) {
+    backward_task_with_type<int32_t>(task, regions, ctx, runtime);
+  } else if (data_type == DT_INT64) {
+    backward_task_with_type<int64_t>(task, regions, ctx, runtime);
+  } else {
+    assert(false && "Unsupported data type in AllToAll backward");
+  }
+}
+
+template <typename DT>
+void AllToAll::backward_task_with_type(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  Domain output_grad_domain = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  Domain input_grad_domain = runtime->get_index_space_domain(
+      ctx, task->regions[1].region.get_index_space());
+  assert(output_grad_domain == input_grad_domain);
+
+  const DT *output_grad_ptr = helperGetTensorPointerRO<DT>(
+      regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  DT *input_grad_ptr = helperGetTensorPointerRW<DT>(
+      regions[1], task->regions[1], FID_DATA, ctx, runtime);
+
+  backward_kernel<DT>(
+      output_grad_ptr, input_grad_ptr, output_grad_domain.get_volume());
+}
+
+}; // namespace FlexFlow
+
+namespace std {
+size_t hash<FlexFlow::AllToAllParams>::operator()(
+    FlexFlow::AllToAllParams const &params) const {
+  size_t key = 0;
+  hash_combine(key, params.split_legion_dim);
+  hash_combine(key, params.concat_legion_dim);
+  hash_combine(key, params.degree);
+  return key;
+}
+}; // namespace std
@@ -24,6 +24,8 @@ RecompileState::RecompileState(std::function<bool(FFModel *)> _trigger_func,
                                FFModel *_ff)
     : trigger_func(_trigger_func), alter_func(_alter_func), ff(_ff) {
   recompilations = 0;
+  search_in_progress = false;
+  search_model = NULL;
 }
 
 bool RecompileState::trigger() {
@@ -31,10 +33,9 @@ bool RecompileState::trigger() {
 }
 
 void RecompileState::alter() {
-  if (recompilations == 0) {
+  if (alter_func) {
     alter_func(ff);
   }
-  recompilations++;
 }
 
 }; // namespace FlexFlow
@@ -0,0 +1,308 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/model.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace FlexFlow {
+
+using namespace Legion;
+
+// A checkpoint directory holds an index describing the parameters and their
+// parallelization, and one raw file per parameter shard, named after the
+// shard's coordinates outside of replica dimensions:
+//   <dir>/index
+//   <dir>/param<i>_<c0>_<c1>...
+// Shards hold the bytes of the shard's instance, so restoring requires the
+// same parallelization of every parameter.
+
+struct CheckpointShardArgs {
+  // <dir>/param<i>
+  char prefix[MAX_FILENAME];
+  DataType data_type;
+  int num_dims;
+  bool replica_dim[MAX_TENSOR_DIM];
+};
+
+static std::string
+    checkpoint_index(std::vector<ParallelTensor> const &params) {
+  std::ostringstream index;
+  index << "flexflow-checkpoint 1\n" << params.size() << "\n";
+  for (size_t i = 0; i < params.size(); i++) {
+    ParallelTensor const &p = params[i];
+    index << i << " " << p->data_type << " " << p->num_dims;
+    for (int j = 0; j < p->num_dims; j++) {
+      index << " " << p->dims[j].size << "/" << p->dims[j].degree
+            << (p->dims[j].is_replica_dim ? "r" : "");
+    }
+    index << "\n";
+  }
+  return index.str();
+}
+
+static CheckpointShardArgs shard_args(std::string const &dir,
+                                      int param_idx,
+                                      ParallelTensor const &p) {
+  CheckpointShardArgs args;
+  std::string prefix = dir + "/param" + std::to_string(param_idx);
+  assert(prefix.size() < MAX_FILENAME);
+  strcpy(args.prefix, prefix.c_str());
+  args.data_type = p->data_type;
+  args.num_dims = p->num_dims;
+  for (int i = 0; i < p->num_dims; i++) {
+    args.replica_dim[i] = p->dims[i].is_replica_dim;
+  }
+  return args;
+}
+
+// Replicas of a shard share the file of the replica at coordinate 0
+static std::string shard_filename(CheckpointShardArgs const &args,
+                                  DomainPoint const &point,
+                                  bool &is_first_replica) {
+  assert(point.get_dim() == args.num_dims);
+  std::string filename = args.prefix;
+  is_first_replica = true;
+  for (int i = 0; i < args.num_dims; i++) {
+    if (args.replica_dim[i]) {
+      is_first_replica = is_first_replica && point[i] == 0;
+    } else {
+      filename += "_" + std::to_string(point[i]);
+    }
+  }
+  return filename;
+}
+
+void FFModel::save_checkpoint(std::string const &dir) {
+  Context ctx = config.lg_ctx;
+  Runtime *runtime = config.lg_hlr;
+  // Files of the previous checkpoint may still be in flight
+  wait_for_checkpoint();
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Cannot create checkpoint directory %s\n", dir.c_str());
+    assert(false);
+  }
+  {
+    // Every shard of a control-replicated run writes the same index
+    std::ofstream index(dir + "/index");
+    index << checkpoint_index(parameters);
+  }
+  for (size_t i = 0; i < parameters.size(); i++) {
+    ParallelTensor const &p = parameters[i];
+    CheckpointShardArgs args = shard_args(dir, i, p);
+    // Snapshot the parameter so that the next updates only wait for the
+    // copy and not for the file to be written
+    LogicalRegion snapshot = runtime->create_logical_region(
+        ctx, p->region.get_index_space(), p->region.get_field_space());
+    LogicalPartition snapshot_part = runtime->get_logical_partition(
+        ctx, snapshot, p->part.get_index_partition());
+    ArgumentMap argmap;
+    IndexLauncher snapshot_launcher(CHECKPOINT_SNAPSHOT_TASK_ID,
+                                    p->parallel_is,
+                                    TaskArgument(&args, sizeof(args)),
+                                    argmap,
+                                    Predicate::TRUE_PRED,
+                                    false /*must*/,
+                                    0 /*mapper_id*/,
+                                    p->machine_view.hash());
+    snapshot_launcher.add_region_requirement(
+        RegionRequirement(p->part,
+                          0 /*projection*/,
+                          READ_ONLY,
+                          EXCLUSIVE,
+                          p->region,
+                          MAP_TO_ZC_MEMORY));
+    snapshot_launcher.add_field(0, FID_DATA);
+    snapshot_launcher.add_region_requirement(
+        RegionRequirement(snapshot_part,
+                          0 /*projection*/,
+                          WRITE_DISCARD,
+                          EXCLUSIVE,
+                          snapshot,
+                          MAP_TO_ZC_MEMORY));
+    snapshot_launcher.add_field(1, FID_DATA);
+    runtime->execute_index_space(ctx, snapshot_launcher);
+    IndexLauncher save_launcher(CHECKPOINT_SAVE_TASK_ID,
+                                p->parallel_is,
+                                TaskArgument(&args, sizeof(args)),
+                                argmap,
+                                Predicate::TRUE_PRED,
+                                false /*must*/,
+                                0 /*mapper_id*/,
+                                p->machine_view.hash());
+    save_launcher.add_region_requirement(
+        RegionRequirement(snapshot_part,
+                          0 /*projection*/,
+                          READ_ONLY,
+                          EXCLUSIVE,
+                          snapshot,
+                          MAP_TO_ZC_MEMORY));
+    save_launcher.add_field(0, FID_DATA);
+    pending_checkpoint.push_back(
+        runtime->execute_index_space(ctx, save_launcher));
+    // Reclaimed once the save tasks are done
+    runtime->destroy_logical_region(ctx, snapshot);
+  }
+}
+
+void FFModel::wait_for_checkpoint() {
+  for (FutureMap &fm : pending_checkpoint) {
+    fm.wait_all_results();
+  }
+  pending_checkpoint.clear();
+}
+
+void FFModel::load_checkpoint(std::string const &dir) {
+  Context ctx = config.lg_ctx;
+  Runtime *runtime = config.lg_hlr;
+  {
+    std::ifstream index(dir + "/index");
+    std::stringstream saved;
+    saved << index.rdbuf();
+    if (!index || saved.str() != checkpoint_index(parameters)) {
+      fprintf(stderr,
+              "Checkpoint %s does not match the parameters or their "
+              "parallelization\n",
+              dir.c_str());
+      assert(false);
+    }
+  }
+  for (size_t i = 0; i < parameters.size(); i++) {
+    ParallelTensor const &p = parameters[i];
+    CheckpointShardArgs args = shard_args(dir, i, p);
+    ArgumentMap argmap;
+    IndexLauncher launcher(CHECKPOINT_LOAD_TASK_ID,
+                           p->parallel_is,
+                           TaskArgument(&args, sizeof(args)),
+                           argmap,
+                           Predicate::TRUE_PRED,
+                           false /*must*/,
+                           0 /*mapper_id*/,
+                           p->machine_view.hash());
+    launcher.add_region_requirement(RegionRequirement(p->part,
+                                                      0 /*projection*/,
+                                                      WRITE_DISCARD,
+                                                      EXCLUSIVE,
+                                                      p->region,
+                                                      MAP_TO_ZC_MEMORY));
+    launcher.add_field(0, FID_DATA);
+    runtime->execute_index_space(ctx, launcher);
+  }
+}
+
+/*
+  regions[0](I): parameter shard
+  regions[1](O): snapshot shard
+*/
+void FFModel::checkpoint_snapshot_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  CheckpointShardArgs const *args = (CheckpointShardArgs const *)task->args;
+  assert(regions.size() == 2);
+  GenericTensorAccessorR src = helperGetGenericTensorAccessorRO(
+      args->data_type, regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW dst = helperGetGenericTensorAccessorWO(
+      args->data_type, regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  assert(src.domain == dst.domain);
+  memcpy(dst.ptr,
+         src.ptr,
+         src.domain.get_volume() * data_type_size(args->data_type));
+}
+
+/*
+  regions[0](I): snapshot shard
+*/
+void FFModel::checkpoint_save_task(Task const *task,
+                                   std::vector<PhysicalRegion> const &regions,
+                                   Context ctx,
+                                   Runtime *runtime) {
+  CheckpointShardArgs const *args = (CheckpointShardArgs const *)task->args;
+  assert(regions.size() == 1);
+  bool is_first_replica;
+  std::string filename =
+      shard_filename(*args, task->index_point, is_first_replica);
+  if (!is_first_replica) {
+    return;
+  }
+  GenericTensorAccessorR acc = helperGetGenericTensorAccessorRO(
+      args->data_type, regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  char const *data = (char const *)acc.ptr;
+  size_t size = acc.domain.get_volume() * data_type_size(args->data_type);
+  // Write to a temporary file so an interrupted save never leaves a
+  // truncated shard behind
+  std::string tmp_filename = filename + ".tmp";
+  int fd = open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot open checkpoint shard %s\n", filename.c_str());
+    assert(false);
+  }
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      fprintf(stderr, "Cannot write checkpoint shard %s\n", filename.c_str());
+      assert(false);
+    }
+    data += written;
+    size -= written;
+  }
+  close(fd);
+  if (rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    fprintf(stderr, "Cannot write checkpoint shard %s\n", filename.c_str());
+    assert(false);
+  }
+}
+
+/*
+  regions[0](O): parameter shard
+*/
+void FFModel::checkpoint_load_task(Task const *task,
+                                   std::vector<PhysicalRegion> const &regions,
+                                   Context ctx,
+                                   Runtime *runtime) {
+  CheckpointShardArgs const *args = (CheckpointShardArgs const *)task->args;
+  assert(regions.size() == 1);
+  bool is_first_replica;
+  std::string filename =
+      shard_filename(*args, task->index_point, is_first_replica);
+  GenericTensorAccessorW acc = helperGetGenericTensorAccessorWO(
+      args->data_type, regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  size_t size = acc.domain.get_volume() * data_type_size(args->data_type);
+  int fd = open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+    fprintf(stderr,
+            "Checkpoint shard %s is missing or has the wrong size\n",
+            filename.c_str());
+    assert(false);
+  }
+  // Copy straight from the page cache instead of through a read buffer
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  assert(data != MAP_FAILED);
+  memcpy(acc.ptr, data, size);
+  munmap(data, size);
+  close(fd);
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,289 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/cost_calibration.h"
+#include "flexflow/ffconst_utils.h"
+#include "flexflow/model.h"
+#include "flexflow/ops/fused.h"
+#include "flexflow/utils/hash_utils.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace FlexFlow {
+
+using namespace Legion;
+
+LegionRuntime::Logger::Category log_calib("calibration");
+
+namespace {
+
+size_t prediction_key(Op const *op, MachineView const &view) {
+  size_t key = op->get_untyped_params_hash();
+  hash_combine(key, op->op_type);
+  hash_combine(key, view.hash());
+  return key;
+}
+
+float median(std::vector<float> values) {
+  if (values.empty()) {
+    return 0.0f;
+  }
+  size_t mid = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + mid, values.end());
+  return values[mid];
+}
+
+} // namespace
+
+bool load_cost_corrections(std::string const &filename,
+                           CostCorrectionMap &corrections) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  // Each line: <op_type id> <op_type name> <forward> <backward> <sync>
+  int op_type;
+  std::string name;
+  CostCorrection correction;
+  while (file >> op_type >> name >> correction.forward >> correction.backward >>
+         correction.sync) {
+    corrections[op_type] = correction;
+  }
+  return true;
+}
+
+bool save_cost_corrections(std::string const &filename,
+                           CostCorrectionMap const &corrections) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  for (auto const &it : corrections) {
+    file << it.first << " "
+         << get_operator_type_name((OperatorType)it.first) << " "
+         << it.second.forward << " " << it.second.backward << " "
+         << it.second.sync << std::endl;
+  }
+  return true;
+}
+
+void apply_cost_correction(CostCorrectionMap const &corrections,
+                           OperatorType type,
+                           CostMetrics &cost_metrics) {
+  auto const &it = corrections.find(type);
+  if (it == corrections.end()) {
+    return;
+  }
+  cost_metrics.forward_time *= it->second.forward;
+  cost_metrics.backward_time *= it->second.backward;
+  cost_metrics.sync_time *= it->second.sync;
+}
+
+CostCalibrator::CostCalibrator(int _num_iterations,
+                               CostCorrectionMap const &applied)
+    : num_iterations(_num_iterations), current_iteration(0),
+      applied_corrections(applied) {}
+
+bool CostCalibrator::is_active() const {
+  return current_iteration < num_iterations;
+}
+
+void CostCalibrator::record_prediction(Op const *op,
+                                       MachineView const &view,
+                                       CostMetrics const &cost_metrics) {
+  OpTimes &predicted = predictions[prediction_key(op, view)];
+  predicted.forward = cost_metrics.forward_time;
+  predicted.backward = cost_metrics.backward_time;
+  predicted.sync = cost_metrics.sync_time;
+}
+
+bool CostCalibrator::lookup_prediction(Op const *op,
+                                       OpTimes &predicted) const {
+  if (op->op_type == OP_FUSED) {
+    // A fused operator is predicted as the sum of its constituents, which
+    // were measured individually during the search
+    FusedOp const *fused = (FusedOp const *)op;
+    predicted = OpTimes();
+    for (int i = 0; i < fused->numOperators; i++) {
+      OpTimes sub;
+      if (!lookup_prediction(fused->operators[i], sub)) {
+        return false;
+      }
+      predicted.forward += sub.forward;
+      predicted.backward += sub.backward;
+      predicted.sync += sub.sync;
+    }
+    return true;
+  }
+  if (op->numOutputs == 0) {
+    return false;
+  }
+  auto const &it =
+      predictions.find(prediction_key(op, op->outputs[0]->machine_view));
+  if (it == predictions.end()) {
+    return false;
+  }
+  predicted = it->second;
+  return true;
+}
+
+CostCalibrator::OpRecord &CostCalibrator::get_record(Op const *op) {
+  auto const &it = record_index.find(op);
+  if (it != record_index.end()) {
+    return records[it->second];
+  }
+  OpRecord record;
+  record.op = op;
+  record.has_prediction = lookup_prediction(op, record.predicted);
+  record_index[op] = records.size();
+  records.push_back(record);
+  return records.back();
+}
+
+void CostCalibrator::record_forward(Op const *op, float run_time) {
+  get_record(op).forward_times.push_back(run_time);
+}
+
+void CostCalibrator::record_backward(Op const *op, float run_time) {
+  get_record(op).backward_times.push_back(run_time);
+}
+
+void CostCalibrator::record_sync(Op const *op, float run_time) {
+  iteration_sync_times[op] += run_time;
+}
+
+void CostCalibrator::finish_iteration(FFModel const *model) {
+  if (!is_active()) {
+    return;
+  }
+  for (auto const &it : iteration_sync_times) {
+    get_record(it.first).sync_times.push_back(it.second);
+  }
+  iteration_sync_times.clear();
+  current_iteration++;
+  if (is_active()) {
+    return;
+  }
+  FFConfig const &config = model->config;
+  if (!config.calibration_report_file.empty()) {
+    export_report(config.calibration_report_file);
+  }
+  if (!config.export_cost_calibration_file.empty()) {
+    if (!save_cost_corrections(config.export_cost_calibration_file,
+                               compute_corrections())) {
+      log_calib.error("Failed to write cost corrections to %s",
+                      config.export_cost_calibration_file.c_str());
+    }
+  }
+}
+
+CostCorrectionMap CostCalibrator::compute_corrections() const {
+  // Accumulate per operator type so that a few tiny operators cannot
+  // dominate the ratio of a type
+  struct Totals {
+    double predicted[3] = {0, 0, 0};
+    double actual[3] = {0, 0, 0};
+  };
+  std::unordered_map<int, Totals> totals;
+  for (auto const &record : records) {
+    // Fused operators mix several types and cannot be attributed to one
+    if (!record.has_prediction || record.op->op_type == OP_FUSED) {
+      continue;
+    }
+    Totals &t = totals[record.op->op_type];
+    if (!record.forward_times.empty()) {
+      t.predicted[0] += record.predicted.forward;
+      t.actual[0] += median(record.forward_times);
+    }
+    if (!record.backward_times.empty()) {
+      t.predicted[1] += record.predicted.backward;
+      t.actual[1] += median(record.backward_times);
+    }
+    if (!record.sync_times.empty()) {
+      t.predicted[2] += record.predicted.sync;
+      t.actual[2] += median(record.sync_times);
+    }
+  }
+  // Types not observed in this run keep the factors they were searched with
+  CostCorrectionMap corrections = applied_corrections;
+  for (auto const &it : totals) {
+    CostCorrection applied;
+    if (applied_corrections.find(it.first) != applied_corrections.end()) {
+      applied = applied_corrections.at(it.first);
+    }
+    float *factors[3] = {&applied.forward, &applied.backward, &applied.sync};
+    for (int i = 0; i < 3; i++) {
+      // Predictions already include the applied factor, so compose with it
+      if (it.second.predicted[i] > 0 && it.second.actual[i] > 0) {
+        *factors[i] *= it.second.actual[i] / it.second.predicted[i];
+      }
+    }
+    corrections[it.first] = applied;
+  }
+  return corrections;
+}
+
+void CostCalibrator::export_report(std::string const &filename) const {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    log_calib.error("Failed to write calibration report to %s",
+                    filename.c_str());
+    return;
+  }
+  file << "op_guid,name,op_type,machine_view,predicted_forward,"
+          "actual_forward,predicted_backward,actual_backward,"
+          "predicted_sync,actual_sync"
+       << std::endl;
+  for (auto const &record : records) {
+    Op const *op = record.op;
+    std::ostringstream view;
+    if (op->numOutputs > 0) {
+      view << op->outputs[0]->machine_view;
+    }
+    std::string view_str = view.str();
+    std::replace(view_str.begin(), view_str.end(), ',', ' ');
+    file << op->op_guid << "," << op->name << ","
+         << get_operator_type_name(op->op_type) << "," << view_str << ",";
+    if (record.has_prediction) {
+      file << record.predicted.forward;
+    }
+    file << "," << median(record.forward_times) << ",";
+    if (record.has_prediction) {
+      file << record.predicted.backward;
+    }
+    file << "," << median(record.backward_times) << ",";
+    if (record.has_prediction) {
+      file << record.predicted.sync;
+    }
+    file << "," << median(record.sync_times) << std::endl;
+  }
+  log_calib.print("Wrote predicted vs. measured costs of %zu operators to %s",
+                  records.size(),
+                  filename.c_str());
+}
+
+/*static*/
+double CostCalibrator::fenced_current_time(FFModel const *model) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  runtime->issue_execution_fence(ctx);
+  TimingLauncher timer(MEASURE_MICRO_SECONDS);
+  Future future = runtime->issue_timing_measurement(ctx, timer);
+  future.get_void_result();
+  return Realm::Clock::current_time_in_microseconds();
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,128 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/device.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <algorithm>
+
+namespace FlexFlow {
+
+int get_legion_stream(ffStream_t *stream) {
+  *stream = nullptr;
+  return 0;
+}
+
+}; // namespace FlexFlow
+
+template <typename DT>
+static void relu_backward(DT *grad_ptr, DT const *output, size_t n) {
+#pragma omp parallel for if (n > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < n; i++) {
+    grad_ptr[i] = (output[i] > 0.0f) ? grad_ptr[i] : 0;
+  }
+}
+
+void relu_backward_kernel(DataType data_type,
+                          void *output_grad_ptr,
+                          void const *output_ptr,
+                          size_t output_size) {
+  if (data_type == DT_FLOAT) {
+    relu_backward<float>(
+        (float *)output_grad_ptr, (float const *)output_ptr, output_size);
+  } else if (data_type == DT_DOUBLE) {
+    relu_backward<double>(
+        (double *)output_grad_ptr, (double const *)output_ptr, output_size);
+  } else {
+    assert(false && "Unsupported data type in Linear backward");
+    exit(1);
+  }
+}
+
+template <typename DT>
+static void sigmoid_backward(DT *grad_ptr, DT const *output, size_t n) {
+#pragma omp parallel for if (n > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < n; i++) {
+    grad_ptr[i] = grad_ptr[i] * output[i] * (1.0f - output[i]);
+  }
+}
+
+void sigmoid_backward_kernel(DataType data_type,
+                             void *output_grad_ptr,
+                             void const *output_ptr,
+                             size_t output_size) {
+  if (data_type == DT_FLOAT) {
+    sigmoid_backward<float>(
+        (float *)output_grad_ptr, (float const *)output_ptr, output_size);
+  } else if (data_type == DT_DOUBLE) {
+    sigmoid_backward<double>(
+        (double *)output_grad_ptr, (double const *)output_ptr, output_size);
+  } else {
+    assert(false && "Unsupported data type in Linear backward");
+    exit(1);
+  }
+}
+
+void add_with_stride(float *output,
+                     float const *input,
+                     int num_blocks,
+                     int output_blk_size,
+                     int input_blk_size) {
+  int min_blk_size = std::min(output_blk_size, input_blk_size);
+  size_t total = (size_t)num_blocks * min_blk_size;
+#pragma omp parallel for if (total > CPU_PARALLEL_THRESHOLD)
+  for (int blk_idx = 0; blk_idx < num_blocks; blk_idx++) {
+    float const *src = input + (size_t)blk_idx * input_blk_size;
+    float *dst = output + (size_t)blk_idx * output_blk_size;
+    for (int i = 0; i < min_blk_size; i++) {
+      dst[i] += src[i];
+    }
+  }
+}
+
+void copy_with_stride(float *output,
+                      float const *input,
+                      int num_blocks,
+                      int output_blk_size,
+                      int input_blk_size) {
+  int min_blk_size = std::min(output_blk_size, input_blk_size);
+  size_t total = (size_t)num_blocks * min_blk_size;
+#pragma omp parallel for if (total > CPU_PARALLEL_THRESHOLD)
+  for (int blk_idx = 0; blk_idx < num_blocks; blk_idx++) {
+    std::copy(input + (size_t)blk_idx * input_blk_size,
+              input + (size_t)blk_idx * input_blk_size + min_blk_size,
+              output + (size_t)blk_idx * output_blk_size);
+  }
+}
+
+template <typename T>
+void print_tensor(T const *ptr, size_t num_elements, char const *prefix) {
+  printf("%s", prefix);
+  for (size_t idx = 0; idx < num_elements; idx++) {
+    printf(" %.4lf", (float)ptr[idx]);
+    if (idx >= 16) {
+      break;
+    }
+  }
+  printf("\n");
+}
+
+template void
+    print_tensor<float>(float const *ptr, size_t rect, char const *prefix);
+template void
+    print_tensor<double>(double const *ptr, size_t rect, char const *prefix);
+template void
+    print_tensor<int32_t>(int32_t const *ptr, size_t rect, char const *prefix);
+template void
+    print_tensor<int64_t>(int64_t const *ptr, size_t rect, char const *prefix);
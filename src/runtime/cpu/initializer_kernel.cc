@@ -0,0 +1,123 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flexflow/accessor.h"
+#include "flexflow/initializer.h"
+#include "flexflow/model.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::Context;
+using Legion::Domain;
+using Legion::PhysicalRegion;
+using Legion::Runtime;
+using Legion::Task;
+
+template <typename DT>
+static void assign_cpu(DT *ptr, size_t size, DT value) {
+  std::fill(ptr, ptr + size, value);
+}
+
+// The random initializers share the counter-based CPU tasks, so a CPU run
+// draws the same weights whatever the partitioning and thread count
+void UniformInitializer::init_task(Task const *task,
+                                   std::vector<PhysicalRegion> const &regions,
+                                   Context ctx,
+                                   Runtime *runtime) {
+  init_task_cpu(task, regions, ctx, runtime);
+}
+
+void GlorotUniform::init_task(Task const *task,
+                              std::vector<PhysicalRegion> const &regions,
+                              Context ctx,
+                              Runtime *runtime) {
+  init_task_cpu(task, regions, ctx, runtime);
+}
+
+void NormInitializer::init_task(Task const *task,
+                                std::vector<PhysicalRegion> const &regions,
+                                Context ctx,
+                                Runtime *runtime) {
+  init_task_cpu(task, regions, ctx, runtime);
+}
+
+void ZeroInitializer::init_task(Task const *task,
+                                std::vector<PhysicalRegion> const &regions,
+                                Context ctx,
+                                Runtime *runtime) {
+  ZeroInitMeta *meta = (ZeroInitMeta *)task->args;
+  assert(meta->num_regions == regions.size());
+  assert(regions.size() == task->regions.size());
+  for (size_t i = 0; i < regions.size(); i++) {
+    Domain domain = runtime->get_index_space_domain(
+        ctx, task->regions[i].region.get_index_space());
+    if (meta->data_types[i] == DT_HALF) {
+      half *w = helperGetTensorPointerWO<half>(
+          regions[i], task->regions[i], FID_DATA, ctx, runtime);
+      assign_cpu<half>(w, domain.get_volume(), half(0.0f));
+    } else if (meta->data_types[i] == DT_FLOAT) {
+      float *w = helperGetTensorPointerWO<float>(
+          regions[i], task->regions[i], FID_DATA, ctx, runtime);
+      assign_cpu<float>(w, domain.get_volume(), 0.0f);
+    } else if (meta->data_types[i] == DT_INT32) {
+      int32_t *w = helperGetTensorPointerWO<int32_t>(
+          regions[i], task->regions[i], FID_DATA, ctx, runtime);
+      assign_cpu<int32_t>(w, domain.get_volume(), 0);
+    } else if (meta->data_types[i] == DT_INT64) {
+      int64_t *w = helperGetTensorPointerWO<int64_t>(
+          regions[i], task->regions[i], FID_DATA, ctx, runtime);
+      assign_cpu<int64_t>(w, domain.get_volume(), 0);
+    } else {
+      assert(false && "Unsupported data type in Zero Initializer");
+    }
+  }
+}
+
+void ConstantInitializer::init_task(Task const *task,
+                                    std::vector<PhysicalRegion> const &regions,
+                                    Context ctx,
+                                    Runtime *runtime) {
+  ConstantInitializer *initializer = (ConstantInitializer *)task->args;
+  assert(regions.size() == task->regions.size());
+  for (size_t i = 0; i < regions.size(); i++) {
+    Domain domain = runtime->get_index_space_domain(
+        ctx, task->regions[i].region.get_index_space());
+    switch (initializer->data_type) {
+      case DT_FLOAT: {
+        float *w = helperGetTensorPointerWO<float>(
+            regions[i], task->regions[i], FID_DATA, ctx, runtime);
+        assign_cpu<float>(w, domain.get_volume(), initializer->float_value);
+        break;
+      }
+      case DT_INT64: {
+        int64_t *w = helperGetTensorPointerWO<int64_t>(
+            regions[i], task->regions[i], FID_DATA, ctx, runtime);
+        assign_cpu<int64_t>(w, domain.get_volume(), initializer->int64_value);
+        break;
+      }
+      case DT_INT32: {
+        int *w = helperGetTensorPointerWO<int>(
+            regions[i], task->regions[i], FID_DATA, ctx, runtime);
+        assign_cpu<int>(w, domain.get_volume(), initializer->int32_value);
+        break;
+      }
+      default: {
+        assert(false && "Unsupported Initialzier Type");
+      }
+    }
+  }
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,179 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flexflow/model.h"
+#include "flexflow/utils/cpu_helper.h"
+
+namespace FlexFlow {
+// declare Legion names
+using Legion::Context;
+using Legion::coord_t;
+using Legion::Machine;
+using Legion::Memory;
+using Legion::PhysicalRegion;
+using Legion::Rect;
+using Legion::Runtime;
+using Legion::Task;
+
+void Op::inner_measure_operator_cost(Simulator *sim,
+                                     std::function<void()> const &forward,
+                                     std::function<void()> const &backward,
+                                     CostMetrics &cost_metrics) const {
+  // CPU kernels run synchronously, so wall-clock time measures them directly
+  double start_time = 0;
+  for (int i = 0; i < sim->warmup_times + sim->repeat_times; i++) {
+    if (i == sim->warmup_times) {
+      start_time = cpu_time_in_milliseconds();
+    }
+    forward();
+  }
+  cost_metrics.forward_time =
+      (cpu_time_in_milliseconds() - start_time) / sim->repeat_times;
+
+  // measure backward time
+  if (sim->computationMode == COMP_MODE_TRAINING) {
+    for (int i = 0; i < sim->warmup_times + sim->repeat_times; i++) {
+      if (i == sim->warmup_times) {
+        start_time = cpu_time_in_milliseconds();
+      }
+      backward();
+    }
+    cost_metrics.backward_time =
+        (cpu_time_in_milliseconds() - start_time) / sim->repeat_times;
+  } else {
+    cost_metrics.backward_time = 0.0f;
+  }
+}
+
+FFHandler
+    UtilityTasks::init_cuda_task(Task const *task,
+                                 std::vector<PhysicalRegion> const &regions,
+                                 Context ctx,
+                                 Runtime *runtime) {
+  assert(regions.size() == 0);
+  assert(task->local_arglen == sizeof(FFInitInfo));
+  FFInitInfo const *info = (FFInitInfo *)task->local_args;
+  printf("workSpaceSize (%zu MB)\n", info->workSpaceSize / 1024 / 1024);
+  FFHandler handle;
+  handle.workSpaceSize = info->workSpaceSize;
+  handle.allowTensorOpMathConversion = info->allowTensorOpMathConversion;
+  // Runs on the OpenMP processor that will execute the operator tasks
+  handle.num_threads = omp_get_max_threads();
+  {
+    // allocate memory for workspace
+    Memory cpu_mem = Machine::MemoryQuery(Machine::get_machine())
+                         .only_kind(DEVICE_MEM_KIND)
+                         .best_affinity_to(task->target_proc)
+                         .first();
+    Realm::Rect<1, coord_t> bounds(
+        Realm::Point<1, coord_t>(0),
+        Realm::Point<1, coord_t>(handle.workSpaceSize - 1));
+    std::vector<size_t> field_sizes;
+    field_sizes.push_back(sizeof(char));
+    Realm::RegionInstance workspaceInst;
+    Realm::RegionInstance::create_instance(workspaceInst,
+                                           cpu_mem,
+                                           bounds,
+                                           field_sizes,
+                                           0,
+                                           Realm::ProfilingRequestSet())
+        .wait();
+    handle.workSpace = workspaceInst.pointer_untyped(0, sizeof(char));
+  }
+  return handle;
+}
+
+void UtilityTasks::dummy_task(Task const *task,
+                              std::vector<PhysicalRegion> const &regions,
+                              Context ctx,
+                              Runtime *runtime) {}
+
+void UtilityTasks::load_images_task(Task const *task,
+                                    std::vector<PhysicalRegion> const &regions,
+                                    Context ctx,
+                                    Runtime *runtime) {
+  // JPEG decoding is only wired up in the GPU backends
+  assert(false && "load_images_task is not supported by the cpu backend");
+}
+
+/*
+  regions[0](O): input_images
+  regions[1](I): input_rgb
+*/
+void UtilityTasks::normalize_images_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  AccessorWO<float, 3> const acc_tensor(regions[0], FID_DATA);
+  AccessorRO<unsigned char, 3> const acc_rgb(regions[1], FID_DATA);
+  Rect<3> rect_tensor, rect_rgb;
+  rect_tensor = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  rect_rgb = runtime->get_index_space_domain(
+      ctx, task->regions[1].region.get_index_space());
+  assert(acc_tensor.accessor.is_dense_arbitrary(rect_tensor));
+  assert(acc_rgb.accessor.is_dense_arbitrary(rect_rgb));
+  assert(rect_tensor == rect_rgb);
+  size_t w = rect_tensor.hi[0] - rect_tensor.lo[0] + 1;
+  size_t h = rect_tensor.hi[1] - rect_tensor.lo[1] + 1;
+  float *tensor_ptr = acc_tensor.ptr(rect_tensor.lo);
+  unsigned char const *rgb_ptr = acc_rgb.ptr(rect_rgb.lo);
+  float const mean[3] = {0.485, 0.456, 0.406};
+  float const var[3] = {0.229, 0.224, 0.225};
+  size_t size = rect_tensor.volume();
+  size_t hxw = h * w;
+#pragma omp parallel for if (size > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < size; i++) {
+    // decide the color of the current position by assuming NCHW layout
+    int c = (i / hxw) % 3;
+    tensor_ptr[i] = (static_cast<float>(rgb_ptr[i]) / 256 - mean[c]) / var[c];
+  }
+}
+
+void UtilityTasks::init_images_task(Task const *task,
+                                    std::vector<PhysicalRegion> const &regions,
+                                    Context ctx,
+                                    Runtime *runtime) {
+  AccessorWO<float, 3> const acc_image(regions[0], FID_DATA);
+  Rect<3> rect_image;
+  rect_image = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  assert(acc_image.accessor.is_dense_arbitrary(rect_image));
+  float *image_ptr = acc_image.ptr(rect_image.lo);
+  std::fill(image_ptr, image_ptr + rect_image.volume(), 1.0f);
+}
+
+void UtilityTasks::init_labels_task(Task const *task,
+                                    std::vector<PhysicalRegion> const &regions,
+                                    Context ctx,
+                                    Runtime *runtime) {
+  AccessorWO<int, 1> const acc_label(regions[0], FID_DATA);
+  Rect<1> rect_label;
+  rect_label = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  assert(acc_label.accessor.is_dense_arbitrary(rect_label));
+  int *label_ptr = acc_label.ptr(rect_label.lo);
+  std::fill(label_ptr, label_ptr + rect_label.volume(), 1);
+}
+
+void FFModel::prefetch() {
+  for (size_t i = 0; i < operators.size(); i++) {
+    operators[i]->prefetch(*this);
+  }
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,148 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flexflow/accessor.h"
+#include "flexflow/model.h"
+#include "flexflow/optimizer.h"
+#include "flexflow/utils/cpu_helper.h"
+#include <unordered_set>
+
+namespace FlexFlow {
+
+LegionRuntime::Logger::Category log_optimizer("optimizer");
+
+// The cpu backend has no NCCL, so only the parameter server updates are
+// defined here; they run on the OpenMP processors holding the parameters
+
+void SGDOptimizer::ps_update_task_gpu(SGDOptimizer const *op,
+                                      float const *w_grad_ptr,
+                                      size_t size,
+                                      int num_replicas,
+                                      float *w_ptr,
+                                      float *v_ptr) {
+  // Step 1: Gather gradients in the first replica
+  gather_replicas_cpu((float *)w_grad_ptr, size, num_replicas);
+  // Step 2: SGD update
+  sgd_update_cpu(size,
+                 op->lr,
+                 op->weight_decay,
+                 op->momentum,
+                 op->nesterov,
+                 w_grad_ptr,
+                 v_ptr,
+                 w_ptr);
+}
+
+void AdamOptimizer::ps_update_task_gpu(AdamOptimizer const *op,
+                                       float const *w_grad_ptr,
+                                       size_t size,
+                                       int num_replicas,
+                                       float *w_ptr,
+                                       float *v_ptr,
+                                       float *m_ptr) {
+  // Step 1: Gather gradients in the first replica
+  gather_replicas_cpu((float *)w_grad_ptr, size, num_replicas);
+  // Step 2: Adam update
+  adam_update_cpu(size,
+                  op->alpha_t,
+                  op->beta1,
+                  op->beta2,
+                  op->weight_decay,
+                  op->epsilon,
+                  w_grad_ptr,
+                  m_ptr,
+                  v_ptr,
+                  w_ptr);
+}
+
+// ==================================================================
+//                     Multi-tensor Updates
+// ==================================================================
+void SGDOptimizer::multi_tensor_update_task_gpu(
+    SGDOptimizer const *op, MultiTensorUpdateArgs const &args) {
+  multi_tensor_update_task_cpu(op, args);
+}
+
+void AdamOptimizer::multi_tensor_update_task_gpu(
+    AdamOptimizer const *op, MultiTensorUpdateArgs const &args) {
+  multi_tensor_update_task_cpu(op, args);
+}
+
+// ==================================================================
+//                     Row-sparse Updates
+// ==================================================================
+static int64_t get_row_id(SparseUpdateArgs const &args, size_t k) {
+  if (args.id_type == DT_INT64) {
+    return ((int64_t const *)args.row_ids)[k];
+  }
+  assert(args.id_type == DT_INT32);
+  return ((int32_t const *)args.row_ids)[k];
+}
+
+// Sum the replicas of each distinct row into the first one, calling update
+// once per row, and then restore the invariant that all rows not listed in
+// the row ids are zero
+template <typename F>
+static void for_each_sparse_row(SparseUpdateArgs const &args, F update) {
+  std::unordered_set<int64_t> visited;
+  for (size_t k = 0; k < args.num_ids; k++) {
+    int64_t row = get_row_id(args, k);
+    if (!visited.insert(row).second) {
+      continue;
+    }
+    size_t offset = (size_t)row * args.row_size;
+    float *w_grad_ptr = args.w_grad_ptr + offset;
+    for (int r = 1; r < args.num_replicas; r++) {
+      float *src = w_grad_ptr + r * args.size;
+      for (int c = 0; c < args.row_size; c++) {
+        w_grad_ptr[c] += src[c];
+        src[c] = 0.0f;
+      }
+    }
+    update(offset, w_grad_ptr);
+    std::fill(w_grad_ptr, w_grad_ptr + args.row_size, 0.0f);
+  }
+}
+
+void SGDOptimizer::ps_sparse_update_task_gpu(SGDOptimizer const *op,
+                                             SparseUpdateArgs const &args) {
+  for_each_sparse_row(args, [&](size_t offset, float const *w_grad_ptr) {
+    sgd_update_cpu(args.row_size,
+                   op->lr,
+                   op->weight_decay,
+                   op->momentum,
+                   op->nesterov,
+                   w_grad_ptr,
+                   args.v_ptr != NULL ? args.v_ptr + offset : NULL,
+                   args.w_ptr + offset);
+  });
+}
+
+void AdamOptimizer::ps_sparse_update_task_gpu(AdamOptimizer const *op,
+                                              SparseUpdateArgs const &args) {
+  for_each_sparse_row(args, [&](size_t offset, float const *w_grad_ptr) {
+    adam_update_cpu(args.row_size,
+                    op->alpha_t,
+                    op->beta1,
+                    op->beta2,
+                    op->weight_decay,
+                    op->epsilon,
+                    w_grad_ptr,
+                    args.m_ptr + offset,
+                    args.v_ptr + offset,
+                    args.w_ptr + offset);
+  });
+}
+
+}; // namespace FlexFlow
@@ -38,11 +38,13 @@
 #include "flexflow/ops/split.h"
 #include "flexflow/ops/topk.h"
 #include "flexflow/ops/transpose.h"
+#include "flexflow/parallel_ops/all_to_all.h"
 #include "flexflow/parallel_ops/combine.h"
 #include "flexflow/parallel_ops/fused_parallel_op.h"
 #include "flexflow/parallel_ops/partition.h"
 #include "flexflow/parallel_ops/reduction.h"
 #include "flexflow/parallel_ops/replicate.h"
+#include "flexflow/substitution.h"
 #include "flexflow/utils/disjoint_set.h"
 #include "legion.h"
 #include "legion/legion_utilities.h"
@@ -811,9 +813,13 @@ void Graph::simplify_parallel_ops() {
 
     std::vector<ParallelOpInfo> node_parallel_op_info,
         successor_parallel_op_info;
-    ((ParallelOp *)node.ptr)->append_parallel_op_info(node_parallel_op_info);
-    ((ParallelOp *)succ.ptr)
-        ->append_parallel_op_info(successor_parallel_op_info);
+    if (!((ParallelOp *)node.ptr)
+             ->append_parallel_op_info(node_parallel_op_info) ||
+        !((ParallelOp *)succ.ptr)
+             ->append_parallel_op_info(successor_parallel_op_info)) {
+      log_simplify.debug() << "Skipping because a parallel op has no info";
+      continue;
+    }
     ParallelOpJoinResult result = try_join_parallel_ops(
         node_parallel_op_info.front(), successor_parallel_op_info.front());
 
@@ -867,12 +873,13 @@ void Graph::simplify(SimplificationSettings const &settings) {
           Node n1 = e2.srcOp;
           // Check that n1 is a parallel op
           // Check that n1 must have a single out edge
+          // Check that both can be described by ParallelOpInfos
+          std::vector<ParallelOpInfo> parallel_ops;
           if (n1.ptr->is_parallel_op() &&
-              this->outEdges.find(n1)->second.size() == 1) {
+              this->outEdges.find(n1)->second.size() == 1 &&
+              ((ParallelOp *)n1.ptr)->append_parallel_op_info(parallel_ops) &&
+              ((ParallelOp *)n2.ptr)->append_parallel_op_info(parallel_ops)) {
             // merge n1 and n2
-            std::vector<ParallelOpInfo> parallel_ops;
-            ((ParallelOp *)n1.ptr)->append_parallel_op_info(parallel_ops);
-            ((ParallelOp *)n2.ptr)->append_parallel_op_info(parallel_ops);
             Node new_node = model->get_or_create_fused_parallel_node(
                 n1.ptr->inputs[0], parallel_ops);
             auto const &inList = this->inEdges.find(n1)->second;
@@ -1172,7 +1179,8 @@ std::ostream &operator<<(std::ostream &s, GraphCostResult const &r) {
 
 std::ostream &operator<<(std::ostream &s, GraphCostResultWithMemory const &r) {
   s << "GraphCostResultWithMemory{run_time_cost=" << r.cost
-    << ", memory_cost=" << r.mem_cost << "}";
+    << ", memory_cost=" << r.mem_cost
+    << ", recompute_cost=" << r.recompute_cost << "}";
   return s;
 }
 
@@ -1205,6 +1213,9 @@ GraphCostResultWithMemory sequence_cost<GraphCostResultWithMemory>(
   result.cost += second.cost;
   result.mem_cost += second.mem_cost;
   result.views.insert(second.views.cbegin(), second.views.cend());
+  result.recompute_cost += second.recompute_cost;
+  result.recomputed_nodes.insert(second.recomputed_nodes.cbegin(),
+                                 second.recomputed_nodes.cend());
   return result;
 }
 
@@ -1272,6 +1283,11 @@ GraphCostResultWithMemory parallel_cost<GraphCostResultWithMemory>(
   result.mem_cost = first.mem_cost + second.mem_cost;
   result.views.insert(first.views.cbegin(), first.views.cend());
   result.views.insert(second.views.cbegin(), second.views.cend());
+  result.recompute_cost = first.recompute_cost + second.recompute_cost;
+  result.recomputed_nodes.insert(first.recomputed_nodes.cbegin(),
+                                 first.recomputed_nodes.cend());
+  result.recomputed_nodes.insert(second.recomputed_nodes.cbegin(),
+                                 second.recomputed_nodes.cend());
 
   return result;
 }
@@ -1569,9 +1585,25 @@ void SearchHelper::add_sink_node_costs<GraphCostResultWithMemory>(
     CostMetrics metrics,
     GraphCostResultWithMemory *result) const {
   float op_total_mem_mb = ((float)(metrics.op_total_mem / 1e4)) / 1e2;
+  float run_time_cost =
+      metrics.forward_time + metrics.backward_time + metrics.sync_time;
+  if (model->config.auto_recompute && sink.node.ptr->is_recomputable()) {
+    // Recomputing the outputs in backward costs another forward pass but
+    // frees the outputs between forward and backward. Take whichever option
+    // has the lower multi-objective cost
+    float saved_mem_mb = ((float)(metrics.op_output_mem / 1e4)) / 1e2;
+    float factor =
+        model->graph_search->get_mem_optim_config().run_time_cost_factor;
+    if (factor * metrics.forward_time < (1 - factor) * saved_mem_mb) {
+      run_time_cost += metrics.forward_time;
+      op_total_mem_mb -= saved_mem_mb;
+      result->recompute_cost += metrics.forward_time;
+      result->recomputed_nodes.insert(sink.node);
+    }
+  }
   this->add_operator_cost_with_memory(
       sink,
-      metrics.forward_time + metrics.backward_time + metrics.sync_time,
+      run_time_cost,
       MemoryUsage{MemoryUsageType::GLOBAL, op_total_mem_mb},
       result);
 }
@@ -1719,6 +1751,7 @@ T SearchHelper::graph_cost(Graph const *graph,
     metrics.op_total_mem = input_num_parts * metrics.inputs_memory +
                            output_num_parts * metrics.outputs_memory +
                            weight_num_parts * metrics.weights_memory;
+    metrics.op_output_mem = output_num_parts * metrics.outputs_memory;
 
     this->logger->spew() << "  op_total_mem: " << metrics.op_total_mem;
     float op_total_mem_mb = (float)((metrics.op_total_mem) / 1e4) / 1e2;
@@ -1769,6 +1802,11 @@ std::unordered_map<Node, MachineView> Graph::optimal_views() const {
   return this->generic_optimal_cost<GraphCostResult>().views;
 }
 
+std::unordered_set<Node> Graph::recomputed_nodes() const {
+  return this->generic_optimal_cost<GraphCostResultWithMemory>()
+      .recomputed_nodes;
+}
+
 Graph Graph::reduced() const {
   using FlexFlow::PCG::Utils::BasicGraph;
   using FlexFlow::PCG::Utils::get_edges;
@@ -1883,6 +1921,8 @@ namespace {
 std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
     try_one_lambda(std::pair<float, MemorySearchResult> &lambda,
                    Task const *task,
+                   Context ctx,
+                   Runtime *runtime,
                    std::shared_ptr<Simulator> &cached_simulator,
                    bool perform_memory_search) {
   // Create a new fresh model
@@ -1900,10 +1940,15 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
                                     model->config.workersPerNode,
                                     model->config.cpusPerNode,
                                     model->all_valid_views);
-  Memory gpu_mem = Machine::MemoryQuery(Machine::get_machine())
-                       .only_kind(Memory::GPU_FB_MEM)
-                       .best_affinity_to(task->target_proc)
-                       .first();
+  // A background search runs on a CPU and measures operators on the first
+  // GPU, whose memory bounds the machine model either way
+  bool on_device = task->task_id != GRAPH_OPTIMIZE_BACKGROUND_TASK_ID;
+  Machine::MemoryQuery gpu_mems(Machine::get_machine());
+  gpu_mems.only_kind(DEVICE_MEM_KIND);
+  if (on_device) {
+    gpu_mems.best_affinity_to(task->target_proc);
+  }
+  Memory gpu_mem = gpu_mems.first();
   MachineModel *machine;
   if (model->config.machine_model_version == 0) {
     machine =
@@ -1921,15 +1966,25 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
            "machine-model-file should not be empty.");
   }
   // Assume this task is running on GPU0
-  if (!cached_simulator) {
-    cached_simulator = std::make_shared<Simulator>(
-        model, model->handlers[0], gpu_mem, machine);
+  if (!cached_simulator && !on_device) {
+    cached_simulator =
+        std::make_shared<Simulator>(model, ctx, runtime, machine);
+  } else if (!cached_simulator) {
+    cached_simulator =
+        std::make_shared<Simulator>(model,
+                                    model->handlers[0],
+                                    gpu_mem,
+                                    machine,
+                                    model->config.simulator_work_space_size);
   } else {
     // Update simulator with the new stuff
     cached_simulator->handler = model->handlers[0];
     cached_simulator->memory = gpu_mem;
     cached_simulator->machine = machine;
   }
+  cached_simulator->cost_corrections = model->cost_corrections;
+  cached_simulator->sparse_embedding_grad =
+      model->config.sparse_embedding_grad;
   model->simulator = cached_simulator.get();
 
   // Perform the search
@@ -1939,7 +1994,7 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
   if (model->config.only_data_parallel) {
     Graph *graph = new Graph(model);
     std::unordered_map<FlexFlow::Op const *, Node> op_to_node_map;
-    for (FlexFlow::Op const *dstOp : model->operators) {
+    for (FlexFlow::Op const *dstOp : model->search_operators) {
       Node dstNode;
       dstNode.ptr = dstOp;
       dstNode.guid = model->node_global_guid++;
@@ -1991,6 +2046,12 @@ bool is_valid_strategy(
   assert(cached_simulator.get() != nullptr &&
          "cached_simulator cannot be nullptr");
 
+  // Outputs recomputed in backward are not kept alive
+  std::unordered_set<Node> recomputed;
+  if (curr_graph->model->config.auto_recompute) {
+    recomputed = curr_graph->recomputed_nodes();
+  }
+
   // Analyze the strategy and update max_per_device_mem_all_deivces in the
   // lambda_result.
   std::unordered_map<int, float> device_to_mem{};
@@ -1998,6 +2059,9 @@ bool is_valid_strategy(
     CostMetrics op_cost =
         cached_simulator->measure_operator_cost(view.first.ptr, view.second);
     float node_mem_as_mb = op_cost.total_memory_in_mb();
+    if (recomputed.find(view.first) != recomputed.end()) {
+      node_mem_as_mb -= (float)(op_cost.outputs_memory / 1e4) / 1e2;
+    }
 
     for (auto const d_id : view.second.device_ids()) {
       if (device_to_mem.find(d_id) == device_to_mem.end()) {
@@ -2063,8 +2127,12 @@ GraphOptimalViewSerialized
 
   // Be optimistic
   lambdas.emplace_back(std::make_pair(1.0, MemorySearchResult{}));
-  auto try_result = try_one_lambda(
-      lambdas.back(), task, cached_simulator, perform_memory_search);
+  auto try_result = try_one_lambda(lambdas.back(),
+                                   task,
+                                   ctx,
+                                   runtime,
+                                   cached_simulator,
+                                   perform_memory_search);
   best_graph = std::move(try_result.first);
   optimal_views = try_result.second;
 
@@ -2079,8 +2147,12 @@ GraphOptimalViewSerialized
                                                   memory_threshold)) {
     // Not found the strategy; need to do binary search
     lambdas.emplace_back(std::make_pair(0.0, MemorySearchResult{}));
-    try_result = try_one_lambda(
-        lambdas.back(), task, cached_simulator, perform_memory_search);
+    try_result = try_one_lambda(lambdas.back(),
+                                task,
+                                ctx,
+                                runtime,
+                                cached_simulator,
+                                perform_memory_search);
     best_graph = std::move(try_result.first);
     optimal_views = try_result.second;
 
@@ -2106,8 +2178,12 @@ GraphOptimalViewSerialized
         float mid = (lower + upper) * 0.5;
 
         lambdas.emplace_back(std::make_pair(mid, MemorySearchResult{}));
-        try_result = try_one_lambda(
-            lambdas.back(), task, cached_simulator, perform_memory_search);
+        try_result = try_one_lambda(lambdas.back(),
+                                    task,
+                                    ctx,
+                                    runtime,
+                                    cached_simulator,
+                                    perform_memory_search);
 
         if (!is_valid_strategy(lambdas,
                                try_result.first.get(),
@@ -2159,6 +2235,27 @@ GraphOptimalViewSerialized
     std::cout << "\nNot doing memory search" << std::endl;
   }
 
+  FFModel *model = *((FFModel **)task->args);
+  // A background search runs while the top-level task trains, so the
+  // decisions below travel with the serialized PCG and are recorded by
+  // FFModel::apply_optimized_graph on the top-level task
+  std::vector<size_t> recompute_layer_ids;
+  if (model_config.auto_recompute && perform_memory_search &&
+      has_valid_strategy) {
+    model->graph_search->update_mem_optim_config(
+        MemoryOptimConfig{lambdas[best_lambda_index].first});
+    for (Node const &node : best_graph->recomputed_nodes()) {
+      if (node.ptr->layer_guid.is_valid_id()) {
+        recompute_layer_ids.push_back(node.ptr->layer_guid.id);
+      }
+    }
+  }
+  // The costs predicted for the chosen views are compared against
+  // measurements by the calibrator and weighed by fusion. A background
+  // search works on a copy of the model, which has no calibrator
+  bool with_predictions = model_config.calibration_iterations > 0 ||
+                          model_config.perform_fusion;
+
   // Following lines are to serialize the optimized PCG.
   // Only need best_graph and optimal_views below.
   Serializer sez;
@@ -2285,6 +2382,13 @@ GraphOptimalViewSerialized
         sez.serialize(combine->combine_degree);
         break;
       }
+      case OP_ALLTOALL: {
+        AllToAll *all_to_all = (AllToAll *)op;
+        sez.serialize(all_to_all->split_dim);
+        sez.serialize(all_to_all->concat_dim);
+        sez.serialize(all_to_all->degree);
+        break;
+      }
       case OP_FUSED_PARALLEL: {
         FusedParallelOp *fused = (FusedParallelOp *)op;
         sez.serialize(fused->num_parallel_ops);
@@ -2303,10 +2407,20 @@ GraphOptimalViewSerialized
   // Second, serialize optimal machine view
   printf("optimal_views.size = %zu\n", optimal_views.size());
   sez.serialize(optimal_views.size());
+  sez.serialize(with_predictions);
   for (auto const &it : optimal_views) {
     sez.serialize((size_t)98765432); // safe guard
     sez.serialize(it.first.guid);
     sez.serialize(it.second);
+    if (with_predictions) {
+      sez.serialize(
+          cached_simulator->measure_operator_cost(it.first.ptr, it.second));
+    }
+  }
+  // Third, serialize the layers whose outputs are recomputed in backward
+  sez.serialize(recompute_layer_ids.size());
+  for (size_t layer_id : recompute_layer_ids) {
+    sez.serialize(layer_id);
   }
   assert(sez.get_used_bytes() < GraphOptimalViewSerialized::buffer_size);
   GraphOptimalViewSerialized ret;
@@ -2399,7 +2513,9 @@ void FFModel::construct_optimal_view(
 void FFModel::deserialize_graph_optimal_view(
     Legion::Deserializer &dez,
     Graph *graph,
-    std::unordered_map<Node, MachineView> &optimal_views) {
+    std::unordered_map<Node, MachineView> &optimal_views,
+    std::unordered_map<Node, CostMetrics> &predicted_costs,
+    std::vector<size_t> &recompute_layer_ids) {
   // Deserializer dez(serialized.data, serialized.total_bytes);
   std::unordered_map<size_t, Node> guid_to_nodes;
   size_t num_nodes;
@@ -2684,6 +2800,16 @@ void FFModel::deserialize_graph_optimal_view(
                                              {reduction_dim, reduction_degree});
         break;
       }
+      case OP_ALLTOALL: {
+        assert(num_inputs == 1);
+        int split_dim, concat_dim, degree;
+        dez.deserialize(split_dim);
+        dez.deserialize(concat_dim);
+        dez.deserialize(degree);
+        node = get_or_create_node<AllToAll>(inputs[0],
+                                            {split_dim, concat_dim, degree});
+        break;
+      }
       case OP_FUSED_PARALLEL: {
         assert(num_inputs == 1);
         std::vector<ParallelOpInfo> parallel_ops;
@@ -2720,7 +2846,9 @@ void FFModel::deserialize_graph_optimal_view(
   }
   // Second, deserialize optimal machine view
   size_t num_views;
+  bool with_predictions;
   dez.deserialize(num_views);
+  dez.deserialize(with_predictions);
   printf("views.size() = %zu\n", num_views);
   for (size_t i = 0; i < num_views; i++) {
     size_t safecode, guid;
@@ -2731,6 +2859,19 @@ void FFModel::deserialize_graph_optimal_view(
     assert(guid_to_nodes.find(guid) != guid_to_nodes.end());
     dez.deserialize(view);
     optimal_views[guid_to_nodes[guid]] = view;
+    if (with_predictions) {
+      CostMetrics cost_metrics;
+      dez.deserialize(cost_metrics);
+      predicted_costs[guid_to_nodes[guid]] = cost_metrics;
+    }
+  }
+  // Third, deserialize the layers whose outputs are recomputed in backward
+  size_t num_recompute_layers;
+  dez.deserialize(num_recompute_layers);
+  for (size_t i = 0; i < num_recompute_layers; i++) {
+    size_t layer_id;
+    dez.deserialize(layer_id);
+    recompute_layer_ids.push_back(layer_id);
   }
   assert(dez.get_remaining_bytes() == 0);
   printf("Deserialized Views...\n");
@@ -15,11 +15,60 @@
 
 #include "flexflow/initializer.h"
 #include "flexflow/model.h"
+#include "flexflow/utils/philox.h"
 
 namespace FlexFlow {
 
 using namespace Legion;
 
+// Fill the float shard in regions[0] with draw(index), where index is the
+// element's position in the whole parameter with the trailing replica
+// dimensions left out.  Values thus depend only on the seed and the element,
+// not on how the parameter is partitioned or how many threads fill it, and
+// all replicas of a shard are identical.
+template <typename F>
+static void fill_by_global_index(Task const *task,
+                                 std::vector<PhysicalRegion> const &regions,
+                                 Context ctx,
+                                 Runtime *runtime,
+                                 int num_replica_dims,
+                                 F const &draw) {
+  assert(regions.size() == 1);
+  assert(task->regions.size() == 1);
+  Domain shard = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  Domain whole = runtime->get_index_space_domain(
+      ctx, task->regions[0].parent.get_index_space());
+  float *w = helperGetTensorPointerWO<float>(
+      regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  int const num_dims = shard.get_dim();
+  int const num_data_dims = num_dims - num_replica_dims;
+  assert(num_data_dims >= 1);
+  coord_t extent[LEGION_MAX_DIM], offset[LEGION_MAX_DIM];
+  coord_t stride[LEGION_MAX_DIM];
+  coord_t whole_stride = 1;
+  for (int d = 0; d < num_dims; d++) {
+    extent[d] = shard.hi()[d] - shard.lo()[d] + 1;
+    offset[d] = shard.lo()[d] - whole.lo()[d];
+    stride[d] = d < num_data_dims ? whole_stride : 0;
+    if (d < num_data_dims) {
+      whole_stride *= whole.hi()[d] - whole.lo()[d] + 1;
+    }
+  }
+  size_t const volume = shard.get_volume();
+#pragma omp parallel for if (volume > CPU_PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < volume; i++) {
+    // both the shard and the whole parameter are laid out column-major
+    size_t rest = i;
+    uint64_t index = 0;
+    for (int d = 0; d < num_dims; d++) {
+      index += (offset[d] + (coord_t)(rest % extent[d])) * stride[d];
+      rest /= extent[d];
+    }
+    w[i] = draw(index);
+  }
+}
+
 Initializer::Initializer(void) {}
 
 Initializer::~Initializer(void) {}
@@ -48,6 +97,7 @@ void GlorotUniform::init(FFModel const *ff, const ParallelTensor p) {
   coord_t fan_out = c_out * receptive_field_size;
   scale = sqrt(6.0f / (fan_in + fan_out));
   this->data_type = p->data_type;
+  this->num_replica_dims = p->get_num_replica_dims();
   if (p->sync_type == ParameterSyncType::PS) {
     assert(p->num_dims >= 2);
     TaskLauncher launcher(GLOROT_INIT_TASK_ID,
@@ -79,6 +129,20 @@ void GlorotUniform::init(FFModel const *ff, const ParallelTensor p) {
   }
 }
 
+void GlorotUniform::init_task_cpu(Task const *task,
+                                  std::vector<PhysicalRegion> const &regions,
+                                  Context ctx,
+                                  Runtime *runtime) {
+  GlorotUniform const *gu = (GlorotUniform const *)task->args;
+  assert(gu->data_type == DT_FLOAT);
+  uint64_t const seed = (uint32_t)gu->seed;
+  float const scale = gu->scale;
+  fill_by_global_index(
+      task, regions, ctx, runtime, gu->num_replica_dims, [&](uint64_t index) {
+        return scale * (2.0f * philox_uniform(seed, index) - 1.0f);
+      });
+}
+
 ZeroInitializer::ZeroInitializer(void) : Initializer() {}
 
 ZeroInitializer::~ZeroInitializer(void) {}
@@ -180,6 +244,7 @@ void UniformInitializer::init(FFModel const *ff, const ParallelTensor p) {
   Context ctx = ff->config.lg_ctx;
   Runtime *runtime = ff->config.lg_hlr;
   this->data_type = p->data_type;
+  this->num_replica_dims = p->get_num_replica_dims();
   if (p->sync_type == ParameterSyncType::PS) {
     TaskLauncher launcher(UNIFORM_INIT_TASK_ID,
                           TaskArgument(this, sizeof(UniformInitializer)));
@@ -209,6 +274,27 @@ void UniformInitializer::init(FFModel const *ff, const ParallelTensor p) {
   }
 }
 
+void UniformInitializer::init_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  UniformInitializer const *initializer =
+      (UniformInitializer const *)task->args;
+  assert(initializer->data_type == DT_FLOAT);
+  uint64_t const seed = (uint32_t)initializer->seed;
+  float const min_val = initializer->min_val;
+  float const range = initializer->max_val - initializer->min_val;
+  fill_by_global_index(task,
+                       regions,
+                       ctx,
+                       runtime,
+                       initializer->num_replica_dims,
+                       [&](uint64_t index) {
+                         return min_val + range * philox_uniform(seed, index);
+                       });
+}
+
 NormInitializer::NormInitializer(int _seed, float _mean, float _stddev)
     : seed(_seed), mean(_mean), stddev(_stddev) {}
 
@@ -218,6 +304,7 @@ void NormInitializer::init(FFModel const *ff, const ParallelTensor p) {
   Context ctx = ff->config.lg_ctx;
   Runtime *runtime = ff->config.lg_hlr;
   this->data_type = p->data_type;
+  this->num_replica_dims = p->get_num_replica_dims();
   if (p->sync_type == ParameterSyncType::PS) {
     TaskLauncher launcher(NORMAL_INIT_TASK_ID,
                           TaskArgument(this, sizeof(NormInitializer)));
@@ -247,6 +334,25 @@ void NormInitializer::init(FFModel const *ff, const ParallelTensor p) {
   }
 }
 
+void NormInitializer::init_task_cpu(Task const *task,
+                                    std::vector<PhysicalRegion> const &regions,
+                                    Context ctx,
+                                    Runtime *runtime) {
+  NormInitializer const *initializer = (NormInitializer const *)task->args;
+  assert(initializer->data_type == DT_FLOAT);
+  uint64_t const seed = (uint32_t)initializer->seed;
+  float const mean = initializer->mean;
+  float const stddev = initializer->stddev;
+  fill_by_global_index(task,
+                       regions,
+                       ctx,
+                       runtime,
+                       initializer->num_replica_dims,
+                       [&](uint64_t index) {
+                         return mean + stddev * philox_normal(seed, index);
+                       });
+}
+
 // ConstantInitializer
 ConstantInitializer::ConstantInitializer(float _value)
     : Initializer(), data_type(DT_FLOAT), float_value(_value) {}
@@ -16,8 +16,10 @@
 #include "flexflow/model.h"
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
 #include "flexflow/utils/cuda_helper.h"
-#else
+#elif defined(FF_USE_HIP_ROCM)
 #include "flexflow/utils/hip_helper.h"
+#else
+#include "flexflow/utils/cpu_helper.h"
 #endif
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/graph.h"
@@ -50,15 +52,19 @@
 #include "flexflow/ops/split.h"
 #include "flexflow/ops/topk.h"
 #include "flexflow/ops/transpose.h"
+#include "flexflow/parallel_ops/all_to_all.h"
 #include "flexflow/parallel_ops/combine.h"
 #include "flexflow/parallel_ops/fused_parallel_op.h"
 #include "flexflow/parallel_ops/partition.h"
 #include "flexflow/parallel_ops/reduction.h"
 #include "flexflow/parallel_ops/replicate.h"
 #include "flexflow/substitution.h"
+#include "flexflow/utils/disjoint_set.h"
+#include "flexflow/utils/memory_planner.h"
 #include "flexflow/utils/random_utils.h"
 #include "flexflow/utils/test_utils.h"
 #include "legion/legion_utilities.h"
+#include <algorithm>
 #include <dirent.h>
 #include <queue>
 #include <unordered_set>
@@ -190,6 +196,30 @@ bool Op::is_parallel_op() const {
   return false;
 }
 
+bool Op::is_recomputable() const {
+  switch (op_type) {
+    case OP_INPUT:
+    case OP_WEIGHT:
+    case OP_NOOP:
+    // Running these twice per iteration would change the results
+    case OP_DROPOUT:
+    case OP_BATCHNORM:
+    case OP_CACHE:
+      return false;
+    case OP_FUSED: {
+      FusedOp const *fused = (FusedOp const *)this;
+      for (int i = 0; i < fused->numOperators; i++) {
+        if (!fused->operators[i]->is_recomputable()) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return !is_parallel_op();
+  }
+}
+
 bool Op::can_inplace_output() {
   return false;
 }
@@ -252,19 +282,27 @@ void Op::zero_grad(FFModel const &ff) {
   ArgumentMap argmap;
   ZeroInitMeta meta;
   meta.op_ptr = this;
-  meta.num_regions = numWeights + numOutputs;
+  // Row-sparse gradients are reset by the optimizer, row by row
+  std::vector<ParallelTensor> dense_weights;
+  for (int i = 0; i < numWeights; i++) {
+    if (weights[i]->sparse_grad_rows == nullptr) {
+      dense_weights.push_back(weights[i]);
+    }
+  }
+  int num_weights = dense_weights.size();
+  meta.num_regions = num_weights + numOutputs;
   assert(meta.num_regions <= ZeroInitMeta::MAX_NUM_REGIONS);
   IndexSpace parallel_is = IndexSpace::NO_SPACE;
-  for (int i = 0; i < numWeights; i++) {
-    meta.data_types[i] = weights[i]->data_type;
+  for (int i = 0; i < num_weights; i++) {
+    meta.data_types[i] = dense_weights[i]->data_type;
     if (parallel_is == IndexSpace::NO_SPACE) {
-      parallel_is = weights[i]->parallel_is;
+      parallel_is = dense_weights[i]->parallel_is;
     } else {
-      assert(parallel_is == weights[i]->parallel_is);
+      assert(parallel_is == dense_weights[i]->parallel_is);
     }
   }
   for (int i = 0; i < numOutputs; i++) {
-    meta.data_types[i + numWeights] = outputs[i]->data_type;
+    meta.data_types[i + num_weights] = outputs[i]->data_type;
     if (parallel_is == IndexSpace::NO_SPACE) {
       parallel_is = outputs[i]->parallel_is;
     } else {
@@ -279,12 +317,13 @@ void Op::zero_grad(FFModel const &ff) {
                          false /*must*/,
                          0 /*mapper_id*/,
                          outputs[0]->machine_view.hash());
-  for (int i = 0; i < numWeights; i++) {
-    launcher.add_region_requirement(RegionRequirement(weights[i]->part_grad,
-                                                      0 /*projection id*/,
-                                                      WRITE_ONLY,
-                                                      EXCLUSIVE,
-                                                      weights[i]->region_grad));
+  for (int i = 0; i < num_weights; i++) {
+    launcher.add_region_requirement(
+        RegionRequirement(dense_weights[i]->part_grad,
+                          0 /*projection id*/,
+                          WRITE_ONLY,
+                          EXCLUSIVE,
+                          dense_weights[i]->region_grad));
     launcher.add_field(i, FID_DATA);
   }
   for (int i = 0; i < numOutputs; i++) {
@@ -297,7 +336,7 @@ void Op::zero_grad(FFModel const &ff) {
     // printf("zero_grad:output[%d]: region(%d,%d,%d)\n", i,
     // lr.get_index_space().get_id(), lr.get_field_space().get_id(),
     // lr.get_tree_id());
-    launcher.add_field(i + numWeights, FID_DATA);
+    launcher.add_field(i + num_weights, FID_DATA);
   }
   runtime->execute_index_space(ctx, launcher);
 }
@@ -314,9 +353,7 @@ ParallelConfig get_basic_data_parallel_config(int num_parts, int dims) {
   for (int i = 0; i < pc.nDims; i++) {
     pc.dim[i] = i == pc.nDims - 1 ? num_parts : 1;
   }
-  for (int i = 0; i < num_parts; i++) {
-    pc.device_ids[i] = i;
-  }
+  pc.device_ids = DeviceList(0, num_parts);
   return pc;
 }
 
@@ -350,9 +387,7 @@ ParallelConfig Op::get_random_parallel_config(FFModel const &ff) const {
   }
   int total_num_devices = ff.config.workersPerNode * ff.config.numNodes;
   int start_idx = std::rand() % (total_num_devices - num_parts + 1);
-  for (int i = 0; i < num_parts; i++) {
-    pc.device_ids[i] = start_idx + i;
-  }
+  pc.device_ids = DeviceList(start_idx, num_parts);
   return pc;
 }
 
@@ -1163,9 +1198,23 @@ FFModel::FFModel(FFConfig &_config)
       tensor_global_guid(TENSOR_GUID_FIRST_VALID),
       parallel_tensor_global_guid(PARALLEL_TENSOR_GUID_FIRST_VALID),
       node_global_guid(NODE_GUID_FIRST_VALID), config(_config), optimizer(NULL),
-      loss_op(NULL), metrics_op(NULL), simulator(NULL) {
+      loss_op(NULL), metrics_op(NULL), simulator(NULL),
+      update_issued_in_backward(false) {
   this->search = new PCG::SearchHelper(this);
   this->graph_search = new PCG::GraphSearchHelper(this);
+  if (!config.import_cost_calibration_file.empty()) {
+    if (!load_cost_corrections(config.import_cost_calibration_file,
+                               cost_corrections)) {
+      fprintf(stderr,
+              "Failed to load cost calibration file %s\n",
+              config.import_cost_calibration_file.c_str());
+      assert(false);
+    }
+  }
+  if (config.calibration_iterations > 0) {
+    calibrator.reset(
+        new CostCalibrator(config.calibration_iterations, cost_corrections));
+  }
 
   Runtime *runtime = config.lg_hlr;
   Context ctx = config.lg_ctx;
@@ -2399,11 +2448,34 @@ IndexSpace FFModel::get_task_is(Domain const &domain) const {
 }
 
 void FFModel::reset_metrics() {
+  Context ctx = config.lg_ctx;
+  Runtime *runtime = config.lg_hlr;
+  // Report the iterations buffered since the last print
+  flush_metrics();
+  TaskLauncher launcher(UPDATE_METRICS_TASK_ID,
+                        TaskArgument(metrics_op, sizeof(Metrics)));
+  current_metrics = runtime->execute_task(ctx, launcher);
+}
+
+void FFModel::flush_metrics() {
+  if (pending_metrics.empty()) {
+    return;
+  }
   Context ctx = config.lg_ctx;
   Runtime *runtime = config.lg_hlr;
   TaskLauncher launcher(UPDATE_METRICS_TASK_ID,
                         TaskArgument(metrics_op, sizeof(Metrics)));
+  launcher.add_future(current_metrics);
+  for (Future const &f : pending_metrics) {
+    launcher.add_future(f);
+  }
   current_metrics = runtime->execute_task(ctx, launcher);
+  pending_metrics.clear();
+}
+
+PerfMetrics FFModel::get_perf_metrics() {
+  flush_metrics();
+  return current_metrics.get_result<PerfMetrics>();
 }
 
 void FFModel::init_operators() {
@@ -2414,14 +2486,342 @@ void FFModel::init_operators() {
 
 void FFModel::forward(int seq_length) {
   iter_config.seq_length = seq_length;
+  if (calibrator != nullptr && calibrator->is_active()) {
+    // Time each operator in isolation to calibrate the simulator
+    for (size_t i = 0; i < operators.size(); i++) {
+      double ts_start = CostCalibrator::fenced_current_time(this);
+      operators[i]->forward(*this);
+      double ts_end = CostCalibrator::fenced_current_time(this);
+      calibrator->record_forward(operators[i], (ts_end - ts_start) / 1e3);
+    }
+    return;
+  }
   for (size_t i = 0; i < operators.size(); i++) {
     operators[i]->forward(*this);
+    if (!recompute_after.empty()) {
+      for (int idx : recompute_after[i]) {
+        discard_outputs(operators[idx]);
+      }
+    }
+  }
+}
+
+void FFModel::discard_outputs(Op const *op) {
+  Context ctx = config.lg_ctx;
+  Runtime *runtime = config.lg_hlr;
+  for (int i = 0; i < op->numOutputs; i++) {
+    DiscardLauncher launcher(op->outputs[i]->region, op->outputs[i]->region);
+    launcher.add_field(FID_DATA);
+    runtime->discard_fields(ctx, launcher);
+  }
+}
+
+void FFModel::recompute_outputs(int op_idx, std::vector<bool> &recomputed) {
+  if (recomputed[op_idx]) {
+    return;
+  }
+  recomputed[op_idx] = true;
+  Op *op = operators[op_idx];
+  // Inputs produced by recomputed operators may have been dropped as well
+  for (int i = 0; i < op->numInputs; i++) {
+    Op const *producer = op->inputs[i]->owner_op;
+    if (producer == NULL || !producer->recompute) {
+      continue;
+    }
+    auto const &it =
+        std::find(operators.begin(), operators.begin() + op_idx, producer);
+    assert(it != operators.begin() + op_idx);
+    recompute_outputs(it - operators.begin(), recomputed);
+  }
+  op->forward(*this);
+}
+
+FFModel::FFModel(FFModel const *model)
+    : op_global_guid(model->op_global_guid),
+      layer_global_guid(model->layer_global_guid),
+      tensor_global_guid(model->tensor_global_guid),
+      parallel_tensor_global_guid(model->parallel_tensor_global_guid),
+      node_global_guid(model->node_global_guid), config(model->config),
+      iter_config(model->iter_config), optimizer(NULL), loss_op(NULL),
+      metrics_op(NULL), simulator(NULL),
+      cost_corrections(model->cost_corrections),
+      update_issued_in_backward(false), metrics_input(model->metrics_input),
+      parallel_label_tensor(model->parallel_label_tensor),
+      label_tensor(model->label_tensor), layers(model->layers),
+      operators(model->operators), search_operators(model->search_operators),
+      parameters(model->parameters), cached_ops(model->cached_ops),
+      cached_noop_ops(model->cached_noop_ops),
+      cached_input_ops(model->cached_input_ops),
+      all_valid_views(model->all_valid_views), debug(model->debug),
+      all_task_is(model->all_task_is) {
+  this->search = new PCG::SearchHelper(this);
+  this->graph_search = new PCG::GraphSearchHelper(this);
+  std::copy(model->handlers, model->handlers + MAX_NUM_WORKERS, handlers);
+}
+
+FFModel *FFModel::create_search_model() const {
+  return new FFModel(this);
+}
+
+void FFModel::free_search_model(FFModel *search_model) {
+  // Operators created by the search are not freed, like those cached by
+  // this model
+  delete search_model->search;
+  delete search_model->graph_search;
+  delete search_model;
+}
+
+bool FFModel::recompile_on_condition(RecompileState &r) {
+  if (!r.search_in_progress) {
+    if (r.trigger()) {
+      r.alter();
+      // Search in the background on a private copy of the model; training
+      // keeps issuing iterations with the current PCG in the meantime
+      r.search_model = create_search_model();
+      TaskLauncher launcher(GRAPH_OPTIMIZE_BACKGROUND_TASK_ID,
+                            TaskArgument(&r.search_model, sizeof(FFModel *)));
+      r.search_result = config.lg_hlr->execute_task(config.lg_ctx, launcher);
+      r.search_in_progress = true;
+    }
+    return false;
+  }
+  if (!r.search_result.is_ready()) {
+    return false;
+  }
+  r.search_in_progress = false;
+  PCG::GraphOptimalViewSerialized ret =
+      r.search_result.get_result<PCG::GraphOptimalViewSerialized>();
+  free_search_model(r.search_model);
+  r.search_model = NULL;
+  if (!switch_to_optimized_graph(ret)) {
+    return false;
+  }
+  r.recompilations++;
+  return true;
+}
+
+// Whether dst can replace src, i.e., both are partitioned and placed the same
+// way; the size of dim 0 is not compared since sparse labels have size 1
+static bool same_parallelization(const ParallelTensor src,
+                                 const ParallelTensor dst) {
+  if (src->num_dims != dst->num_dims ||
+      !(src->machine_view == dst->machine_view)) {
+    return false;
+  }
+  for (int i = 0; i < src->num_dims; i++) {
+    if (src->dims[i].degree != dst->dims[i].degree ||
+        src->dims[i].is_replica_dim != dst->dims[i].is_replica_dim) {
+      return false;
+    }
+    if (i > 0 && src->dims[i].size != dst->dims[i].size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether only the replica dims of t are partitioned, in which case every
+// replica holds the whole tensor
+static bool is_replicated_only(const ParallelTensor t) {
+  for (int i = 0; i < t->num_dims; i++) {
+    if (!t->dims[i].is_replica_dim && t->dims[i].degree > 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FFModel::switch_to_optimized_graph(
+    PCG::GraphOptimalViewSerialized const &ret) {
+  Context ctx = config.lg_ctx;
+  Runtime *runtime = config.lg_hlr;
+  std::vector<Op *> old_operators = operators;
+  std::unordered_set<size_t> old_recompute_layers = recompute_layers;
+  std::unordered_map<size_t, CostMetrics> old_predicted_layer_costs =
+      predicted_layer_costs;
+  Op *old_final_operator = get_final_operator();
+  std::unordered_map<Tensor, ParallelTensor> old_parallel_tensors;
+  for (auto const &layer : layers) {
+    if (layer->op_type == OP_INPUT) {
+      Tensor tensor = layer->outputs[0];
+      old_parallel_tensors[tensor] = tensor->parallel_tensor;
+    }
+    for (int i = 0; i < layer->numWeights; i++) {
+      Tensor weight = layer->weights[i];
+      old_parallel_tensors[weight] = weight->parallel_tensor;
+    }
+  }
+  apply_optimized_graph(ret);
+
+  // Data loaders write the input and label tensors, so the new PCG must
+  // keep their parallelization
+  Op *final_operator = get_final_operator();
+  bool compatible =
+      same_parallelization(parallel_label_tensor,
+                           final_operator->outputs[0]) &&
+      (final_operator->op_type == OP_AGG_SPEC) ==
+          (old_final_operator->op_type == OP_AGG_SPEC);
+  for (auto const &it : old_parallel_tensors) {
+    ParallelTensor old_pt = it.second;
+    ParallelTensor new_pt = it.first->parallel_tensor;
+    if (old_pt->owner_op->op_type == OP_INPUT) {
+      compatible = compatible && same_parallelization(old_pt, new_pt);
+    } else if (!same_parallelization(old_pt, new_pt)) {
+      // Weights whose replication changed are copied through the host
+      compatible = compatible && is_replicated_only(old_pt) &&
+                   is_replicated_only(new_pt);
+    }
+  }
+  if (!compatible) {
+    fprintf(stderr,
+            "Warning: the recompiled PCG changes the parallelization of the "
+            "inputs, labels or partitioned weights; keeping the current "
+            "PCG.\n");
+    // The operators of the new PCG have not been mapped yet, so nothing but
+    // this function refers to them
+    for (Op *op : operators) {
+      delete op;
+    }
+    operators = old_operators;
+    recompute_layers = old_recompute_layers;
+    predicted_layer_costs = old_predicted_layer_costs;
+    for (auto const &it : old_parallel_tensors) {
+      it.first->parallel_tensor = it.second;
+    }
+    return false;
+  }
+
+  // Keep the input operators, whose tensors the data loaders hold
+  std::unordered_map<ParallelTensor, ParallelTensor> kept_inputs;
+  for (auto const &it : old_parallel_tensors) {
+    if (it.second->owner_op->op_type == OP_INPUT) {
+      kept_inputs[it.first->parallel_tensor] = it.second;
+      it.first->parallel_tensor = it.second;
+    }
+  }
+  for (size_t l = 0; l < operators.size(); l++) {
+    Op *op = operators[l];
+    if (op->op_type == OP_INPUT) {
+      assert(kept_inputs.find(op->outputs[0]) != kept_inputs.end());
+      operators[l] = kept_inputs[op->outputs[0]]->owner_op;
+      continue;
+    }
+    for (int i = 0; i < op->numInputs; i++) {
+      auto const &it = kept_inputs.find(op->inputs[i]);
+      if (it != kept_inputs.end()) {
+        op->inputs[i] = it->second;
+      }
+    }
+  }
+
+  parameters.clear();
+  finalize_operators();
+  for (auto const &it : old_parallel_tensors) {
+    if (it.second->owner_op->op_type != OP_INPUT) {
+      copy_parallel_tensor(it.second, it.first->parallel_tensor);
+    }
+  }
+  init_parameter_updates();
+  for (auto const &it : old_parallel_tensors) {
+    if (it.second->owner_op->op_type != OP_INPUT &&
+        config.computationMode == COMP_MODE_TRAINING) {
+      optimizer->migrate_state(it.second, it.first->parallel_tensor);
+    }
+  }
+
+  // Release the regions the new PCG does not use; Legion defers their
+  // destruction until the tasks still using them complete
+  std::set<LogicalRegion> live_regions = {parallel_label_tensor->region};
+  for (auto const &op : operators) {
+    for (int i = 0; i < op->numInputs; i++) {
+      live_regions.insert(op->inputs[i]->region);
+      live_regions.insert(op->inputs[i]->region_grad);
+    }
+    for (int i = 0; i < op->numOutputs; i++) {
+      live_regions.insert(op->outputs[i]->region);
+      live_regions.insert(op->outputs[i]->region_grad);
+    }
+    for (int i = 0; i < op->numWeights; i++) {
+      live_regions.insert(op->weights[i]->region);
+      live_regions.insert(op->weights[i]->region_grad);
+    }
   }
+  std::set<LogicalRegion> dead_regions;
+  for (auto const &op : old_operators) {
+    for (int i = 0; i < op->numOutputs; i++) {
+      dead_regions.insert(op->outputs[i]->region);
+      dead_regions.insert(op->outputs[i]->region_grad);
+    }
+    for (int i = 0; i < op->numWeights; i++) {
+      dead_regions.insert(op->weights[i]->region);
+      dead_regions.insert(op->weights[i]->region_grad);
+    }
+  }
+  for (auto const &region : dead_regions) {
+    if (region != LogicalRegion::NO_REGION &&
+        live_regions.find(region) == live_regions.end()) {
+      runtime->destroy_logical_region(ctx, region);
+    }
+  }
+
+  init_operators();
+  return true;
+}
+
+template <typename T>
+static void copy_through_host(FFModel const *ff,
+                              const ParallelTensor src,
+                              const ParallelTensor dst) {
+  std::vector<int> dims;
+  size_t volume = 1;
+  for (int i = 0; i < dst->num_dims; i++) {
+    if (!dst->dims[i].is_replica_dim) {
+      dims.push_back(dst->dims[i].size);
+      volume *= dst->dims[i].size;
+    }
+  }
+  std::vector<T> buffer(volume);
+  bool ok = src->get_tensor<T>(ff, buffer.data(), false /*get_gradients*/);
+  ok = ok && dst->set_tensor<T>(ff, dims, buffer.data());
+  assert(ok);
 }
 
-void FFModel::recompile_on_condition(RecompileState &r) {
-  if (r.trigger()) {
-    r.alter();
+void FFModel::copy_parallel_tensor(const ParallelTensor src,
+                                   const ParallelTensor dst) const {
+  Context ctx = config.lg_ctx;
+  Runtime *runtime = config.lg_hlr;
+  assert(src->data_type == dst->data_type);
+  Domain src_domain =
+      runtime->get_index_space_domain(ctx, src->region.get_index_space());
+  Domain dst_domain =
+      runtime->get_index_space_domain(ctx, dst->region.get_index_space());
+  if (src_domain == dst_domain) {
+    CopyLauncher launcher;
+    launcher.add_copy_requirements(
+        RegionRequirement(src->region, READ_ONLY, EXCLUSIVE, src->region),
+        RegionRequirement(dst->region, WRITE_DISCARD, EXCLUSIVE, dst->region));
+    launcher.add_src_field(0, FID_DATA);
+    launcher.add_dst_field(0, FID_DATA);
+    runtime->issue_copy_operation(ctx, launcher);
+    return;
+  }
+  // The number of replicas changed: read one replica and write it to all
+  assert(is_replicated_only(src) && is_replicated_only(dst));
+  switch (dst->data_type) {
+    case DT_FLOAT:
+      copy_through_host<float>(this, src, dst);
+      break;
+    case DT_DOUBLE:
+      copy_through_host<double>(this, src, dst);
+      break;
+    case DT_INT32:
+      copy_through_host<int32_t>(this, src, dst);
+      break;
+    case DT_INT64:
+      copy_through_host<int64_t>(this, src, dst);
+      break;
+    default:
+      assert(false && "Unsupported data type");
   }
 }
 
@@ -2444,9 +2844,24 @@ void FFModel::backward(int seq_length) {
   Op *final_operator = get_final_operator();
   assert(final_operator->numOutputs == 1);
   loss_op->backward(this, final_operator->outputs[0], parallel_label_tensor);
+  // Synchronize and update parameters bucket by bucket as soon as their
+  // gradients are produced, overlapping communication with the remaining
+  // backward tasks (see --grad-sync-bucket-size)
+  bool overlap_update = !ready_update_buckets.empty() &&
+                        !(calibrator != nullptr && calibrator->is_active());
+  if (overlap_update) {
+    optimizer->next();
+  }
   // Perform backpropagation
+  std::vector<bool> recomputed(recompute_after.size(), false);
   // std::set<LogicalRegion> resetedInputGrads;
   for (int l = operators.size() - 1; l >= 0; l--) {
+    if (!recompute_after.empty()) {
+      // Recompute dropped outputs before their first use in backward
+      for (int idx : recompute_after[l]) {
+        recompute_outputs(idx, recomputed);
+      }
+    }
 #ifdef ENABLE_RESNET_INPUT_GRADIENT_OPTIMIZATION
     for (int i = 0; i < operators[l]->numInputs; i++) {
       if (resetedInputGrads.find(operators[l]->inputs[i]->region) ==
@@ -2462,17 +2877,229 @@ void FFModel::backward(int seq_length) {
     // TODO: If operator serves for metrics and for further prop
     // if(l == metrics_input && metrics_input < (int)operators.size()-1)
     //  continue;
-    operators[l]->backward(*this);
+    if (calibrator != nullptr && calibrator->is_active()) {
+      double ts_start = CostCalibrator::fenced_current_time(this);
+      operators[l]->backward(*this);
+      double ts_end = CostCalibrator::fenced_current_time(this);
+      calibrator->record_backward(operators[l], (ts_end - ts_start) / 1e3);
+    } else {
+      operators[l]->backward(*this);
+    }
+    if (overlap_update) {
+      for (size_t b : ready_update_buckets[l]) {
+        std::vector<ParallelTensor> const &bucket =
+            optimizer->update_buckets[b];
+        if (config.multi_tensor_update) {
+          optimizer->multi_tensor_update(bucket);
+        } else {
+          for (size_t i = 0; i < bucket.size(); i++) {
+            optimizer->update(bucket[i]);
+          }
+        }
+      }
+    }
   }
+  update_issued_in_backward = overlap_update;
 }
 
 void FFModel::update() {
+  if (update_issued_in_backward) {
+    // All parameters were already updated by backward()
+    update_issued_in_backward = false;
+    return;
+  }
   optimizer->next();
+  if (calibrator != nullptr && calibrator->is_active()) {
+    for (size_t i = 0; i < parameters.size(); i++) {
+      double ts_start = CostCalibrator::fenced_current_time(this);
+      optimizer->update(parameters[i]);
+      double ts_end = CostCalibrator::fenced_current_time(this);
+      calibrator->record_sync(parameters[i]->owner_op,
+                              (ts_end - ts_start) / 1e3);
+    }
+    calibrator->finish_iteration(this);
+    return;
+  }
+  if (config.multi_tensor_update) {
+    for (size_t i = 0; i < optimizer->update_buckets.size(); i++) {
+      optimizer->multi_tensor_update(optimizer->update_buckets[i]);
+    }
+    return;
+  }
   for (size_t i = 0; i < parameters.size(); i++) {
     optimizer->update(parameters[i]);
   }
 }
 
+void FFModel::set_recompute(const Tensor output, bool recompute) {
+  assert(output->owner_layer != nullptr);
+  output->owner_layer->recompute = recompute;
+}
+
+void FFModel::create_recompute_schedule() {
+  for (size_t i = 0; i < layers.size(); i++) {
+    if (layers[i]->recompute) {
+      recompute_layers.insert(layers[i]->layer_guid.id);
+    }
+  }
+  recompute_after.clear();
+  if (recompute_layers.empty() ||
+      config.computationMode != COMP_MODE_TRAINING) {
+    return;
+  }
+  // An operator (or a fused operator, if all of its constituents are marked)
+  // is recomputed when its layer is marked
+  auto is_marked = [&](Op const *op) {
+    return op->layer_guid.is_valid_id() &&
+           recompute_layers.find(op->layer_guid.id) != recompute_layers.end();
+  };
+  std::unordered_map<Op const *, int> op_to_idx;
+  for (size_t l = 0; l < operators.size(); l++) {
+    op_to_idx[operators[l]] = l;
+  }
+  // The outputs of an operator are used until the forward of its last
+  // consumer, which is also the first consumer to run backward
+  std::vector<int> last_consumer(operators.size(), -1);
+  for (size_t l = 0; l < operators.size(); l++) {
+    for (int i = 0; i < operators[l]->numInputs; i++) {
+      auto const &it = op_to_idx.find(operators[l]->inputs[i]->owner_op);
+      if (it != op_to_idx.end()) {
+        last_consumer[it->second] =
+            std::max(last_consumer[it->second], (int)l);
+      }
+    }
+  }
+  recompute_after.resize(operators.size());
+  int num_recomputed = 0;
+  Op const *final_operator = get_final_operator();
+  for (size_t l = 0; l < operators.size(); l++) {
+    Op *op = operators[l];
+    bool marked = is_marked(op);
+    if (op->op_type == OP_FUSED) {
+      FusedOp const *fused = (FusedOp const *)op;
+      marked = fused->numOperators > 0;
+      for (int i = 0; i < fused->numOperators; i++) {
+        marked = marked && is_marked(fused->operators[i]);
+      }
+    }
+    op->recompute = false;
+    // The final operator's outputs are read by the loss and the metrics
+    if (!marked || op == final_operator || !op->is_recomputable() ||
+        last_consumer[l] < 0) {
+      continue;
+    }
+    // Recomputing an in-place operator would apply it twice
+    bool inplace = false;
+    for (int i = 0; i < op->numOutputs; i++) {
+      for (int j = 0; j < op->numInputs; j++) {
+        inplace = inplace || op->outputs[i]->region == op->inputs[j]->region;
+      }
+    }
+    if (inplace) {
+      continue;
+    }
+    op->recompute = true;
+    recompute_after[last_consumer[l]].push_back(l);
+    num_recomputed++;
+  }
+  log_measure.debug("Recomputing the outputs of %d operators in backward",
+                    num_recomputed);
+}
+
+void FFModel::plan_activation_memory() {
+  Runtime *runtime = config.lg_hlr;
+  bool training = config.computationMode == COMP_MODE_TRAINING;
+  int const num_ops = operators.size();
+  int const num_steps = training ? 2 * num_ops : num_ops;
+  // In-place operators write their input regions, so activations are
+  // tracked by region and owned by the operator that first produces them
+  std::map<LogicalRegion, size_t> region_idx;
+  std::vector<LogicalRegion> regions;
+  std::vector<size_t> sizes;
+  std::vector<int> producer, last_use;
+  for (int l = 0; l < num_ops; l++) {
+    Op const *op = operators[l];
+    if (op->op_type == OP_INPUT || op->op_type == OP_WEIGHT) {
+      continue;
+    }
+    for (int i = 0; i < op->numOutputs; i++) {
+      ParallelTensor const &output = op->outputs[i];
+      if (region_idx.find(output->region) == region_idx.end()) {
+        region_idx[output->region] = regions.size();
+        regions.push_back(output->region);
+        sizes.push_back(output->get_shape().get_piece_size());
+        producer.push_back(l);
+        last_use.push_back(l);
+      }
+    }
+  }
+  std::vector<std::vector<int>> consumers(num_ops);
+  for (int l = 0; l < num_ops; l++) {
+    Op const *op = operators[l];
+    for (int i = 0; i < op->numInputs; i++) {
+      auto const &it = region_idx.find(op->inputs[i]->region);
+      if (it != region_idx.end()) {
+        last_use[it->second] = std::max(last_use[it->second], l);
+        consumers[producer[it->second]].push_back(l);
+      }
+    }
+    for (int i = 0; i < op->numOutputs; i++) {
+      auto const &it = region_idx.find(op->outputs[i]->region);
+      if (it != region_idx.end()) {
+        last_use[it->second] = std::max(last_use[it->second], l);
+      }
+    }
+  }
+  // A recomputed operator runs again before the backward of its last
+  // consumer, or earlier when a recomputed consumer needs it first
+  std::vector<int> recompute_step(num_ops, num_steps);
+  for (int l = num_ops - 1; l >= 0 && training; l--) {
+    if (!operators[l]->recompute) {
+      continue;
+    }
+    for (int c : consumers[l]) {
+      recompute_step[l] = std::min(recompute_step[l], 2 * num_ops - 1 - c);
+      if (operators[c]->recompute) {
+        recompute_step[l] = std::min(recompute_step[l], recompute_step[c]);
+      }
+    }
+  }
+  Op const *final_operator = get_final_operator();
+  std::vector<std::vector<LiveInterval>> lifetimes(regions.size());
+  for (size_t t = 0; t < regions.size(); t++) {
+    int const p = producer[t];
+    if (operators[p] == final_operator) {
+      // Read by the loss and the metrics
+      lifetimes[t].push_back({p, num_steps - 1});
+    } else if (!training) {
+      lifetimes[t].push_back({p, last_use[t]});
+    } else if (operators[p]->recompute) {
+      lifetimes[t].push_back({p, last_use[t]});
+      lifetimes[t].push_back({recompute_step[p], 2 * num_ops - 1 - p});
+    } else {
+      // Kept until the backward of the producer
+      lifetimes[t].push_back({p, 2 * num_ops - 1 - p});
+    }
+  }
+  MemoryPlan plan = plan_memory(sizes, lifetimes);
+  for (size_t t = 0; t < regions.size(); t++) {
+    int slot = plan.slot_of[t];
+    runtime->attach_semantic_information(regions[t],
+                                         MEMORY_SLOT_SEMANTIC_TAG,
+                                         &slot,
+                                         sizeof(slot),
+                                         true /*is_mutable*/);
+  }
+  if (config.profiling) {
+    printf("Planned %zu activations into %zu memory slots: %.2f MB "
+           "(liveness lower bound %.2f MB)\n",
+           regions.size(),
+           plan.slot_sizes.size(),
+           plan.planned_bytes() / 1e6,
+           plan.lower_bound / 1e6);
+  }
+}
+
 Op *FFModel::get_final_operator() const {
   int idx = operators.size() - 1;
   while (operators[idx]->op_type == OP_INPUT ||
@@ -2492,114 +3119,163 @@ void FFModel::compile(Optimizer *_optimizer,
   compile(loss_type, metrics, comp_mode);
 }
 
-bool FFModel::apply_fusion(std::vector<Op *> const &operators,
+// Whether op launches kernels that can be moved into a FusedOp
+static bool is_fusable_operator(Op *op) {
+  // don't fuse input and weight operator since they don't involve any
+  // forward/backward task launches
+  if (op->op_type == OP_INPUT || op->op_type == OP_WEIGHT) {
+    return false;
+  }
+  // don't fuse parallel op since they have different parallel_is in
+  // forward/backward
+  if (op->is_parallel_op()) {
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+// Operators launched as one task, in the order of FFModel::operators
+struct FusionGroup {
+  // The FusedOp, or the only operator of the group
+  Op *op;
+  float forward_time, backward_time;
+  // Whether operators on other machine views consume outputs of the group
+  bool has_remote_consumers;
+};
+
+} // namespace
+
+void FFModel::apply_fusion(std::vector<Op *> const &operators,
                            std::vector<Op *> &new_operators) {
-  // Context ctx = config.lg_ctx;
-  // Runtime* runtime = config.lg_hlr;
-  for (size_t l = 1; l < operators.size() - 1; l++) {
-    // don't fuse input and weight operator since they don't involve any
-    // forward/backward task launches
-    if (operators[l]->op_type == OP_INPUT ||
-        operators[l]->op_type == OP_WEIGHT) {
-      continue;
-    }
-    // don't fuse parallel op since they have different parallel_is in
-    // forward/backward
-    if (operators[l]->is_parallel_op()) {
-      continue;
-    }
-    size_t start = 0;
-    {
-      Op *opl = operators[l];
-      for (int idx = 0; idx < opl->numInputs; idx++) {
-        bool found = false;
-        for (size_t i = 0; i < l; i++) {
-          if (opl->inputs[idx]->owner_op == operators[i]) {
-            assert(!found);
-            found = true;
-            if (i > start) {
-              start = i;
-            }
-          }
-        }
-        assert(found || (opl->inputs[idx]->owner_op == NULL));
+  bool training = config.computationMode == COMP_MODE_TRAINING;
+  // Record producers and consumers before FusedOps take over the ownership
+  // of the tensors
+  std::unordered_map<Op const *, std::vector<Op *>> producers, consumers;
+  for (Op *op : operators) {
+    for (int i = 0; i < op->numInputs; i++) {
+      Op *owner = op->inputs[i]->owner_op;
+      if (owner != nullptr) {
+        producers[op].push_back(owner);
+        consumers[owner].push_back(op);
       }
     }
-    for (size_t i = start; i < l; i++) {
-      // Domain d1 =
-      // runtime->get_index_space_domain(operators[l]->outputs[0]->parallel_is);
-      // Domain d2 =
-      // runtime->get_index_space_domain(operators[i]->outputs[0]->parallel_is);
-      MachineView view1 = operators[l]->outputs[0]->machine_view;
-      MachineView view2 = operators[i]->outputs[0]->machine_view;
-      if (view1 == view2) {
+  }
+  // Each operator maps to the first operator of its group
+  disjoint_set<Op const *> fused_with;
+  std::unordered_map<Op const *, size_t> group_idx;
+  std::vector<FusionGroup> groups;
+  // Groups that may still absorb operators, in order, for each machine view
+  std::unordered_map<MachineView, std::vector<size_t>> open_groups;
+  for (size_t l = 0; l < operators.size(); l++) {
+    Op *op = operators[l];
+    MachineView view = op->outputs[0]->machine_view;
+    CostMetrics cost;
+    auto it = predicted_layer_costs.find(op->layer_guid.id);
+    if (it != predicted_layer_costs.end()) {
+      cost = it->second;
+    }
+    bool remote_consumers = false, remote_producers = false;
+    for (Op const *consumer : consumers[op]) {
+      remote_consumers |= !(consumer->outputs[0]->machine_view == view);
+    }
+    for (Op const *producer : producers[op]) {
+      remote_producers |= !(producer->outputs[0]->machine_view == view);
+    }
+    // the first and last operators are never fused
+    bool fusable = l > 0 && l + 1 < operators.size() && is_fusable_operator(op);
+    bool fused = false;
+    if (fusable) {
+      // op can only join a group placed after the groups of its producers
+      size_t start = 0;
+      for (Op const *producer : producers[op]) {
+        start = std::max(start, group_idx.at(fused_with.find(producer)));
+      }
+      std::vector<size_t> &candidates = open_groups[view];
+      auto iter = std::lower_bound(candidates.begin(), candidates.end(), start);
+      for (; iter != candidates.end(); iter++) {
+        FusionGroup &group = groups[*iter];
+        // Fusing saves the launches of op's tasks, but delays the remote
+        // consumers of the group until op's forward is done, and the remote
+        // producers of op until the group's backward is done
+        float saved = config.fusion_launch_overhead * (training ? 2 : 1);
+        float lost = 0.0f;
+        if (group.has_remote_consumers) {
+          lost += cost.forward_time;
+        }
+        if (training && remote_producers) {
+          lost += group.backward_time;
+        }
+        if (lost > saved) {
+          continue;
+        }
         FusedOp *fused_op = nullptr;
         bool allocate_new_fused_op = false;
-        if (operators[i]->op_type == OP_FUSED) {
-          fused_op = (FusedOp *)operators[i];
+        if (group.op->op_type == OP_FUSED) {
+          fused_op = (FusedOp *)group.op;
         } else {
-          //  cannot be an in-place operator
-          if (operators[i]->has_inplace_output()) {
-            continue;
-          }
-          // don't fuse input and weight operator since they don't involve any
-          // forward/backward kernels
-          if (operators[i]->op_type == OP_INPUT ||
-              operators[i]->op_type == OP_WEIGHT) {
-            continue;
-          }
-          // don't fuse parallel op since they have different parallel_is in
-          // forward/backward
-          if (operators[i]->is_parallel_op()) {
-            continue;
-          }
-          fused_op = new FusedOp(*this, operators[i]);
+          fused_op = new FusedOp(*this, group.op);
           allocate_new_fused_op = true;
         }
-        if (fused_op->add_operator(*this, operators[l])) {
-          // Construct new operators
-          new_operators.clear();
-          for (size_t j = 0; j < i; j++) {
-            new_operators.push_back(operators[j]);
+        if (fused_op->add_operator(*this, op)) {
+          fused_with.m_union(op, fused_op->operators[0]);
+          group.op = fused_op;
+          group.forward_time += cost.forward_time;
+          group.backward_time += cost.backward_time;
+          group.has_remote_consumers |= remote_consumers;
+          if (fused_op->numOperators == MAX_NUM_FUSED_OPERATORS) {
+            candidates.erase(iter);
           }
-          new_operators.push_back(fused_op);
-          for (size_t j = i + 1; j < operators.size(); j++) {
-            if (j == l) {
-              continue; // l and i are fused
-            }
-            Op *op = operators[j];
-            // Update input tensors that belong to operator[l] or operator[i]
-            for (int idx = 0; idx < op->numInputs; idx++) {
-              if ((op->inputs[idx]->owner_op == operators[l]) ||
-                  (op->inputs[idx]->owner_op == operators[i])) {
-                int found = -1;
-                for (int k = 0; k < fused_op->numOutputs; k++) {
-                  if (fused_op->outputs[k]->region == op->inputs[idx]->region) {
-                    assert(found == -1);
-                    found = k;
-                  }
-                }
-                assert(found >= 0);
-                op->inputs[idx] = fused_op->outputs[found];
-              }
-            }
-            // Insert op
-            new_operators.push_back(op);
-          }
-          // We are exact one operator fewer than the original
-          assert(new_operators.size() + 1 == operators.size());
-          return true;
-        } else {
-          // TODO: delete fused_op to avoid memory leakage
-          if (allocate_new_fused_op) {
-            delete fused_op;
+          fused = true;
+          break;
+        }
+        if (allocate_new_fused_op) {
+          // Give the outputs back to the operator before dropping fused_op
+          for (int i = 0; i < group.op->numOutputs; i++) {
+            group.op->outputs[i]->owner_op = group.op;
+            group.op->outputs[i]->owner_idx = i;
           }
-          continue;
+          delete fused_op;
         }
       }
     }
+    if (!fused) {
+      group_idx[fused_with.find(op)] = groups.size();
+      //  cannot fuse into an in-place operator
+      if (is_fusable_operator(op) && !op->has_inplace_output()) {
+        open_groups[view].push_back(groups.size());
+      }
+      groups.push_back(FusionGroup{
+          op, cost.forward_time, cost.backward_time, remote_consumers});
+    }
+  }
+  new_operators.clear();
+  for (FusionGroup const &group : groups) {
+    new_operators.push_back(group.op);
+  }
+  // Update input tensors that belong to fused operators
+  for (Op *op : new_operators) {
+    for (int idx = 0; idx < op->numInputs; idx++) {
+      Op const *owner = op->inputs[idx]->owner_op;
+      if (owner == nullptr || owner->op_type == OP_FUSED) {
+        continue;
+      }
+      Op *group_op = groups[group_idx.at(fused_with.find(owner))].op;
+      if (group_op == owner) {
+        continue;
+      }
+      int found = -1;
+      for (int k = 0; k < group_op->numOutputs; k++) {
+        if (group_op->outputs[k]->region == op->inputs[idx]->region) {
+          assert(found == -1);
+          found = k;
+        }
+      }
+      assert(found >= 0);
+      op->inputs[idx] = group_op->outputs[found];
+    }
   }
-  return false;
 }
 
 Op *FFModel::create_operator_from_layer(
@@ -2820,6 +3496,8 @@ void FFModel::compile(LossType loss_type,
             "data-parallel PCG.\n");
   }
   create_operators_from_layers();
+  // Keep the PCG created from the layers, which every search starts from
+  search_operators = operators;
   // Launch the graph optimize task
   {
     FFModel *model = this;
@@ -2829,47 +3507,7 @@ void FFModel::compile(LossType loss_type,
 
     PCG::GraphOptimalViewSerialized ret =
         future.get_result<PCG::GraphOptimalViewSerialized>();
-    Deserializer dez(ret.data, ret.total_bytes);
-    // Reconstruct operators
-    PCG::Graph *best_graph = new PCG::Graph(this);
-    std::unordered_map<PCG::Node, MachineView> optimal_views;
-    deserialize_graph_optimal_view(dez, best_graph, optimal_views);
-    operators.clear();
-    convert_graph_to_operators(best_graph, optimal_views);
-    best_graph->print_dot();
-    delete best_graph;
-    for (auto const &layer : layers) {
-      // map inputs to parallel tensor
-      if (layer->op_type == OP_INPUT) {
-        Tensor tensor = layer->outputs[0];
-        ParallelTensor parallel_tensor = nullptr;
-        for (auto const &op : operators) {
-          if (op->op_type == OP_INPUT) {
-            NoOp *noop = (NoOp *)op;
-            if (noop->input_tensor_guid == tensor->tensor_guid) {
-              parallel_tensor = op->outputs[0];
-            }
-          }
-        }
-        assert(parallel_tensor != nullptr);
-        tensor->parallel_tensor = parallel_tensor;
-      }
-      // map weights to parallel_tensor
-      for (int i = 0; i < layer->numWeights; i++) {
-        assert(layer->weights[i] != nullptr);
-        Tensor weight = layer->weights[i];
-        ParallelTensor parallel_weight = nullptr;
-        for (auto const &op : operators) {
-          if (op->layer_guid == layer->layer_guid) {
-            assert(op->op_type == layer->op_type);
-            assert(op->numWeights == layer->numWeights);
-            parallel_weight = op->weights[i];
-          }
-        }
-        assert(parallel_weight != nullptr);
-        weight->parallel_tensor = parallel_weight;
-      }
-    }
+    apply_optimized_graph(ret);
   }
 
   bool repl_labels = (operators[operators.size() - 1]->op_type == OP_AGG_SPEC);
@@ -2881,6 +3519,121 @@ void FFModel::compile(LossType loss_type,
                         TaskArgument(metrics_op, sizeof(Metrics)));
   current_metrics = runtime->execute_task(ctx, launcher);
 
+  finalize_operators();
+
+  Op *final_operator = get_final_operator();
+  // assert(final_operator->outputs[0].num_dims == 2);
+  ParallelDim p_dims[MAX_TENSOR_DIM];
+  int dims[MAX_TENSOR_DIM];
+  int num_p_dims = final_operator->outputs[0]->num_dims;
+  int num_dims = 0;
+  // FIXME: Currently assume 1st input for 1st operator = batch_size
+  for (int i = 0; i < num_p_dims; i++) {
+    p_dims[i] = final_operator->outputs[0]->dims[i];
+    if (!p_dims[i].is_replica_dim) {
+      dims[num_dims++] = p_dims[i].size;
+    }
+  }
+  DataType label_type = DT_FLOAT;
+  if (loss_type == LOSS_SPARSE_CATEGORICAL_CROSSENTROPY) {
+    // assign dims[num_dims-1] = 1 for sparse categorical labels
+    assert(p_dims[0].degree == 1);
+    p_dims[0].size = 1;
+    dims[0] = 1;
+    label_type = DT_INT32;
+  }
+  // create label tensor
+  switch (num_dims) {
+#define DIMFUNC(DIM)                                                           \
+  case DIM: {                                                                  \
+    label_tensor = create_tensor_legion_ordering(                              \
+        num_dims, dims, label_type, NULL, 0 /*idx*/, false /*create_grad*/);   \
+    parallel_label_tensor = create_parallel_tensor_legion_ordering(            \
+        num_p_dims, p_dims, label_type);                                       \
+    label_tensor->parallel_tensor = parallel_label_tensor;                     \
+    parallel_label_tensor->machine_view =                                      \
+        final_operator->outputs[0]->machine_view;                              \
+    map_tensor(parallel_label_tensor, parallel_label_tensor->owner_op);        \
+    break;                                                                     \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default: {
+      assert(false && "Unsupported dim");
+    }
+  }
+  init_parameter_updates();
+}
+
+void FFModel::apply_optimized_graph(
+    PCG::GraphOptimalViewSerialized const &ret) {
+  Deserializer dez(ret.data, ret.total_bytes);
+  // Reconstruct operators
+  PCG::Graph *best_graph = new PCG::Graph(this);
+  std::unordered_map<PCG::Node, MachineView> optimal_views;
+  std::unordered_map<PCG::Node, CostMetrics> predicted_costs;
+  std::vector<size_t> recompute_layer_ids;
+  deserialize_graph_optimal_view(
+      dez, best_graph, optimal_views, predicted_costs, recompute_layer_ids);
+  // The reconstructed operators have the parameters of the searched ones,
+  // so the predictions are keyed the same way
+  for (auto const &it : predicted_costs) {
+    Op const *op = it.first.ptr;
+    if (calibrator != nullptr) {
+      calibrator->record_prediction(op, optimal_views.at(it.first), it.second);
+    }
+    if (config.perform_fusion && op->layer_guid.is_valid_id()) {
+      predicted_layer_costs[op->layer_guid.id] = it.second;
+    }
+  }
+  // Layers marked with set_recompute are added back by
+  // create_recompute_schedule
+  recompute_layers.clear();
+  recompute_layers.insert(recompute_layer_ids.begin(),
+                          recompute_layer_ids.end());
+  if (!recompute_layer_ids.empty()) {
+    log_measure.debug("Recomputing the outputs of %zu layers in backward",
+                      recompute_layers.size());
+  }
+  operators.clear();
+  convert_graph_to_operators(best_graph, optimal_views);
+  best_graph->print_dot();
+  delete best_graph;
+  for (auto const &layer : layers) {
+    // map inputs to parallel tensor
+    if (layer->op_type == OP_INPUT) {
+      Tensor tensor = layer->outputs[0];
+      ParallelTensor parallel_tensor = nullptr;
+      for (auto const &op : operators) {
+        if (op->op_type == OP_INPUT) {
+          NoOp *noop = (NoOp *)op;
+          if (noop->input_tensor_guid == tensor->tensor_guid) {
+            parallel_tensor = op->outputs[0];
+          }
+        }
+      }
+      assert(parallel_tensor != nullptr);
+      tensor->parallel_tensor = parallel_tensor;
+    }
+    // map weights to parallel_tensor
+    for (int i = 0; i < layer->numWeights; i++) {
+      assert(layer->weights[i] != nullptr);
+      Tensor weight = layer->weights[i];
+      ParallelTensor parallel_weight = nullptr;
+      for (auto const &op : operators) {
+        if (op->layer_guid == layer->layer_guid) {
+          assert(op->op_type == layer->op_type);
+          assert(op->numWeights == layer->numWeights);
+          parallel_weight = op->weights[i];
+        }
+      }
+      assert(parallel_weight != nullptr);
+      weight->parallel_tensor = parallel_weight;
+    }
+  }
+}
+
+void FFModel::finalize_operators() {
   // Perform inplace optimizations
   if (config.enable_inplace_optimizations) {
     for (size_t l = 1; l < operators.size(); l++) {
@@ -2927,8 +3680,21 @@ void FFModel::compile(LossType loss_type,
       assert(op->weights[i]->owner_op != NULL);
       assert(op->weights[i]->region != LogicalRegion::NO_REGION);
       parameters.push_back(op->weights[i]);
+      // Each point task of a row-sparse NCCL update reads the row ids of its
+      // own replica, so the ids must be partitioned like the weight (e.g.
+      // not batch-parallel ids with a replicated table); otherwise the
+      // gradient is reset and synchronized densely
+      ParallelTensor rows = op->weights[i]->sparse_grad_rows;
+      if (rows != nullptr &&
+          op->weights[i]->sync_type == ParameterSyncType::NCCL &&
+          rows->parallel_is != op->weights[i]->parallel_is) {
+        op->weights[i]->sparse_grad_rows = nullptr;
+      }
+    }
+    // The input operators kept by a recompilation are already mapped
+    if (op->outputs[0]->region == LogicalRegion::NO_REGION) {
+      op->map_output_tensors(*this);
     }
-    op->map_output_tensors(*this);
     // for (int i = 0; i < op->numOutputs; i++) {
     //   // Output tensor
     //   map_tensor(op->outputs[i], op);
@@ -2966,19 +3732,20 @@ void FFModel::compile(LossType loss_type,
     fprintf(stderr, "Applying fusion optimizations during compilation...\n");
     fprintf(stderr, "%zu operators before fusion...\n", operators.size());
     std::vector<Op *> new_operators;
-    std::vector<Op *> old_operators = operators;
-    while (apply_fusion(operators, new_operators)) {
+    std::unordered_set<Op *> old_operators(operators.begin(), operators.end());
+    apply_fusion(operators, new_operators);
+    {
+      // No operator may consume the output of a later operator
+      std::unordered_set<Op const *> launched;
       for (size_t i = 0; i < new_operators.size(); i++) {
+        launched.insert(new_operators[i]);
         for (int idx = 0; idx < new_operators[i]->numInputs; idx++) {
-          for (size_t j = i + 1; j < new_operators.size(); j++) {
-            if (new_operators[i]->inputs[idx]->owner_op == new_operators[j]) {
-              assert(false);
-            }
-          }
+          Op const *owner = new_operators[i]->inputs[idx]->owner_op;
+          assert(owner == nullptr || launched.count(owner) > 0);
         }
       }
-      operators = new_operators;
     }
+    operators = new_operators;
     // Check integrity
     for (size_t l = 0; l < operators.size(); l++) {
       if (operators[l]->op_type == OP_FUSED) {
@@ -3016,14 +3783,7 @@ void FFModel::compile(LossType loss_type,
           ooff += fused->op_num_outputs[op];
         }
       } else {
-        bool found = false;
-        for (size_t i = 0; i < old_operators.size(); i++) {
-          if (old_operators[i] == operators[l]) {
-            assert(!found);
-            found = true;
-          }
-        }
-        assert(found);
+        assert(old_operators.count(operators[l]) > 0);
       }
     }
     fprintf(stderr, "%zu operators after fusion...\n", operators.size());
@@ -3062,6 +3822,8 @@ void FFModel::compile(LossType loss_type,
   Op *final_operator = get_final_operator();
   // FIXME: currently assume the final operator has exactly one output
   assert(final_operator->numOutputs == 1);
+  create_recompute_schedule();
+  plan_activation_memory();
   for (size_t i = 0; i < operators.size(); i++) {
     Op *op = operators[i];
     printf("operator[%zu]: type(%d)\n", i, operators[i]->op_type);
@@ -3082,51 +3844,44 @@ void FFModel::compile(LossType loss_type,
              handle.get_tree_id());
     }
   }
-  // assert(final_operator->outputs[0].num_dims == 2);
-  ParallelDim p_dims[MAX_TENSOR_DIM];
-  int dims[MAX_TENSOR_DIM];
-  int num_p_dims = final_operator->outputs[0]->num_dims;
-  int num_dims = 0;
-  // FIXME: Currently assume 1st input for 1st operator = batch_size
-  for (int i = 0; i < num_p_dims; i++) {
-    p_dims[i] = final_operator->outputs[0]->dims[i];
-    if (!p_dims[i].is_replica_dim) {
-      dims[num_dims++] = p_dims[i].size;
-    }
-  }
-  DataType label_type = DT_FLOAT;
-  if (loss_type == LOSS_SPARSE_CATEGORICAL_CROSSENTROPY) {
-    // assign dims[num_dims-1] = 1 for sparse categorical labels
-    assert(p_dims[0].degree == 1);
-    p_dims[0].size = 1;
-    dims[0] = 1;
-    label_type = DT_INT32;
-  }
-  // create label tensor
-  switch (num_dims) {
-#define DIMFUNC(DIM)                                                           \
-  case DIM: {                                                                  \
-    label_tensor = create_tensor_legion_ordering(                              \
-        num_dims, dims, label_type, NULL, 0 /*idx*/, false /*create_grad*/);   \
-    parallel_label_tensor = create_parallel_tensor_legion_ordering(            \
-        num_p_dims, p_dims, label_type);                                       \
-    label_tensor->parallel_tensor = parallel_label_tensor;                     \
-    parallel_label_tensor->machine_view =                                      \
-        final_operator->outputs[0]->machine_view;                              \
-    map_tensor(parallel_label_tensor, parallel_label_tensor->owner_op);        \
-    break;                                                                     \
-  }
-    LEGION_FOREACH_N(DIMFUNC)
-#undef DIMFUNC
-    default: {
-      assert(false && "Unsupported dim");
-    }
+}
+
+void FFModel::init_parameter_updates() {
+  ready_update_buckets.clear();
+  if (config.computationMode == COMP_MODE_INFERENCE) {
+    // Inference never updates parameters, so no optimizer state is allocated
+    return;
   }
   // init optimizer
   assert(optimizer != NULL);
   optimizer->init();
+  optimizer->create_update_buckets((size_t)config.grad_sync_bucket_size *
+                                   1024 * 1024);
+  if (config.grad_sync_bucket_size > 0 &&
+      config.computationMode == COMP_MODE_TRAINING) {
+    // A parameter's gradient is complete after the backward of the (possibly
+    // fused) operator that uses it; a bucket is ready after the first of its
+    // operators in topological order, which backward launches last
+    std::map<LogicalRegion, int> weight_to_op;
+    for (size_t l = 0; l < operators.size(); l++) {
+      for (int i = 0; i < operators[l]->numWeights; i++) {
+        weight_to_op[operators[l]->weights[i]->region] = l;
+      }
+    }
+    ready_update_buckets.resize(operators.size());
+    for (size_t b = 0; b < optimizer->update_buckets.size(); b++) {
+      int ready = operators.size() - 1;
+      for (auto const &p : optimizer->update_buckets[b]) {
+        assert(weight_to_op.find(p->region) != weight_to_op.end());
+        ready = std::min(ready, weight_to_op[p->region]);
+      }
+      ready_update_buckets[ready].push_back(b);
+    }
+  }
 
 #ifdef FF_USE_NCCL
+  Context ctx = config.lg_ctx;
+  Runtime *runtime = config.lg_hlr;
   if (config.computationMode == COMP_MODE_TRAINING) {
     // init all nccl communicators
     for (size_t l = 0; l < operators.size(); l++) {
@@ -3471,6 +4226,7 @@ struct DefaultConfig {
   const static int epochs = 1;
   // const static int iterations = 1;
   const static int batchSize = 64;
+  const static int printFreq = 1;
   const static bool profiling = false;
   constexpr static float learningRate = 0.01f;
   constexpr static float weightDecay = 0.0001f;
@@ -3483,6 +4239,8 @@ struct DefaultConfig {
       (size_t)2 * 1024 * 1024 * 1024; // 2GB
   constexpr static float searchAlpha = 1.2f;
   const static bool searchOverlapBackwardUpdate = false;
+  const static int gradSyncBucketSize = 0; // MB, 0 disables the overlap
+  constexpr static float fusionLaunchOverhead = 0.01f; // ms
   const static bool onlyDataParallel = false;
   const static bool enableSampleParallel = true;
   const static bool enableParameterParallel = false;
@@ -3496,12 +4254,14 @@ struct DefaultConfig {
   const static bool enable_control_replication = true;
   // The default python data loader type is 2 to enable control replication
   const static int python_data_loader_type = 2;
+  const static int calibration_iterations = 0;
 };
 
 FFConfig::FFConfig() {
   epochs = DefaultConfig::epochs;
   // iterations = DefaultConfig::iterations;
   batchSize = DefaultConfig::batchSize;
+  printFreq = DefaultConfig::printFreq;
   profiling = DefaultConfig::profiling;
   learningRate = DefaultConfig::learningRate;
   weightDecay = DefaultConfig::weightDecay;
@@ -3537,6 +4297,15 @@ FFConfig::FFConfig() {
   perform_fusion = false;
   base_optimize_threshold = DefaultConfig::base_optimize_threshold;
   perform_memory_search = false;
+  multi_tensor_update = false;
+  fusion_launch_overhead = DefaultConfig::fusionLaunchOverhead;
+  grad_sync_bucket_size = DefaultConfig::gradSyncBucketSize;
+  auto_recompute = false;
+  sparse_embedding_grad = false;
+  calibration_iterations = DefaultConfig::calibration_iterations;
+  calibration_report_file = "";
+  export_cost_calibration_file = "";
+  import_cost_calibration_file = "";
 
   // Parse input arguments
   {
@@ -3550,7 +4319,7 @@ FFConfig::FFConfig() {
   numNodes = machine.get_address_space_count();
   workersPerNode = Machine::ProcessorQuery(machine)
                        .local_address_space()
-                       .only_kind(Processor::TOC_PROC)
+                       .only_kind(DEVICE_PROC_KIND)
                        .count();
   cpusPerNode = Machine::ProcessorQuery(machine)
                     .local_address_space()
@@ -3659,6 +4428,26 @@ void FFConfig::parse_args(char **argv, int argc) {
       perform_fusion = true;
       continue;
     }
+    if (!strcmp(argv[i], "--fusion-launch-overhead")) {
+      fusion_launch_overhead = atof(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--multi-tensor-update")) {
+      multi_tensor_update = true;
+      continue;
+    }
+    if (!strcmp(argv[i], "--grad-sync-bucket-size")) {
+      grad_sync_bucket_size = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--auto-recompute")) {
+      auto_recompute = true;
+      continue;
+    }
+    if (!strcmp(argv[i], "--sparse-embedding-grad")) {
+      sparse_embedding_grad = true;
+      continue;
+    }
     if (!strcmp(argv[i], "--overlap")) {
       search_overlap_backward_update = true;
       continue;
@@ -3726,6 +4515,22 @@ void FFConfig::parse_args(char **argv, int argc) {
       perform_memory_search = true;
       continue;
     }
+    if (!strcmp(argv[i], "--calibrate-iterations")) {
+      calibration_iterations = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--calibration-report")) {
+      calibration_report_file = std::string(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--export-cost-calibration")) {
+      export_cost_calibration_file = std::string(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--import-cost-calibration")) {
+      import_cost_calibration_file = std::string(argv[++i]);
+      continue;
+    }
   }
 }
 
@@ -3735,10 +4540,12 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   if (!pre_register) {
     assert(runtime != NULL);
   }
+  Runtime::register_reduction_op<PerfMetricsReduction>(
+      PERF_METRICS_REDOP_ID, true /*permit_duplicates*/);
   // CNN_INIT_TASK
   {
     TaskVariantRegistrar registrar(FF_INIT_TASK_ID, "cuda_init_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<FFHandler,
@@ -3756,7 +4563,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ELEMENTUNARY_INIT_TASK_ID,
                                    "ElementWiseUnary Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, ElementUnary::init_task>(
@@ -3772,7 +4579,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ELEMENTUNARY_FWD_TASK_ID,
                                    "ElementWiseUnary Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<ElementUnary::forward_task>(
@@ -3787,7 +4594,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ELEMENTUNARY_BWD_TASK_ID,
                                    "ElementWiseUnary Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<ElementUnary::backward_task>(
@@ -3803,7 +4610,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ELEMENTBINARY_INIT_TASK_ID,
                                    "ElementWiseBinary Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, ElementBinary::init_task>(
@@ -3819,7 +4626,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ELEMENTBINARY_FWD_TASK_ID,
                                    "ElementWiseBinary Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<ElementBinary::forward_task>(
@@ -3834,7 +4641,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ELEMENTBINARY_BWD_TASK_ID,
                                    "ElementWiseBinary Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<ElementBinary::backward_task>(
@@ -3849,7 +4656,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Cast
   {
     TaskVariantRegistrar registrar(CAST_INIT_TASK_ID, "Cast Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Cast::init_task>(
@@ -3863,7 +4670,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CAST_FWD_TASK_ID, "Cast Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Cast::forward_task>(
@@ -3877,7 +4684,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CAST_BWD_TASK_ID, "Cast Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Cast::backward_task>(
@@ -3892,7 +4699,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Conv2D task
   {
     TaskVariantRegistrar registrar(CONV2D_INIT_TASK_ID, "Conv2D Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Conv2D::init_task>(
@@ -3906,7 +4713,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CONV2D_FWD_TASK_ID, "Conv2D Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Conv2D::forward_task>(
@@ -3920,7 +4727,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CONV2D_BWD_TASK_ID, "Conv2D Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Conv2D::backward_task>(
@@ -3934,7 +4741,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   //{
   //  TaskVariantRegistrar registrar(CONV2D_UPD_TASK_ID, "Conv2D Update");
-  //  registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+  //  registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
   //  registrar.set_leaf();
   //  Runtime::preregister_task_variant<Conv2D::update_task>(
   //     registrar, "Conv2D Update Task");
@@ -3942,7 +4749,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Dropout task
   {
     TaskVariantRegistrar registrar(DROPOUT_INIT_TASK_ID, "Dropout Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Dropout::init_task>(
@@ -3956,7 +4763,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(DROPOUT_FWD_TASK_ID, "Dropout Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Dropout::forward_task>(
@@ -3970,7 +4777,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(DROPOUT_BWD_TASK_ID, "Dropout Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Dropout::backward_task>(
@@ -3985,7 +4792,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Embedding task GPU
   {
     TaskVariantRegistrar registrar(EMBED_INIT_TASK_ID, "Embedding Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Embedding::init_task>(
@@ -3999,7 +4806,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(EMBED_FWD_TASK_ID, "Embedding Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Embedding::forward_task>(
@@ -4013,7 +4820,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(EMBED_BWD_TASK_ID, "Embedding Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Embedding::backward_task>(
@@ -4043,7 +4850,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Gather task
   {
     TaskVariantRegistrar registrar(GATHER_INIT_TASK_ID, "Gather Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Gather::init_task>(
@@ -4057,7 +4864,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(GATHER_FWD_TASK_ID, "Gather Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Gather::forward_task>(
@@ -4071,7 +4878,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(GATHER_BWD_TASK_ID, "Gather Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Gather::backward_task>(
@@ -4087,7 +4894,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Cache task CPU
   {
     TaskVariantRegistrar registrar(CACHE_INIT_TASK_ID, "Cache Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Cache::init_task>(
@@ -4101,7 +4908,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CACHE_FWD_TASK_ID, "Cache Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Cache::forward_task>(
@@ -4115,7 +4922,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CACHE_UPDATE_TASK_ID, "Cache Update");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<float, Cache::update_task>(
@@ -4130,7 +4937,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Group by task CPU
   {
     TaskVariantRegistrar registrar(GROUP_BY_INIT_TASK_ID, "Group_by Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Group_by::init_task>(
@@ -4144,7 +4951,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(GROUP_BY_FWD_TASK_ID, "Group_by Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Group_by::forward_task>(
@@ -4158,7 +4965,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(GROUP_BY_BWD_TASK_ID, "Group_by Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Group_by::backward_task>(
@@ -4174,7 +4981,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Aggregate task CPU
   {
     TaskVariantRegistrar registrar(AGGREGATE_INIT_TASK_ID, "Aggregate Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Aggregate::init_task>(
@@ -4188,7 +4995,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(AGGREGATE_FWD_TASK_ID, "Aggregate Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Aggregate::forward_task>(
@@ -4202,7 +5009,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(AGGREGATE_BWD_TASK_ID, "Aggregate Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Aggregate::backward_task>(
@@ -4219,7 +5026,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(AGG_SPEC_INIT_TASK_ID,
                                    "Aggregate specification Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, AggregateSpec::init_task>(
@@ -4235,7 +5042,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(AGG_SPEC_FWD_TASK_ID,
                                    "Aggregate specification Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<AggregateSpec::forward_task>(
@@ -4250,7 +5057,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(AGG_SPEC_BWD_TASK_ID,
                                    "Aggregate specification Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<AggregateSpec::backward_task>(
@@ -4266,7 +5073,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Pool2D task
   {
     TaskVariantRegistrar registrar(POOL2D_INIT_TASK_ID, "pool2d_init_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Pool2D::init_task>(
@@ -4280,7 +5087,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(POOL2D_FWD_TASK_ID, "pool2d_fwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Pool2D::forward_task>(
@@ -4294,7 +5101,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(POOL2D_BWD_TASK_ID, "pool2d_bwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Pool2D::backward_task>(
@@ -4309,7 +5116,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // BatchNorm task
   {
     TaskVariantRegistrar registrar(BATCHNORM_INIT_TASK_ID, "bn_init_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, BatchNorm::init_task>(
@@ -4323,7 +5130,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(BATCHNORM_FWD_TASK_ID, "bn_fwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<BatchNorm::forward_task>(registrar,
@@ -4337,7 +5144,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(BATCHNORM_BWD_TASK_ID, "bn_bwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<BatchNorm::backward_task>(
@@ -4353,7 +5160,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(BATCHMATMUL_INIT_TASK_ID,
                                    "BatchMatmul Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, BatchMatmul::init_task>(
@@ -4369,7 +5176,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(BATCHMATMUL_FWD_TASK_ID,
                                    "BatchMatmul Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<BatchMatmul::forward_task>(
@@ -4384,7 +5191,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(BATCHMATMUL_BWD_TASK_ID,
                                    "BatchMatmul Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<BatchMatmul::backward_task>(
@@ -4400,7 +5207,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(LAYERNORM_INIT_TASK_ID,
                                    "layernorm_init_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, LayerNorm::init_task>(
@@ -4414,7 +5221,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(LAYERNORM_FWD_TASK_ID, "layernorm_fwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<LayerNorm::forward_task>(
@@ -4428,7 +5235,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(LAYERNORM_BWD_TASK_ID, "layernorm_bwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<LayerNorm::backward_task>(
@@ -4443,7 +5250,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Linear task
   {
     TaskVariantRegistrar registrar(LINEAR_INIT_TASK_ID, "Linear Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Linear::init_task>(
@@ -4457,7 +5264,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(LINEAR_FWD_TASK_ID, "Linear Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Linear::forward_task>(
@@ -4471,7 +5278,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(LINEAR_BWD_TASK_ID, "Linear Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Linear::backward_task>(
@@ -4486,7 +5293,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Flat task
   {
     TaskVariantRegistrar registrar(FLAT_INIT_TASK_ID, "flat_init_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Flat::init_task>(
@@ -4500,7 +5307,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(FLAT_FWD_TASK_ID, "flat_fwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Flat::forward_task>(registrar,
@@ -4514,7 +5321,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(FLAT_BWD_TASK_ID, "flat_bwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Flat::backward_task>(registrar,
@@ -4529,7 +5336,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Softmax task
   {
     TaskVariantRegistrar registrar(SOFTMAX_INIT_TASK_ID, "softmax_init_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Softmax::init_task>(
@@ -4543,7 +5350,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(SOFTMAX_FWD_TASK_ID, "softmax_fwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Softmax::forward_task>(
@@ -4557,7 +5364,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(SOFTMAX_BWD_TASK_ID, "softmax_bwd_task");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Softmax::backward_task>(
@@ -4572,7 +5379,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // compute Loss
   {
     TaskVariantRegistrar registrar(LOSS_BWD_TASK_ID, "Loss Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Loss::backward_task>(
@@ -4587,7 +5394,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // compute Metrics
   {
     TaskVariantRegistrar registrar(METRICS_COMP_TASK_ID, "Metrics Compute");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<PerfMetrics, Metrics::compute_task>(
@@ -4603,7 +5410,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // MSELoss
   //{
   //  TaskVariantRegistrar registrar(MSELOSS_BWD_TASK_ID, "MSELoss Backward");
-  //  registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+  //  registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
   //  registrar.set_leaf();
   //  Runtime::preregister_task_variant<PerfMetrics, MSELoss::backward_task>(
   //      registrar, "MSELoss Backward Task");
@@ -4628,7 +5435,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Concat task
   {
     TaskVariantRegistrar registrar(CONCAT_INIT_TASK_ID, "Concat Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Concat::init_task>(
@@ -4642,7 +5449,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CONCAT_FWD_TASK_ID, "Concat Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Concat::forward_task>(
@@ -4656,7 +5463,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CONCAT_BWD_TASK_ID, "Concat Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Concat::backward_task>(
@@ -4671,7 +5478,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Split task
   {
     TaskVariantRegistrar registrar(SPLIT_INIT_TASK_ID, "Split Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Split::init_task>(
@@ -4685,7 +5492,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(SPLIT_FWD_TASK_ID, "Split Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Split::forward_task>(
@@ -4699,7 +5506,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(SPLIT_BWD_TASK_ID, "Split Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Split::backward_task>(
@@ -4714,7 +5521,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Reduce task
   {
     TaskVariantRegistrar registrar(REDUCE_INIT_TASK_ID, "Reduce Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Reduce::init_task>(
@@ -4728,7 +5535,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(REDUCE_FWD_TASK_ID, "Reduce Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Reduce::forward_task>(
@@ -4742,7 +5549,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(REDUCE_BWD_TASK_ID, "Reduce Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Reduce::backward_task>(
@@ -4757,7 +5564,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Reshape task
   {
     TaskVariantRegistrar registrar(RESHAPE_INIT_TASK_ID, "Reshape Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Reshape::init_task>(
@@ -4771,7 +5578,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(RESHAPE_FWD_TASK_ID, "Reshape Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Reshape::forward_task>(
@@ -4785,7 +5592,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(RESHAPE_BWD_TASK_ID, "Reshape Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Reshape::backward_task>(
@@ -4800,7 +5607,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Reverse task
   {
     TaskVariantRegistrar registrar(REVERSE_INIT_TASK_ID, "Reverse Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Reverse::init_task>(
@@ -4814,7 +5621,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(REVERSE_FWD_TASK_ID, "Reverse Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Reverse::forward_task>(
@@ -4828,7 +5635,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(REVERSE_BWD_TASK_ID, "Reverse Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Reverse::backward_task>(
@@ -4843,7 +5650,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Topk task
   {
     TaskVariantRegistrar registrar(TOPK_INIT_TASK_ID, "TopK Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, TopK::init_task>(
@@ -4857,7 +5664,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(TOPK_FWD_TASK_ID, "TopK Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<TopK::forward_task>(
@@ -4871,7 +5678,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(TOPK_BWD_TASK_ID, "TopK Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<TopK::backward_task>(
@@ -4886,7 +5693,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Transpose task
   {
     TaskVariantRegistrar registrar(TRANSPOSE_INIT_TASK_ID, "Transpose Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Transpose::init_task>(
@@ -4900,7 +5707,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(TRANSPOSE_FWD_TASK_ID, "Transpose Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Transpose::forward_task>(
@@ -4914,7 +5721,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(TRANSPOSE_BWD_TASK_ID, "Transpose Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Transpose::backward_task>(
@@ -4930,7 +5737,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ATTENTION_INIT_TASK_ID,
                                    "MultiHeadAttention Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *,
@@ -4947,7 +5754,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ATTENTION_FWD_TASK_ID,
                                    "MultiHeadAttention Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<MultiHeadAttention::forward_task>(
@@ -4963,7 +5770,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ATTENTION_BWD_TASK_ID,
                                    "MultiHeadAttention Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<MultiHeadAttention::backward_task>(
@@ -4979,7 +5786,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // NoOp
   {
     TaskVariantRegistrar registrar(NOOP_INIT_TASK_ID, "Weight NCCL Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, NoOp::init_task>(
@@ -4994,7 +5801,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // FusedOp Task
   {
     TaskVariantRegistrar registrar(FUSEDOP_INIT_TASK_ID, "FusedOp Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, FusedOp::init_task>(
@@ -5008,7 +5815,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(FUSEDOP_FWD_TASK_ID, "FusedOp Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<FusedOp::forward_task>(
@@ -5022,7 +5829,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(FUSEDOP_BWD_TASK_ID, "FusedOp Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<FusedOp::backward_task>(
@@ -5039,7 +5846,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(REPARTITION_INIT_TASK_ID,
                                    "Repartition Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Repartition::init_task>(
@@ -5055,7 +5862,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(REPARTITION_FWD_TASK_ID,
                                    "Repartition Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Repartition::forward_task>(
@@ -5070,7 +5877,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(REPARTITION_BWD_TASK_ID,
                                    "Repartition Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Repartition::backward_task>(
@@ -5085,7 +5892,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Combine
   {
     TaskVariantRegistrar registrar(COMBINE_INIT_TASK_ID, "Combine Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<OpMeta *, Combine::init_task>(
@@ -5099,7 +5906,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(COMBINE_FWD_TASK_ID, "Combine Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Combine::forward_task>(
@@ -5113,7 +5920,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(COMBINE_BWD_TASK_ID, "Combine Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Combine::backward_task>(
@@ -5128,7 +5935,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Replicate
   {
     TaskVariantRegistrar registrar(REPLICATE_FWD_TASK_ID, "Replicate Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Replicate::forward_task>(
@@ -5142,7 +5949,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(REPLICATE_BWD_TASK_ID, "Replicate Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Replicate::backward_task>(
@@ -5157,7 +5964,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Reduction
   {
     TaskVariantRegistrar registrar(REDUCTION_FWD_TASK_ID, "Reduction Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Reduction::forward_task>(
@@ -5171,7 +5978,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(REDUCTION_BWD_TASK_ID, "Reduction Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Reduction::backward_task>(
@@ -5183,11 +5990,54 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<Reduction::backward_task>(registrar);
     }
   }
+  // AllToAll
+  {
+    TaskVariantRegistrar registrar(ALLTOALL_INIT_TASK_ID, "AllToAll Init");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<OpMeta *, AllToAll::init_task>(
+          registrar, "AllToAll init Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<OpMeta *, AllToAll::init_task>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(ALLTOALL_FWD_TASK_ID, "AllToAll Forward");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<AllToAll::forward_task>(
+          registrar, "AllToAll Forward Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<AllToAll::forward_task>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(ALLTOALL_BWD_TASK_ID, "AllToAll Backward");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<AllToAll::backward_task>(
+          registrar, "AllToAll Backward Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<AllToAll::backward_task>(registrar);
+    }
+  }
   // FusedParallelOp
   {
     TaskVariantRegistrar registrar(FUSED_PARALLELOP_FWD_TASK_ID,
                                    "FusedParallel Forward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<FusedParallelOp::forward_task>(
@@ -5202,7 +6052,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(FUSED_PARALLELOP_BWD_TASK_ID,
                                    "FusedParallel Backward");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<FusedParallelOp::backward_task>(
@@ -5218,7 +6068,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(SGD_UPD_PS_TASK_ID,
                                    "SGD Parameter Server Update");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<SGDOptimizer::ps_update_task>(
@@ -5233,7 +6083,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(ADAM_UPD_PS_TASK_ID,
                                    "Adam Parameter Server Update");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<AdamOptimizer::ps_update_task>(
@@ -5248,7 +6098,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
 #ifdef FF_USE_NCCL
   {
     TaskVariantRegistrar registrar(SGD_UPD_NCCL_TASK_ID, "SGD NCCL Update");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<SGDOptimizer::nccl_update_task>(
@@ -5262,7 +6112,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(ADAM_UPD_NCCL_TASK_ID, "Adam NCCL Update");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<AdamOptimizer::nccl_update_task>(
@@ -5275,6 +6125,176 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+#endif
+  {
+    TaskVariantRegistrar registrar(SGD_MULTI_UPD_PS_TASK_ID,
+                                   "SGD Multi-Tensor PS Update");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          SGDOptimizer::ps_multi_tensor_update_task>(
+          registrar, "SGD Multi-Tensor PS Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          SGDOptimizer::ps_multi_tensor_update_task>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(SGD_MULTI_UPD_PS_TASK_ID,
+                                   "SGD Multi-Tensor PS Update");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          SGDOptimizer::ps_multi_tensor_update_task_cpu>(
+          registrar, "SGD Multi-Tensor PS Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          SGDOptimizer::ps_multi_tensor_update_task_cpu>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(ADAM_MULTI_UPD_PS_TASK_ID,
+                                   "Adam Multi-Tensor PS Update");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          AdamOptimizer::ps_multi_tensor_update_task>(
+          registrar, "Adam Multi-Tensor PS Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          AdamOptimizer::ps_multi_tensor_update_task>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(ADAM_MULTI_UPD_PS_TASK_ID,
+                                   "Adam Multi-Tensor PS Update");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          AdamOptimizer::ps_multi_tensor_update_task_cpu>(
+          registrar, "Adam Multi-Tensor PS Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          AdamOptimizer::ps_multi_tensor_update_task_cpu>(registrar);
+    }
+  }
+#ifdef FF_USE_NCCL
+  {
+    TaskVariantRegistrar registrar(SGD_MULTI_UPD_NCCL_TASK_ID,
+                                   "SGD Multi-Tensor NCCL Update");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          SGDOptimizer::nccl_multi_tensor_update_task>(
+          registrar, "SGD Multi-Tensor NCCL Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          SGDOptimizer::nccl_multi_tensor_update_task>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(ADAM_MULTI_UPD_NCCL_TASK_ID,
+                                   "Adam Multi-Tensor NCCL Update");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          AdamOptimizer::nccl_multi_tensor_update_task>(
+          registrar, "Adam Multi-Tensor NCCL Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          AdamOptimizer::nccl_multi_tensor_update_task>(registrar);
+    }
+  }
+#endif
+  {
+    TaskVariantRegistrar registrar(SGD_SPARSE_UPD_PS_TASK_ID,
+                                   "SGD Sparse PS Update");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<SGDOptimizer::ps_sparse_update_task>(
+          registrar, "SGD Sparse PS Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<SGDOptimizer::ps_sparse_update_task>(
+          registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(ADAM_SPARSE_UPD_PS_TASK_ID,
+                                   "Adam Sparse PS Update");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<AdamOptimizer::ps_sparse_update_task>(
+          registrar, "Adam Sparse PS Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<AdamOptimizer::ps_sparse_update_task>(
+          registrar);
+    }
+  }
+#ifdef FF_USE_NCCL
+  {
+    TaskVariantRegistrar registrar(SGD_SPARSE_UPD_NCCL_TASK_ID,
+                                   "SGD Sparse NCCL Update");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<SGDOptimizer::nccl_sparse_update_task>(
+          registrar, "SGD Sparse NCCL Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<SGDOptimizer::nccl_sparse_update_task>(
+          registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(ADAM_SPARSE_UPD_NCCL_TASK_ID,
+                                   "Adam Sparse NCCL Update");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<AdamOptimizer::nccl_sparse_update_task>(
+          registrar, "Adam Sparse NCCL Update Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<AdamOptimizer::nccl_sparse_update_task>(
+          registrar);
+    }
+  }
 #endif
   // Initializer
   {
@@ -5293,7 +6313,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(ZERO_INIT_TASK_ID, "Zero Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<ZeroInitializer::init_task>(
@@ -5322,7 +6342,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(CONSTANT_INIT_TASK_ID, "Constant Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<ConstantInitializer::init_task>(
@@ -5336,7 +6356,22 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(UNIFORM_INIT_TASK_ID, "Uniform Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<UniformInitializer::init_task_cpu>(
+          registrar, "Uniform Init Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<UniformInitializer::init_task_cpu>(
+          registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(UNIFORM_INIT_TASK_ID, "Uniform Init");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<UniformInitializer::init_task>(
@@ -5350,7 +6385,21 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(GLOROT_INIT_TASK_ID, "Glorot Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<GlorotUniform::init_task_cpu>(
+          registrar, "Glorot Init Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<GlorotUniform::init_task_cpu>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(GLOROT_INIT_TASK_ID, "Glorot Init");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<GlorotUniform::init_task>(
@@ -5364,7 +6413,21 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   }
   {
     TaskVariantRegistrar registrar(NORMAL_INIT_TASK_ID, "Normalize Init");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<NormInitializer::init_task_cpu>(
+          registrar, "Normalize Init Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<NormInitializer::init_task_cpu>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(NORMAL_INIT_TASK_ID, "Normalize Init");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<NormInitializer::init_task>(
@@ -5381,7 +6444,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(NCCL_GETUNIQUEID_TASK_ID,
                                    "NCCL GetUniqueId");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<ncclUniqueId,
@@ -5398,7 +6461,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   {
     TaskVariantRegistrar registrar(NCCL_INIT_COMMS_TASK_ID,
                                    "NCCL Init Communicators");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<ncclComm_t, Op::init_nccl_comms_task>(
@@ -5415,7 +6478,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Search
   {
     TaskVariantRegistrar registrar(STRATEGY_SEARCH_TASK_ID, "Stretegy Search");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<Simulator::strategy_search_task>(
@@ -5431,7 +6494,7 @@ void register_flexflow_internal_tasks(Runtime *runtime,
   // Graph optimize
   {
     TaskVariantRegistrar registrar(GRAPH_OPTIMIZE_TASK_ID, "Graph Optimize");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<PCG::GraphOptimalViewSerialized,
@@ -5446,10 +6509,47 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  // Graph optimize in the background, on a CPU so that training keeps all
+  // devices; it launches its measurements as tasks and is not a leaf
+  {
+    TaskVariantRegistrar registrar(GRAPH_OPTIMIZE_BACKGROUND_TASK_ID,
+                                   "Graph Optimize Background");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    if (pre_register) {
+      Runtime::preregister_task_variant<PCG::GraphOptimalViewSerialized,
+                                        PCG::Graph::graph_optimize_task>(
+          registrar, "Graph Optimize Background Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<PCG::GraphOptimalViewSerialized,
+                                     PCG::Graph::graph_optimize_task>(
+          registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(MEASURE_OPERATOR_COST_TASK_ID,
+                                   "Measure Operator Cost");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<MeasuredOperatorCost,
+                                        Simulator::measure_operator_cost_task>(
+          registrar, "Measure Operator Cost Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<MeasuredOperatorCost,
+                                     Simulator::measure_operator_cost_task>(
+          registrar);
+    }
+  }
   // Parameter Server Prefetch task
   {
     TaskVariantRegistrar registrar(PS_PREFETCH_TASK_ID, "Weights Prefetch");
-    registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
     registrar.set_leaf();
     if (pre_register) {
       Runtime::preregister_task_variant<UtilityTasks::dummy_task>(
@@ -5461,6 +6561,53 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<UtilityTasks::dummy_task>(registrar);
     }
   }
+  // Checkpoint tasks: the snapshot copies each parameter shard into zero-copy
+  // memory on its device, and the file I/O then runs on a CPU next to that
+  // memory so that it never occupies a GPU processor
+  {
+    TaskVariantRegistrar registrar(CHECKPOINT_SNAPSHOT_TASK_ID,
+                                   "Checkpoint Snapshot");
+    registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<FFModel::checkpoint_snapshot_task>(
+          registrar, "Checkpoint Snapshot Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<FFModel::checkpoint_snapshot_task>(
+          registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(CHECKPOINT_SAVE_TASK_ID, "Checkpoint Save");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<FFModel::checkpoint_save_task>(
+          registrar, "Checkpoint Save Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<FFModel::checkpoint_save_task>(registrar);
+    }
+  }
+  {
+    TaskVariantRegistrar registrar(CHECKPOINT_LOAD_TASK_ID, "Checkpoint Load");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<FFModel::checkpoint_load_task>(
+          registrar, "Checkpoint Load Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<FFModel::checkpoint_load_task>(registrar);
+    }
+  }
 }
 
 // template instantiations
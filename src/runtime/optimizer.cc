@@ -15,6 +15,9 @@
 
 #include "flexflow/optimizer.h"
 #include "flexflow/model.h"
+#ifdef FF_USE_AVX2
+#include <immintrin.h>
+#endif
 
 namespace FlexFlow {
 
@@ -22,6 +25,430 @@ using namespace Legion;
 
 Optimizer::Optimizer(FFModel const *_model) : model(_model) {}
 
+void Optimizer::create_update_buckets(size_t bucket_bytes) {
+  update_buckets.clear();
+  // Parameters with the same sync type and task index space (i.e., the same
+  // MachineView) can be updated by a single (index) task launch. Parameters
+  // are visited in reverse topological order, the order in which backward
+  // produces their gradients
+  std::map<std::pair<int, IndexSpace>, size_t> open_buckets;
+  std::map<std::pair<int, IndexSpace>, size_t> open_bucket_bytes;
+  for (int i = model->parameters.size() - 1; i >= 0; i--) {
+    ParallelTensor p = model->parameters[i];
+    if (p->sparse_grad_rows != nullptr) {
+      // Row-sparse gradients are synchronized on their own (sparse_update)
+      update_buckets.push_back({p});
+      continue;
+    }
+    std::pair<int, IndexSpace> key((int)p->sync_type, p->parallel_is);
+    auto const &it = open_buckets.find(key);
+    if (it == open_buckets.end() ||
+        update_buckets[it->second].size() >= MAX_NUM_MULTI_TENSORS ||
+        (bucket_bytes > 0 && open_bucket_bytes[key] >= bucket_bytes)) {
+      open_buckets[key] = update_buckets.size();
+      open_bucket_bytes[key] = 0;
+      update_buckets.push_back({p});
+    } else {
+      update_buckets[it->second].push_back(p);
+    }
+    open_bucket_bytes[key] += p->get_shape().get_piece_size();
+  }
+}
+
+void Optimizer::launch_nccl_sync(IndexLauncher &launcher) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  launcher.concurrent = true;
+  if (model->config.grad_sync_bucket_size <= 0) {
+    runtime->execute_index_space(ctx, launcher);
+    runtime->issue_execution_fence(ctx);
+    return;
+  }
+  // Collectives must be issued in the same order on all GPUs. Instead of an
+  // execution fence, which would also block the backward tasks launched
+  // after this one, each launch waits for all points of the previous one
+  for (size_t i = 0; i < last_sync_futures.size(); i++) {
+    launcher.add_future(last_sync_futures[i]);
+  }
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+  last_sync_futures.clear();
+  Domain domain = runtime->get_index_space_domain(ctx, launcher.launch_space);
+  for (Domain::DomainPointIterator it(domain); it; it++) {
+    last_sync_futures.push_back(fm.get_future(*it));
+  }
+}
+
+namespace {
+
+// Fill args from region requirements laid out as regions_per_tensor
+// consecutive requirements per parameter: the gradient, the weight, and then
+// the optimizer states (v and m)
+void get_multi_tensor_args(Task const *task,
+                           std::vector<PhysicalRegion> const &regions,
+                           Context ctx,
+                           Runtime *runtime,
+                           int regions_per_tensor,
+                           MultiTensorUpdateArgs &args) {
+  assert(regions.size() == task->regions.size());
+  assert(regions.size() % regions_per_tensor == 0);
+  args.num_tensors = regions.size() / regions_per_tensor;
+  assert(args.num_tensors <= MAX_NUM_MULTI_TENSORS);
+  for (int t = 0; t < args.num_tensors; t++) {
+    int r = t * regions_per_tensor;
+    Domain domain = runtime->get_index_space_domain(
+        ctx, task->regions[r + 1].region.get_index_space());
+    args.v_ptrs[t] = NULL;
+    args.m_ptrs[t] = NULL;
+    switch (domain.get_dim()) {
+#define DIMFUNC(DIM)                                                           \
+  case DIM: {                                                                  \
+    TensorAccessorR<float, DIM> accWGrad(                                      \
+        regions[r], task->regions[r], FID_DATA, ctx, runtime);                 \
+    TensorAccessorW<float, DIM> accW(regions[r + 1],                           \
+                                     task->regions[r + 1],                     \
+                                     FID_DATA,                                 \
+                                     ctx,                                      \
+                                     runtime,                                  \
+                                     true /*readOutput*/);                     \
+    assert(accWGrad.rect.volume() % accW.rect.volume() == 0);                  \
+    args.sizes[t] = accW.rect.volume();                                        \
+    args.num_replicas[t] = accWGrad.rect.volume() / accW.rect.volume();        \
+    args.w_grad_ptrs[t] = accWGrad.ptr;                                        \
+    args.w_ptrs[t] = accW.ptr;                                                 \
+    if (regions_per_tensor > 2) {                                              \
+      TensorAccessorW<float, DIM> accV(regions[r + 2],                         \
+                                       task->regions[r + 2],                   \
+                                       FID_DATA,                               \
+                                       ctx,                                    \
+                                       runtime,                                \
+                                       true /*readOutput*/);                   \
+      assert(accW.rect == accV.rect);                                          \
+      args.v_ptrs[t] = accV.ptr;                                               \
+    }                                                                          \
+    if (regions_per_tensor > 3) {                                              \
+      TensorAccessorW<float, DIM> accM(regions[r + 3],                         \
+                                       task->regions[r + 3],                   \
+                                       FID_DATA,                               \
+                                       ctx,                                    \
+                                       runtime,                                \
+                                       true /*readOutput*/);                   \
+      assert(accW.rect == accM.rect);                                          \
+      args.m_ptrs[t] = accM.ptr;                                               \
+    }                                                                          \
+    break;                                                                     \
+  }
+      LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+      default: {
+        // Unsupported dims
+        assert(false);
+      }
+    }
+  }
+}
+
+// Pass the OpMeta (and thus the NCCL communicator) of the bucket's first
+// parameter to each point task
+void set_argumentmap_for_sync(FFModel const *model,
+                              const ParallelTensor p,
+                              ArgumentMap &argmap) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  Domain domain = runtime->get_index_space_domain(ctx, p->parallel_is);
+  switch (domain.get_dim()) {
+#define DIMFUNC(DIM)                                                           \
+  case DIM: {                                                                  \
+    Rect<DIM> rect = domain;                                                   \
+    int idx = 0;                                                               \
+    for (PointInRectIterator<DIM> it(rect); it(); it++) {                      \
+      OpMeta *mp = p->owner_op->meta[idx++];                                   \
+      argmap.set_point(*it, TaskArgument(&mp, sizeof(OpMeta *)));              \
+    }                                                                          \
+    break;                                                                     \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      assert(false);
+  }
+}
+
+} // namespace
+
+void gather_replicas_cpu(float *w_grad, size_t size, int num_replicas) {
+  for (int r = 1; r < num_replicas; r++) {
+    float const *src = w_grad + r * size;
+    size_t i = 0;
+#ifdef FF_USE_AVX2
+    for (; i + 8 <= size; i += 8) {
+      _mm256_storeu_ps(
+          w_grad + i,
+          _mm256_add_ps(_mm256_loadu_ps(w_grad + i), _mm256_loadu_ps(src + i)));
+    }
+#endif
+    for (; i < size; i++) {
+      w_grad[i] += src[i];
+    }
+  }
+}
+
+void sgd_update_cpu(size_t count,
+                    float lr,
+                    float weight_decay,
+                    float momentum,
+                    bool nesterov,
+                    float const *WGrad,
+                    float *V,
+                    float *W) {
+  size_t i = 0;
+#ifdef FF_USE_AVX2
+  __m256 const vlr = _mm256_set1_ps(lr);
+  __m256 const vdecay = _mm256_set1_ps(weight_decay);
+  __m256 const vmomentum = _mm256_set1_ps(momentum);
+  for (; i + 8 <= count; i += 8) {
+    __m256 w = _mm256_loadu_ps(W + i);
+    __m256 gt =
+        _mm256_add_ps(_mm256_loadu_ps(WGrad + i), _mm256_mul_ps(vdecay, w));
+    if (momentum > 0.0f) {
+      __m256 v =
+          _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(V + i), vmomentum), gt);
+      _mm256_storeu_ps(V + i, v);
+      gt = nesterov ? _mm256_add_ps(gt, _mm256_mul_ps(vmomentum, v)) : v;
+    }
+    _mm256_storeu_ps(W + i, _mm256_sub_ps(w, _mm256_mul_ps(vlr, gt)));
+  }
+#endif
+  for (; i < count; i++) {
+    float gt = WGrad[i] + weight_decay * W[i];
+    if (momentum > 0.0f) {
+      V[i] = V[i] * momentum + gt;
+      if (nesterov) {
+        gt = gt + momentum * V[i];
+      } else {
+        gt = V[i];
+      }
+    }
+    W[i] -= lr * gt;
+  }
+}
+
+void adam_update_cpu(size_t count,
+                     float alpha_t,
+                     float beta1,
+                     float beta2,
+                     float weight_decay,
+                     float epsilon,
+                     float const *WGrad,
+                     float *M,
+                     float *V,
+                     float *W) {
+  size_t i = 0;
+#ifdef FF_USE_AVX2
+  __m256 const valpha = _mm256_set1_ps(alpha_t);
+  __m256 const vbeta1 = _mm256_set1_ps(beta1);
+  __m256 const vbeta2 = _mm256_set1_ps(beta2);
+  __m256 const vbeta1c = _mm256_set1_ps(1 - beta1);
+  __m256 const vbeta2c = _mm256_set1_ps(1 - beta2);
+  __m256 const vdecay = _mm256_set1_ps(weight_decay);
+  __m256 const veps = _mm256_set1_ps(epsilon);
+  for (; i + 8 <= count; i += 8) {
+    __m256 w = _mm256_loadu_ps(W + i);
+    __m256 gt =
+        _mm256_add_ps(_mm256_loadu_ps(WGrad + i), _mm256_mul_ps(vdecay, w));
+    __m256 mt = _mm256_add_ps(_mm256_mul_ps(vbeta1, _mm256_loadu_ps(M + i)),
+                              _mm256_mul_ps(vbeta1c, gt));
+    __m256 vt =
+        _mm256_add_ps(_mm256_mul_ps(vbeta2, _mm256_loadu_ps(V + i)),
+                      _mm256_mul_ps(_mm256_mul_ps(vbeta2c, gt), gt));
+    _mm256_storeu_ps(M + i, mt);
+    _mm256_storeu_ps(V + i, vt);
+    __m256 denom = _mm256_add_ps(_mm256_sqrt_ps(vt), veps);
+    _mm256_storeu_ps(
+        W + i,
+        _mm256_sub_ps(w, _mm256_div_ps(_mm256_mul_ps(valpha, mt), denom)));
+  }
+#endif
+  for (; i < count; i++) {
+    float gt = WGrad[i] + weight_decay * W[i];
+    float mt = beta1 * M[i] + (1 - beta1) * gt;
+    float vt = beta2 * V[i] + (1 - beta2) * gt * gt;
+    M[i] = mt;
+    V[i] = vt;
+    W[i] -= alpha_t * mt / (sqrt(vt) + epsilon);
+  }
+}
+
+namespace {
+
+// Fill args from the region requirements of a sparse update task: the
+// gradient, the parameter, the row ids and then num_states optimizer states
+void get_sparse_update_args(Task const *task,
+                            std::vector<PhysicalRegion> const &regions,
+                            Context ctx,
+                            Runtime *runtime,
+                            int num_states,
+                            SparseUpdateArgs &args) {
+  assert(regions.size() == task->regions.size());
+  assert((int)regions.size() == 3 + num_states);
+  Domain domain = runtime->get_index_space_domain(
+      ctx, task->regions[1].region.get_index_space());
+  args.v_ptr = NULL;
+  args.m_ptr = NULL;
+  switch (domain.get_dim()) {
+#define DIMFUNC(DIM)                                                           \
+  case DIM: {                                                                  \
+    TensorAccessorW<float, DIM> accWGrad(regions[0],                           \
+                                         task->regions[0],                     \
+                                         FID_DATA,                             \
+                                         ctx,                                  \
+                                         runtime,                              \
+                                         true /*readOutput*/);                 \
+    TensorAccessorW<float, DIM> accW(regions[1],                               \
+                                     task->regions[1],                         \
+                                     FID_DATA,                                 \
+                                     ctx,                                      \
+                                     runtime,                                  \
+                                     true /*readOutput*/);                     \
+    assert(accWGrad.rect.volume() % accW.rect.volume() == 0);                  \
+    args.size = accW.rect.volume();                                            \
+    args.row_size = accW.rect.hi[0] - accW.rect.lo[0] + 1;                     \
+    args.num_replicas = accWGrad.rect.volume() / accW.rect.volume();           \
+    args.w_grad_ptr = accWGrad.ptr;                                            \
+    args.w_ptr = accW.ptr;                                                     \
+    if (num_states > 0) {                                                      \
+      TensorAccessorW<float, DIM> accV(regions[3],                             \
+                                       task->regions[3],                       \
+                                       FID_DATA,                               \
+                                       ctx,                                    \
+                                       runtime,                                \
+                                       true /*readOutput*/);                   \
+      assert(accW.rect == accV.rect);                                          \
+      args.v_ptr = accV.ptr;                                                   \
+    }                                                                          \
+    if (num_states > 1) {                                                      \
+      TensorAccessorW<float, DIM> accM(regions[4],                             \
+                                       task->regions[4],                       \
+                                       FID_DATA,                               \
+                                       ctx,                                    \
+                                       runtime,                                \
+                                       true /*readOutput*/);                   \
+      assert(accW.rect == accM.rect);                                          \
+      args.m_ptr = accM.ptr;                                                   \
+    }                                                                          \
+    break;                                                                     \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default: {
+      // Unsupported dims
+      assert(false);
+    }
+  }
+  // Row ids are the int32 or int64 indices looked up by the owner operator
+  size_t id_size = runtime->get_field_size(
+      ctx, task->regions[2].region.get_field_space(), FID_DATA);
+  args.id_type = id_size == sizeof(int64_t) ? DT_INT64 : DT_INT32;
+  GenericTensorAccessorR row_ids = helperGetGenericTensorAccessorRO(
+      args.id_type, regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  args.row_ids = row_ids.ptr;
+  args.num_ids = row_ids.domain.get_volume();
+}
+
+} // namespace
+
+void Optimizer::sparse_update(const ParallelTensor p,
+                              TaskArgument const &optimizer_arg,
+                              TaskID ps_task_id,
+                              TaskID nccl_task_id,
+                              std::vector<ParallelTensor> const &states) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  assert(p->owner_op != NULL);
+  ParallelTensor rows = p->sparse_grad_rows;
+  assert(rows != nullptr);
+  if (p->sync_type == ParameterSyncType::PS) {
+    TaskLauncher launcher(ps_task_id,
+                          optimizer_arg,
+                          Predicate::TRUE_PRED,
+                          0 /*mapper_id*/,
+                          p->machine_view.hash());
+    // regions[0]: region_grad, whose rows are reset after the update
+    launcher.add_region_requirement(RegionRequirement(
+        p->region_grad, READ_WRITE, EXCLUSIVE, p->region_grad));
+    launcher.add_field(0, FID_DATA);
+    // regions[1]: region
+    launcher.add_region_requirement(
+        RegionRequirement(p->region, READ_WRITE, EXCLUSIVE, p->region));
+    launcher.add_field(1, FID_DATA);
+    // regions[2]: row ids of all replicas
+    launcher.add_region_requirement(
+        RegionRequirement(rows->region, READ_ONLY, EXCLUSIVE, rows->region));
+    launcher.add_field(2, FID_DATA);
+    for (size_t i = 0; i < states.size(); i++) {
+      launcher.add_region_requirement(RegionRequirement(
+          states[i]->region, READ_WRITE, EXCLUSIVE, states[i]->region));
+      launcher.add_field(3 + i, FID_DATA);
+    }
+    runtime->execute_task(ctx, launcher);
+    // Send the parameters back to all worker devices (see
+    // SGDOptimizer::update)
+    ArgumentMap argmap;
+    IndexLauncher index_launcher(PS_PREFETCH_TASK_ID,
+                                 p->parallel_is,
+                                 TaskArgument(NULL, 0),
+                                 argmap,
+                                 Predicate::TRUE_PRED,
+                                 false /*must*/,
+                                 0 /*mapper_id*/,
+                                 p->machine_view.hash());
+    index_launcher.add_region_requirement(RegionRequirement(
+        p->part, 0 /*projection*/, READ_ONLY, EXCLUSIVE, p->region));
+    index_launcher.add_field(0, FID_DATA);
+    runtime->execute_index_space(ctx, index_launcher);
+  } else if (p->sync_type == ParameterSyncType::NCCL) {
+    assert(p->owner_op->op_type != OP_FUSED);
+    assert(p->parallel_is != IndexSpace::NO_SPACE);
+    // Each point task updates its replica from its own row ids; compile()
+    // makes the gradient dense when the ids are partitioned differently
+    ArgumentMap argmap;
+    set_argumentmap_for_sync(model, p, argmap);
+    IndexLauncher launcher(nccl_task_id,
+                           p->parallel_is,
+                           optimizer_arg,
+                           argmap,
+                           Predicate::TRUE_PRED,
+                           false /*must_epoch*/,
+                           0 /*mapper_id*/,
+                           p->machine_view.hash());
+    // regions[0]: region_grad
+    launcher.add_region_requirement(RegionRequirement(p->part_grad,
+                                                      0 /*projection id*/,
+                                                      READ_WRITE,
+                                                      EXCLUSIVE,
+                                                      p->region_grad));
+    launcher.add_field(0, FID_DATA);
+    // regions[1]: region
+    launcher.add_region_requirement(RegionRequirement(
+        p->part, 0 /*projection id*/, READ_WRITE, EXCLUSIVE, p->region));
+    launcher.add_field(1, FID_DATA);
+    // regions[2]: row ids
+    launcher.add_region_requirement(RegionRequirement(
+        rows->part, 0 /*projection id*/, READ_ONLY, EXCLUSIVE, rows->region));
+    launcher.add_field(2, FID_DATA);
+    for (size_t i = 0; i < states.size(); i++) {
+      launcher.add_region_requirement(RegionRequirement(states[i]->part,
+                                                        0 /*projection id*/,
+                                                        READ_WRITE,
+                                                        EXCLUSIVE,
+                                                        states[i]->region));
+      launcher.add_field(3 + i, FID_DATA);
+    }
+    launch_nccl_sync(launcher);
+  } else {
+    assert(false);
+  }
+}
+
 ParallelTensor create_replica_parameter(FFModel const *model,
                                         const ParallelTensor p) {
   Context ctx = model->config.lg_ctx;
@@ -85,12 +512,40 @@ void SGDOptimizer::init(void) {
   delete initializer;
 }
 
+void SGDOptimizer::migrate_state(const ParallelTensor old_p,
+                                 const ParallelTensor new_p) {
+  if (momentum <= 0.0f) {
+    return;
+  }
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  assert(v_values.find(old_p->region) != v_values.end());
+  assert(v_values.find(new_p->region) != v_values.end());
+  model->copy_parallel_tensor(v_values[old_p->region],
+                              v_values[new_p->region]);
+  runtime->destroy_logical_region(ctx, v_values[old_p->region]->region);
+  v_values.erase(old_p->region);
+}
+
 void SGDOptimizer::next(void) {}
 
 void SGDOptimizer::update(const ParallelTensor p) {
   Context ctx = model->config.lg_ctx;
   Runtime *runtime = model->config.lg_hlr;
   assert(p->owner_op != NULL);
+  if (p->sparse_grad_rows != nullptr) {
+    std::vector<ParallelTensor> states;
+    if (momentum > 0.0f) {
+      assert(v_values.find(p->region) != v_values.end());
+      states.push_back(v_values[p->region]);
+    }
+    sparse_update(p,
+                  TaskArgument(this, sizeof(SGDOptimizer)),
+                  SGD_SPARSE_UPD_PS_TASK_ID,
+                  SGD_SPARSE_UPD_NCCL_TASK_ID,
+                  states);
+    return;
+  }
   if (p->sync_type == ParameterSyncType::PS) {
     TaskLauncher launcher(SGD_UPD_PS_TASK_ID,
                           TaskArgument(this, sizeof(SGDOptimizer)),
@@ -187,10 +642,7 @@ void SGDOptimizer::update(const ParallelTensor p) {
     }
     // MustEpochLauncher must_epoch_launcher;
     // must_epoch_launcher.add_index_task(launcher);
-    launcher.concurrent = true;
-    FutureMap fm = runtime->execute_index_space(ctx, launcher);
-    // runtime->execute_must_epoch(ctx, must_epoch_launcher);
-    runtime->issue_execution_fence(ctx);
+    launch_nccl_sync(launcher);
   } else {
     assert(false);
   }
@@ -315,6 +767,197 @@ void SGDOptimizer::nccl_update_task(Task const *task,
 }
 #endif
 
+void SGDOptimizer::multi_tensor_update(std::vector<ParallelTensor> const &ps) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  assert(ps.size() > 0 && ps.size() <= MAX_NUM_MULTI_TENSORS);
+  if (ps[0]->sparse_grad_rows != nullptr) {
+    // Row-sparse gradients are in buckets of their own
+    assert(ps.size() == 1);
+    update(ps[0]);
+    return;
+  }
+  ParallelTensor p0 = ps[0];
+  for (size_t i = 0; i < ps.size(); i++) {
+    assert(ps[i]->owner_op != NULL);
+    assert(ps[i]->sparse_grad_rows == nullptr);
+    assert(ps[i]->sync_type == p0->sync_type);
+    assert(ps[i]->parallel_is == p0->parallel_is);
+    if (momentum > 0.0f) {
+      assert(v_values.find(ps[i]->region) != v_values.end());
+    }
+  }
+  if (p0->sync_type == ParameterSyncType::PS) {
+    TaskLauncher launcher(SGD_MULTI_UPD_PS_TASK_ID,
+                          TaskArgument(this, sizeof(SGDOptimizer)),
+                          Predicate::TRUE_PRED,
+                          0 /*mapper_id*/,
+                          p0->machine_view.hash());
+    int idx = 0;
+    for (size_t i = 0; i < ps.size(); i++) {
+      ParallelTensor p = ps[i];
+      launcher.add_region_requirement(RegionRequirement(
+          p->region_grad, READ_ONLY, EXCLUSIVE, p->region_grad));
+      launcher.add_field(idx++, FID_DATA);
+      launcher.add_region_requirement(
+          RegionRequirement(p->region, READ_WRITE, EXCLUSIVE, p->region));
+      launcher.add_field(idx++, FID_DATA);
+      if (momentum > 0.0f) {
+        launcher.add_region_requirement(
+            RegionRequirement(v_values[p->region]->region,
+                              READ_WRITE,
+                              EXCLUSIVE,
+                              v_values[p->region]->region));
+        launcher.add_field(idx++, FID_DATA);
+      }
+    }
+    runtime->execute_task(ctx, launcher);
+    // Send all updated parameters of the bucket back to the workers
+    ArgumentMap argmap;
+    IndexLauncher index_launcher(PS_PREFETCH_TASK_ID,
+                                 p0->parallel_is,
+                                 TaskArgument(NULL, 0),
+                                 argmap,
+                                 Predicate::TRUE_PRED,
+                                 false /*must*/,
+                                 0 /*mapper_id*/,
+                                 p0->machine_view.hash());
+    for (size_t i = 0; i < ps.size(); i++) {
+      index_launcher.add_region_requirement(RegionRequirement(
+          ps[i]->part, 0 /*projection*/, READ_ONLY, EXCLUSIVE, ps[i]->region));
+      index_launcher.add_field(i, FID_DATA);
+    }
+    runtime->execute_index_space(ctx, index_launcher);
+  } else if (p0->sync_type == ParameterSyncType::NCCL) {
+    assert(p0->parallel_is != IndexSpace::NO_SPACE);
+    ArgumentMap argmap;
+    set_argumentmap_for_sync(model, p0, argmap);
+    IndexLauncher launcher(SGD_MULTI_UPD_NCCL_TASK_ID,
+                           p0->parallel_is,
+                           TaskArgument(this, sizeof(SGDOptimizer)),
+                           argmap,
+                           Predicate::TRUE_PRED,
+                           false /*must_epoch*/,
+                           0 /*mapper_id*/,
+                           p0->machine_view.hash());
+    int idx = 0;
+    for (size_t i = 0; i < ps.size(); i++) {
+      ParallelTensor p = ps[i];
+      // See SGDOptimizer::update
+      assert(p->owner_op->op_type != OP_FUSED);
+      launcher.add_region_requirement(RegionRequirement(p->part_grad,
+                                                        0 /*projection id*/,
+                                                        READ_ONLY,
+                                                        EXCLUSIVE,
+                                                        p->region_grad));
+      launcher.add_field(idx++, FID_DATA);
+      launcher.add_region_requirement(RegionRequirement(
+          p->part, 0 /*projection id*/, READ_WRITE, EXCLUSIVE, p->region));
+      launcher.add_field(idx++, FID_DATA);
+      if (momentum > 0.0f) {
+        launcher.add_region_requirement(
+            RegionRequirement(v_values[p->region]->part,
+                              0 /*projection id*/,
+                              READ_WRITE,
+                              EXCLUSIVE,
+                              v_values[p->region]->region));
+        launcher.add_field(idx++, FID_DATA);
+      }
+    }
+    launch_nccl_sync(launcher);
+  } else {
+    assert(false);
+  }
+}
+
+void SGDOptimizer::ps_multi_tensor_update_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  SGDOptimizer const *op = (SGDOptimizer *)task->args;
+  MultiTensorUpdateArgs args;
+  get_multi_tensor_args(
+      task, regions, ctx, runtime, op->momentum > 0.0f ? 3 : 2, args);
+  multi_tensor_update_task_gpu(op, args);
+}
+
+void SGDOptimizer::ps_multi_tensor_update_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  SGDOptimizer const *op = (SGDOptimizer *)task->args;
+  MultiTensorUpdateArgs args;
+  get_multi_tensor_args(
+      task, regions, ctx, runtime, op->momentum > 0.0f ? 3 : 2, args);
+  multi_tensor_update_task_cpu(op, args);
+}
+
+void SGDOptimizer::multi_tensor_update_task_cpu(
+    SGDOptimizer const *op, MultiTensorUpdateArgs const &args) {
+  for (int t = 0; t < args.num_tensors; t++) {
+    // Step 1: Gather gradients in the first replica
+    float *w_grad_ptr = (float *)args.w_grad_ptrs[t];
+    gather_replicas_cpu(w_grad_ptr, args.sizes[t], args.num_replicas[t]);
+    // Step 2: SGD update
+    sgd_update_cpu(args.sizes[t],
+                   op->lr,
+                   op->weight_decay,
+                   op->momentum,
+                   op->nesterov,
+                   w_grad_ptr,
+                   args.v_ptrs[t],
+                   args.w_ptrs[t]);
+  }
+}
+
+#ifdef FF_USE_NCCL
+void SGDOptimizer::nccl_multi_tensor_update_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  SGDOptimizer const *op = (SGDOptimizer *)task->args;
+  OpMeta const *meta = *((OpMeta **)task->local_args);
+  MultiTensorUpdateArgs args;
+  get_multi_tensor_args(
+      task, regions, ctx, runtime, op->momentum > 0.0f ? 3 : 2, args);
+  for (int t = 0; t < args.num_tensors; t++) {
+    assert(args.num_replicas[t] == 1);
+  }
+  nccl_multi_tensor_update_task_gpu(op, meta, args);
+}
+#endif
+
+void SGDOptimizer::ps_sparse_update_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  SGDOptimizer const *op = (SGDOptimizer *)task->args;
+  SparseUpdateArgs args;
+  get_sparse_update_args(
+      task, regions, ctx, runtime, op->momentum > 0.0f ? 1 : 0, args);
+  ps_sparse_update_task_gpu(op, args);
+}
+
+#ifdef FF_USE_NCCL
+void SGDOptimizer::nccl_sparse_update_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  SGDOptimizer const *op = (SGDOptimizer *)task->args;
+  OpMeta const *meta = *((OpMeta **)task->local_args);
+  SparseUpdateArgs args;
+  get_sparse_update_args(
+      task, regions, ctx, runtime, op->momentum > 0.0f ? 1 : 0, args);
+  assert(args.num_replicas == 1);
+  nccl_sparse_update_task_gpu(op, meta, args);
+}
+#endif
+
 // ------------------------------------------------------------------
 //                        Adam Optimizer
 // ------------------------------------------------------------------
@@ -364,6 +1007,24 @@ void AdamOptimizer::init(void) {
   delete initializer;
 }
 
+void AdamOptimizer::migrate_state(const ParallelTensor old_p,
+                                  const ParallelTensor new_p) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  assert(v_values.find(old_p->region) != v_values.end());
+  assert(m_values.find(old_p->region) != m_values.end());
+  assert(v_values.find(new_p->region) != v_values.end());
+  assert(m_values.find(new_p->region) != m_values.end());
+  model->copy_parallel_tensor(v_values[old_p->region],
+                              v_values[new_p->region]);
+  model->copy_parallel_tensor(m_values[old_p->region],
+                              m_values[new_p->region]);
+  runtime->destroy_logical_region(ctx, v_values[old_p->region]->region);
+  runtime->destroy_logical_region(ctx, m_values[old_p->region]->region);
+  v_values.erase(old_p->region);
+  m_values.erase(old_p->region);
+}
+
 void AdamOptimizer::set_weight_decay(double _weight_decay) {
   weight_decay = _weight_decay;
 }
@@ -381,6 +1042,14 @@ void AdamOptimizer::update(const ParallelTensor p) {
   assert(v_values.find(p->region) != v_values.end());
   assert(m_values.find(p->region) != m_values.end());
   assert(p->owner_op != NULL);
+  if (p->sparse_grad_rows != nullptr) {
+    sparse_update(p,
+                  TaskArgument(this, sizeof(AdamOptimizer)),
+                  ADAM_SPARSE_UPD_PS_TASK_ID,
+                  ADAM_SPARSE_UPD_NCCL_TASK_ID,
+                  {v_values[p->region], m_values[p->region]});
+    return;
+  }
   if (p->sync_type == ParameterSyncType::PS) {
     TaskLauncher launcher(ADAM_UPD_PS_TASK_ID,
                           TaskArgument(this, sizeof(AdamOptimizer)),
@@ -483,15 +1152,183 @@ void AdamOptimizer::update(const ParallelTensor p) {
     launcher.add_field(3, FID_DATA);
     // MustEpochLauncher must_epoch_launcher;
     // must_epoch_launcher.add_index_task(launcher);
-    launcher.concurrent = true;
-    FutureMap fm = runtime->execute_index_space(ctx, launcher);
-    // runtime->execute_must_epoch(ctx, must_epoch_launcher);
-    runtime->issue_execution_fence(ctx);
+    launch_nccl_sync(launcher);
   } else {
     assert(false);
   }
 }
 
+void AdamOptimizer::multi_tensor_update(
+    std::vector<ParallelTensor> const &ps) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  assert(ps.size() > 0 && ps.size() <= MAX_NUM_MULTI_TENSORS);
+  if (ps[0]->sparse_grad_rows != nullptr) {
+    // Row-sparse gradients are in buckets of their own
+    assert(ps.size() == 1);
+    update(ps[0]);
+    return;
+  }
+  ParallelTensor p0 = ps[0];
+  for (size_t i = 0; i < ps.size(); i++) {
+    assert(ps[i]->owner_op != NULL);
+    assert(ps[i]->sparse_grad_rows == nullptr);
+    assert(ps[i]->sync_type == p0->sync_type);
+    assert(ps[i]->parallel_is == p0->parallel_is);
+    assert(v_values.find(ps[i]->region) != v_values.end());
+    assert(m_values.find(ps[i]->region) != m_values.end());
+  }
+  if (p0->sync_type == ParameterSyncType::PS) {
+    TaskLauncher launcher(ADAM_MULTI_UPD_PS_TASK_ID,
+                          TaskArgument(this, sizeof(AdamOptimizer)),
+                          Predicate::TRUE_PRED,
+                          0 /*mapper_id*/,
+                          p0->machine_view.hash());
+    int idx = 0;
+    for (size_t i = 0; i < ps.size(); i++) {
+      ParallelTensor p = ps[i];
+      launcher.add_region_requirement(RegionRequirement(
+          p->region_grad, READ_ONLY, EXCLUSIVE, p->region_grad));
+      launcher.add_field(idx++, FID_DATA);
+      launcher.add_region_requirement(
+          RegionRequirement(p->region, READ_WRITE, EXCLUSIVE, p->region));
+      launcher.add_field(idx++, FID_DATA);
+      launcher.add_region_requirement(
+          RegionRequirement(v_values[p->region]->region,
+                            READ_WRITE,
+                            EXCLUSIVE,
+                            v_values[p->region]->region));
+      launcher.add_field(idx++, FID_DATA);
+      launcher.add_region_requirement(
+          RegionRequirement(m_values[p->region]->region,
+                            READ_WRITE,
+                            EXCLUSIVE,
+                            m_values[p->region]->region));
+      launcher.add_field(idx++, FID_DATA);
+    }
+    runtime->execute_task(ctx, launcher);
+    // Send all updated parameters of the bucket back to the workers
+    ArgumentMap argmap;
+    IndexLauncher index_launcher(PS_PREFETCH_TASK_ID,
+                                 p0->parallel_is,
+                                 TaskArgument(NULL, 0),
+                                 argmap,
+                                 Predicate::TRUE_PRED,
+                                 false /*must*/,
+                                 0 /*mapper_id*/,
+                                 p0->machine_view.hash());
+    for (size_t i = 0; i < ps.size(); i++) {
+      index_launcher.add_region_requirement(RegionRequirement(
+          ps[i]->part, 0 /*projection*/, READ_ONLY, EXCLUSIVE, ps[i]->region));
+      index_launcher.add_field(i, FID_DATA);
+    }
+    runtime->execute_index_space(ctx, index_launcher);
+  } else if (p0->sync_type == ParameterSyncType::NCCL) {
+    assert(p0->parallel_is != IndexSpace::NO_SPACE);
+    ArgumentMap argmap;
+    set_argumentmap_for_sync(model, p0, argmap);
+    IndexLauncher launcher(ADAM_MULTI_UPD_NCCL_TASK_ID,
+                           p0->parallel_is,
+                           TaskArgument(this, sizeof(AdamOptimizer)),
+                           argmap,
+                           Predicate::TRUE_PRED,
+                           false /*must_epoch*/,
+                           0 /*mapper_id*/,
+                           p0->machine_view.hash());
+    int idx = 0;
+    for (size_t i = 0; i < ps.size(); i++) {
+      ParallelTensor p = ps[i];
+      // See AdamOptimizer::update
+      assert(p->owner_op->op_type != OP_FUSED);
+      launcher.add_region_requirement(RegionRequirement(p->part_grad,
+                                                        0 /*projection id*/,
+                                                        READ_ONLY,
+                                                        EXCLUSIVE,
+                                                        p->region_grad));
+      launcher.add_field(idx++, FID_DATA);
+      launcher.add_region_requirement(RegionRequirement(
+          p->part, 0 /*projection id*/, READ_WRITE, EXCLUSIVE, p->region));
+      launcher.add_field(idx++, FID_DATA);
+      launcher.add_region_requirement(
+          RegionRequirement(v_values[p->region]->part,
+                            0 /*projection id*/,
+                            READ_WRITE,
+                            EXCLUSIVE,
+                            v_values[p->region]->region));
+      launcher.add_field(idx++, FID_DATA);
+      launcher.add_region_requirement(
+          RegionRequirement(m_values[p->region]->part,
+                            0 /*projection id*/,
+                            READ_WRITE,
+                            EXCLUSIVE,
+                            m_values[p->region]->region));
+      launcher.add_field(idx++, FID_DATA);
+    }
+    launch_nccl_sync(launcher);
+  } else {
+    assert(false);
+  }
+}
+
+void AdamOptimizer::ps_multi_tensor_update_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  AdamOptimizer const *op = (AdamOptimizer *)task->args;
+  MultiTensorUpdateArgs args;
+  get_multi_tensor_args(task, regions, ctx, runtime, 4, args);
+  multi_tensor_update_task_gpu(op, args);
+}
+
+void AdamOptimizer::ps_multi_tensor_update_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  AdamOptimizer const *op = (AdamOptimizer *)task->args;
+  MultiTensorUpdateArgs args;
+  get_multi_tensor_args(task, regions, ctx, runtime, 4, args);
+  multi_tensor_update_task_cpu(op, args);
+}
+
+void AdamOptimizer::multi_tensor_update_task_cpu(
+    AdamOptimizer const *op, MultiTensorUpdateArgs const &args) {
+  for (int t = 0; t < args.num_tensors; t++) {
+    // Step 1: Gather gradients in the first replica
+    float *w_grad_ptr = (float *)args.w_grad_ptrs[t];
+    gather_replicas_cpu(w_grad_ptr, args.sizes[t], args.num_replicas[t]);
+    // Step 2: Adam update
+    adam_update_cpu(args.sizes[t],
+                    op->alpha_t,
+                    op->beta1,
+                    op->beta2,
+                    op->weight_decay,
+                    op->epsilon,
+                    w_grad_ptr,
+                    args.m_ptrs[t],
+                    args.v_ptrs[t],
+                    args.w_ptrs[t]);
+  }
+}
+
+#ifdef FF_USE_NCCL
+void AdamOptimizer::nccl_multi_tensor_update_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  AdamOptimizer const *op = (AdamOptimizer *)task->args;
+  OpMeta const *meta = *((OpMeta **)task->local_args);
+  MultiTensorUpdateArgs args;
+  get_multi_tensor_args(task, regions, ctx, runtime, 4, args);
+  for (int t = 0; t < args.num_tensors; t++) {
+    assert(args.num_replicas[t] == 1);
+  }
+  nccl_multi_tensor_update_task_gpu(op, meta, args);
+}
+#endif
+
 void AdamOptimizer::ps_update_task(Task const *task,
                                    std::vector<PhysicalRegion> const &regions,
                                    Context ctx,
@@ -607,4 +1444,30 @@ void AdamOptimizer::nccl_update_task(Task const *task,
 }
 #endif
 
+void AdamOptimizer::ps_sparse_update_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  AdamOptimizer const *op = (AdamOptimizer *)task->args;
+  SparseUpdateArgs args;
+  get_sparse_update_args(task, regions, ctx, runtime, 2, args);
+  ps_sparse_update_task_gpu(op, args);
+}
+
+#ifdef FF_USE_NCCL
+void AdamOptimizer::nccl_sparse_update_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  AdamOptimizer const *op = (AdamOptimizer *)task->args;
+  OpMeta const *meta = *((OpMeta **)task->local_args);
+  SparseUpdateArgs args;
+  get_sparse_update_args(task, regions, ctx, runtime, 2, args);
+  assert(args.num_replicas == 1);
+  nccl_sparse_update_task_gpu(op, meta, args);
+}
+#endif
+
 }; // namespace FlexFlow
@@ -218,4 +218,549 @@ __host__ void AdamOptimizer::nccl_update_task_gpu(AdamOptimizer const *op,
 }
 #endif
 
+// ==================================================================
+//                     Multi-tensor Updates
+// ==================================================================
+// blockIdx.y selects the parameter of the bucket; the x dimension of the grid
+// is sized for the largest parameter and loops over the local elements.
+// Gradients of replicas (PS) are summed on the fly, which fuses the gather
+// and the update into a single pass over memory.
+__global__ void multi_tensor_sgd_update(MultiTensorUpdateArgs args,
+                                        float lr,
+                                        float weight_decay,
+                                        float momentum,
+                                        bool nesterov) {
+  int t = blockIdx.y;
+  size_t count = args.sizes[t];
+  float const *WGrad = args.w_grad_ptrs[t];
+  float *V = args.v_ptrs[t];
+  float *W = args.w_ptrs[t];
+  for (size_t i = blockIdx.x * blockDim.x + threadIdx.x; i < count;
+       i += blockDim.x * gridDim.x) {
+    float gt = WGrad[i];
+    for (int r = 1; r < args.num_replicas[t]; r++) {
+      gt += WGrad[r * count + i];
+    }
+    gt += weight_decay * W[i];
+    if (momentum > 0.0f) {
+      V[i] = V[i] * momentum + gt;
+      if (nesterov) {
+        gt = gt + momentum * V[i];
+      } else {
+        gt = V[i];
+      }
+    }
+    W[i] -= lr * gt;
+  }
+}
+
+__global__ void multi_tensor_adam_update(MultiTensorUpdateArgs args,
+                                         float alpha_t,
+                                         float beta1,
+                                         float beta2,
+                                         float weight_decay,
+                                         float epsilon) {
+  int t = blockIdx.y;
+  size_t count = args.sizes[t];
+  float const *WGrad = args.w_grad_ptrs[t];
+  float *M = args.m_ptrs[t];
+  float *V = args.v_ptrs[t];
+  float *W = args.w_ptrs[t];
+  for (size_t i = blockIdx.x * blockDim.x + threadIdx.x; i < count;
+       i += blockDim.x * gridDim.x) {
+    float gt = WGrad[i];
+    for (int r = 1; r < args.num_replicas[t]; r++) {
+      gt += WGrad[r * count + i];
+    }
+    gt += weight_decay * W[i];
+    float mt = beta1 * M[i] + (1 - beta1) * gt;
+    float vt = beta2 * V[i] + (1 - beta2) * gt * gt;
+    M[i] = mt;
+    V[i] = vt;
+    W[i] -= alpha_t * mt / (sqrt(vt) + epsilon);
+  }
+}
+
+static dim3 get_multi_tensor_grid(MultiTensorUpdateArgs const &args) {
+  size_t max_size = 0;
+  for (int t = 0; t < args.num_tensors; t++) {
+    max_size = std::max(max_size, args.sizes[t]);
+  }
+  return dim3(GET_BLOCKS(max_size), args.num_tensors);
+}
+
+#ifdef FF_USE_NCCL
+// Issue the all-reduces of all gradients in the bucket as one NCCL group
+static void multi_tensor_all_reduce(OpMeta const *meta,
+                                    MultiTensorUpdateArgs const &args,
+                                    cudaStream_t stream) {
+  checkNCCL(ncclGroupStart());
+  for (int t = 0; t < args.num_tensors; t++) {
+    checkNCCL(ncclAllReduce(args.w_grad_ptrs[t],
+                            (float *)args.w_grad_ptrs[t],
+                            args.sizes[t],
+                            ncclFloat,
+                            ncclSum,
+                            meta->handle.ncclComm,
+                            stream));
+  }
+  checkNCCL(ncclGroupEnd());
+}
+#endif
+
+__host__ void SGDOptimizer::multi_tensor_update_task_gpu(
+    SGDOptimizer const *op, MultiTensorUpdateArgs const &args) {
+  cudaStream_t stream;
+  checkCUDA(get_legion_stream(&stream));
+  dim3 grid = get_multi_tensor_grid(args);
+  multi_tensor_sgd_update<<<grid, CUDA_NUM_THREADS, 0, stream>>>(
+      args,
+      op->lr,
+      op->weight_decay,
+      op->momentum,
+      op->nesterov);
+}
+
+#ifdef FF_USE_NCCL
+__host__ void SGDOptimizer::nccl_multi_tensor_update_task_gpu(
+    SGDOptimizer const *op,
+    OpMeta const *meta,
+    MultiTensorUpdateArgs const &args) {
+  cudaStream_t stream;
+  checkCUDA(get_legion_stream(&stream));
+  multi_tensor_all_reduce(meta, args, stream);
+  multi_tensor_update_task_gpu(op, args);
+}
+#endif
+
+__host__ void AdamOptimizer::multi_tensor_update_task_gpu(
+    AdamOptimizer const *op, MultiTensorUpdateArgs const &args) {
+  cudaStream_t stream;
+  checkCUDA(get_legion_stream(&stream));
+  dim3 grid = get_multi_tensor_grid(args);
+  multi_tensor_adam_update<<<grid, CUDA_NUM_THREADS, 0, stream>>>(
+      args,
+      op->alpha_t,
+      op->beta1,
+      op->beta2,
+      op->weight_decay,
+      op->epsilon);
+}
+
+#ifdef FF_USE_NCCL
+__host__ void AdamOptimizer::nccl_multi_tensor_update_task_gpu(
+    AdamOptimizer const *op,
+    OpMeta const *meta,
+    MultiTensorUpdateArgs const &args) {
+  cudaStream_t stream;
+  checkCUDA(get_legion_stream(&stream));
+  multi_tensor_all_reduce(meta, args, stream);
+  multi_tensor_update_task_gpu(op, args);
+}
+#endif
+
+// ==================================================================
+//                     Row-sparse Updates
+// ==================================================================
+// The row ids of a row-sparse gradient may contain repeats. Each distinct
+// row is owned by its first occurrence, found through an open-addressing
+// hash set, so that it is updated exactly once. Ownership only depends on
+// the order of the ids, so all ranks that see the same ids agree on it.
+struct RowOwnerTable {
+  size_t size;
+  int64_t *keys;
+  int *owners;
+};
+
+static constexpr unsigned long long EMPTY_ROW = ~0ULL;
+
+template <typename T>
+static T *alloc_scratch(size_t count) {
+  // Freed by Legion when the task completes
+  Legion::Rect<1> bounds(Legion::Point<1>(0),
+                         Legion::Point<1>(std::max(count, (size_t)1) - 1));
+  Legion::DeferredBuffer<T, 1> buffer(bounds, Legion::Memory::GPU_FB_MEM);
+  return buffer.ptr(0);
+}
+
+__device__ size_t row_slot(int64_t row, size_t table_size) {
+  // Finalizer of MurmurHash3
+  unsigned long long h = (unsigned long long)row;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h & (table_size - 1);
+}
+
+template <typename TI>
+__global__ void copy_row_ids(size_t num_ids, TI const *src, int64_t *dst) {
+  CUDA_KERNEL_LOOP(i, num_ids) {
+    dst[i] = src[i];
+  }
+}
+
+__global__ void
+    insert_row_ids(RowOwnerTable table, size_t num_ids, int64_t const *rows) {
+  CUDA_KERNEL_LOOP(k, num_ids) {
+    unsigned long long row = (unsigned long long)rows[k];
+    size_t slot = row_slot(rows[k], table.size);
+    while (true) {
+      unsigned long long prev = atomicCAS(
+          (unsigned long long *)(table.keys + slot), EMPTY_ROW, row);
+      if (prev == EMPTY_ROW || prev == row) {
+        atomicMin(table.owners + slot, (int)k);
+        break;
+      }
+      slot = (slot + 1) & (table.size - 1);
+    }
+  }
+}
+
+__device__ bool
+    is_row_owner(RowOwnerTable const &table, int64_t row, Legion::coord_t k) {
+  size_t slot = row_slot(row, table.size);
+  while (table.keys[slot] != row) {
+    slot = (slot + 1) & (table.size - 1);
+  }
+  return table.owners[slot] == k;
+}
+
+// Convert the row ids to int64 in scratch memory
+static int64_t *get_row_ids(SparseUpdateArgs const &args,
+                            cudaStream_t stream) {
+  int64_t *rows = alloc_scratch<int64_t>(args.num_ids);
+  if (args.id_type == DT_INT64) {
+    copy_row_ids<<<GET_BLOCKS(args.num_ids), CUDA_NUM_THREADS, 0, stream>>>(
+        args.num_ids, (int64_t const *)args.row_ids, rows);
+  } else {
+    assert(args.id_type == DT_INT32);
+    copy_row_ids<<<GET_BLOCKS(args.num_ids), CUDA_NUM_THREADS, 0, stream>>>(
+        args.num_ids, (int32_t const *)args.row_ids, rows);
+  }
+  return rows;
+}
+
+static RowOwnerTable build_row_owner_table(size_t num_ids,
+                                           int64_t const *rows,
+                                           cudaStream_t stream) {
+  RowOwnerTable table;
+  // Keep the load factor at or below 0.5
+  table.size = 1;
+  while (table.size < 2 * num_ids) {
+    table.size *= 2;
+  }
+  table.keys = alloc_scratch<int64_t>(table.size);
+  table.owners = alloc_scratch<int>(table.size);
+  assign_kernel<int64_t>
+      <<<GET_BLOCKS(table.size), CUDA_NUM_THREADS, 0, stream>>>(
+          table.keys, table.size, (int64_t)EMPTY_ROW);
+  assign_kernel<int32_t>
+      <<<GET_BLOCKS(table.size), CUDA_NUM_THREADS, 0, stream>>>(
+          table.owners, table.size, INT_MAX);
+  insert_row_ids<<<GET_BLOCKS(num_ids), CUDA_NUM_THREADS, 0, stream>>>(
+      table, num_ids, rows);
+  return table;
+}
+
+// The gradient of the k-th row id is either the sum over the replicas of
+// its row (compact == false) or the k-th row of a compact buffer
+__device__ float sparse_grad(float const *WGrad,
+                             size_t replica_size,
+                             int num_replicas,
+                             bool compact,
+                             int64_t row,
+                             int row_size,
+                             Legion::coord_t k,
+                             int c) {
+  size_t offset = compact ? k * row_size + c : row * row_size + c;
+  float gt = 0.0f;
+  for (int r = 0; r < num_replicas; r++) {
+    gt += WGrad[r * replica_size + offset];
+  }
+  return gt;
+}
+
+__global__ void sparse_sgd_update(RowOwnerTable table,
+                                  size_t num_ids,
+                                  int64_t const *rows,
+                                  int row_size,
+                                  float const *WGrad,
+                                  size_t replica_size,
+                                  int num_replicas,
+                                  bool compact,
+                                  float lr,
+                                  float weight_decay,
+                                  float momentum,
+                                  bool nesterov,
+                                  float *V,
+                                  float *W) {
+  CUDA_KERNEL_LOOP(i, num_ids * row_size) {
+    Legion::coord_t k = i / row_size;
+    int c = i % row_size;
+    int64_t row = rows[k];
+    if (!is_row_owner(table, row, k)) {
+      continue;
+    }
+    size_t j = row * row_size + c;
+    float gt = sparse_grad(
+        WGrad, replica_size, num_replicas, compact, row, row_size, k, c);
+    gt += weight_decay * W[j];
+    if (momentum > 0.0f) {
+      V[j] = V[j] * momentum + gt;
+      if (nesterov) {
+        gt = gt + momentum * V[j];
+      } else {
+        gt = V[j];
+      }
+    }
+    W[j] -= lr * gt;
+  }
+}
+
+__global__ void sparse_adam_update(RowOwnerTable table,
+                                   size_t num_ids,
+                                   int64_t const *rows,
+                                   int row_size,
+                                   float const *WGrad,
+                                   size_t replica_size,
+                                   int num_replicas,
+                                   bool compact,
+                                   float alpha_t,
+                                   float beta1,
+                                   float beta2,
+                                   float weight_decay,
+                                   float epsilon,
+                                   float *M,
+                                   float *V,
+                                   float *W) {
+  CUDA_KERNEL_LOOP(i, num_ids * row_size) {
+    Legion::coord_t k = i / row_size;
+    int c = i % row_size;
+    int64_t row = rows[k];
+    if (!is_row_owner(table, row, k)) {
+      continue;
+    }
+    size_t j = row * row_size + c;
+    float gt = sparse_grad(
+        WGrad, replica_size, num_replicas, compact, row, row_size, k, c);
+    gt += weight_decay * W[j];
+    float mt = beta1 * M[j] + (1 - beta1) * gt;
+    float vt = beta2 * V[j] + (1 - beta2) * gt * gt;
+    M[j] = mt;
+    V[j] = vt;
+    W[j] -= alpha_t * mt / (sqrt(vt) + epsilon);
+  }
+}
+
+// Restore the invariant that all rows not listed in rows are zero
+__global__ void zero_grad_rows(size_t num_ids,
+                               int64_t const *rows,
+                               int row_size,
+                               size_t replica_size,
+                               int num_replicas,
+                               float *WGrad) {
+  CUDA_KERNEL_LOOP(i, num_ids * row_size) {
+    size_t j = rows[i / row_size] * row_size + i % row_size;
+    for (int r = 0; r < num_replicas; r++) {
+      WGrad[r * replica_size + j] = 0.0f;
+    }
+  }
+}
+
+#ifdef FF_USE_NCCL
+// Copy the local gradient of each owned row id into a compact buffer
+__global__ void pack_grad_rows(RowOwnerTable table,
+                               size_t num_ids,
+                               int64_t const *rows,
+                               int row_size,
+                               float const *WGrad,
+                               float *packed) {
+  CUDA_KERNEL_LOOP(i, num_ids * row_size) {
+    Legion::coord_t k = i / row_size;
+    int64_t row = rows[k];
+    packed[i] = is_row_owner(table, row, k)
+                    ? WGrad[row * row_size + i % row_size]
+                    : 0.0f;
+  }
+}
+
+// Exchange the row ids of all ranks and sum their gradient rows into a
+// compact buffer, so that the communication volume is proportional to the
+// global number of row ids rather than to the number of rows. All ranks
+// must have the same number of row ids
+struct SparseAllReduce {
+  size_t num_ids;
+  int64_t const *rows;
+  RowOwnerTable table;
+  float const *packed;
+};
+
+static SparseAllReduce sparse_all_reduce(OpMeta const *meta,
+                                         SparseUpdateArgs const &args,
+                                         int64_t const *local_rows,
+                                         cudaStream_t stream) {
+  int num_ranks;
+  checkNCCL(ncclCommCount(meta->handle.ncclComm, &num_ranks));
+  SparseAllReduce result;
+  result.num_ids = args.num_ids * num_ranks;
+  int64_t *rows = alloc_scratch<int64_t>(result.num_ids);
+  checkNCCL(ncclAllGather(local_rows,
+                          rows,
+                          args.num_ids,
+                          ncclInt64,
+                          meta->handle.ncclComm,
+                          stream));
+  result.rows = rows;
+  result.table = build_row_owner_table(result.num_ids, rows, stream);
+  size_t packed_size = result.num_ids * args.row_size;
+  float *packed = alloc_scratch<float>(packed_size);
+  pack_grad_rows<<<GET_BLOCKS(packed_size), CUDA_NUM_THREADS, 0, stream>>>(
+      result.table,
+      result.num_ids,
+      rows,
+      args.row_size,
+      args.w_grad_ptr,
+      packed);
+  checkNCCL(ncclAllReduce(packed,
+                          packed,
+                          packed_size,
+                          ncclFloat,
+                          ncclSum,
+                          meta->handle.ncclComm,
+                          stream));
+  result.packed = packed;
+  return result;
+}
+#endif
+
+__host__ void SGDOptimizer::ps_sparse_update_task_gpu(
+    SGDOptimizer const *op, SparseUpdateArgs const &args) {
+  cudaStream_t stream;
+  checkCUDA(get_legion_stream(&stream));
+  int64_t *rows = get_row_ids(args, stream);
+  RowOwnerTable table = build_row_owner_table(args.num_ids, rows, stream);
+  size_t count = args.num_ids * args.row_size;
+  // Gather the replicas of each row and update it in a single pass
+  sparse_sgd_update<<<GET_BLOCKS(count), CUDA_NUM_THREADS, 0, stream>>>(
+      table,
+      args.num_ids,
+      rows,
+      args.row_size,
+      args.w_grad_ptr,
+      args.size,
+      args.num_replicas,
+      false /*compact*/,
+      op->lr,
+      op->weight_decay,
+      op->momentum,
+      op->nesterov,
+      args.v_ptr,
+      args.w_ptr);
+  zero_grad_rows<<<GET_BLOCKS(count), CUDA_NUM_THREADS, 0, stream>>>(
+      args.num_ids,
+      rows,
+      args.row_size,
+      args.size,
+      args.num_replicas,
+      args.w_grad_ptr);
+}
+
+#ifdef FF_USE_NCCL
+__host__ void
+    SGDOptimizer::nccl_sparse_update_task_gpu(SGDOptimizer const *op,
+                                              OpMeta const *meta,
+                                              SparseUpdateArgs const &args) {
+  cudaStream_t stream;
+  checkCUDA(get_legion_stream(&stream));
+  int64_t *local_rows = get_row_ids(args, stream);
+  SparseAllReduce reduced = sparse_all_reduce(meta, args, local_rows, stream);
+  size_t count = reduced.num_ids * args.row_size;
+  sparse_sgd_update<<<GET_BLOCKS(count), CUDA_NUM_THREADS, 0, stream>>>(
+      reduced.table,
+      reduced.num_ids,
+      reduced.rows,
+      args.row_size,
+      reduced.packed,
+      0 /*replica_size*/,
+      1 /*num_replicas*/,
+      true /*compact*/,
+      op->lr,
+      op->weight_decay,
+      op->momentum,
+      op->nesterov,
+      args.v_ptr,
+      args.w_ptr);
+  size_t local_count = args.num_ids * args.row_size;
+  zero_grad_rows<<<GET_BLOCKS(local_count), CUDA_NUM_THREADS, 0, stream>>>(
+      args.num_ids, local_rows, args.row_size, args.size, 1, args.w_grad_ptr);
+}
+#endif
+
+__host__ void AdamOptimizer::ps_sparse_update_task_gpu(
+    AdamOptimizer const *op, SparseUpdateArgs const &args) {
+  cudaStream_t stream;
+  checkCUDA(get_legion_stream(&stream));
+  int64_t *rows = get_row_ids(args, stream);
+  RowOwnerTable table = build_row_owner_table(args.num_ids, rows, stream);
+  size_t count = args.num_ids * args.row_size;
+  // Gather the replicas of each row and update it in a single pass
+  sparse_adam_update<<<GET_BLOCKS(count), CUDA_NUM_THREADS, 0, stream>>>(
+      table,
+      args.num_ids,
+      rows,
+      args.row_size,
+      args.w_grad_ptr,
+      args.size,
+      args.num_replicas,
+      false /*compact*/,
+      op->alpha_t,
+      op->beta1,
+      op->beta2,
+      op->weight_decay,
+      op->epsilon,
+      args.m_ptr,
+      args.v_ptr,
+      args.w_ptr);
+  zero_grad_rows<<<GET_BLOCKS(count), CUDA_NUM_THREADS, 0, stream>>>(
+      args.num_ids,
+      rows,
+      args.row_size,
+      args.size,
+      args.num_replicas,
+      args.w_grad_ptr);
+}
+
+#ifdef FF_USE_NCCL
+__host__ void
+    AdamOptimizer::nccl_sparse_update_task_gpu(AdamOptimizer const *op,
+                                               OpMeta const *meta,
+                                               SparseUpdateArgs const &args) {
+  cudaStream_t stream;
+  checkCUDA(get_legion_stream(&stream));
+  int64_t *local_rows = get_row_ids(args, stream);
+  SparseAllReduce reduced = sparse_all_reduce(meta, args, local_rows, stream);
+  size_t count = reduced.num_ids * args.row_size;
+  sparse_adam_update<<<GET_BLOCKS(count), CUDA_NUM_THREADS, 0, stream>>>(
+      reduced.table,
+      reduced.num_ids,
+      reduced.rows,
+      args.row_size,
+      reduced.packed,
+      0 /*replica_size*/,
+      1 /*num_replicas*/,
+      true /*compact*/,
+      op->alpha_t,
+      op->beta1,
+      op->beta2,
+      op->weight_decay,
+      op->epsilon,
+      args.m_ptr,
+      args.v_ptr,
+      args.w_ptr);
+  size_t local_count = args.num_ids * args.row_size;
+  zero_grad_rows<<<GET_BLOCKS(local_count), CUDA_NUM_THREADS, 0, stream>>>(
+      args.num_ids, local_rows, args.row_size, args.size, 1, args.w_grad_ptr);
+}
+#endif
+
 }; // namespace FlexFlow
@@ -206,6 +206,7 @@ ParallelTensorBase::ParallelTensorBase(ParallelTensorBase const &rhs) {
   sync_type = rhs.sync_type;
   initializer = rhs.initializer;
   create_gradients = rhs.create_gradients;
+  sparse_grad_rows = rhs.sparse_grad_rows;
 }
 
 void ParallelTensorBase::inline_map(FFConfig &config) {
@@ -646,6 +647,74 @@ bool ParallelTensorBase::is_valid_machine_view(MachineView const &view) const {
   return true;
 }
 
+// Attach a dense host buffer, laid out like an inline mapping of lr, as an
+// external instance of lr
+static PhysicalRegion attach_host_buffer(Context ctx,
+                                         Runtime *runtime,
+                                         LogicalRegion lr,
+                                         LogicalRegion parent,
+                                         void const *ptr) {
+  AttachLauncher launcher(
+      EXTERNAL_INSTANCE, lr, parent, false /*restricted*/, false /*mapped*/);
+  std::vector<FieldID> fields(1, FID_DATA);
+  const Memory local_sysmem =
+      Machine::MemoryQuery(Machine::get_machine())
+          .has_affinity_to(runtime->get_executing_processor(ctx))
+          .only_kind(Memory::SYSTEM_MEM)
+          .first();
+  launcher.attach_array_soa(
+      const_cast<void *>(ptr), true /*column_major*/, fields, local_sysmem);
+  return runtime->attach_external_resource(ctx, launcher);
+}
+
+// Split lr into num_blocks pieces along its outermost dims, which is how
+// the replicas of a parameter are laid out
+static std::vector<LogicalRegion> outer_blocks(Context ctx,
+                                               Runtime *runtime,
+                                               LogicalRegion lr,
+                                               size_t num_blocks) {
+  std::vector<LogicalRegion> blocks;
+  if (num_blocks == 1) {
+    blocks.push_back(lr);
+    return blocks;
+  }
+  Domain domain = runtime->get_index_space_domain(ctx, lr.get_index_space());
+  IndexPartition ip = IndexPartition::NO_PART;
+  switch (domain.get_dim()) {
+#define DIMFUNC(DIM)                                                           \
+  case DIM: {                                                                  \
+    Rect<DIM> rect = domain;                                                   \
+    Point<DIM> block;                                                          \
+    size_t remaining = num_blocks;                                             \
+    for (int i = DIM - 1; i >= 0; i--) {                                       \
+      size_t extent = rect.hi[i] - rect.lo[i] + 1;                             \
+      if (remaining % extent == 0) {                                           \
+        block[i] = 1;                                                          \
+        remaining /= extent;                                                   \
+      } else {                                                                 \
+        assert(extent % remaining == 0);                                       \
+        block[i] = extent / remaining;                                         \
+        remaining = 1;                                                         \
+      }                                                                        \
+    }                                                                          \
+    ip = runtime->create_partition_by_blockify(                                \
+        ctx, IndexSpaceT<DIM>(lr.get_index_space()), block);                   \
+    break;                                                                     \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      assert(false);
+  }
+  LogicalPartition lp = runtime->get_logical_partition(ctx, lr, ip);
+  Domain colors = runtime->get_index_partition_color_space(ctx, ip);
+  for (Domain::DomainPointIterator it(colors); it; it++) {
+    blocks.push_back(runtime->get_logical_subregion_by_color(ctx, lp, *it));
+  }
+  assert(blocks.size() == num_blocks);
+  return blocks;
+}
+
 template <typename T>
 bool ParallelTensorBase::set_tensor(FFModel const *ff,
                                     std::vector<int> const &dim_sizes,
@@ -667,30 +736,31 @@ bool ParallelTensorBase::set_tensor(FFModel const *ff,
   for (size_t i = 0; i < dim_sizes.size(); i++) {
     volume = volume * dim_sizes[i];
   }
-  RegionRequirement req(region, READ_WRITE, EXCLUSIVE, region);
-  req.add_field(FID_DATA);
-  InlineLauncher launcher(req);
-  PhysicalRegion pr = runtime->map_region(ctx, launcher);
-  pr.wait_until_valid();
-  switch (num_dims) {
-#define DIMFUNC(DIM)                                                           \
-  case DIM: {                                                                  \
-    TensorAccessorW<T, DIM> acc(pr, req, FID_DATA, ctx, runtime, true);        \
-    assert(acc.rect.volume() == volume * num_replicas);                        \
-    T *ptr = acc.ptr;                                                          \
-    for (size_t i = 0; i < num_replicas; i++) {                                \
-      memcpy(ptr, data, volume * sizeof(T));                                   \
-      ptr += volume;                                                           \
-    }                                                                          \
-    break;                                                                     \
-  }
-    LEGION_FOREACH_N(DIMFUNC)
-#undef DIMFUNC
-    default:
-      // Unsupported dim
-      assert(false);
-  }
-  runtime->unmap_region(ctx, pr);
+  assert(runtime->get_index_space_domain(ctx, region.get_index_space())
+             .get_volume() == volume * num_replicas);
+  // Attach the caller's buffer once per replica to a scratch region over the
+  // same index space and copy that into the tensor, so Legion moves the data
+  // straight into the tensor's instances without staging the whole
+  // (replicated) tensor in host memory first
+  LogicalRegion src = runtime->create_logical_region(
+      ctx, region.get_index_space(), region.get_field_space());
+  std::vector<PhysicalRegion> attached;
+  for (LogicalRegion const &block :
+       outer_blocks(ctx, runtime, src, num_replicas)) {
+    attached.push_back(attach_host_buffer(ctx, runtime, block, src, data));
+  }
+  CopyLauncher copy;
+  copy.add_copy_requirements(
+      RegionRequirement(src, READ_ONLY, EXCLUSIVE, src),
+      RegionRequirement(region, WRITE_DISCARD, EXCLUSIVE, region));
+  copy.add_src_field(0, FID_DATA);
+  copy.add_dst_field(0, FID_DATA);
+  runtime->issue_copy_operation(ctx, copy);
+  // The caller may release its buffer once the copy has read it
+  for (PhysicalRegion &pr : attached) {
+    runtime->detach_external_resource(ctx, pr, false /*flush*/).wait();
+  }
+  runtime->destroy_logical_region(ctx, src);
   return true;
 }
 
@@ -700,9 +770,10 @@ bool ParallelTensorBase::get_tensor(FFModel const *ff,
                                     bool get_gradients) {
   Context ctx = ff->config.lg_ctx;
   Runtime *runtime = ff->config.lg_hlr;
+  LogicalRegion parent = get_gradients ? region_grad : region;
   LogicalRegion weight_lr = LogicalRegion::NO_REGION;
   if (sync_type == ParameterSyncType::PS) {
-    weight_lr = get_gradients ? region_grad : region;
+    weight_lr = parent;
   } else {
     assert(owner_op != NULL);
     Domain domain = runtime->get_index_space_domain(ctx, parallel_is);
@@ -723,27 +794,27 @@ bool ParallelTensorBase::get_tensor(FFModel const *ff,
   for (int i = 0; i < num_dims; i++) {
     volume = volume * dims[i].size / dims[i].degree;
   }
-  RegionRequirement req(
-      weight_lr, READ_ONLY, EXCLUSIVE, get_gradients ? region_grad : region);
-  req.add_field(FID_DATA);
-  InlineLauncher launcher(req);
-  PhysicalRegion pr = runtime->map_region(ctx, launcher);
-  pr.wait_until_valid();
-  switch (num_dims) {
-#define DIMFUNC(DIM)                                                           \
-  case DIM: {                                                                  \
-    TensorAccessorR<T, DIM> acc(pr, req, FID_DATA, ctx, runtime);              \
-    assert(acc.rect.volume() == volume);                                       \
-    memcpy(data, acc.ptr, volume * sizeof(T));                                 \
-    break;                                                                     \
-  }
-    LEGION_FOREACH_N(DIMFUNC)
-#undef DIMFUNC
-    default:
-      // Unsupported dim
-      assert(false);
-  }
-  runtime->unmap_region(ctx, pr);
+  assert(runtime->get_index_space_domain(ctx, weight_lr.get_index_space())
+             .get_volume() == volume);
+  // Attach the caller's buffer to the same piece of a scratch region and copy
+  // the tensor into it, so the data lands in place without an inline mapping
+  LogicalRegion dst = runtime->create_logical_region(
+      ctx, parent.get_index_space(), parent.get_field_space());
+  LogicalRegion dst_piece =
+      runtime->get_logical_subregion_by_tree(ctx,
+                                             weight_lr.get_index_space(),
+                                             dst.get_field_space(),
+                                             dst.get_tree_id());
+  PhysicalRegion pr = attach_host_buffer(ctx, runtime, dst_piece, dst, data);
+  CopyLauncher copy;
+  copy.add_copy_requirements(
+      RegionRequirement(weight_lr, READ_ONLY, EXCLUSIVE, parent),
+      RegionRequirement(dst_piece, WRITE_DISCARD, EXCLUSIVE, dst));
+  copy.add_src_field(0, FID_DATA);
+  copy.add_dst_field(0, FID_DATA);
+  runtime->issue_copy_operation(ctx, copy);
+  runtime->detach_external_resource(ctx, pr, true /*flush*/).wait();
+  runtime->destroy_logical_region(ctx, dst);
   return true;
 }
 
@@ -15,6 +15,7 @@
 
 #include "flexflow/simulator.h"
 #include "flexflow/model.h"
+#include "flexflow/parallel_ops/all_to_all.h"
 #include "flexflow/parallel_ops/combine.h"
 #include "flexflow/parallel_ops/partition.h"
 #include "flexflow/parallel_ops/reduction.h"
@@ -23,6 +24,7 @@
 #include "flexflow/utils/hash_utils.h"
 #include "queue"
 #include <memory>
+#include <mutex>
 #include <random>
 #include <unordered_set>
 
@@ -67,12 +69,7 @@ bool ParallelConfig::is_data_parallel() const {
       return false;
     }
   }
-  for (int i = 0; i < nparts; i++) {
-    if (device_ids[i] != i) {
-      return false;
-    }
-  }
-  return true;
+  return device_ids == DeviceList(0, nparts);
 }
 
 bool MachineResource::is_valid_machine_view(MachineView const &view) const {
@@ -345,6 +342,27 @@ SimTask *TaskManager::get_backward_task(Op const *op, int idx) {
   return hash_to_backward_task[hash];
 }
 
+Simulator::Simulator(FFModel const *model,
+                     Context ctx,
+                     Runtime *runtime,
+                     MachineModel *machine)
+    : machine(machine), base_ptr(NULL), capacity(0), offset(0),
+      warmup_times(5), repeat_times(10),
+      computationMode(model->config.computationMode), measure_model(model),
+      measure_ctx(ctx), measure_runtime(runtime) {
+  conv2d_meta = NULL;
+  linear_meta = NULL;
+  pool2d_meta = NULL;
+  ele_unary_meta = NULL;
+  ele_binary_meta = NULL;
+  batch_matmul_meta = NULL;
+  concat_meta = NULL;
+  transpose_meta = NULL;
+  segment_size = model->config.simulator_segment_size;
+  max_num_segments = model->config.simulator_max_num_segments;
+  task_manager = new TaskManager(1024 * 1024);
+}
+
 void Simulator::free_all() {
   offset = 0;
 }
@@ -525,10 +543,8 @@ ParallelConfig Op::view_to_pc(MachineView const &view) const {
     }
   }
 
-  std::vector<int> device_ids = view.device_ids();
-  assert(device_ids.size() <= MAX_NUM_WORKERS);
-  for (size_t i = 0; i < device_ids.size(); i++) {
-    config.device_ids[i] = device_ids[i];
+  for (int device_id : view.device_ids()) {
+    config.device_ids.push_back(device_id);
   }
 
   return config;
@@ -543,11 +559,12 @@ CostMetrics Simulator::measure_operator_cost(Op const *op,
     if (this->strict_hash_to_operator_cost.find(key) ==
         this->strict_hash_to_operator_cost.end()) {
       CostMetrics cost_metrics{};
-      bool is_implemented = op->measure_operator_cost(this, mv, cost_metrics);
+      bool is_implemented = measure_on_device(op, mv, cost_metrics);
       if (!is_implemented) {
         handle_measure_operator_cost_unimplemented(op);
       }
       op->estimate_sync_cost(this, mv, cost_metrics);
+      apply_cost_correction(cost_corrections, op->op_type, cost_metrics);
       this->strict_hash_to_operator_cost[key] = cost_metrics;
     }
     return this->strict_hash_to_operator_cost.at(key);
@@ -564,11 +581,12 @@ CostMetrics Simulator::measure_operator_cost(Op const *op,
 
   if (iter == hash_to_operator_cost.end()) {
     CostMetrics cost_metrics{};
-    bool is_implemented = op->measure_operator_cost(this, mv, cost_metrics);
+    bool is_implemented = measure_on_device(op, mv, cost_metrics);
     if (!is_implemented) {
       handle_measure_operator_cost_unimplemented(op);
     }
     op->estimate_sync_cost(this, mv, cost_metrics);
+    apply_cost_correction(cost_corrections, op->op_type, cost_metrics);
     hash_to_operator_cost[hash] = cost_metrics;
     return cost_metrics;
   } else {
@@ -576,6 +594,95 @@ CostMetrics Simulator::measure_operator_cost(Op const *op,
   }
 }
 
+bool Simulator::measure_on_device(Op const *op,
+                                  MachineView const &mv,
+                                  CostMetrics &cost_metrics) {
+  if (measure_runtime == nullptr) {
+    return op->measure_operator_cost(this, mv, cost_metrics);
+  }
+  MeasureOperatorCostArgs args{measure_model, op, mv};
+  TaskLauncher launcher(MEASURE_OPERATOR_COST_TASK_ID,
+                        TaskArgument(&args, sizeof(MeasureOperatorCostArgs)));
+  Future future = measure_runtime->execute_task(measure_ctx, launcher);
+  MeasuredOperatorCost ret = future.get_result<MeasuredOperatorCost>();
+  cost_metrics = ret.cost_metrics;
+  return ret.is_implemented;
+}
+
+// Workspace of a new measurement simulator, which also leaves room for the
+// buffers an operator allocates besides its tensors
+static size_t const MEASURE_WORK_SPACE_SIZE = (size_t)64 * 1024 * 1024;
+
+// Bytes of the shards of an operator's tensors and of their gradients
+static size_t measured_tensors_size(Op const *op) {
+  size_t size = 0;
+  auto add = [&size](ParallelTensor const &t) {
+    size += t->get_volume() / t->get_total_num_parts() *
+            data_type_size(t->data_type);
+  };
+  for (int i = 0; i < op->numInputs; i++) {
+    add(op->inputs[i]);
+  }
+  for (int i = 0; i < op->numOutputs; i++) {
+    add(op->outputs[i]);
+  }
+  for (int i = 0; i < op->numWeights; i++) {
+    add(op->weights[i]);
+  }
+  return 2 * size;
+}
+
+/**
+ * @brief Measure one operator for a search running on a CPU processor.
+ * @details Each GPU keeps one simulator for these measurements, without a
+ * task manager. Its workspace starts at MEASURE_WORK_SPACE_SIZE and is only
+ * reallocated, up to --simulator-workspace-size, when an operator's tensors
+ * do not fit, so little device memory is held while training runs.
+ */
+MeasuredOperatorCost Simulator::measure_operator_cost_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  static std::mutex simulators_lock;
+  // Not freed at exit, when the runtime owning their workspaces is gone
+  static std::map<Processor, Simulator *> simulators;
+  MeasureOperatorCostArgs const *args =
+      (MeasureOperatorCostArgs const *)task->args;
+  FFModel const *model = args->model;
+  size_t work_space_size =
+      std::min(measured_tensors_size(args->op) + MEASURE_WORK_SPACE_SIZE,
+               model->config.simulator_work_space_size);
+  Simulator *sim;
+  {
+    std::lock_guard<std::mutex> guard(simulators_lock);
+    Simulator *&cached = simulators[task->target_proc];
+    if (cached == NULL || cached->capacity < work_space_size) {
+      if (cached != NULL) {
+        work_space_size =
+            std::min(std::max(2 * cached->capacity, work_space_size),
+                     model->config.simulator_work_space_size);
+        // Free the old workspace before allocating the new one
+        delete cached;
+      }
+      Memory gpu_mem = Machine::MemoryQuery(Machine::get_machine())
+                           .only_kind(DEVICE_MEM_KIND)
+                           .best_affinity_to(task->target_proc)
+                           .first();
+      // The mapper places this task on the first GPU, like the graph
+      // optimize task, whose handler is handlers[0]
+      cached = new Simulator(
+          model, model->handlers[0], gpu_mem, NULL, work_space_size);
+    }
+    sim = cached;
+  }
+  MeasuredOperatorCost ret;
+  ret.cost_metrics = CostMetrics{};
+  ret.is_implemented =
+      args->op->measure_operator_cost(sim, args->view, ret.cost_metrics);
+  return ret;
+}
+
 float Simulator::estimate_repartition_xfer_cost(
     int repartition_dim,
     int repartition_degree,
@@ -617,6 +724,73 @@ float Simulator::estimate_repartition_xfer_cost(
   return 2 * max_xfer_cost;
 }
 
+// Every output piece gathers one slice from each of the degree input pieces
+// that share its coordinates outside split_dim and concat_dim
+float Simulator::estimate_all_to_all_xfer_cost(
+    int split_dim,
+    int concat_dim,
+    int degree,
+    ParallelTensorShape const &input_tensor_shape,
+    ParallelTensorShape const &output_tensor_shape,
+    MachineView const &source_view,
+    MachineView const &sink_view) const {
+  auto input_mapping = input_tensor_shape.get_tensor_dim_to_mv_dim_mapping();
+  auto output_mapping = output_tensor_shape.get_tensor_dim_to_mv_dim_mapping();
+  size_t slice_size = output_tensor_shape.get_piece_size() / degree;
+  float max_xfer_cost = 0.0f;
+  std::unordered_map<std::pair<int, int>, size_t> internode_transfers;
+  for (Domain::DomainPointIterator it(sink_view.get_domain()); it; it++) {
+    int sink_device = sink_view.get_device_id(*it);
+    DomainPoint source_dp;
+    source_dp.dim = source_view.ndims;
+    for (int i = 0; i < source_view.ndims; i++) {
+      source_dp.point_data[i] = 0;
+    }
+    for (auto const &kv : input_mapping) {
+      int dim = kv.first;
+      coord_t coord = 0;
+      if (output_mapping.find(dim) != output_mapping.end()) {
+        coord = (*it).point_data[output_mapping.at(dim)];
+      }
+      if (dim == split_dim) {
+        coord /= degree;
+      } else if (dim == concat_dim) {
+        coord *= degree;
+      }
+      source_dp.point_data[kv.second] = coord;
+    }
+    assert(input_mapping.find(concat_dim) != input_mapping.end());
+    int concat_mv_dim = input_mapping.at(concat_dim);
+    coord_t first = source_dp.point_data[concat_mv_dim];
+    size_t intranode_bytes = 0;
+    int dst_node_id = machine->get_gpu(sink_device)->node_id;
+    for (int k = 0; k < degree; k++) {
+      source_dp.point_data[concat_mv_dim] = first + k;
+      int source_device = source_view.get_device_id(source_dp);
+      if (source_device == sink_device) {
+        continue;
+      }
+      int src_node_id = machine->get_gpu(source_device)->node_id;
+      if (src_node_id == dst_node_id) {
+        intranode_bytes += slice_size;
+      } else {
+        internode_transfers[{src_node_id, dst_node_id}] += slice_size;
+      }
+    }
+    max_xfer_cost =
+        std::max(max_xfer_cost,
+                 intranode_bytes / machine->get_intra_node_gpu_bandwidth());
+  }
+
+  for (auto const &kv : internode_transfers) {
+    max_xfer_cost = std::max(
+        max_xfer_cost, kv.second / machine->get_inter_node_gpu_bandwidth());
+  }
+
+  // The backward pass sends the gradients the other way around
+  return 2 * max_xfer_cost;
+}
+
 // estimate the data transfer costs from some op with view source_view to Op op
 // with view sink_view
 float Simulator::estimate_xfer_cost(Op const *op,
@@ -653,6 +827,16 @@ float Simulator::estimate_xfer_cost(Op const *op,
                                                     sink_view,
                                                     source_view);
       }
+      case OP_ALLTOALL: {
+        AllToAll *all_to_all = (AllToAll *)op;
+        return this->estimate_all_to_all_xfer_cost(all_to_all->split_dim,
+                                                   all_to_all->concat_dim,
+                                                   all_to_all->degree,
+                                                   input_tensor->get_shape(),
+                                                   output_tensor->get_shape(),
+                                                   source_view,
+                                                   sink_view);
+      }
       case OP_REPLICATE: {
         Replicate *replicate = (Replicate *)op;
         ParallelTensorShape fake_input_shape = input_tensor->get_shape();
@@ -812,6 +996,105 @@ float Simulator::default_estimate_sync_cost(
   }
 }
 
+float Simulator::estimate_nccl_sync_time(Op const *op,
+                                         ParallelConfig const &pc) {
+  float sync_run_time = 0.0f;
+  size_t element_size =
+      data_type_size(DT_FLOAT); // assume all weights have float elements
+  for (int j = 0; j < op->numWeights; j++) {
+    std::set<int> synched;
+    for (int firstId = 0; firstId < pc.num_parts(); firstId++) {
+      if (synched.find(firstId) == synched.end()) {
+        synched.insert(firstId);
+        Domain firstR = op->get_weight_tensor_shape(pc, j, firstId);
+        Device *firstDevice = machine->get_gpu(pc.device_ids[firstId]);
+        size_t volume = firstR.get_volume();
+        if (sparse_embedding_grad && op->op_type == OP_EMBEDDING) {
+          // Only the rows looked up by the whole batch are exchanged
+          size_t row_size = firstR.hi()[0] - firstR.lo()[0] + 1;
+          volume = std::min(volume, op->inputs[0]->get_volume() * row_size);
+        }
+        float nccl_time = 0.0f;
+        for (int nextId = firstId + 1; nextId < pc.num_parts(); nextId++) {
+          Domain nextR = op->get_weight_tensor_shape(pc, j, nextId);
+          if (firstR.intersection(nextR).get_volume() > 0) {
+            // Assert all or nothing:
+            // The two weights must be fully overlapped or not at all
+            assert(firstR == nextR);
+            assert(synched.find(nextId) == synched.end());
+            synched.insert(nextId);
+            Device *nextDevice = machine->get_gpu(pc.device_ids[nextId]);
+            // Compute the bandwidth between firstDevice/nextDevice
+            float bandwidth = 0.0f;
+            if (firstDevice->node_id == nextDevice->node_id) {
+              bandwidth = machine->get_intra_node_gpu_bandwidth();
+            } else {
+              bandwidth = machine->get_inter_node_gpu_bandwidth();
+            }
+            // printf("[NCCL Time] Op(%s) Weight(%d) firstId(%d)
+            // nextId(%d): volume is %f\n", op->name, j, firstId, nextId,
+            // (float)firstR.get_volume());
+            nccl_time = std::max(
+                nccl_time, 2 * (float)volume * element_size / bandwidth);
+          }
+        }
+        sync_run_time += nccl_time;
+      }
+    }
+  }
+  return sync_run_time;
+}
+
+float Simulator::simulate_bucketed_sync(
+    FFModel const *model,
+    std::map<Op const *, ParallelConfig> const &global,
+    std::map<Op const *, float> const &backward_finish_times) {
+  struct SyncBucket {
+    size_t bytes = 0;
+    int num_tensors = 0;
+    float ready_time = 0.0f, run_time = 0.0f;
+  };
+  size_t bucket_bytes =
+      (size_t)model->config.grad_sync_bucket_size * 1024 * 1024;
+  size_t element_size =
+      data_type_size(DT_FLOAT); // assume all weights have float elements
+  // Buckets are keyed by the devices of their operators, which determine the
+  // NCCL communicator used by the runtime
+  std::map<std::vector<int>, SyncBucket> open_buckets;
+  std::vector<SyncBucket> issued_buckets;
+  for (int l = model->operators.size() - 1; l >= 0; l--) {
+    Op const *op = model->operators[l];
+    if (op->numWeights == 0) {
+      continue;
+    }
+    ParallelConfig pc = global.find(op)->second;
+    std::vector<int> devices = pc.device_ids.to_vector();
+    SyncBucket &bucket = open_buckets[devices];
+    for (int j = 0; j < op->numWeights; j++) {
+      bucket.bytes +=
+          op->get_weight_tensor_shape(pc, j, 0).get_volume() * element_size;
+    }
+    bucket.num_tensors += op->numWeights;
+    bucket.run_time += estimate_nccl_sync_time(op, pc);
+    bucket.ready_time =
+        std::max(bucket.ready_time, backward_finish_times.at(op));
+    if (bucket.bytes >= bucket_bytes ||
+        bucket.num_tensors >= MAX_NUM_MULTI_TENSORS) {
+      issued_buckets.push_back(bucket);
+      open_buckets.erase(devices);
+    }
+  }
+  // Partially filled buckets are synchronized at the end of backward
+  for (auto const &it : open_buckets) {
+    issued_buckets.push_back(it.second);
+  }
+  float finish_time = 0.0f;
+  for (auto const &bucket : issued_buckets) {
+    finish_time = std::max(finish_time, bucket.ready_time) + bucket.run_time;
+  }
+  return finish_time;
+}
+
 float Simulator::simulate_runtime(
     FFModel const *model,
     std::map<Op const *, ParallelConfig> const &global,
@@ -917,7 +1200,8 @@ float Simulator::simulate_runtime(
     finals.push_back(t);
   }
 
-  if (model->config.search_overlap_backward_update &&
+  if ((model->config.search_overlap_backward_update ||
+       model->config.grad_sync_bucket_size > 0) &&
       comp_mode == COMP_MODE_TRAINING) {
     // Step 3a: consider backpropagation and weight update are overlapped
     for (int l = model->operators.size() - 1; l >= 0; l--) {
@@ -1034,6 +1318,25 @@ float Simulator::simulate_runtime(
   // Step 5: perform simulation
   float sim_time = 0.0f;
   std::map<Device *, float> device_times;
+#ifdef FF_USE_NCCL
+  // Track when the gradients of each operator's weights are produced
+  bool bucketed_sync = model->config.grad_sync_bucket_size > 0 &&
+                       comp_mode == COMP_MODE_TRAINING;
+  std::map<SimTask const *, Op const *> weight_backward_tasks;
+  std::map<Op const *, float> backward_finish_times;
+  if (bucketed_sync) {
+    for (Op const *op : model->operators) {
+      if (op->numWeights == 0) {
+        continue;
+      }
+      ParallelConfig pc = global.find(op)->second;
+      for (int j = 0; j < pc.num_parts(); j++) {
+        weight_backward_tasks[task_manager->get_backward_task(op, j)] = op;
+      }
+      backward_finish_times[op] = 0.0f;
+    }
+  }
+#endif
   size_t idx = 0;
   DotFile<SimTask *> taskGraph;
   bool export_taskgraph = (export_file_name != "");
@@ -1072,6 +1375,15 @@ float Simulator::simulate_runtime(
     if (end_time > sim_time) {
       sim_time = end_time;
     }
+#ifdef FF_USE_NCCL
+    if (bucketed_sync) {
+      auto const &it = weight_backward_tasks.find(cur_task);
+      if (it != weight_backward_tasks.end()) {
+        float &finish_time = backward_finish_times[it->second];
+        finish_time = std::max(finish_time, end_time);
+      }
+    }
+#endif
     for (size_t i = 0; i < cur_task->next_tasks.size(); i++) {
       SimTask *next = cur_task->next_tasks[i];
       if (export_taskgraph) {
@@ -1091,7 +1403,11 @@ float Simulator::simulate_runtime(
   // Assert all tasks were processed
   assert(idx == task_manager->global_task_id);
 #ifdef FF_USE_NCCL
-  if (comp_mode == COMP_MODE_TRAINING) {
+  if (bucketed_sync) {
+    // Gradient synchronization overlaps with the remaining backward tasks
+    sim_time = std::max(
+        sim_time, simulate_bucketed_sync(model, global, backward_finish_times));
+  } else if (comp_mode == COMP_MODE_TRAINING) {
     std::unordered_set<Op const *> possible_syncs(model->operators.begin(),
                                                   model->operators.end());
     std::unordered_map<Op const *, std::unique_ptr<OpSyncTask>> tasks;
@@ -1135,54 +1451,14 @@ float Simulator::simulate_runtime(
       }
       if (to_run != nullptr) {
         possible_syncs.erase(to_run);
-        float sync_run_time = 0.0f;
         OpSyncTask *task = tasks.at(to_run).get();
         Op const *op = to_run;
         ParallelConfig pc = global.find(op)->second;
-        size_t element_size =
-            data_type_size(DT_FLOAT); // assume all weights have float elements
 
         for (int j = 0; j < pc.num_parts(); j++) {
           available_devices[pc.device_ids[j]] = false;
         }
-
-        for (int j = 0; j < op->numWeights; j++) {
-          std::set<int> synched;
-          for (int firstId = 0; firstId < pc.num_parts(); firstId++) {
-            if (synched.find(firstId) == synched.end()) {
-              synched.insert(firstId);
-              Domain firstR = op->get_weight_tensor_shape(pc, j, firstId);
-              Device *firstDevice = machine->get_gpu(pc.device_ids[firstId]);
-              float nccl_time = 0.0f;
-              for (int nextId = firstId + 1; nextId < pc.num_parts();
-                   nextId++) {
-                Domain nextR = op->get_weight_tensor_shape(pc, j, nextId);
-                if (firstR.intersection(nextR).get_volume() > 0) {
-                  // Assert all or nothing:
-                  // The two weights must be fully overlapped or not at all
-                  assert(firstR == nextR);
-                  assert(synched.find(nextId) == synched.end());
-                  synched.insert(nextId);
-                  Device *nextDevice = machine->get_gpu(pc.device_ids[nextId]);
-                  // Compute the bandwidth between firstDevice/nextDevice
-                  float bandwidth = 0.0f;
-                  if (firstDevice->node_id == nextDevice->node_id) {
-                    bandwidth = machine->get_intra_node_gpu_bandwidth();
-                  } else {
-                    bandwidth = machine->get_inter_node_gpu_bandwidth();
-                  }
-                  // printf("[NCCL Time] Op(%s) Weight(%d) firstId(%d)
-                  // nextId(%d): volume is %f\n", op->name, j, firstId, nextId,
-                  // (float)firstR.get_volume());
-                  nccl_time = std::max(nccl_time,
-                                       2 * (float)firstR.get_volume() *
-                                           element_size / bandwidth);
-                }
-              }
-              sync_run_time += nccl_time;
-            }
-          }
-        }
+        float sync_run_time = estimate_nccl_sync_time(op, pc);
 
         task->finish_time = sync_sim_time + sync_run_time;
         sync_ready_queue.push(task);
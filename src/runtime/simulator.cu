@@ -54,13 +54,14 @@ typedef Realm::Rect<1, coord_t> Rect1;
 Simulator::Simulator(FFModel const *model,
                      FFHandler _handler,
                      Memory _memory,
-                     MachineModel *machine)
+                     MachineModel *machine,
+                     size_t work_space_size)
     : memory(_memory), handler(_handler), offset(0), warmup_times(5),
       repeat_times(10), computationMode(model->config.computationMode) {
   // Allocate simulator memory
   Rect1 bounds(Point1(0), Point1(0));
   std::vector<size_t> field_sizes;
-  field_sizes.push_back(model->config.simulator_work_space_size);
+  field_sizes.push_back(work_space_size);
   Realm::RegionInstance::create_instance(simulatorInst,
                                          memory,
                                          bounds,
@@ -69,7 +70,7 @@ Simulator::Simulator(FFModel const *model,
                                          Realm::ProfilingRequestSet())
       .wait();
   base_ptr = (char *)simulatorInst.pointer_untyped(0, sizeof(char));
-  capacity = model->config.simulator_work_space_size;
+  capacity = work_space_size;
 
   // Set cublas/cudnn streams to allow Realm catch the events
   cudaStream_t stream;
@@ -96,10 +97,15 @@ Simulator::Simulator(FFModel const *model,
   segment_size = model->config.simulator_segment_size;
   max_num_segments = model->config.simulator_max_num_segments;
   // Initialize task manager
-  task_manager = new TaskManager(max_num_tasks);
+  task_manager = machine != NULL ? new TaskManager(max_num_tasks) : NULL;
 }
 
 Simulator::~Simulator(void) {
+  if (measure_runtime != nullptr) {
+    // Host-only simulators own no device state
+    delete task_manager;
+    return;
+  }
   simulatorInst.destroy();
   cudaEventDestroy(start_event);
   cudaEventDestroy(end_event);
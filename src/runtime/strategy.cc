@@ -140,8 +140,10 @@ bool load_strategies_from_file(
     // printf("device size %d\n", device_ids_size);
     assert(n == device_ids_size || device_ids_size == 0);
     for (int j = 0; j < device_ids_size; j++) {
-      input >> config.device_ids[j];
-      // printf("%d\t", config.device_ids[j]);
+      int device_id;
+      input >> device_id;
+      config.device_ids.push_back(device_id);
+      // printf("%d\t", device_id);
     }
     // printf("\n");
     MappingTagID hash = FFConfig::get_hash_id(op_name);
@@ -32,6 +32,7 @@
 #include "flexflow/ops/pool_2d.h"
 #include "flexflow/ops/softmax.h"
 #include "flexflow/ops/split.h"
+#include "flexflow/parallel_ops/all_to_all.h"
 #include "flexflow/parallel_ops/combine.h"
 #include "flexflow/parallel_ops/fused_parallel_op.h"
 #include "flexflow/parallel_ops/partition.h"
@@ -119,6 +120,10 @@ GraphXfer *leading_relu_branch_partition(FFModel *model,
                                          int num_partitions);
 GraphXfer *
     create_linear_relu_merge(FFModel *model, int num_dims, bool use_bias);
+GraphXfer *create_combine_repartition_all_to_all(FFModel *model,
+                                                 int concat_dim,
+                                                 int split_dim,
+                                                 int num_parts);
 
 PMConstraint::PMConstraint(Compare c, PMParameter p, int v)
     : comp(c), para(p), value(v) {}
@@ -1001,6 +1006,15 @@ bool GraphXfer::create_new_operator(OpX const *opx, Node &op) {
                                               {combine_dim, combine_degree});
       break;
     }
+    case OP_ALLTOALL: {
+      int split_dim, concat_dim, degree;
+      assert(opx->get_pm_constraint(PM_ALLTOALL_SPLIT_DIM, split_dim));
+      assert(opx->get_pm_constraint(PM_ALLTOALL_CONCAT_DIM, concat_dim));
+      assert(opx->get_pm_constraint(PM_ALLTOALL_DEGREE, degree));
+      op = model->get_or_create_node<AllToAll>(inputs[0],
+                                               {split_dim, concat_dim, degree});
+      break;
+    }
     default: {
       std::cout << "opx->type = " << get_operator_type_name(opx->type)
                 << std::endl;
@@ -1174,6 +1188,17 @@ OpX *GraphXfer::create_combine(TensorX const &input,
   return part;
 }
 
+OpX *GraphXfer::create_all_to_all(TensorX const &input,
+                                  int split_dim,
+                                  int concat_dim,
+                                  int num_parts) {
+  OpX *all_to_all = new OpX(OP_ALLTOALL, 1, 1, input);
+  all_to_all->add_pm_constraint(COMPARE_EQ, PM_ALLTOALL_SPLIT_DIM, split_dim);
+  all_to_all->add_pm_constraint(COMPARE_EQ, PM_ALLTOALL_CONCAT_DIM, concat_dim);
+  all_to_all->add_pm_constraint(COMPARE_EQ, PM_ALLTOALL_DEGREE, num_parts);
+  return all_to_all;
+}
+
 void Graph::print_strategy_computation_graph(
     std::unordered_map<Node, MachineView> const &strategy) const {
   DotFile<Node> dot(std::cout);
@@ -1252,6 +1277,13 @@ void Graph::export_strategy_computation_graph(
                    << std::to_string(r->reduction_degree);
           break;
         }
+        case OP_ALLTOALL: {
+          AllToAll *a = (AllToAll *)node.ptr;
+          meta_row << std::to_string(a->split_dim)
+                   << std::to_string(a->concat_dim)
+                   << std::to_string(a->degree);
+          break;
+        }
         default: {
           if (mv.ndims == 0) {
             meta_row << "N/A";
@@ -1445,6 +1477,7 @@ int get_num_inputs(sl::Operator const &op) {
     case OP_COMBINE:
     case OP_REPLICATE:
     case OP_REDUCTION:
+    case OP_ALLTOALL:
     case OP_PIPELINE:
       return 1;
     default:
@@ -1480,6 +1513,9 @@ OpX *create_opx(sl::Operator const &op,
         case OP_REPLICATE:
           degree_key = PM_REPLICATE_DEGREE;
           break;
+        case OP_ALLTOALL:
+          degree_key = PM_ALLTOALL_DEGREE;
+          break;
       }
 
       if (degree_key.has_value()) {
@@ -1767,6 +1803,15 @@ void GraphSearchHelper::generate_all_pcg_xfers() {
   for (auto const &it : all_parallel_degrees) {
     all_pcg_xfers.push_back(
         create_partition_attention_combine(this->model, 16 /*num_heads*/, it));
+    // Between any two of the (at most 4) dims the rules above partition
+    for (int concat_dim = 0; concat_dim < 4; concat_dim++) {
+      for (int split_dim = 0; split_dim < 4; split_dim++) {
+        if (split_dim != concat_dim) {
+          all_pcg_xfers.push_back(create_combine_repartition_all_to_all(
+              this->model, concat_dim, split_dim, it));
+        }
+      }
+    }
   }
 
   if (config.substitution_json_path.has_value()) {
@@ -1843,9 +1888,9 @@ void GraphSearchHelper::generate_all_pcg_xfers() {
       }
       {
         std::unordered_set<int> concat_num_inputs;
-        for (size_t i = 0; i < this->model->operators.size(); i++) {
-          if (this->model->operators[i]->op_type == OP_CONCAT) {
-            concat_num_inputs.insert(this->model->operators[i]->numInputs);
+        for (FlexFlow::Op const *op : this->model->search_operators) {
+          if (op->op_type == OP_CONCAT) {
+            concat_num_inputs.insert(op->numInputs);
           }
         }
         for (auto const &it2 : concat_num_inputs) {
@@ -1870,7 +1915,7 @@ void GraphSearchHelper::generate_all_pcg_xfers() {
 Graph *GraphSearchHelper::construct_graph() {
   Graph *graph = new Graph(this->model);
   std::unordered_map<FlexFlow::Op const *, Node> op_to_node_map;
-  for (FlexFlow::Op const *dstOp : this->model->operators) {
+  for (FlexFlow::Op const *dstOp : this->model->search_operators) {
     Node dstNode;
     dstNode.ptr = dstOp;
     dstNode.guid = this->model->node_global_guid++;
@@ -2077,6 +2122,10 @@ void GraphSearchHelper::update_mem_optim_config(
   mem_config = new_config;
 }
 
+MemoryOptimConfig const &GraphSearchHelper::get_mem_optim_config() const {
+  return mem_config;
+}
+
 void GraphSearchHelper::find_rewrite_matches(
     Graph const *graph, std::vector<GraphXferMatch> &matches) const {
   std::vector<GraphXfer *> xfers;
@@ -3565,6 +3614,36 @@ GraphXfer *
   return subst;
 }
 
+// Moves the partitioning from concat_dim to split_dim without gathering the
+// whole tensor on fewer devices, as for tokens entering or leaving experts
+GraphXfer *create_combine_repartition_all_to_all(FFModel *model,
+                                                 int concat_dim,
+                                                 int split_dim,
+                                                 int num_parts) {
+  GraphXfer *subst = new GraphXfer(model);
+  TensorX input = subst->new_tensor();
+  OpX *combine = subst->create_combine(input, concat_dim, num_parts);
+  OpX *partition =
+      subst->create_repartition(combine->outputs[0], split_dim, num_parts);
+  OpX *all_to_all =
+      subst->create_all_to_all(input, split_dim, concat_dim, num_parts);
+
+  subst->map_output(partition->outputs[0], all_to_all->outputs[0]);
+
+  subst->srcOps.push_back(combine);
+  subst->srcOps.push_back(partition);
+
+  subst->dstOps.push_back(all_to_all);
+
+  std::ostringstream oss;
+  oss << "combine_repartition_all_to_all["
+      << "concat_dim=" << concat_dim << ",split_dim=" << split_dim
+      << ",num_parts=" << num_parts << "]";
+  subst->name = oss.str();
+
+  return subst;
+}
+
 }; // namespace FlexFlow::PCG
 
 namespace FlexFlow {
@@ -3739,6 +3818,16 @@ bool FFModel::convert_graph_to_operators(
                                reduction->reduction_degree);
         break;
       }
+      case OP_ALLTOALL: {
+        assert(inList.size() == 1);
+        AllToAll *all_to_all = (AllToAll *)node.ptr;
+        new_op = new AllToAll(*this,
+                              inputs[0],
+                              all_to_all->split_dim,
+                              all_to_all->concat_dim,
+                              all_to_all->degree);
+        break;
+      }
       case OP_FUSED_PARALLEL: {
         assert(inList.size() == 1);
         FusedParallelOp *fused = (FusedParallelOp *)node.ptr;
@@ -0,0 +1,58 @@
+#include "flexflow/utils/batch_cache.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+using namespace FlexFlow;
+
+TEST(batch_cache, fingerprint) {
+  // Reference values of XXH64 with seed 0
+  EXPECT_EQ(fingerprint("", 0), 0xEF46DB3751D8E999ULL);
+  EXPECT_EQ(fingerprint("abc", 3), 0x44BC2CF5AD770999ULL);
+
+  std::vector<int> a(1000), b(1000);
+  for (int i = 0; i < 1000; i++) {
+    a[i] = b[i] = i;
+  }
+  size_t bytes = a.size() * sizeof(int);
+  EXPECT_EQ(fingerprint(a.data(), bytes), fingerprint(b.data(), bytes));
+  b[999] = -1;
+  EXPECT_NE(fingerprint(a.data(), bytes), fingerprint(b.data(), bytes));
+}
+
+TEST(batch_cache, lru) {
+  BatchCache cache(2);
+  EXPECT_EQ(cache.lookup(1), -1);
+  int s1 = cache.insert(1);
+  EXPECT_EQ(cache.lookup(2), -1);
+  int s2 = cache.insert(2);
+  EXPECT_NE(s1, s2);
+  EXPECT_EQ(cache.size(), 2);
+
+  // 1 becomes the most recent entry, so inserting 3 evicts 2
+  EXPECT_EQ(cache.lookup(1), s1);
+  EXPECT_EQ(cache.lookup(3), -1);
+  EXPECT_EQ(cache.insert(3), s2);
+  EXPECT_EQ(cache.lookup(2), -1);
+  EXPECT_EQ(cache.lookup(3), s2);
+  EXPECT_EQ(cache.lookup(1), s1);
+  EXPECT_EQ(cache.size(), 2);
+
+  EXPECT_EQ(cache.hits, 3u);
+  EXPECT_EQ(cache.misses, 4u);
+  EXPECT_FLOAT_EQ(cache.hit_rate(), 3.0f / 7.0f);
+}
+
+TEST(batch_cache, collision) {
+  BatchCache cache(2);
+  int s1 = cache.insert(1);
+  auto never = [](int slot) { return false; };
+  // A fingerprint match whose payload differs is a miss
+  EXPECT_EQ(cache.lookup(1, never), -1);
+  EXPECT_EQ(cache.hits, 0u);
+  EXPECT_EQ(cache.misses, 1u);
+  EXPECT_EQ(cache.lookup(1, [&](int slot) { return slot == s1; }), s1);
+  EXPECT_EQ(cache.hits, 1u);
+  // The colliding batch overwrites the entry's slot
+  EXPECT_EQ(cache.insert(1), s1);
+  EXPECT_EQ(cache.size(), 1);
+}
@@ -0,0 +1,54 @@
+#include "flexflow/utils/benchmark_stats.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+TEST(benchmark_stats, summary) {
+  std::vector<float> samples;
+  for (int i = 100; i >= 1; i--) {
+    samples.push_back((float)i);
+  }
+  LatencySummary s = summarize_latencies(samples);
+  EXPECT_EQ(s.count, 100);
+  EXPECT_FLOAT_EQ(s.mean, 50.5f);
+  EXPECT_NEAR(s.stddev, 28.866f, 1e-3);
+  EXPECT_FLOAT_EQ(s.min, 1.0f);
+  EXPECT_FLOAT_EQ(s.p50, 50.0f);
+  EXPECT_FLOAT_EQ(s.p90, 90.0f);
+  EXPECT_FLOAT_EQ(s.p99, 99.0f);
+  EXPECT_FLOAT_EQ(s.max, 100.0f);
+  EXPECT_EQ(summarize_latencies({}).count, 0);
+  EXPECT_FLOAT_EQ(summarize_latencies({3.0f}).p99, 3.0f);
+}
+
+TEST(benchmark_stats, diff) {
+  auto result = [](std::string name, std::vector<float> fwd) {
+    BenchmarkResult r;
+    r.name = name;
+    r.forward = summarize_latencies(fwd);
+    return r;
+  };
+  std::vector<BenchmarkResult> baseline = {
+      result("steady", {1.0f, 1.0f, 1.1f}),
+      result("slower", {1.0f, 1.0f, 1.1f}),
+      result("noisy", {1.0f, 1.0f, 1.1f}),
+      result("faster", {2.0f, 2.0f, 2.1f}),
+      result("dropped", {1.0f})};
+  std::vector<BenchmarkResult> current = {
+      result("steady", {1.0f, 1.05f, 1.1f}),
+      result("slower", {1.3f, 1.4f, 1.5f}),
+      // slow median but its fastest samples match the baseline
+      result("noisy", {0.9f, 1.5f, 1.6f}),
+      result("faster", {1.0f, 1.0f, 1.1f}),
+      result("added", {1.0f})};
+  BenchmarkDiff diff = diff_benchmarks(current, baseline, 0.1f);
+  ASSERT_EQ(diff.regressions.size(), 1);
+  EXPECT_EQ(diff.regressions[0].name, "slower");
+  EXPECT_TRUE(diff.regressions[0].forward);
+  EXPECT_FLOAT_EQ(diff.regressions[0].baseline_ms, 1.0f);
+  EXPECT_FLOAT_EQ(diff.regressions[0].current_ms, 1.4f);
+  ASSERT_EQ(diff.improvements.size(), 1);
+  EXPECT_EQ(diff.improvements[0].name, "faster");
+  ASSERT_EQ(diff.missing.size(), 1);
+  EXPECT_EQ(diff.missing[0], "dropped");
+}
@@ -0,0 +1,131 @@
+#include "flexflow/utils/device_list.h"
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <new>
+
+using namespace FlexFlow;
+
+// Count heap allocations so that tests can check a list stays inline
+static size_t num_allocations = 0;
+
+void *operator new(size_t size) {
+  num_allocations++;
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept {
+  std::free(ptr);
+}
+
+TEST(device_list, contiguous_is_one_run) {
+  DeviceList list;
+  for (int i = 0; i < 1024; i++) {
+    list.push_back(4 + i);
+  }
+  EXPECT_EQ(list.size(), 1024);
+  EXPECT_EQ(list[0], 4);
+  EXPECT_EQ(list[1023], 1027);
+  EXPECT_EQ(list, DeviceList(4, 1024));
+}
+
+TEST(device_list, strided) {
+  DeviceList list;
+  for (int i = 0; i < 8; i++) {
+    list.push_back(6 - 2 * i);
+  }
+  EXPECT_EQ(list, DeviceList(6, 8, -2));
+  EXPECT_EQ(list[7], -8);
+}
+
+TEST(device_list, irregular_round_trip) {
+  std::vector<int> ids = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3};
+  DeviceList list;
+  for (int id : ids) {
+    list.push_back(id);
+  }
+  EXPECT_EQ(list.size(), (int)ids.size());
+  EXPECT_EQ(list.to_vector(), ids);
+  for (size_t i = 0; i < ids.size(); i++) {
+    EXPECT_EQ(list[i], ids[i]);
+  }
+}
+
+TEST(device_list, multi_dim_view) {
+  // 2x32 view with strides (1, 4), as built by Op::view_to_pc
+  std::vector<int> ids;
+  DeviceList list;
+  for (int i = 0; i < 32; i++) {
+    for (int j = 0; j < 2; j++) {
+      ids.push_back(j + 4 * i);
+      list.push_back(j + 4 * i);
+    }
+  }
+  EXPECT_EQ(list.size(), 64);
+  EXPECT_EQ(list.to_vector(), ids);
+  for (size_t i = 0; i < ids.size(); i++) {
+    EXPECT_EQ(list[i], ids[i]);
+  }
+  DeviceList copy = list;
+  EXPECT_EQ(copy, list);
+  copy.clear();
+  EXPECT_TRUE(copy.empty());
+  copy.push_back(1);
+  copy.push_back(3);
+  EXPECT_EQ(copy, DeviceList(1, 2, 2));
+}
+
+TEST(device_list, equality) {
+  DeviceList a, b;
+  a.push_back(0);
+  b.push_back(0);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a, DeviceList(0, 1, 7));
+  a.push_back(2);
+  EXPECT_NE(a, b);
+  b.push_back(1);
+  EXPECT_NE(a, b);
+  EXPECT_NE(DeviceList(), DeviceList(0, 1));
+  b.push_back(7);
+  EXPECT_NE(a, b);
+  a.push_back(7);
+  EXPECT_NE(a, b);
+  DeviceList c = b;
+  EXPECT_EQ(b, c);
+}
+
+TEST(device_list, multi_dim_views_stay_inline) {
+  // Every view of a 4x4x4 grid of workers, as enumerated by the search
+  int extents[][3] = {{4, 4, 4}, {2, 8, 4}, {2, 2, 2}, {3, 1, 5}, {64, 1, 1}};
+  int strides[][3] = {{1, 4, 16}, {1, 4, 32}, {32, 1, 8}, {2, 7, 9}, {1, 1, 1}};
+  for (int v = 0; v < 5; v++) {
+    std::vector<int> ids;
+    for (int k = 0; k < extents[v][2]; k++) {
+      for (int j = 0; j < extents[v][1]; j++) {
+        for (int i = 0; i < extents[v][0]; i++) {
+          ids.push_back(3 + i * strides[v][0] + j * strides[v][1] +
+                        k * strides[v][2]);
+        }
+      }
+    }
+    size_t allocations = num_allocations;
+    DeviceList list;
+    for (int id : ids) {
+      list.push_back(id);
+    }
+    DeviceList copy = list;
+    EXPECT_EQ(num_allocations, allocations);
+    EXPECT_EQ(copy, list);
+    ASSERT_EQ(list.size(), (int)ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+      EXPECT_EQ(list[i], ids[i]);
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#include "flexflow/utils/memory_planner.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+TEST(memory_planner, chain_reuses_two_slots) {
+  // inference over a chain: each activation is read by the next operator
+  int const num_ops = 6;
+  std::vector<size_t> sizes(num_ops, 100);
+  std::vector<std::vector<LiveInterval>> lifetimes;
+  for (int i = 0; i < num_ops; i++) {
+    lifetimes.push_back({{i, i + 1}});
+  }
+  MemoryPlan plan = plan_memory(sizes, lifetimes);
+  EXPECT_EQ(plan.slot_sizes.size(), 2);
+  EXPECT_EQ(plan.planned_bytes(), 200);
+  EXPECT_EQ(plan.lower_bound, 200);
+  for (int i = 0; i + 1 < num_ops; i++) {
+    EXPECT_NE(plan.slot_of[i], plan.slot_of[i + 1]);
+  }
+}
+
+TEST(memory_planner, overlapping_tensors_never_share) {
+  std::vector<size_t> sizes = {64, 32, 128, 16, 256};
+  std::vector<std::vector<LiveInterval>> lifetimes = {
+      {{0, 3}}, {{2, 5}}, {{4, 4}}, {{1, 9}}, {{6, 8}}};
+  MemoryPlan plan = plan_memory(sizes, lifetimes);
+  for (size_t a = 0; a < sizes.size(); a++) {
+    EXPECT_GE(plan.slot_sizes[plan.slot_of[a]], sizes[a]);
+    for (size_t b = a + 1; b < sizes.size(); b++) {
+      if (plan.slot_of[a] != plan.slot_of[b]) {
+        continue;
+      }
+      for (LiveInterval const &x : lifetimes[a]) {
+        for (LiveInterval const &y : lifetimes[b]) {
+          EXPECT_TRUE(x.last < y.first || y.last < x.first);
+        }
+      }
+    }
+  }
+  EXPECT_GE(plan.planned_bytes(), plan.lower_bound);
+  EXPECT_LT(plan.planned_bytes(), 64 + 32 + 128 + 16 + 256);
+}
+
+TEST(memory_planner, recomputed_tensor_is_live_twice) {
+  // tensor 0 is dropped after step 1 and recomputed for steps 6 to 8, so
+  // tensor 1 can use its memory in between but tensor 2 cannot
+  std::vector<size_t> sizes = {100, 100, 100};
+  std::vector<std::vector<LiveInterval>> lifetimes = {
+      {{0, 1}, {6, 8}}, {{2, 5}}, {{3, 7}}};
+  MemoryPlan plan = plan_memory(sizes, lifetimes);
+  EXPECT_EQ(plan.slot_of[0], plan.slot_of[1]);
+  EXPECT_NE(plan.slot_of[0], plan.slot_of[2]);
+  EXPECT_EQ(plan.planned_bytes(), 200);
+  EXPECT_EQ(plan.lower_bound, 200);
+}
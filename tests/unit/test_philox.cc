@@ -0,0 +1,49 @@
+#include "flexflow/utils/philox.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+TEST(philox, known_answers) {
+  // Known-answer vectors of the reference Random123 implementation
+  std::array<uint32_t, 4> r = philox4x32({0u, 0u, 0u, 0u}, {0u, 0u});
+  EXPECT_EQ(r[0], 0x6627e8d5u);
+  EXPECT_EQ(r[1], 0xe169c58du);
+  EXPECT_EQ(r[2], 0xbc57ac4cu);
+  EXPECT_EQ(r[3], 0x9b00dbd8u);
+  r = philox4x32({0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u},
+                 {0xa4093822u, 0x299f31d0u});
+  EXPECT_EQ(r[0], 0xd16cfe09u);
+  EXPECT_EQ(r[1], 0x94fdccebu);
+  EXPECT_EQ(r[2], 0x5001e420u);
+  EXPECT_EQ(r[3], 0x24126ea1u);
+}
+
+TEST(philox, order_independent) {
+  // Drawing element 1000 alone gives the value it gets in a full pass
+  std::vector<float> all;
+  for (uint64_t i = 0; i < 2000; i++) {
+    all.push_back(philox_uniform(42, i));
+  }
+  EXPECT_EQ(philox_uniform(42, 1000), all[1000]);
+  EXPECT_NE(philox_uniform(43, 1000), all[1000]);
+}
+
+TEST(philox, distributions) {
+  int const n = 100000;
+  double sum = 0.0, sum_sq = 0.0, normal_sum = 0.0, normal_sum_sq = 0.0;
+  for (int i = 0; i < n; i++) {
+    float u = philox_uniform(7, i);
+    ASSERT_GE(u, 0.0f);
+    ASSERT_LT(u, 1.0f);
+    sum += u;
+    sum_sq += u * u;
+    float z = philox_normal(7, i);
+    ASSERT_TRUE(std::isfinite(z));
+    normal_sum += z;
+    normal_sum_sq += z * z;
+  }
+  EXPECT_NEAR(sum / n, 0.5, 0.01);
+  EXPECT_NEAR(sum_sq / n - 0.25, 1.0 / 12, 0.01);
+  EXPECT_NEAR(normal_sum / n, 0.0, 0.02);
+  EXPECT_NEAR(normal_sum_sq / n, 1.0, 0.02);
+}
@@ -0,0 +1,444 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ffconst_utils.h"
+#include "flexflow/model.h"
+#include "flexflow/ops/batch_matmul.h"
+#include "flexflow/ops/conv_2d.h"
+#include "flexflow/ops/element_binary.h"
+#include "flexflow/ops/element_unary.h"
+#include "flexflow/ops/linear.h"
+#include "flexflow/ops/pool_2d.h"
+#include "flexflow/ops/softmax.h"
+#include "flexflow/utils/benchmark_stats.h"
+#include <fstream>
+#include <functional>
+#include <nlohmann/json.hpp>
+
+using namespace Legion;
+using namespace FlexFlow;
+using json = nlohmann::json;
+
+LegionRuntime::Logger::Category log_bench("op_benchmark");
+
+// Operator microbenchmarks: every case builds one operator from its Params
+// struct, for each data-parallel degree of its sample dimension, and times
+// it with the operator's measure_operator_cost on one device processor (an
+// OpenMP processor with the cpu backend).  Results are written as JSON and,
+// given a baseline written by an earlier run, diffed against it.
+
+struct BenchmarkConfig {
+  // only run cases whose name contains this string
+  std::string filter;
+  std::string output_file = "op_benchmark.json";
+  std::string baseline_file;
+  int num_samples = 20;
+  int warmup_times = 5, repeat_times = 10;
+  // relative slowdown of the median reported as a regression
+  float tolerance = 0.1f;
+  // largest data-parallel degree, defaults to the number of workers
+  int max_degree = 0;
+};
+
+struct BenchmarkTaskArgs {
+  FFModel *model;
+  BenchmarkConfig const *config;
+};
+
+struct BenchmarkCase {
+  std::string name;
+  // returns the operator with the sample dimension split degree ways, or
+  // nullptr when the params are invalid for that split
+  std::function<Op const *(FFModel &, int degree)> build;
+};
+
+void parse_input_args(char **argv, int argc, BenchmarkConfig &config) {
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--bench-filter")) {
+      config.filter = std::string(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--bench-output")) {
+      config.output_file = std::string(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--bench-baseline")) {
+      config.baseline_file = std::string(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--bench-samples")) {
+      config.num_samples = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--bench-warmup")) {
+      config.warmup_times = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--bench-repeat")) {
+      config.repeat_times = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--bench-tolerance")) {
+      config.tolerance = atof(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--bench-max-degree")) {
+      config.max_degree = atoi(argv[++i]);
+      continue;
+    }
+  }
+}
+
+// dims in Legion order (innermost first), the last one being the sample
+// dimension; a replica dimension is appended as for model inputs
+static ParallelTensor create_input(FFModel &model,
+                                   std::vector<int> const &dims,
+                                   int degree) {
+  int const num_dims = (int)dims.size();
+  ParallelDim pdims[MAX_TENSOR_DIM];
+  for (int i = 0; i < num_dims; i++) {
+    pdims[i].size = dims[i];
+    pdims[i].degree = 1;
+    pdims[i].parallel_idx = -1;
+    pdims[i].is_replica_dim = false;
+  }
+  if (degree > 1) {
+    pdims[num_dims - 1].degree = degree;
+    pdims[num_dims - 1].parallel_idx = 0;
+  }
+  pdims[num_dims].size = 1;
+  pdims[num_dims].degree = 1;
+  pdims[num_dims].parallel_idx = -1;
+  pdims[num_dims].is_replica_dim = true;
+  return model.create_parallel_tensor_legion_ordering(
+      num_dims + 1, pdims, DT_FLOAT);
+}
+
+static std::vector<BenchmarkCase> benchmark_cases() {
+  std::vector<BenchmarkCase> cases;
+  for (int batch : {64, 256}) {
+    for (int channels : {1024, 4096}) {
+      std::string shape =
+          "b" + std::to_string(batch) + "_c" + std::to_string(channels);
+      cases.push_back({"linear/" + shape, [=](FFModel &ff, int degree) {
+                         LinearParams params;
+                         params.out_channels = channels;
+                         params.use_bias = true;
+                         params.data_type = DT_FLOAT;
+                         params.activation = AC_MODE_RELU;
+                         params.kernel_reg_type = REG_MODE_NONE;
+                         params.kernel_reg_lambda = 0.0f;
+                         return ff
+                             .get_or_create_node<Linear>(
+                                 create_input(ff, {channels, batch}, degree),
+                                 params)
+                             .ptr;
+                       }});
+      cases.push_back({"relu/" + shape, [=](FFModel &ff, int degree) {
+                         ElementUnaryParams params;
+                         params.op_type = OP_RELU;
+                         params.inplace = false;
+                         return ff
+                             .get_or_create_node<ElementUnary>(
+                                 create_input(ff, {channels, batch}, degree),
+                                 params)
+                             .ptr;
+                       }});
+      cases.push_back({"add/" + shape, [=](FFModel &ff, int degree) {
+                         ElementBinaryParams params;
+                         params.type = OP_EW_ADD;
+                         return ff
+                             .get_or_create_node<ElementBinary>(
+                                 {create_input(ff, {channels, batch}, degree),
+                                  create_input(ff, {channels, batch}, degree)},
+                                 params)
+                             .ptr;
+                       }});
+      cases.push_back({"softmax/" + shape, [=](FFModel &ff, int degree) {
+                         SoftmaxParams params;
+                         params.dim = 0;
+                         return ff
+                             .get_or_create_node<Softmax>(
+                                 create_input(ff, {channels, batch}, degree),
+                                 params)
+                             .ptr;
+                       }});
+    }
+  }
+  for (int batch : {16, 64}) {
+    for (int size : {28, 56}) {
+      std::string shape =
+          "b" + std::to_string(batch) + "_hw" + std::to_string(size);
+      cases.push_back({"conv2d/" + shape, [=](FFModel &ff, int degree) {
+                         Conv2DParams params;
+                         params.out_channels = 64;
+                         params.kernel_h = params.kernel_w = 3;
+                         params.stride_h = params.stride_w = 1;
+                         params.padding_h = params.padding_w = 1;
+                         params.groups = 1;
+                         params.activation = AC_MODE_NONE;
+                         params.use_bias = true;
+                         return ff
+                             .get_or_create_node<Conv2D>(
+                                 create_input(
+                                     ff, {size, size, 64, batch}, degree),
+                                 params)
+                             .ptr;
+                       }});
+      cases.push_back({"pool2d/" + shape, [=](FFModel &ff, int degree) {
+                         Pool2DParams params;
+                         params.kernel_h = params.kernel_w = 2;
+                         params.stride_h = params.stride_w = 2;
+                         params.padding_h = params.padding_w = 0;
+                         params.pool_type = POOL_MAX;
+                         params.activation = AC_MODE_NONE;
+                         return ff
+                             .get_or_create_node<Pool2D>(
+                                 create_input(
+                                     ff, {size, size, 64, batch}, degree),
+                                 params)
+                             .ptr;
+                       }});
+    }
+  }
+  for (int seq_length : {128, 512}) {
+    std::string shape = "b64_s" + std::to_string(seq_length);
+    cases.push_back({"batch_matmul/" + shape, [=](FFModel &ff, int degree) {
+                       BatchMatmulParams params;
+                       params.a_seq_length_dim = -1;
+                       params.b_seq_length_dim = -1;
+                       // (seq_length x 64) * (64 x seq_length) per sample
+                       return ff
+                           .get_or_create_node<BatchMatmul>(
+                               {create_input(ff, {64, seq_length, 64}, degree),
+                                create_input(ff, {seq_length, 64, 64}, degree)},
+                               params)
+                           .ptr;
+                     }});
+  }
+  return cases;
+}
+
+static json summary_to_json(LatencySummary const &s) {
+  return json{{"count", s.count},
+              {"mean", s.mean},
+              {"stddev", s.stddev},
+              {"min", s.min},
+              {"p50", s.p50},
+              {"p90", s.p90},
+              {"p99", s.p99},
+              {"max", s.max}};
+}
+
+static LatencySummary summary_from_json(json const &j) {
+  LatencySummary s;
+  s.count = j.at("count").get<int>();
+  s.mean = j.at("mean").get<float>();
+  s.stddev = j.at("stddev").get<float>();
+  s.min = j.at("min").get<float>();
+  s.p50 = j.at("p50").get<float>();
+  s.p90 = j.at("p90").get<float>();
+  s.p99 = j.at("p99").get<float>();
+  s.max = j.at("max").get<float>();
+  return s;
+}
+
+static char const *backend_name() {
+#if defined(FF_USE_CPU_ONLY)
+  return "cpu";
+#elif defined(FF_USE_HIP_ROCM)
+  return "hip";
+#else
+  return "cuda";
+#endif
+}
+
+/*
+  Runs on a device processor, like the strategy search, so that operators
+  are measured with the kernels and memory the model itself would use.
+  Returns the number of regressions against the baseline.
+*/
+int benchmark_task(Task const *task,
+                   std::vector<PhysicalRegion> const &regions,
+                   Context ctx,
+                   Runtime *runtime) {
+  BenchmarkTaskArgs const *args = (BenchmarkTaskArgs const *)task->args;
+  FFModel *model = args->model;
+  BenchmarkConfig const &config = *args->config;
+  Memory device_mem = Machine::MemoryQuery(Machine::get_machine())
+                          .only_kind(DEVICE_MEM_KIND)
+                          .best_affinity_to(task->target_proc)
+                          .first();
+  SimpleMachineModel machine(model->config.numNodes,
+                             model->config.workersPerNode,
+                             device_mem.capacity());
+  Simulator sim(model, model->handlers[0], device_mem, &machine);
+  sim.warmup_times = config.warmup_times;
+  sim.repeat_times = config.repeat_times;
+  int max_degree = config.max_degree > 0 ? config.max_degree
+                                         : model->config.workersPerNode;
+
+  std::vector<BenchmarkResult> results;
+  json output = {{"backend", backend_name()},
+                 {"warmup_times", config.warmup_times},
+                 {"repeat_times", config.repeat_times},
+                 {"benchmarks", json::array()}};
+  for (BenchmarkCase const &c : benchmark_cases()) {
+    if (c.name.find(config.filter) == std::string::npos) {
+      continue;
+    }
+    for (int degree = 1; degree <= max_degree; degree *= 2) {
+      Op const *op = c.build(*model, degree);
+      if (op == nullptr) {
+        continue;
+      }
+      MachineView view;
+      view.device_type = MachineView::GPU;
+      view.ndims = 1;
+      view.start_device_id = 0;
+      view.dim[0] = degree;
+      view.stride[0] = 1;
+      if (!op->outputs[0]->is_valid_machine_view(view)) {
+        continue;
+      }
+      // every sample is the mean of repeat_times runs of one shard
+      std::vector<float> forward, backward;
+      bool is_implemented = true;
+      for (int s = 0; s < config.num_samples && is_implemented; s++) {
+        CostMetrics cost_metrics{};
+        is_implemented = op->measure_operator_cost(&sim, view, cost_metrics);
+        forward.push_back(cost_metrics.forward_time);
+        backward.push_back(cost_metrics.backward_time);
+      }
+      if (!is_implemented) {
+        log_bench.warning("%s: measure_operator_cost is not implemented",
+                          c.name.c_str());
+        break;
+      }
+      BenchmarkResult result;
+      result.name = c.name + "/dp" + std::to_string(degree);
+      result.forward = summarize_latencies(forward);
+      if (model->config.computationMode == COMP_MODE_TRAINING) {
+        result.backward = summarize_latencies(backward);
+      }
+      results.push_back(result);
+      log_bench.print("%-32s forward p50 %.4f ms p90 %.4f ms, "
+                      "backward p50 %.4f ms p90 %.4f ms",
+                      result.name.c_str(),
+                      result.forward.p50,
+                      result.forward.p90,
+                      result.backward.p50,
+                      result.backward.p90);
+      output["benchmarks"].push_back(
+          {{"name", result.name},
+           {"op", get_operator_type_name(op->op_type)},
+           {"degree", degree},
+           {"forward", summary_to_json(result.forward)},
+           {"backward", summary_to_json(result.backward)},
+           {"forward_samples", forward},
+           {"backward_samples", backward}});
+    }
+  }
+  {
+    std::ofstream file(config.output_file);
+    file << output.dump(2) << std::endl;
+    if (!file) {
+      fprintf(stderr,
+              "Cannot write benchmark results to %s\n",
+              config.output_file.c_str());
+      assert(false);
+    }
+  }
+  if (config.baseline_file.empty()) {
+    return 0;
+  }
+
+  std::ifstream file(config.baseline_file);
+  if (!file) {
+    fprintf(stderr,
+            "Cannot open benchmark baseline %s\n",
+            config.baseline_file.c_str());
+    assert(false);
+  }
+  json baseline_json = json::parse(file);
+  if (baseline_json.at("backend").get<std::string>() != backend_name()) {
+    log_bench.warning("baseline %s was measured with the %s backend",
+                      config.baseline_file.c_str(),
+                      baseline_json.at("backend").get<std::string>().c_str());
+  }
+  std::vector<BenchmarkResult> baseline;
+  for (json const &b : baseline_json.at("benchmarks")) {
+    BenchmarkResult result;
+    result.name = b.at("name").get<std::string>();
+    result.forward = summary_from_json(b.at("forward"));
+    result.backward = summary_from_json(b.at("backward"));
+    // cases filtered out of this run are not missing
+    if (result.name.find(config.filter) != std::string::npos) {
+      baseline.push_back(result);
+    }
+  }
+  BenchmarkDiff diff = diff_benchmarks(results, baseline, config.tolerance);
+  for (BenchmarkChange const &c : diff.improvements) {
+    log_bench.print("improved:  %-32s %s %.4f ms -> %.4f ms",
+                    c.name.c_str(),
+                    c.forward ? "forward " : "backward",
+                    c.baseline_ms,
+                    c.current_ms);
+  }
+  for (BenchmarkChange const &c : diff.regressions) {
+    log_bench.print("REGRESSED: %-32s %s %.4f ms -> %.4f ms",
+                    c.name.c_str(),
+                    c.forward ? "forward " : "backward",
+                    c.baseline_ms,
+                    c.current_ms);
+  }
+  for (std::string const &name : diff.missing) {
+    log_bench.warning("%s is in the baseline but was not measured",
+                      name.c_str());
+  }
+  return (int)diff.regressions.size();
+}
+
+void FlexFlow::top_level_task(Task const *task,
+                              std::vector<PhysicalRegion> const &regions,
+                              Context ctx,
+                              Runtime *runtime) {
+  FFConfig ffConfig;
+  BenchmarkConfig benchConfig;
+  {
+    InputArgs const &command_args = HighLevelRuntime::get_input_args();
+    parse_input_args(command_args.argv, command_args.argc, benchConfig);
+  }
+  FFModel ff(ffConfig);
+  BenchmarkTaskArgs args{&ff, &benchConfig};
+  TaskLauncher launcher(CUSTOM_GPU_TASK_ID_1,
+                        TaskArgument(&args, sizeof(args)));
+  int num_regressions =
+      runtime->execute_task(ctx, launcher).get_result<int>();
+  if (num_regressions > 0) {
+    log_bench.print("%d benchmark(s) regressed beyond %.0f%%",
+                    num_regressions,
+                    benchConfig.tolerance * 100);
+    Runtime::set_return_code(1);
+  }
+}
+
+void FlexFlow::register_custom_tasks() {
+  TaskVariantRegistrar registrar(CUSTOM_GPU_TASK_ID_1, "Operator Benchmark");
+  registrar.add_constraint(ProcessorConstraint(DEVICE_PROC_KIND));
+  registrar.set_leaf();
+  Runtime::preregister_task_variant<int, benchmark_task>(
+      registrar, "Operator Benchmark Task");
+}
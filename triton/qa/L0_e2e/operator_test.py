@@ -104,6 +104,46 @@ class OperatorTest(unittest.TestCase):
             self.assertTrue(False, "unexpected error {}".format(ex))
         log.debug("====== end of test_add ======")
 
+    def test_generated_strategy(self):
+        log = logging.getLogger("Operator Test Logging")
+        log.debug("====== test_generated_strategy ======")
+        # The model has no model.strategy file, so the backend generates the
+        # partitioning of its Add and Tanh layers when loading it
+        model_name = "generated_strategy"
+
+        # Prepare input
+        input_shape = [4, 2]
+        ec = reduce((lambda x, y: x * y), input_shape)
+        input_data = np.arange(ec, dtype=np.float32).reshape(input_shape)
+        inputs = [
+            tritonhttpclient.InferInput('input0', input_shape, "FP32"),
+            tritonhttpclient.InferInput('input1', input_shape, "FP32")
+        ]
+        inputs[0].set_data_from_numpy(input_data)
+        inputs[1].set_data_from_numpy(input_data)
+
+        output_name = 'output'
+        outputs = [tritonhttpclient.InferRequestedOutput(output_name)]
+        expected_output_data = np.tanh(input_data + input_data)
+
+        log.debug("input data: {}".format(input_data))
+
+        try:
+            result = self.client.infer(model_name=model_name,
+                                       inputs=inputs,
+                                       outputs=outputs)
+
+            # Validate the results by comparing with precomputed values.
+            output_data = result.as_numpy(output_name)
+            self.assertTrue(
+                np.allclose(output_data, expected_output_data, atol=1e-07),
+                "Expect response to have value {}, got {}".format(
+                    expected_output_data, output_data))
+            log.debug("output data: {}".format(output_data))
+        except InferenceServerException as ex:
+            self.assertTrue(False, "unexpected error {}".format(ex))
+        log.debug("====== end of test_generated_strategy ======")
+
     def test_sub(self):
         log = logging.getLogger("Operator Test Logging")
         log.debug("====== test_sub ======")
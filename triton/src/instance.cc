@@ -73,6 +73,15 @@ LegionModelInstance::Create(
 
 LegionModelInstance::~LegionModelInstance()
 {
+  // Drain the batches still in flight
+  if (pipeline_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(pipeline_lock_);
+      pipeline_shutdown_ = true;
+    }
+    pipeline_cond_.notify_all();
+    pipeline_thread_.join();
+  }
   // Finish the implicit top-level task associated with this instance
   Bind();
   model_state_->finalize(this, index_, runtime_, context_, mapper_);
@@ -97,7 +106,8 @@ LegionModelInstance::LegionModelInstance(
     LegionModelState* model_state, unsigned index, Realm::Event ready)
     : BackendModelInstance(model_state, triton_model_instance),
       runtime_(model_state->runtime_->legion_), model_state_(model_state),
-      index_(index), context_ready_(ready), mapper_(0)
+      index_(index), context_ready_(ready), mapper_(0), pipeline_inflight_(0),
+      pipeline_shutdown_(false)
 {
   execution_barrier_ = Realm::Barrier::NO_BARRIER;
 }
@@ -304,9 +314,75 @@ LegionModelInstance::ProcessRequests(
     return;
   }
 
+  InflightBatch batch;
+  batch.requests_.assign(requests, requests + request_count);
+  batch.responses_ = std::move(responses);
+  batch.inputs_ = std::move(inputs);
+  batch.outputs_ = std::move(outputs);
+  batch.total_batch_size_ = total_batch_size;
+  batch.request_start_ns_ = request_start_ns;
+  // With pipelining the next batch can be staged while this one executes
+  if (model_state_->PipelineDepth() > 1)
+    EnqueueBatch(std::move(batch));
+  else
+    ExecuteBatch(batch);
+}
+
+void
+LegionModelInstance::EnqueueBatch(InflightBatch&& batch)
+{
+  std::unique_lock<std::mutex> guard(pipeline_lock_);
+  if (!pipeline_thread_.joinable())
+    pipeline_thread_ = std::thread(&LegionModelInstance::PipelineLoop, this);
+  // Bounding the batches in flight also bounds the memory held by staged
+  // inputs and outputs
+  pipeline_cond_.wait(guard, [this] {
+    return pipeline_inflight_ < model_state_->PipelineDepth();
+  });
+  pipeline_inflight_++;
+  pipeline_.emplace_back(std::move(batch));
+  guard.unlock();
+  pipeline_cond_.notify_all();
+}
+
+void
+LegionModelInstance::PipelineLoop(void)
+{
+  while (true) {
+    InflightBatch batch;
+    {
+      std::unique_lock<std::mutex> guard(pipeline_lock_);
+      pipeline_cond_.wait(
+          guard, [this] { return pipeline_shutdown_ || !pipeline_.empty(); });
+      if (pipeline_.empty())
+        return;
+      batch = std::move(pipeline_.front());
+      pipeline_.pop_front();
+    }
+    // Batches are executed in the order they were staged
+    ExecuteBatch(batch);
+    {
+      std::lock_guard<std::mutex> guard(pipeline_lock_);
+      pipeline_inflight_--;
+    }
+    pipeline_cond_.notify_all();
+  }
+}
+
+void
+LegionModelInstance::ExecuteBatch(InflightBatch& batch)
+{
+  const uint32_t request_count = batch.requests_.size();
+  TRITONBACKEND_Request** requests = batch.requests_.data();
+  std::vector<TRITONBACKEND_Response*>& responses = batch.responses_;
+  const uint64_t request_start_ns = batch.request_start_ns_;
+  const size_t total_batch_size = batch.total_batch_size_;
+
   std::vector<uint64_t> compute_input_end_ns(request_count);
   std::vector<uint64_t> compute_output_start_ns(request_count);
-  RunModel(inputs, outputs, compute_input_end_ns, compute_output_start_ns);
+  RunModel(
+      batch.inputs_, batch.outputs_, compute_input_end_ns,
+      compute_output_start_ns);
 
   uint64_t request_end_ns = request_start_ns;
   SET_TIMESTAMP(request_end_ns);
@@ -434,18 +510,17 @@ LegionModelInstance::SetInputTensors(
               input, nullptr, nullptr, nullptr, nullptr,
               &total_buffer_byte_size, &buffer_count));
 
-      // Check if the input buffers need to be preprocessed into
-      // contiguous buffer that satisfies the constraints
+      // Each buffer is bound directly as its own piece of the input as long
+      // as it holds whole rows along the outermost (batch) dimension, so the
+      // buffers of a request are scattered into the tensor without a copy.
+      // Only buffers splitting a row need to be gathered into a contiguous
+      // buffer first.
       bool need_preprocess = false;
       std::vector<const void*> buffers;
+      std::vector<uint64_t> buffer_byte_sizes;
       std::vector<Memory> buffer_memories;
       std::vector<std::pair<TRITONSERVER_MemoryType, int64_t>> buffer_locations;
-      // FIXME need to understand how a buffer satisfies the constraints,
-      // currently the request input must be in one contiguous buffer, and
-      // we shouldn't need to concatenate buffer for requests as splitting along
-      // batch dimension should be okay.
-      need_preprocess = (buffer_count > 1);
-      if (!need_preprocess) {
+      for (uint32_t buffer_idx = 0; buffer_idx < buffer_count; ++buffer_idx) {
         const void* buffer;
         uint64_t buffer_byte_size;
         TRITONSERVER_MemoryType memory_type;
@@ -453,39 +528,20 @@ LegionModelInstance::SetInputTensors(
         RESPOND_ALL_AND_RETURN_IF_ERROR(
             false, responses, request_count,
             TRITONBACKEND_InputBuffer(
-                input, 0, &buffer, &buffer_byte_size, &memory_type,
+                input, buffer_idx, &buffer, &buffer_byte_size, &memory_type,
                 &memory_type_id));
+        if ((buffer_count > 1) &&
+            (tensor.strides_.empty() || (buffer_byte_size == 0) ||
+             ((buffer_byte_size % tensor.strides_[0]) != 0))) {
+          need_preprocess = true;
+          break;
+        }
         buffers.emplace_back(buffer);
+        buffer_byte_sizes.emplace_back(buffer_byte_size);
         buffer_locations.emplace_back(memory_type, memory_type_id);
         buffer_memories.emplace_back(
             runtime->FindMemory(memory_type, memory_type_id));
       }
-      // for (size_t buffer_idx = 0; buffer_idx < buffer_count; ++buffer_count)
-      // {
-      //   const void* buffer;
-      //   uint64_t buffer_byte_size;
-      //   TRITONSERVER_MemoryType memory_type;
-      //   int64_t memory_type_id;
-      //   RESPOND_ALL_AND_RETURN_IF_ERROR(
-      //       false, responses, request_count,
-      //       TRITONBACKEND_InputBuffer(
-      //           input, buffer_idx, &buffer, &buffer_byte_size, &memory_type,
-      //           &memory_type_id));
-      //   // Check if the buffer is good
-      //   for (auto it = tensor.strides_.cbegin();
-      //        it != tensor.strides_.cend(); ++it) {
-      //     if (*it <= buffer_byte_size) {
-      //       need_preprocess = ((buffer_byte_size % *it) != 0);
-      //       break;
-      //     }
-      //   }
-      //   if (need_preprocess) {
-      //     break;
-      //   } else {
-      //     buffers.emplace_back(buffer);
-      //     buffer_locations.emplace_back(memory_type, memory_type_id);
-      //   }
-      // }
       if (need_preprocess) {
         // FIXME using CPU for now, can be smart based on what kind of input
         // buffer that the model prefers
@@ -503,6 +559,7 @@ LegionModelInstance::SetInputTensors(
                 requests[request_idx], input_name, backend_memory->MemoryPtr(),
                 &total_buffer_byte_size));
         tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
+        tensor.buffer_byte_sizes_.emplace_back(total_buffer_byte_size);
         tensor.buffer_locations_.emplace_back(
             backend_memory->MemoryType(), backend_memory->MemoryTypeId());
         tensor.buffer_memories_.emplace_back(runtime->FindMemory(
@@ -511,6 +568,9 @@ LegionModelInstance::SetInputTensors(
         std::copy(
             buffers.begin(), buffers.end(),
             std::back_inserter(tensor.buffers_));
+        std::copy(
+            buffer_byte_sizes.begin(), buffer_byte_sizes.end(),
+            std::back_inserter(tensor.buffer_byte_sizes_));
         std::copy(
             buffer_locations.begin(), buffer_locations.end(),
             std::back_inserter(tensor.buffer_locations_));
@@ -533,8 +593,11 @@ LegionModelInstance::SetInputTensors(
       // set the value of the padding to zeros
       memset(backend_memory->MemoryPtr(), 0, byte_size);
       tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
+      tensor.buffer_byte_sizes_.emplace_back(byte_size);
       tensor.buffer_locations_.emplace_back(
           backend_memory->MemoryType(), backend_memory->MemoryTypeId());
+      tensor.buffer_memories_.emplace_back(runtime->FindMemory(
+          backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
     }
   }
   return true;
@@ -808,4 +871,47 @@ LegionModelInstance::find_or_create_tiled_partition(
   return result;
 }
 
+LogicalPartition
+LegionModelInstance::find_or_create_batch_partition(
+    Tensor* tensor, const std::vector<size_t>& rows)
+{
+  LogicalRegion region = tensor->region[index_];
+  assert(region.exists());
+  const std::pair<IndexSpace, std::vector<size_t>> key(
+      region.get_index_space(), rows);
+  std::map<std::pair<IndexSpace, std::vector<size_t>>, IndexPartition>::
+      const_iterator finder = batch_partitions.find(key);
+  IndexPartition partition;
+  if (finder != batch_partitions.end()) {
+    partition = finder->second;
+  } else {
+    // One piece per buffer, each covering a contiguous range of rows
+    // of the outermost dimension
+    Domain color_domain(DomainPoint(0), DomainPoint(coord_t(rows.size()) - 1));
+    IndexSpace color_space = find_or_create_index_space(color_domain);
+    std::map<DomainPoint, Domain> pieces;
+    DomainPoint lo, hi;
+    lo.dim = tensor->bounds.size();
+    hi.dim = tensor->bounds.size();
+    for (unsigned d = 0; d < tensor->bounds.size(); d++) {
+      lo[d] = 0;
+      hi[d] = tensor->bounds[d] - 1;
+    }
+    coord_t offset = 0;
+    for (unsigned idx = 0; idx < rows.size(); idx++) {
+      lo[0] = offset;
+      hi[0] = offset + rows[idx] - 1;
+      pieces[DomainPoint(coord_t(idx))] = Domain(lo, hi);
+      offset += rows[idx];
+    }
+    assert(size_t(offset) == tensor->bounds[0]);
+    partition = runtime_->create_partition_by_domain(
+        context_, region.get_index_space(), pieces, color_space,
+        true /*perform intersections*/, LEGION_DISJOINT_COMPLETE_KIND);
+    batch_partitions[key] = partition;
+  }
+  return runtime_->get_logical_partition_by_tree(
+      context_, partition, region.get_field_space(), region.get_tree_id());
+}
+
 }}}  // namespace triton::backend::legion
@@ -16,6 +16,10 @@
 #ifndef __LEGION_TRITON_INSTANCE_H__
 #define __LEGION_TRITON_INSTANCE_H__
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include "legion.h"
 #include "model.h"
 #include "runtime.h"
@@ -29,6 +33,8 @@ namespace triton { namespace backend { namespace legion {
 struct InputTensor {
   std::string name_;
   std::vector<const void*> buffers_;
+  // Each buffer holds whole rows along the outermost dimension
+  std::vector<uint64_t> buffer_byte_sizes_;
   std::vector<std::pair<TRITONSERVER_MemoryType, int64_t>> buffer_locations_;
   std::vector<Realm::Memory> buffer_memories_;
   std::vector<int64_t> strides_;
@@ -47,6 +53,17 @@ struct OutputTensor {
   std::vector<std::unique_ptr<BackendMemory>> allocated_memory_;
 };
 
+// A batch of requests whose inputs and outputs have been staged and which
+// is waiting for or going through its execution
+struct InflightBatch {
+  std::vector<TRITONBACKEND_Request*> requests_;
+  std::vector<TRITONBACKEND_Response*> responses_;
+  std::vector<InputTensor> inputs_;
+  std::vector<OutputTensor> outputs_;
+  size_t total_batch_size_;
+  uint64_t request_start_ns_;
+};
+
 //
 // LegionModelInstance
 //
@@ -121,6 +138,15 @@ class LegionModelInstance : public BackendModelInstance {
       std::vector<TRITONBACKEND_Response*>* responses,
       std::vector<OutputTensor>& outputs);
 
+  // Run a staged batch, then send its responses, report its statistics
+  // and release its requests
+  void ExecuteBatch(InflightBatch& batch);
+
+  // Hand a staged batch to the pipeline thread, blocking while the
+  // instance already has as many batches in flight as the model allows
+  void EnqueueBatch(InflightBatch&& batch);
+  void PipelineLoop(void);
+
   LegionModelInstance(
       TRITONBACKEND_ModelInstance* triton_model_instance,
       LegionModelState* model_state, unsigned index, Realm::Event ready);
@@ -137,6 +163,10 @@ class LegionModelInstance : public BackendModelInstance {
   Legion::LogicalRegion create_tensor_region(Tensor* tensor);
   Legion::LogicalPartition find_or_create_tiled_partition(
       Tensor* tensor, const LayerStrategy* strategy);
+  // Split a tensor along its outermost dimension into pieces of the
+  // given numbers of rows
+  Legion::LogicalPartition find_or_create_batch_partition(
+      Tensor* tensor, const std::vector<size_t>& rows);
 
  public:
   Legion::Runtime* const runtime_;
@@ -152,6 +182,16 @@ class LegionModelInstance : public BackendModelInstance {
   Realm::FastReservation lock_;
   Realm::Barrier execution_barrier_;
 
+ private:
+  // Batches are staged by the Triton thread calling ProcessRequests while
+  // the pipeline thread executes the earlier ones
+  std::mutex pipeline_lock_;
+  std::condition_variable pipeline_cond_;
+  std::deque<InflightBatch> pipeline_;
+  std::thread pipeline_thread_;
+  unsigned pipeline_inflight_;
+  bool pipeline_shutdown_;
+
  private:
   std::map<Legion::Domain, Legion::IndexSpace> top_level_index_spaces;
   struct Partition {
@@ -171,6 +211,10 @@ class LegionModelInstance : public BackendModelInstance {
     Legion::Domain extent;
   };
   std::map<Legion::IndexSpace, std::vector<Partition>> top_level_partitions;
+  std::map<
+      std::pair<Legion::IndexSpace, std::vector<size_t>>,
+      Legion::IndexPartition>
+      batch_partitions;
   std::map<DataType, Legion::FieldSpace> top_level_field_spaces;
   std::vector<Legion::LogicalRegion> top_level_regions;
 };
@@ -20,6 +20,8 @@
 #include "operator.h"
 #include "tensor.h"
 
+#include <sstream>
+
 using namespace Legion;
 
 namespace triton { namespace backend { namespace legion {
@@ -80,9 +82,27 @@ LegionModelState::LoadModel()
   // TODO: load files based on the default / cc file name that may be set
   // in model config
   auto model_path = JoinPath({RepositoryPath(), std::to_string(Version())});
+  const std::string onnx_file = JoinPath({model_path, "model.onnx"});
+  const std::string strategy_file = JoinPath({model_path, "model.strategy"});
   assert(strategy_ == nullptr);
-  strategy_ = PartitionStrategy::LoadStrategy(
-      JoinPath({model_path, "model.strategy"}), this);
+  bool has_strategy_file = false;
+  RETURN_IF_ERROR(FileExists(strategy_file, &has_strategy_file));
+  if (has_strategy_file) {
+    strategy_ = PartitionStrategy::LoadStrategy(strategy_file, this);
+  } else {
+    // No hand-written strategy, search one for this model and machine
+    std::string generated;
+    RETURN_IF_ERROR(
+        PartitionStrategy::GenerateStrategy(onnx_file, this, &generated));
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_INFO,
+        (std::string("Generated partition strategy for model '") + Name() +
+         "', save it as " + strategy_file + " to customize it:\n" + generated)
+            .c_str());
+    std::istringstream input(generated);
+    strategy_ =
+        PartitionStrategy::LoadStrategy(input, "generated strategy", this);
+  }
 
   // load the ONNX model description as a list of layers
   // with tensor dependences between then and put them in layers_
@@ -91,13 +111,9 @@ LegionModelState::LoadModel()
           Realm::Processor::Kind kind) -> const std::vector<Realm::Processor>& {
         return runtime_->FindLocalProcessors(kind);
       },
-      this, strategy_, JoinPath({model_path, "model.onnx"}), &inputs_,
-      &outputs_, &layers_));
+      this, strategy_, onnx_file, &inputs_, &outputs_, &layers_));
   RETURN_IF_ERROR(SetOutputInfos());
 
-  // Should have the same number of layers in both cases
-  assert(strategy_->layers.size() == layers_.size());
-
   // Perform the layer fusion optimization based on the partitioning strategy
   FuseLayers();
 
@@ -152,21 +168,48 @@ LegionModelState::forward(
   // Attach the external memory allocations to the logical regions for the
   // tensors
   const std::vector<FieldID> fields(1, FID_DATA);
-  std::vector<PhysicalRegion> input_regions(inputs.size());
+  std::vector<PhysicalRegion> input_regions;
   for (unsigned idx = 0; idx < inputs.size(); idx++) {
     const InputTensor& input = inputs[idx];
-    assert(input.buffers_.size() == 1);
-    assert(input.buffer_locations_.size() == 1);
-    assert(input.buffer_memories_.size() == 1);
+    assert(!input.buffers_.empty());
+    assert(input.buffer_byte_sizes_.size() == input.buffers_.size());
+    assert(input.buffer_locations_.size() == input.buffers_.size());
+    assert(input.buffer_memories_.size() == input.buffers_.size());
     assert(input.strides_.size() == inputs_[idx].second->bounds.size());
     LogicalRegion region = inputs_[idx].second->region[instance_index];
-    AttachLauncher launcher(
-        LEGION_EXTERNAL_INSTANCE, region, region, false /*restricted*/,
-        false /*mapped*/);
-    launcher.attach_array_soa(
-        const_cast<void*>(input.buffers_[0]), false /*not column major*/,
-        fields, input.buffer_memories_[0]);
-    input_regions[idx] = runtime->attach_external_resource(ctx, launcher);
+    if (input.buffers_.size() == 1) {
+      AttachLauncher launcher(
+          LEGION_EXTERNAL_INSTANCE, region, region, false /*restricted*/,
+          false /*mapped*/);
+      launcher.attach_array_soa(
+          const_cast<void*>(input.buffers_[0]), false /*not column major*/,
+          fields, input.buffer_memories_[0]);
+      input_regions.push_back(
+          runtime->attach_external_resource(ctx, launcher));
+      continue;
+    }
+    // Attach each buffer in place to the rows of the tensor that it holds
+    // and let the consumers gather the pieces rather than first copying
+    // them into one contiguous buffer
+    std::vector<size_t> rows(input.buffers_.size());
+    for (unsigned idx2 = 0; idx2 < input.buffers_.size(); idx2++) {
+      assert((input.buffer_byte_sizes_[idx2] % input.strides_[0]) == 0);
+      rows[idx2] = input.buffer_byte_sizes_[idx2] / input.strides_[0];
+    }
+    LogicalPartition partition = instance->find_or_create_batch_partition(
+        inputs_[idx].second, rows);
+    for (unsigned idx2 = 0; idx2 < input.buffers_.size(); idx2++) {
+      LogicalRegion piece = runtime->get_logical_subregion_by_color(
+          ctx, partition, DomainPoint(coord_t(idx2)));
+      AttachLauncher launcher(
+          LEGION_EXTERNAL_INSTANCE, piece, region, false /*restricted*/,
+          false /*mapped*/);
+      launcher.attach_array_soa(
+          const_cast<void*>(input.buffers_[idx2]), false /*not column major*/,
+          fields, input.buffer_memories_[idx2]);
+      input_regions.push_back(
+          runtime->attach_external_resource(ctx, launcher));
+    }
   }
   std::vector<PhysicalRegion> output_regions(outputs.size());
   for (unsigned idx = 0; idx < outputs.size(); idx++) {
@@ -293,6 +336,33 @@ LegionModelState::ValidateModelConfig()
     // FIXME add check for other model config fields that not yet supported
   }
 
+  {
+    // Optional 'pipeline_depth' parameter enabling the asynchronous
+    // execution of up to that many batches per instance
+    triton::common::TritonJson::Value params;
+    triton::common::TritonJson::Value depth;
+    if (ModelConfig().Find("parameters", &params) &&
+        params.Find("pipeline_depth", &depth)) {
+      std::string depth_str;
+      RETURN_IF_ERROR(depth.MemberAsString("string_value", &depth_str));
+      int value = 0;
+      try {
+        value = std::stoi(depth_str);
+      }
+      catch (const std::exception&) {
+      }
+      if (value < 1) {
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string(
+                 "'pipeline_depth' must be a positive integer for model '" +
+                 Name() + "', got '" + depth_str + "'")
+                 .c_str()));
+      }
+      pipeline_depth_ = value;
+    }
+  }
+
   {
     // Build a map from name to tensors of the model for easy lookup
     std::map<std::string, Tensor*> tensors;
@@ -514,7 +584,9 @@ LegionModelState::LoadLayers(void) const
   std::vector<Realm::Event> loaded_events;
   for (unsigned idx1 = 0; idx1 < layers_.size(); idx1++) {
     Operator* op = layers_[idx1];
-    const LayerStrategy* config = strategy_->layers[idx1];
+    // Layers don't line up with the strategy when the parser folded nodes
+    // away, each layer keeps the strategy of the node it came from
+    const LayerStrategy* config = op->strategy;
     for (unsigned idx2 = 0; idx2 < config->nProcs; idx2++) {
       Realm::Processor proc = config->local_processors[idx2];
       loaded_events.push_back(runtime_->LoadLayer(proc, op));
@@ -537,7 +609,7 @@ LegionModelState::FreeLayers(void) const
   std::vector<Realm::Event> freed_events;
   for (unsigned idx1 = 0; idx1 < layers_.size(); idx1++) {
     Operator* op = layers_[idx1];
-    const LayerStrategy* config = strategy_->layers[idx1];
+    const LayerStrategy* config = op->strategy;
     for (unsigned idx2 = 0; idx2 < config->nProcs; idx2++) {
       Realm::Processor proc = config->local_processors[idx2];
       freed_events.push_back(runtime_->FreeLayer(proc, op));
@@ -64,13 +64,16 @@ class LegionModelState : public BackendModel {
   {
     return output_infos_;
   }
+  // Maximum number of batches an instance may have staged or executing at
+  // the same time, 1 runs each batch to completion before returning
+  unsigned PipelineDepth() const { return pipeline_depth_; }
 
  private:
   LegionModelState(
       TRITONBACKEND_Model* triton_model, LegionTritonRuntime* runtime,
       const std::string& n, uint64_t v)
       : BackendModel(triton_model), runtime_(runtime), name(n), version(v),
-        strategy_(nullptr)
+        strategy_(nullptr), pipeline_depth_(1)
   {
   }
 
@@ -95,6 +98,7 @@ class LegionModelState : public BackendModel {
       outputs_;  // We do NOT own these tensors
   std::vector<Operator*> layers_;
   PartitionStrategy* strategy_;
+  unsigned pipeline_depth_;
   std::vector<LegionModelInstance*> instances_;
   // Output information parsed from 'outputs_' for easier access,
   // use to interact with Triton APIs.
@@ -20,14 +20,24 @@
 // Legion layers
 #include "operators/binary.h"
 #include "operators/conv2d.h"
+#include "operators/linear.h"
+#include "operators/matmul.h"
 #include "operators/pool2d.h"
+#include "operators/reshape.h"
 #include "operators/softmax.h"
 #include "operators/unary.h"
 
+#include <fcntl.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/text_format.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <set>
 #include <string>
 #include "triton/backend/backend_common.h"
 
@@ -121,8 +131,433 @@ ReadTextFile(const std::string& path, std::string* contents)
   return nullptr;  // success
 }
 
+// Returns whether the block of a tensor within 'local_bounds' is a single
+// contiguous range of its packed row-major layout
+bool
+IsContiguousBlock(
+    const std::vector<size_t>& bounds, const Legion::Domain& local_bounds)
+{
+  int dim_idx = bounds.size() - 1;
+  // Inner dimensions must be complete...
+  while ((dim_idx > 0) && (local_bounds.lo()[dim_idx] == 0) &&
+         (size_t(local_bounds.hi()[dim_idx] + 1) == bounds[dim_idx]))
+    --dim_idx;
+  // ...and the ones outside of the first partial dimension singular
+  for (--dim_idx; dim_idx >= 0; --dim_idx) {
+    if (local_bounds.lo()[dim_idx] != local_bounds.hi()[dim_idx])
+      return false;
+  }
+  return true;
+}
+
+size_t
+Volume(const std::vector<size_t>& dims)
+{
+  size_t volume = 1;
+  for (const auto dim : dims) volume *= dim;
+  return volume;
+}
+
+std::vector<size_t>
+ProtoDims(const onnx::TensorProto& proto)
+{
+  return std::vector<size_t>(proto.dims().begin(), proto.dims().end());
+}
+
+// Read the values of a float tensor stored in the model file, tensors in
+// external data are left alone by the graph simplification
+bool
+ReadFloatData(const onnx::TensorProto& proto, std::vector<float>* values)
+{
+  if ((proto.data_type() != onnx::TensorProto::FLOAT) ||
+      (proto.data_location() == onnx::TensorProto::EXTERNAL))
+    return false;
+  const size_t volume = Volume(ProtoDims(proto));
+  if (proto.has_raw_data()) {
+    if (proto.raw_data().size() != (volume * sizeof(float)))
+      return false;
+    values->resize(volume);
+    std::memcpy(
+        values->data(), proto.raw_data().data(), volume * sizeof(float));
+  } else {
+    if (size_t(proto.float_data().size()) != volume)
+      return false;
+    values->assign(proto.float_data().begin(), proto.float_data().end());
+  }
+  return true;
+}
+
+void
+WriteFloatData(const std::vector<float>& values, onnx::TensorProto* proto)
+{
+  proto->set_data_type(onnx::TensorProto::FLOAT);
+  proto->clear_float_data();
+  proto->set_raw_data(
+      reinterpret_cast<const char*>(values.data()),
+      values.size() * sizeof(float));
+}
+
+const onnx::AttributeProto*
+FindAttribute(const onnx::NodeProto& node, const std::string& name)
+{
+  for (const auto& attribute : node.attribute()) {
+    if (attribute.name() == name)
+      return &attribute;
+  }
+  return nullptr;
+}
+
 }  // namespace
 
+// Evaluate 'node' on the host if all of its inputs are known constants, the
+// result is appended to the initializers of 'graph'. Returns whether the node
+// has been folded.
+bool
+FoldConstantNode(
+    const onnx::NodeProto& node,
+    std::map<std::string, const onnx::TensorProto*>* constants,
+    onnx::GraphProto* graph)
+{
+  if (node.output_size() != 1)
+    return false;
+  std::unique_ptr<onnx::TensorProto> result(new onnx::TensorProto());
+  if (node.op_type() == "Constant") {
+    if (node.attribute_size() != 1)
+      return false;
+    const auto& attribute = node.attribute(0);
+    if (attribute.name() == "value") {
+      result->CopyFrom(attribute.t());
+    } else if (attribute.name() == "value_float") {
+      result->set_data_type(onnx::TensorProto::FLOAT);
+      result->add_float_data(attribute.f());
+    } else if (attribute.name() == "value_floats") {
+      result->set_data_type(onnx::TensorProto::FLOAT);
+      result->add_dims(attribute.floats_size());
+      *result->mutable_float_data() = attribute.floats();
+    } else if (attribute.name() == "value_int") {
+      result->set_data_type(onnx::TensorProto::INT64);
+      result->add_int64_data(attribute.i());
+    } else if (attribute.name() == "value_ints") {
+      result->set_data_type(onnx::TensorProto::INT64);
+      result->add_dims(attribute.ints_size());
+      *result->mutable_int64_data() = attribute.ints();
+    } else {
+      return false;
+    }
+  } else {
+    if (node.input_size() == 0)
+      return false;
+    std::vector<const onnx::TensorProto*> inputs;
+    for (const auto& input : node.input()) {
+      auto it = constants->find(input);
+      if (it == constants->end())
+        return false;
+      inputs.emplace_back(it->second);
+    }
+    if (node.op_type() == "Identity") {
+      result->CopyFrom(*inputs[0]);
+    } else if (node.op_type() == "Reshape") {
+      const auto* allow_zero = FindAttribute(node, "allowzero");
+      std::vector<int64_t> shape;
+      std::vector<size_t> dims;
+      if ((inputs.size() != 2) || !ReadInt64Data(*inputs[1], &shape) ||
+          !ReshapeDims(
+              ProtoDims(*inputs[0]), shape,
+              (allow_zero != nullptr) && (allow_zero->i() != 0), &dims))
+        return false;
+      result->CopyFrom(*inputs[0]);
+      result->clear_dims();
+      for (const auto dim : dims) result->add_dims(dim);
+    } else if (
+        (node.op_type() == "Sqrt") || (node.op_type() == "Reciprocal")) {
+      std::vector<float> values;
+      if (!ReadFloatData(*inputs[0], &values))
+        return false;
+      const bool is_sqrt = (node.op_type() == "Sqrt");
+      for (auto& value : values)
+        value = is_sqrt ? std::sqrt(value) : (1.f / value);
+      *result->mutable_dims() = inputs[0]->dims();
+      WriteFloatData(values, result.get());
+    } else if (
+        (node.op_type() == "Add") || (node.op_type() == "Sub") ||
+        (node.op_type() == "Mul") || (node.op_type() == "Div")) {
+      // Same shapes or a scalar operand, like the layers they replace. Any
+      // other broadcast is left to the layers, equal volumes do not imply
+      // equal shapes ([1, N] and [N, 1])
+      std::vector<float> lhs, rhs;
+      if ((inputs.size() != 2) || !ReadFloatData(*inputs[0], &lhs) ||
+          !ReadFloatData(*inputs[1], &rhs))
+        return false;
+      const bool same_dims = (ProtoDims(*inputs[0]) == ProtoDims(*inputs[1]));
+      // A single value broadcasts to the other operand's shape as long as it
+      // does not add dimensions to it
+      const bool lhs_scalar =
+          (lhs.size() == 1) &&
+          (inputs[0]->dims_size() <= inputs[1]->dims_size());
+      const bool rhs_scalar =
+          (rhs.size() == 1) &&
+          (inputs[1]->dims_size() <= inputs[0]->dims_size());
+      if (!same_dims && !lhs_scalar && !rhs_scalar)
+        return false;
+      std::vector<float> values(std::max(lhs.size(), rhs.size()));
+      for (size_t idx = 0; idx < values.size(); ++idx) {
+        const float a = lhs[(lhs.size() == 1) ? 0 : idx];
+        const float b = rhs[(rhs.size() == 1) ? 0 : idx];
+        switch (node.op_type()[0]) {
+          case 'A':
+            values[idx] = a + b;
+            break;
+          case 'S':
+            values[idx] = a - b;
+            break;
+          case 'M':
+            values[idx] = a * b;
+            break;
+          default:
+            values[idx] = a / b;
+            break;
+        }
+      }
+      *result->mutable_dims() =
+          inputs[(!same_dims && lhs_scalar) ? 1 : 0]->dims();
+      WriteFloatData(values, result.get());
+    } else {
+      return false;
+    }
+  }
+  result->set_name(node.output(0));
+  auto initializer = graph->add_initializer();
+  initializer->Swap(result.get());
+  (*constants)[node.output(0)] = initializer;
+  return true;
+}
+
+namespace {
+
+// Fold 'bn' into the weight and bias of the convolution 'conv' that produces
+// its input:
+//   W' = W * s, b' = (b - mean) * s + beta, with s = scale / sqrt(var + eps)
+// Returns whether the node has been folded.
+bool
+FoldBatchNormalization(
+    const onnx::NodeProto& bn, onnx::NodeProto* conv,
+    std::map<std::string, const onnx::TensorProto*>* constants,
+    onnx::GraphProto* graph)
+{
+  if ((bn.input_size() != 5) || (bn.output_size() != 1) ||
+      (conv->input_size() < 2))
+    return false;
+  float epsilon = 1e-5f;
+  for (const auto& attribute : bn.attribute()) {
+    if (attribute.name() == "epsilon")
+      epsilon = attribute.f();
+    else if (
+        ((attribute.name() == "training_mode") && (attribute.i() != 0)) ||
+        ((attribute.name() == "spatial") && (attribute.i() != 1)))
+      return false;
+  }
+  std::vector<float> params[4];
+  for (int idx = 0; idx < 4; ++idx) {
+    auto it = constants->find(bn.input(idx + 1));
+    if ((it == constants->end()) || !ReadFloatData(*it->second, &params[idx]))
+      return false;
+  }
+  const std::vector<float>& scale = params[0];
+  const std::vector<float>& beta = params[1];
+  const std::vector<float>& mean = params[2];
+  const std::vector<float>& var = params[3];
+  auto weight_it = constants->find(conv->input(1));
+  std::vector<float> weight;
+  if ((weight_it == constants->end()) ||
+      !ReadFloatData(*weight_it->second, &weight) ||
+      (weight_it->second->dims_size() == 0))
+    return false;
+  const size_t channels = weight_it->second->dims(0);
+  std::vector<float> bias(channels, 0.f);
+  if (conv->input_size() > 2) {
+    auto bias_it = constants->find(conv->input(2));
+    if ((bias_it == constants->end()) ||
+        !ReadFloatData(*bias_it->second, &bias))
+      return false;
+  }
+  if ((bias.size() != channels) || (scale.size() != channels) ||
+      (beta.size() != channels) || (mean.size() != channels) ||
+      (var.size() != channels))
+    return false;
+
+  const size_t channel_volume = weight.size() / channels;
+  for (size_t c = 0; c < channels; ++c) {
+    const float s = scale[c] / std::sqrt(var[c] + epsilon);
+    for (size_t idx = 0; idx < channel_volume; ++idx)
+      weight[c * channel_volume + idx] *= s;
+    bias[c] = (bias[c] - mean[c]) * s + beta[c];
+  }
+
+  auto folded_weight = graph->add_initializer();
+  folded_weight->set_name(bn.output(0) + "_folded_weight");
+  *folded_weight->mutable_dims() = weight_it->second->dims();
+  WriteFloatData(weight, folded_weight);
+  auto folded_bias = graph->add_initializer();
+  folded_bias->set_name(bn.output(0) + "_folded_bias");
+  folded_bias->add_dims(channels);
+  WriteFloatData(bias, folded_bias);
+  (*constants)[folded_weight->name()] = folded_weight;
+  (*constants)[folded_bias->name()] = folded_bias;
+
+  conv->set_input(1, folded_weight->name());
+  if (conv->input_size() > 2)
+    conv->set_input(2, folded_bias->name());
+  else
+    conv->add_input(folded_bias->name());
+  conv->set_output(0, bn.output(0));
+  return true;
+}
+
+}  // namespace
+
+bool
+ReadInt64Data(const onnx::TensorProto& proto, std::vector<int64_t>* values)
+{
+  if ((proto.data_type() != onnx::TensorProto::INT64) ||
+      (proto.data_location() == onnx::TensorProto::EXTERNAL))
+    return false;
+  const size_t volume = Volume(ProtoDims(proto));
+  if (proto.has_raw_data()) {
+    if (proto.raw_data().size() != (volume * sizeof(int64_t)))
+      return false;
+    values->resize(volume);
+    std::memcpy(
+        values->data(), proto.raw_data().data(), volume * sizeof(int64_t));
+  } else {
+    if (size_t(proto.int64_data().size()) != volume)
+      return false;
+    values->assign(proto.int64_data().begin(), proto.int64_data().end());
+  }
+  return true;
+}
+
+// Output shape of a Reshape, following the ONNX rules for 0 (copy the input
+// extent unless 'allow_zero') and -1 (inferred from the remaining volume)
+bool
+ReshapeDims(
+    const std::vector<size_t>& input_dims, const std::vector<int64_t>& shape,
+    bool allow_zero, std::vector<size_t>* output_dims)
+{
+  output_dims->clear();
+  int inferred = -1;
+  size_t known_volume = 1;
+  for (size_t idx = 0; idx < shape.size(); ++idx) {
+    if (shape[idx] == -1) {
+      if (inferred >= 0)
+        return false;
+      inferred = idx;
+      output_dims->emplace_back(1);
+    } else if ((shape[idx] == 0) && !allow_zero) {
+      if (idx >= input_dims.size())
+        return false;
+      output_dims->emplace_back(input_dims[idx]);
+      known_volume *= input_dims[idx];
+    } else if (shape[idx] < 0) {
+      return false;
+    } else {
+      output_dims->emplace_back(shape[idx]);
+      known_volume *= shape[idx];
+    }
+  }
+  const size_t volume = Volume(input_dims);
+  if (inferred >= 0) {
+    if ((known_volume == 0) || ((volume % known_volume) != 0))
+      return false;
+    (*output_dims)[inferred] = volume / known_volume;
+    return true;
+  }
+  return (known_volume == volume);
+}
+
+// Output shape of a matrix multiplication of operands with at least 2
+// dimensions, the batch dimensions are broadcast following numpy
+bool
+MatMulDims(
+    const std::vector<size_t>& lhs, const std::vector<size_t>& rhs,
+    std::vector<size_t>* output_dims)
+{
+  if ((lhs.size() < 2) || (rhs.size() < 2) ||
+      (lhs[lhs.size() - 1] != rhs[rhs.size() - 2]))
+    return false;
+  const size_t rank = std::max(lhs.size(), rhs.size());
+  output_dims->assign(rank, 1);
+  for (size_t idx = 0; (idx + 2) < rank; ++idx) {
+    const size_t lhs_offset = rank - lhs.size();
+    const size_t rhs_offset = rank - rhs.size();
+    const size_t lhs_dim = (idx < lhs_offset) ? 1 : lhs[idx - lhs_offset];
+    const size_t rhs_dim = (idx < rhs_offset) ? 1 : rhs[idx - rhs_offset];
+    if ((lhs_dim != rhs_dim) && (lhs_dim != 1) && (rhs_dim != 1))
+      return false;
+    (*output_dims)[idx] = (lhs_dim == 1) ? rhs_dim : lhs_dim;
+  }
+  (*output_dims)[rank - 2] = lhs[lhs.size() - 2];
+  (*output_dims)[rank - 1] = rhs[rhs.size() - 1];
+  return true;
+}
+
+// Private copy-on-write mapping of a whole file. Weights may point into the
+// mapping and are writable like any other local allocation; untouched pages
+// stay shared with the page cache and writes never reach the file.
+class MappedFile {
+ public:
+  static TRITONSERVER_Error* Open(
+      const std::string& path, std::shared_ptr<MappedFile>* file)
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL,
+          (std::string("failed to open external data file ") + path + ": " +
+           strerror(errno))
+              .c_str());
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL,
+          (std::string("failed to stat external data file ") + path + ": " +
+           strerror(errno))
+              .c_str());
+    }
+    void* base = nullptr;
+    if (st.st_size > 0) {
+      // Writable so that weights can be used in place like malloc'ed data
+      base = mmap(
+          nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      if (base == MAP_FAILED) {
+        close(fd);
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INTERNAL,
+            (std::string("failed to map external data file ") + path + ": " +
+             strerror(errno))
+                .c_str());
+      }
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    file->reset(new MappedFile(base, st.st_size));
+    return nullptr;  // success
+  }
+  ~MappedFile()
+  {
+    if (base_ != nullptr)
+      munmap(base_, size_);
+  }
+  const char* data() const { return static_cast<const char*>(base_); }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile(void* base, size_t size) : base_(base), size_(size) {}
+  void* const base_;
+  const size_t size_;
+};
+
 std::map<std::string, OnnxParser::ParseFn_t> OnnxParser::op_type_parser_map_{
     {"Conv", &OnnxParser::ParseConv2D},
     {"Flatten", &OnnxParser::ParseFlatten},
@@ -137,7 +572,11 @@ std::map<std::string, OnnxParser::ParseFn_t> OnnxParser::op_type_parser_map_{
     {"Cast", &OnnxParser::ParseCast},
     {"Tanh", &OnnxParser::ParseTanh},
     {"Reciprocal", &OnnxParser::ParseReciprocal},
-    {"Sqrt", &OnnxParser::ParseSqrt}};
+    {"Sqrt", &OnnxParser::ParseSqrt},
+    {"MatMul", &OnnxParser::ParseMatMul},
+    {"Gemm", &OnnxParser::ParseGemm},
+    {"Reshape", &OnnxParser::ParseReshape},
+    {"BatchNormalization", &OnnxParser::ParseBatchNormalization}};
 
 TRITONSERVER_Error*
 OnnxParser::LoadModel(
@@ -177,10 +616,16 @@ OnnxParser::LoadModel(
   OnnxParser parser(
       find_local_processor_fn, model, strategy, onnx_model, inputs, outputs,
       layers);
+  const size_t separator = onnx_file.find_last_of('/');
+  parser.model_dir_ = (separator == std::string::npos)
+                          ? std::string(".")
+                          : onnx_file.substr(0, separator);
 
   // Note that the weights specified in 'initializer' may also be specified
   // in 'input', thus we should parse in "weight, input" order so that we can
   // filter the weight from input.
+  std::vector<size_t> node_layers;
+  SimplifyGraph(onnx_model.mutable_graph(), &node_layers);
   RETURN_IF_ERROR(parser.ParseWeight(onnx_model.graph()));
   RETURN_IF_ERROR(parser.ParseInput(onnx_model.graph()));
 
@@ -188,8 +633,8 @@ OnnxParser::LoadModel(
     const auto& node = onnx_model.graph().node(idx);
     auto parser_it = op_type_parser_map_.find(node.op_type());
     if (parser_it != op_type_parser_map_.end()) {
-      RETURN_IF_ERROR(
-          (parser_it->second)(&parser, strategy->layers[idx], node));
+      RETURN_IF_ERROR((parser_it->second)(
+          &parser, strategy->layers[node_layers[idx]], node));
     } else {
       return TRITONSERVER_ErrorNew(
           TRITONSERVER_ERROR_UNSUPPORTED,
@@ -228,6 +673,115 @@ OnnxParser::~OnnxParser()
   }
 }
 
+void
+OnnxParser::SimplifyGraph(
+    onnx::GraphProto* onnx_graph, std::vector<size_t>* node_layers)
+{
+  std::map<std::string, const onnx::TensorProto*> constants;
+  for (const auto& initializer : onnx_graph->initializer())
+    constants.emplace(initializer.name(), &initializer);
+  std::set<std::string> graph_outputs;
+  for (const auto& io : onnx_graph->output()) graph_outputs.insert(io.name());
+
+  const int num_nodes = onnx_graph->node_size();
+  std::vector<bool> removed(num_nodes, false);
+  // Tensors to read in place of the outputs of bypassed nodes
+  std::map<std::string, std::string> aliases;
+  // Index of the node producing each tensor
+  std::map<std::string, int> producers;
+  // ONNX requires nodes to be topologically sorted, so a single pass sees the
+  // result of folding the producers before their consumers
+  for (int idx = 0; idx < num_nodes; ++idx) {
+    auto node = onnx_graph->mutable_node(idx);
+    for (int input_idx = 0; input_idx < node->input_size(); ++input_idx) {
+      auto it = aliases.find(node->input(input_idx));
+      if (it != aliases.end())
+        node->set_input(input_idx, it->second);
+    }
+    if ((node->output_size() == 1) &&
+        (graph_outputs.find(node->output(0)) == graph_outputs.end()) &&
+        FoldConstantNode(*node, &constants, onnx_graph)) {
+      removed[idx] = true;
+      continue;
+    }
+    if ((node->op_type() == "Identity") && (node->input_size() == 1) &&
+        (graph_outputs.find(node->output(0)) == graph_outputs.end())) {
+      aliases[node->output(0)] = node->input(0);
+      removed[idx] = true;
+      continue;
+    }
+    auto producer = (node->input_size() > 0) ? producers.find(node->input(0))
+                                             : producers.end();
+    if ((node->op_type() == "BatchNormalization") &&
+        (producer != producers.end()) &&
+        (onnx_graph->node(producer->second).op_type() == "Conv") &&
+        (graph_outputs.find(node->input(0)) == graph_outputs.end())) {
+      // The convolution can only absorb the normalization if nothing else
+      // reads its output
+      bool shared = false;
+      for (int other = producer->second + 1; other < num_nodes; ++other) {
+        if ((other == idx) || removed[other])
+          continue;
+        for (const auto& input : onnx_graph->node(other).input()) {
+          auto alias = aliases.find(input);
+          if (((alias != aliases.end()) ? alias->second : input) ==
+              node->input(0))
+            shared = true;
+        }
+      }
+      if (!shared &&
+          FoldBatchNormalization(
+              *node, onnx_graph->mutable_node(producer->second), &constants,
+              onnx_graph)) {
+        producers[node->output(0)] = producer->second;
+        removed[idx] = true;
+        continue;
+      }
+    }
+    if ((node->op_type() == "Reshape") && (producer != producers.end()) &&
+        (onnx_graph->node(producer->second).op_type() == "Reshape")) {
+      // Only the last shape of a chain matters, unless it copies extents
+      // from its input
+      const auto* allow_zero = FindAttribute(*node, "allowzero");
+      auto shape = constants.find(node->input_size() > 1 ? node->input(1) : "");
+      std::vector<int64_t> shape_values;
+      if ((shape != constants.end()) &&
+          ReadInt64Data(*shape->second, &shape_values) &&
+          (((allow_zero != nullptr) && (allow_zero->i() != 0)) ||
+           (std::find(shape_values.begin(), shape_values.end(), 0) ==
+            shape_values.end())))
+        node->set_input(0, onnx_graph->node(producer->second).input(0));
+    }
+    for (const auto& output : node->output()) producers[output] = idx;
+  }
+
+  // Drop the nodes that no longer contribute to any output
+  std::set<std::string> live(graph_outputs);
+  for (int idx = num_nodes - 1; idx >= 0; --idx) {
+    if (removed[idx])
+      continue;
+    const auto& node = onnx_graph->node(idx);
+    bool used = false;
+    for (const auto& output : node.output())
+      used = used || (live.find(output) != live.end());
+    if (!used) {
+      removed[idx] = true;
+      continue;
+    }
+    for (const auto& input : node.input()) live.insert(input);
+  }
+
+  google::protobuf::RepeatedPtrField<onnx::NodeProto> nodes;
+  node_layers->clear();
+  for (int idx = 0; idx < num_nodes; ++idx) {
+    if (removed[idx])
+      continue;
+    nodes.Add()->Swap(onnx_graph->mutable_node(idx));
+    node_layers->emplace_back(idx);
+  }
+  onnx_graph->mutable_node()->Swap(&nodes);
+}
+
 TRITONSERVER_Error*
 OnnxParser::ParseWeight(const onnx::GraphProto& onnx_graph)
 {
@@ -306,48 +860,52 @@ OnnxParser::LoadWeight(
     std::function<Legion::Rect<Dim>(Realm::Processor)> local_bound_fn,
     const onnx::TensorProto* weight_proto, Weights* weight)
 {
+  const size_t element_size = sizeof_datatype(weight->type);
+  size_t total_byte_size = element_size;
+  std::vector<size_t> strides(weight->bounds.size());
+  for (int dim_idx = (weight->bounds.size() - 1); dim_idx >= 0; --dim_idx) {
+    strides[dim_idx] = total_byte_size;
+    total_byte_size *= weight->bounds[dim_idx];
+  }
+
+  // Whether every local processor holds the whole tensor
+  bool replicated = true;
+  std::vector<size_t> local_procs;
   const auto& processors = find_local_processor_fn_(strategy->kind);
   for (const auto& proc : processors) {
     if (strategy->is_local_processor(proc)) {
       size_t proc_idx = strategy->find_local_offset(proc);
       weight->local_bounds[proc_idx] = Legion::Domain(local_bound_fn(proc));
       const auto& local_bounds = weight->local_bounds[proc_idx];
-      size_t total_byte_size = sizeof_datatype(weight->type);
+      size_t local_byte_size = element_size;
       for (int dim_idx = (weight->bounds.size() - 1); dim_idx >= 0; --dim_idx) {
-        weight->local_strides[proc_idx][dim_idx] = total_byte_size;
-        total_byte_size *=
+        weight->local_strides[proc_idx][dim_idx] = local_byte_size;
+        local_byte_size *=
             ((local_bounds.hi()[dim_idx] + 1) - local_bounds.lo()[dim_idx]);
       }
-      weight->local_allocation[proc_idx] = std::malloc(total_byte_size);
-      if (weight->local_allocation[proc_idx] == nullptr) {
-        return TRITONSERVER_ErrorNew(
-            TRITONSERVER_ERROR_INTERNAL,
-            (std::string(
-                 "Failed to allocate local system memory for weight for '" +
-                 std::to_string(weight->owner->op_type) + "' layer named '" +
-                 weight->owner->op_name + "'")
-                 .c_str()));
-      }
+      if (local_byte_size != total_byte_size)
+        replicated = false;
+      local_procs.emplace_back(proc_idx);
     }
   }
 
-  // [FIXME] need to expand to be able to load from external files
+  std::shared_ptr<MappedFile> mapping;
+  const char* weight_ptr = nullptr;
   if (weight_proto->has_data_location() &&
       (weight_proto->data_location() ==
        onnx::TensorProto::DataLocation::TensorProto_DataLocation_EXTERNAL)) {
-    return TRITONSERVER_ErrorNew(
-        TRITONSERVER_ERROR_UNSUPPORTED,
-        "Loading weight stored out of ONNX file is currently not supported");
+    RETURN_IF_ERROR(
+        MapExternalData(weight_proto, total_byte_size, &mapping, &weight_ptr));
+  } else if (weight_proto->has_raw_data()) {
+    weight_ptr = weight_proto->raw_data().data();
   }
-  const void* weight_ptr = weight_proto->has_data_location()
-                               ? nullptr
-                               : weight_proto->raw_data().data();
   // boolean value stored in raw_data is represent in 1 byte (00000001 for true,
   // 00000000 for false), thus special handling is required
   // https://github.com/onnx/onnx/blob/v1.9.0/onnx/onnx-ml.proto#L558
   bool is_raw_boolean =
       ((weight_ptr != nullptr) && (weight->type == DT_BOOLEAN));
   if (weight_ptr == nullptr) {
+    const void* typed_ptr = nullptr;
     switch (weight->type) {
       case DT_INT8:
       case DT_UINT8:
@@ -356,20 +914,20 @@ OnnxParser::LoadWeight(
       case DT_UINT16:
       case DT_HALF:
       case DT_INT32:
-        weight_ptr = weight_proto->int32_data().data();
+        typed_ptr = weight_proto->int32_data().data();
         break;
       case DT_FLOAT:
-        weight_ptr = weight_proto->float_data().data();
+        typed_ptr = weight_proto->float_data().data();
         break;
       case DT_DOUBLE:
-        weight_ptr = weight_proto->double_data().data();
+        typed_ptr = weight_proto->double_data().data();
         break;
       case DT_INT64:
-        weight_ptr = weight_proto->int64_data().data();
+        typed_ptr = weight_proto->int64_data().data();
         break;
       case DT_UINT32:
       case DT_UINT64:
-        weight_ptr = weight_proto->uint64_data().data();
+        typed_ptr = weight_proto->uint64_data().data();
         break;
       default:
         return TRITONSERVER_ErrorNew(
@@ -377,25 +935,115 @@ OnnxParser::LoadWeight(
             "Loading weight of unsupported data type");
         break;
     }
+    weight_ptr = reinterpret_cast<const char*>(typed_ptr);
   }
-  size_t total_byte_size = sizeof_datatype(weight->type);
-  std::vector<size_t> strides(weight->bounds.size());
-  for (int dim_idx = (weight->bounds.size() - 1); dim_idx >= 0; --dim_idx) {
-    strides[dim_idx] = total_byte_size;
-    total_byte_size *= weight->bounds[dim_idx];
+
+  // A replicated weight is loaded once and shared by all the local
+  // processors. Mapped data is used in place when suitably aligned, other
+  // data has to be copied as the ONNX model is released after parsing.
+  if (replicated && !is_raw_boolean && !local_procs.empty()) {
+    std::shared_ptr<void> storage;
+    void* allocation = nullptr;
+    if ((mapping != nullptr) &&
+        ((reinterpret_cast<uintptr_t>(weight_ptr) % element_size) == 0)) {
+      allocation = const_cast<char*>(weight_ptr);
+      storage = mapping;
+    } else {
+      allocation = std::malloc(total_byte_size);
+      if (allocation == nullptr) {
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INTERNAL,
+            (std::string(
+                 "Failed to allocate local system memory for weight for '" +
+                 std::to_string(weight->owner->op_type) + "' layer named '" +
+                 weight->owner->op_name + "'")
+                 .c_str()));
+      }
+      std::memcpy(allocation, weight_ptr, total_byte_size);
+      storage.reset(allocation, std::free);
+    }
+    for (const size_t proc_idx : local_procs) {
+      weight->local_allocation[proc_idx] = allocation;
+      weight->local_storage[proc_idx] = storage;
+    }
+    return nullptr;  // success
   }
-  for (size_t proc_idx = 0; proc_idx < MAX_LOCAL_PROCS; ++proc_idx) {
-    if (weight->local_allocation[proc_idx] != nullptr) {
+
+  for (const size_t proc_idx : local_procs) {
+    const auto& local_bounds = weight->local_bounds[proc_idx];
+    const size_t local_byte_size = element_size * local_bounds.get_volume();
+    weight->local_allocation[proc_idx] = std::malloc(local_byte_size);
+    if (weight->local_allocation[proc_idx] == nullptr) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL,
+          (std::string(
+               "Failed to allocate local system memory for weight for '" +
+               std::to_string(weight->owner->op_type) + "' layer named '" +
+               weight->owner->op_name + "'")
+               .c_str()));
+    }
+    if (!is_raw_boolean && IsContiguousBlock(weight->bounds, local_bounds)) {
+      // The local block is one range of the source, copy it in bulk
+      size_t src_offset = 0;
+      for (size_t dim_idx = 0; dim_idx < strides.size(); ++dim_idx)
+        src_offset += strides[dim_idx] * local_bounds.lo()[dim_idx];
+      std::memcpy(
+          weight->local_allocation[proc_idx], weight_ptr + src_offset,
+          local_byte_size);
+    } else {
       RETURN_IF_ERROR(SetElementData(
-          strides, weight->local_bounds[proc_idx],
-          weight->local_strides[proc_idx], 0, is_raw_boolean,
-          reinterpret_cast<const char*>(weight_ptr),
+          strides, local_bounds, weight->local_strides[proc_idx], 0,
+          is_raw_boolean, weight_ptr,
           reinterpret_cast<char*>(weight->local_allocation[proc_idx])));
     }
   }
   return nullptr;  // success
 }
 
+TRITONSERVER_Error*
+OnnxParser::MapExternalData(
+    const onnx::TensorProto* weight_proto, size_t byte_size,
+    std::shared_ptr<MappedFile>* storage, const char** data)
+{
+  std::string location;
+  size_t offset = 0;
+  size_t length = byte_size;
+  for (const auto& entry : weight_proto->external_data()) {
+    if (entry.key() == "location")
+      location = entry.value();
+    else if (entry.key() == "offset")
+      offset = std::stoull(entry.value());
+    else if (entry.key() == "length")
+      length = std::stoull(entry.value());
+  }
+  if (location.empty()) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("External data of weight '") + weight_proto->name() +
+         "' does not specify its location")
+            .c_str());
+  }
+  const std::string path = JoinPath({model_dir_, location});
+  auto finder = mapped_files_.find(path);
+  if (finder == mapped_files_.end()) {
+    std::shared_ptr<MappedFile> file;
+    RETURN_IF_ERROR(MappedFile::Open(path, &file));
+    finder = mapped_files_.emplace(path, file).first;
+  }
+  const std::shared_ptr<MappedFile>& file = finder->second;
+  if ((length != byte_size) || (offset > file->size()) ||
+      (length > (file->size() - offset))) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("External data of weight '") + weight_proto->name() +
+         "' does not fit in " + path)
+            .c_str());
+  }
+  *storage = file;
+  *data = file->data() + offset;
+  return nullptr;  // success
+}
+
 TRITONSERVER_Error*
 OnnxParser::SetElementData(
     const std::vector<size_t>& strides, const Legion::Domain& local_bounds,
@@ -1482,4 +2130,384 @@ OnnxParser::ParseSqrt(
   return nullptr;  // success
 }
 
+TRITONSERVER_Error*
+OnnxParser::ParseMatMul(
+    OnnxParser* parser, const LayerStrategy* strategy,
+    const onnx::NodeProto& onnx_node)
+{
+  if (onnx_node.input().size() != 2) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (onnx_node.op_type() + std::string("' layer named '") +
+         onnx_node.name() + std::string("' must have 2 inputs, got ") +
+         std::to_string(onnx_node.input().size()))
+            .c_str());
+  }
+
+  // A constant right-hand side is a weight rather than an operand
+  if ((parser->tensors_.find(onnx_node.input(1)) == parser->tensors_.end()) &&
+      (parser->weights_.find(onnx_node.input(1)) != parser->weights_.end()))
+    return parser->ParseLinear(strategy, onnx_node, false /*transposed*/);
+
+  Tensor* inputs[2];
+  for (int idx = 0; idx < 2; ++idx) {
+    auto input_it = parser->tensors_.find(onnx_node.input(idx));
+    if (input_it == parser->tensors_.end()) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_UNSUPPORTED,
+          (std::string("Unable to find tensor '") + onnx_node.input(idx) +
+           "' for '" + onnx_node.op_type() + "' layer named '" +
+           onnx_node.name() +
+           "', the tensor must be specified either as model input or as "
+           "output of layer that precedes this layer, or the second operand "
+           "must be an initializer")
+              .c_str());
+    }
+    inputs[idx] = input_it->second.get();
+  }
+  if (inputs[0]->type != inputs[1]->type) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Non-matching input types: ") +
+         std::to_string(inputs[0]->type) + std::string(" and ") +
+         std::to_string(inputs[1]->type))
+            .c_str());
+  }
+  std::vector<size_t> output_dims;
+  if (!MatMulDims(inputs[0]->bounds, inputs[1]->bounds, &output_dims)) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Input tensors for '") + onnx_node.op_type() +
+         "' layer named '" + onnx_node.name() +
+         "' must have at least 2 dimensions with matching inner dimensions "
+         "and broadcastable batch dimensions")
+            .c_str());
+  }
+
+  std::unique_ptr<MatMul> op(
+      new MatMul(parser->model_, strategy, onnx_node.name().c_str()));
+  std::unique_ptr<Tensor> output(
+      new Tensor(op.get(), inputs[0]->type, output_dims));
+  op->Configure(inputs[0], inputs[1], output.get());
+
+  parser->tensors_.emplace(onnx_node.output(0), std::move(output));
+  parser->layers_->emplace_back(op.release());
+
+  return nullptr;  // success
+}
+
+TRITONSERVER_Error*
+OnnxParser::ParseGemm(
+    OnnxParser* parser, const LayerStrategy* strategy,
+    const onnx::NodeProto& onnx_node)
+{
+  // Only the form A * B + C is mapped: onto a Linear layer when B is an
+  // initializer, taking C as its bias when C is a constant vector, and onto
+  // a MatMul layer otherwise, followed by an Add layer for any remaining C
+  bool trans_b = false;
+  for (const auto& attribute : onnx_node.attribute()) {
+    bool supported = true;
+    if ((attribute.name() == "alpha") || (attribute.name() == "beta")) {
+      RETURN_IF_TYPE_MISMATCH(
+          onnx_node, attribute,
+          onnx::AttributeProto::AttributeType::
+              AttributeProto_AttributeType_FLOAT);
+      supported = (attribute.f() == 1.f);
+    } else if (attribute.name() == "transA") {
+      RETURN_IF_TYPE_MISMATCH(
+          onnx_node, attribute,
+          onnx::AttributeProto::AttributeType::
+              AttributeProto_AttributeType_INT);
+      supported = (attribute.i() == 0);
+    } else if (attribute.name() == "transB") {
+      RETURN_IF_TYPE_MISMATCH(
+          onnx_node, attribute,
+          onnx::AttributeProto::AttributeType::
+              AttributeProto_AttributeType_INT);
+      trans_b = (attribute.i() != 0);
+    } else {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG,
+          (std::string("Unknown attribute '") + attribute.name() + "' for '" +
+           onnx_node.op_type() + "' layer named '" + onnx_node.name() + "'")
+              .c_str());
+    }
+    if (!supported) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_UNSUPPORTED,
+          (std::string("Unsupported attribute value for attribute '") +
+           attribute.name() + "' in '" + onnx_node.op_type() +
+           "' layer named '" + onnx_node.name() +
+           "', currently supported value is " +
+           ((attribute.name()[0] == 't') ? "0" : "1.0"))
+              .c_str());
+    }
+  }
+  if ((onnx_node.input().size() != 2) && (onnx_node.input().size() != 3)) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (onnx_node.op_type() + std::string("' layer named '") +
+         onnx_node.name() + std::string("' must have 2 or 3 inputs, got ") +
+         std::to_string(onnx_node.input().size()))
+            .c_str());
+  }
+  const bool constant_b =
+      (parser->tensors_.find(onnx_node.input(1)) == parser->tensors_.end()) &&
+      (parser->weights_.find(onnx_node.input(1)) != parser->weights_.end());
+  if (trans_b && !constant_b) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNSUPPORTED,
+        (std::string("Unsupported attribute value for attribute 'transB' ") +
+         "in '" + onnx_node.op_type() + "' layer named '" + onnx_node.name() +
+         "', B can only be transposed when it is an initializer")
+            .c_str());
+  }
+  if (onnx_node.input().size() == 2) {
+    if (constant_b)
+      return parser->ParseLinear(strategy, onnx_node, trans_b);
+    return ParseMatMul(parser, strategy, onnx_node);
+  }
+  if (constant_b) {
+    // C becomes the bias of the layer if it is a constant of shape (N)
+    // or (1, N), anything else is broadcast by the Add layer below
+    auto bias_it = parser->weights_.find(onnx_node.input(2));
+    if ((bias_it != parser->weights_.end()) &&
+        (parser->tensors_.find(onnx_node.input(2)) == parser->tensors_.end())) {
+      const auto& weight_dims = parser->weights_.at(onnx_node.input(1))->dims();
+      const auto& bias_dims = bias_it->second->dims();
+      const int64_t out_dim =
+          (weight_dims.size() == 2) ? weight_dims[trans_b ? 0 : 1] : -1;
+      if (((bias_dims.size() == 1) && (bias_dims[0] == out_dim)) ||
+          ((bias_dims.size() == 2) && (bias_dims[0] == 1) &&
+           (bias_dims[1] == out_dim)))
+        return parser->ParseLinear(strategy, onnx_node, trans_b);
+    }
+  }
+
+  onnx::NodeProto matmul_node;
+  matmul_node.set_op_type("MatMul");
+  matmul_node.set_name(onnx_node.name() + "_matmul");
+  matmul_node.add_input(onnx_node.input(0));
+  matmul_node.add_input(onnx_node.input(1));
+  matmul_node.add_output(onnx_node.output(0) + "_matmul");
+  if (constant_b) {
+    RETURN_IF_ERROR(parser->ParseLinear(strategy, matmul_node, trans_b));
+  } else {
+    RETURN_IF_ERROR(ParseMatMul(parser, strategy, matmul_node));
+  }
+
+  onnx::NodeProto add_node;
+  add_node.set_op_type("Add");
+  add_node.set_name(onnx_node.name());
+  add_node.add_input(matmul_node.output(0));
+  add_node.add_input(onnx_node.input(2));
+  add_node.add_output(onnx_node.output(0));
+  return parser->ParseBinary(strategy, add_node, OperatorType::OP_EW_ADD);
+}
+
+TRITONSERVER_Error*
+OnnxParser::ParseLinear(
+    const LayerStrategy* strategy, const onnx::NodeProto& onnx_node,
+    bool transposed_weight)
+{
+  auto input_it = tensors_.find(onnx_node.input(0));
+  if (input_it == tensors_.end()) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNSUPPORTED,
+        (std::string("Unable to find tensor '") + onnx_node.input(0) +
+         "' for '" + onnx_node.op_type() + "' layer named '" +
+         onnx_node.name() +
+         "', the tensor must be specified either as model input or as "
+         "output of layer that precedes this layer")
+            .c_str());
+  }
+  Tensor* input = input_it->second.get();
+
+  // Weight (defer construction of the tensor, need to be owned by the layer)
+  auto weight_it = weights_.find(onnx_node.input(1));
+  assert(weight_it != weights_.end());
+  const auto& weight_proto = weight_it->second;
+  DataType weight_dt;
+  RETURN_IF_ERROR(OnnxTypeToDataType(weight_proto->data_type(), &weight_dt));
+  std::vector<size_t> weight_dims;
+  for (const auto& dim : weight_proto->dims()) {
+    weight_dims.emplace_back(dim);
+  }
+  if ((input->bounds.size() < 2) || (weight_dims.size() != 2) ||
+      (weight_dims[transposed_weight ? 1 : 0] != input->bounds.back())) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Weight tensor '") + onnx_node.input(1) + "' for '" +
+         onnx_node.op_type() + "' layer named '" + onnx_node.name() +
+         "' must have shape " + (transposed_weight ? "(N, K)" : "(K, N)") +
+         " for an input of at least 2 dimensions with K as the last one")
+            .c_str());
+  }
+  if (weight_dt != input->type) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Non-matching input types: ") +
+         std::to_string(input->type) + std::string(" and ") +
+         std::to_string(weight_dt))
+            .c_str());
+  }
+  if (strategy->dim[strategy->nDims - 1] != 1) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNSUPPORTED,
+        (onnx_node.op_type() + std::string(" layer named '") +
+         onnx_node.name() +
+         "' with a constant operand cannot be partitioned along its last "
+         "dimension")
+            .c_str());
+  }
+  const size_t in_dim = weight_dims[transposed_weight ? 1 : 0];
+  const size_t out_dim = weight_dims[transposed_weight ? 0 : 1];
+
+  // Bias (defer construction of the tensor, need to be owned by the layer)
+  const bool use_bias = (onnx_node.input().size() == 3);
+  const onnx::TensorProto* bias_proto = nullptr;
+  DataType bias_dt;
+  if (use_bias) {
+    auto bias_it = weights_.find(onnx_node.input(2));
+    assert(bias_it != weights_.end());
+    bias_proto = bias_it->second;
+    RETURN_IF_ERROR(OnnxTypeToDataType(bias_proto->data_type(), &bias_dt));
+  }
+
+  // Construct layer
+  std::unique_ptr<Linear> linear_op(new Linear(
+      model_, strategy, in_dim, out_dim, transposed_weight, use_bias,
+      onnx_node.name().c_str()));
+  auto linear_op_ptr = linear_op.get();
+
+  // Finalize weight, bias, and output
+  std::unique_ptr<Weights> weight(
+      new Weights(linear_op.get(), weight_dt, weight_dims));
+  std::unique_ptr<Weights> bias(
+      use_bias ? new Weights(linear_op.get(), bias_dt, {out_dim}) : nullptr);
+  std::vector<size_t> output_dims(input->bounds);
+  output_dims.back() = out_dim;
+  std::unique_ptr<Tensor> output(
+      new Tensor(linear_op.get(), input->type, output_dims));
+
+  linear_op->Configure(input, weight.get(), output.get(), bias.get());
+
+  // Load weight after layer configured as the bound can be computed after that
+  RETURN_IF_ERROR(LoadWeight<2>(
+      strategy,
+      [linear_op_ptr](Realm::Processor proc) {
+        return linear_op_ptr->GetWeightBounds(proc);
+      },
+      weight_proto, weight.get()));
+  if (bias != nullptr) {
+    RETURN_IF_ERROR(LoadWeight<1>(
+        strategy,
+        [linear_op_ptr](Realm::Processor proc) {
+          return linear_op_ptr->GetBiasBounds(proc);
+        },
+        bias_proto, bias.get()));
+  }
+  // Weights are relased here as they are not placed in 'tensors_'
+  weight.release();
+  bias.release();
+
+  tensors_.emplace(onnx_node.output(0), std::move(output));
+  layers_->emplace_back(linear_op.release());
+  return nullptr;  // success
+}
+
+TRITONSERVER_Error*
+OnnxParser::ParseReshape(
+    OnnxParser* parser, const LayerStrategy* strategy,
+    const onnx::NodeProto& onnx_node)
+{
+  bool allow_zero = false;
+  for (const auto& attribute : onnx_node.attribute()) {
+    if (attribute.name() == "allowzero") {
+      RETURN_IF_TYPE_MISMATCH(
+          onnx_node, attribute,
+          onnx::AttributeProto::AttributeType::
+              AttributeProto_AttributeType_INT);
+      allow_zero = (attribute.i() != 0);
+    } else {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG,
+          (std::string("Unknown attribute '") + attribute.name() + "' for '" +
+           onnx_node.op_type() + "' layer named '" + onnx_node.name() + "'")
+              .c_str());
+    }
+  }
+  if (onnx_node.input().size() != 2) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (onnx_node.op_type() + std::string("' layer named '") +
+         onnx_node.name() + std::string("' must have 2 inputs, got ") +
+         std::to_string(onnx_node.input().size()))
+            .c_str());
+  }
+
+  auto input_it = parser->tensors_.find(onnx_node.input(0));
+  if (input_it == parser->tensors_.end()) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Unable to find tensor '") + onnx_node.input(0) +
+         "' for '" + onnx_node.op_type() + "' layer named '" +
+         onnx_node.name() +
+         "', the tensor must be specified either as model input or as output "
+         "of layer that precedes this layer")
+            .c_str());
+  }
+  auto& input = input_it->second;
+
+  // The output shape must be known when the model is loaded
+  std::vector<int64_t> shape;
+  auto shape_it = parser->weights_.find(onnx_node.input(1));
+  if ((shape_it == parser->weights_.end()) ||
+      !ReadInt64Data(*shape_it->second, &shape)) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNSUPPORTED,
+        (std::string("Shape '") + onnx_node.input(1) + "' for '" +
+         onnx_node.op_type() + "' layer named '" + onnx_node.name() +
+         "' must be an INT64 initializer of the model or computable from "
+         "constants")
+            .c_str());
+  }
+  std::vector<size_t> output_dims;
+  if (!ReshapeDims(input->bounds, shape, allow_zero, &output_dims)) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Shape '") + onnx_node.input(1) + "' for '" +
+         onnx_node.op_type() + "' layer named '" + onnx_node.name() +
+         "' is not compatible with input tensor '" + onnx_node.input(0) + "'")
+            .c_str());
+  }
+
+  std::unique_ptr<Reshape> op(
+      new Reshape(parser->model_, strategy, onnx_node.name().c_str()));
+  std::unique_ptr<Tensor> output(
+      new Tensor(op.get(), input->type, output_dims));
+  op->Configure(input.get(), output.get());
+
+  parser->tensors_.emplace(onnx_node.output(0), std::move(output));
+  parser->layers_->emplace_back(op.release());
+
+  return nullptr;  // success
+}
+
+TRITONSERVER_Error*
+OnnxParser::ParseBatchNormalization(
+    OnnxParser* parser, const LayerStrategy* strategy,
+    const onnx::NodeProto& onnx_node)
+{
+  // Any batch normalization that could be folded into the convolution
+  // before it is gone by now
+  return TRITONSERVER_ErrorNew(
+      TRITONSERVER_ERROR_UNSUPPORTED,
+      (onnx_node.op_type() + std::string(" layer named '") + onnx_node.name() +
+       "' is only supported in inference mode with constant parameters, "
+       "directly following a 'Conv' layer with constant weights that it can "
+       "be folded into")
+          .c_str());
+}
+
 }}}  // namespace triton::backend::legion
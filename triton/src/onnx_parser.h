@@ -13,6 +13,8 @@
  * limitations under the License.
  */
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include "model.h"
@@ -24,6 +26,27 @@
 
 namespace triton { namespace backend { namespace legion {
 
+class MappedFile;
+
+// Shape helpers shared with the strategy search, which estimates the layers
+// before the model is parsed
+bool ReadInt64Data(
+    const onnx::TensorProto& proto, std::vector<int64_t>* values);
+bool ReshapeDims(
+    const std::vector<size_t>& input_dims, const std::vector<int64_t>& shape,
+    bool allow_zero, std::vector<size_t>* output_dims);
+bool MatMulDims(
+    const std::vector<size_t>& lhs, const std::vector<size_t>& rhs,
+    std::vector<size_t>* output_dims);
+
+// Graph simplification run before the layers are parsed: evaluates 'node'
+// when all of its inputs are in 'constants' and appends the result to the
+// initializers of 'graph'. Returns whether the node has been folded.
+bool FoldConstantNode(
+    const onnx::NodeProto& node,
+    std::map<std::string, const onnx::TensorProto*>* constants,
+    onnx::GraphProto* graph);
+
 class OnnxParser {
  public:
   static TRITONSERVER_Error* LoadModel(
@@ -89,6 +112,26 @@ class OnnxParser {
   static TRITONSERVER_Error* ParseSqrt(
       OnnxParser* parser, const LayerStrategy* strategy,
       const onnx::NodeProto& onnx_node);
+  static TRITONSERVER_Error* ParseMatMul(
+      OnnxParser* parser, const LayerStrategy* strategy,
+      const onnx::NodeProto& onnx_node);
+  static TRITONSERVER_Error* ParseGemm(
+      OnnxParser* parser, const LayerStrategy* strategy,
+      const onnx::NodeProto& onnx_node);
+  static TRITONSERVER_Error* ParseReshape(
+      OnnxParser* parser, const LayerStrategy* strategy,
+      const onnx::NodeProto& onnx_node);
+  static TRITONSERVER_Error* ParseBatchNormalization(
+      OnnxParser* parser, const LayerStrategy* strategy,
+      const onnx::NodeProto& onnx_node);
+
+  // Rewrite the graph before any layer is created: evaluate nodes whose
+  // inputs are all constant, fold batch normalization into the preceding
+  // convolution, bypass Identity nodes and Reshape chains, and drop nodes
+  // that no output depends on. 'node_layers' maps each remaining node to its
+  // index in the partition strategy.
+  static void SimplifyGraph(
+      onnx::GraphProto* onnx_graph, std::vector<size_t>* node_layers);
 
   TRITONSERVER_Error* ParseInput(const onnx::GraphProto& onnx_graph);
   TRITONSERVER_Error* ParseWeight(const onnx::GraphProto& onnx_graph);
@@ -97,12 +140,22 @@ class OnnxParser {
   TRITONSERVER_Error* ParseBinary(
       const LayerStrategy* strategy, const onnx::NodeProto& onnx_node,
       OperatorType op_type);
+  // Product of a tensor with a constant matrix (the initializer named by
+  // the second input) plus an optional constant bias as the third input
+  TRITONSERVER_Error* ParseLinear(
+      const LayerStrategy* strategy, const onnx::NodeProto& onnx_node,
+      bool transposed_weight);
 
   template <int Dim>
   TRITONSERVER_Error* LoadWeight(
       const LayerStrategy* strategy,
       std::function<Legion::Rect<Dim>(Realm::Processor)> local_bound_fn,
       const onnx::TensorProto* weight_proto, Weights* weight);
+  // Locate the bytes of a weight stored outside of the ONNX file, the
+  // returned storage keeps the mapping of the data file alive
+  TRITONSERVER_Error* MapExternalData(
+      const onnx::TensorProto* weight_proto, size_t byte_size,
+      std::shared_ptr<MappedFile>* storage, const char** data);
   TRITONSERVER_Error* SetElementData(
       const std::vector<size_t>& strides, const Legion::Domain& local_bounds,
       const size_t* local_strides, size_t dim_idx, const bool is_raw_boolean,
@@ -121,6 +174,10 @@ class OnnxParser {
   std::vector<Operator*>* layers_;
   std::map<std::string, std::unique_ptr<Tensor>> tensors_;
   std::map<std::string, const onnx::TensorProto*> weights_;
+  // Directory that paths of external data are relative to
+  std::string model_dir_;
+  // External data files, each mapped once and shared by all its weights
+  std::map<std::string, std::shared_ptr<MappedFile>> mapped_files_;
 };
 
 }}}  // namespace triton::backend::legion
@@ -17,6 +17,7 @@
 #include "operators/binary.h"
 #include "operators/concat.h"
 #include "operators/conv2d.h"
+#include "operators/linear.h"
 #include "operators/matmul.h"
 #include "operators/reshape.h"
 #include "operators/softmax.h"
@@ -46,6 +47,7 @@ Operator::PreregisterTaskVariants(void)
   BinaryOperator::PreregisterTaskVariants();
   Concat::PreregisterTaskVariants();
   Conv2D::PreregisterTaskVariants();
+  Linear::PreregisterTaskVariants();
   MatMul::PreregisterTaskVariants();
   Reshape::PreregisterTaskVariants();
   Softmax::PreregisterTaskVariants();
@@ -293,7 +293,7 @@ Conv2D::Load(Processor proc)
           device_ptr, wts->local_allocation[local_index], weights_size,
           cudaMemcpyHostToDevice));
       // Free the old allocation since we no longer need it
-      std::free(wts->local_allocation[local_index]);
+      wts->ReleaseLocalAllocation(local_index);
       wts->local_allocation[local_index] = device_ptr;
       wts->local_memory[local_index] = local_fb;
     }
@@ -464,10 +464,9 @@ Conv2D::Free(Processor proc)
     CHECK_CUDNN(cudnnDestroyActivationDescriptor(proc_args.actiDesc));
     CHECK_CUDNN(cudnnDestroyConvolutionDescriptor(proc_args.convDesc));
     CHECK_CUDA(cudaFree(weights[0]->local_allocation[local_index]));
-    if (use_bias) {
-      std::free(weights[1]->local_allocation[local_index]);
-      weights[1]->local_allocation[local_index] = nullptr;
-    }
+    weights[0]->local_allocation[local_index] = nullptr;
+    if (use_bias)
+      weights[1]->ReleaseLocalAllocation(local_index);
     if (proc_args.workSpaceSize > 0) {
       for (int idx = 0; idx < MAX_NUM_INSTANCES; idx++) {
         CHECK_CUDA(cudaFree(workspaces[idx][local_index]));
@@ -476,10 +475,7 @@ Conv2D::Free(Processor proc)
   } else
 #endif
   {
-    for (Weights* wts : weights) {
-      std::free(wts->local_allocation[local_index]);
-      wts->local_allocation[local_index] = nullptr;
-    }
+    for (Weights* wts : weights) wts->ReleaseLocalAllocation(local_index);
   }
 }
 
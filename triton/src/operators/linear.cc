@@ -0,0 +1,483 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linear.h"
+
+using namespace Legion;
+
+namespace triton { namespace backend { namespace legion {
+
+LinearArgs::LinearArgs(void) {}
+
+Linear::Linear(
+    LegionModelState* model, const LayerStrategy* strategy, size_t inDim,
+    size_t outDim, bool transposed, bool bias, const char* name)
+    : Operator(
+          model, strategy, OP_LINEAR, name, 1 /*inputs*/,
+          bias ? 2 : 1 /*weights*/, 1 /*outputs*/),
+      in_dim(inDim), out_dim(outDim), transposed_weight(transposed),
+      use_bias(bias)
+{
+  assert(strategy->nDims >= 2);
+  // We don't support partitioning over the feature dimension right now
+  assert(strategy->dim[strategy->nDims - 1] == 1);
+}
+
+Linear::~Linear(void) {}
+
+void
+Linear::Configure(Tensor* input, Weights* wts, Tensor* output, Weights* bias)
+{
+  assert(input != nullptr);
+  assert(input->bounds.size() == size_t(strategy->nDims));
+  assert(in_dim == input->bounds.back());
+  assert(wts != nullptr);
+  assert(output != nullptr);
+  assert(output->bounds.size() == input->bounds.size());
+  assert(out_dim == output->bounds.back());
+  if (use_bias)
+    assert(bias != nullptr);
+  else
+    assert(bias == nullptr);
+  inputs.push_back(input);
+  outputs.push_back(output);
+  weights.push_back(wts);
+  if (use_bias)
+    weights.push_back(bias);
+  // The input is tiled like the output, the feature dimension is never
+  // partitioned so each tile covers all of it
+  switch (input->bounds.size()) {
+#define DIMFUNC(DIM)                                                        \
+  case DIM: {                                                               \
+    Transform<DIM, DIM> transform;                                          \
+    Rect<DIM> extent;                                                       \
+    for (int i = 0; i < DIM; i++) {                                         \
+      const coord_t tile =                                                  \
+          (input->bounds[i] + strategy->dim[i] - 1) / strategy->dim[i];     \
+      for (int j = 0; j < DIM; j++) transform[i][j] = (i == j) ? tile : 0; \
+      extent.lo[i] = 0;                                                     \
+      extent.hi[i] = tile - 1;                                              \
+    }                                                                       \
+    input_transform = transform;                                            \
+    input_extent = extent;                                                  \
+    break;                                                                  \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+}
+
+Domain
+Linear::GetInputBounds(Processor proc)
+{
+  const DomainPoint point = strategy->find_local_point(proc);
+  const DomainPoint offset = input_transform * point;
+  switch (inputs[0]->bounds.size()) {
+#define DIMFUNC(DIM)                                                   \
+  case DIM: {                                                          \
+    Point<DIM> off = offset;                                           \
+    Rect<DIM> extent = input_extent;                                   \
+    Rect<DIM> bounds(extent.lo + off, extent.hi + off);                \
+    Point<DIM> upper;                                                  \
+    for (int i = 0; i < DIM; i++) upper[i] = inputs[0]->bounds[i] - 1; \
+    Rect<DIM> full(Point<DIM>::ZEROES(), upper);                       \
+    Rect<DIM> result = full.intersection(bounds);                      \
+    return Domain(result);                                             \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+  return Domain();
+}
+
+Domain
+Linear::GetOutputBounds(Processor proc)
+{
+  const size_t dims = outputs[0]->bounds.size();
+  DomainPoint lo, hi;
+  lo.dim = dims;
+  hi.dim = dims;
+  for (int d = 0; d < dims; d++) {
+    lo[d] = 0;
+    hi[d] = outputs[0]->bounds[d] - 1;
+  }
+  const Domain global(lo, hi);
+  return strategy->find_local_domain(proc, global);
+}
+
+Rect<2>
+Linear::GetWeightBounds(Realm::Processor proc)
+{
+  // Every processor needs the whole weight since only the leading
+  // dimensions of the input are partitioned
+  return Rect<2>(
+      Point<2>(0, 0),
+      Point<2>(weights[0]->bounds[0] - 1, weights[0]->bounds[1] - 1));
+}
+
+Rect<1>
+Linear::GetBiasBounds(Realm::Processor proc)
+{
+  // Always return the whole bias bound
+  return Rect<1>(0, weights[1]->bounds[0] - 1);
+}
+
+void
+Linear::Load(Processor proc)
+{
+  assert(proc.kind() == strategy->kind);
+  // If this processor is not used for this layer there is nothing to do
+  if (!strategy->is_local_processor(proc))
+    return;
+  const unsigned local_index = strategy->find_local_offset(proc);
+  LinearArgs& proc_args = args[local_index];
+  proc_args.owner = this;
+  proc_args.input_bounds = GetInputBounds(proc);
+  proc_args.output_bounds = GetOutputBounds(proc);
+  proc_args.weight_bounds = GetWeightBounds(proc);
+  proc_args.input_datatype = inputs[0]->type;
+  proc_args.output_datatype = outputs[0]->type;
+  proc_args.weight_datatype = weights[0]->type;
+  proc_args.use_bias = use_bias;
+  proc_args.transposed_weight = transposed_weight;
+  if (use_bias) {
+    proc_args.bias_bounds = GetBiasBounds(proc);
+    proc_args.bias_datatype = weights[1]->type;
+  }
+#ifdef LEGION_USE_CUDA
+  if (proc.kind() == Processor::TOC_PROC) {
+    proc_args.cublas = model->runtime_->cublas[local_index];
+    proc_args.cudnn = model->runtime_->cudnn[local_index];
+    if (use_bias) {
+      // View the output as (rows, out_dim, 1, 1) so the bias broadcasts
+      // over every row
+      const size_t rows = proc_args.output_bounds.get_volume() / out_dim;
+      CHECK_CUDNN(cudnnCreateTensorDescriptor(&proc_args.biasTensor));
+      CHECK_CUDNN(cudnnSetTensor4dDescriptor(
+          proc_args.biasTensor, CUDNN_TENSOR_NCHW,
+          to_cudnn_datatype(weights[1]->type), 1, out_dim, 1, 1));
+      CHECK_CUDNN(cudnnCreateTensorDescriptor(&proc_args.outputTensor));
+      CHECK_CUDNN(cudnnSetTensor4dDescriptor(
+          proc_args.outputTensor, CUDNN_TENSOR_NCHW,
+          to_cudnn_datatype(outputs[0]->type), rows, out_dim, 1, 1));
+    }
+  }
+#endif
+}
+
+void
+Linear::initialize(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Runtime* runtime, Context ctx, MapperID mapper)
+{
+  const Domain launch_domain = strategy->get_launch_domain();
+  // Find or create the launch space domain
+  IndexSpace launch_space = instance->find_or_create_index_space(launch_domain);
+  // Also get the sharding function from the strategy
+  ShardingFunction* shardfn = strategy->sharding_function;
+  // Construct a future map for the pass-by-value arguments
+  std::map<DomainPoint, TaskArgument> values;
+  unsigned first_index = MAX_LOCAL_PROCS;
+  for (Domain::DomainPointIterator itr(launch_domain); itr; itr++) {
+    const Processor proc = shardfn->find_proc(itr.p, launch_domain);
+    if (!strategy->is_local_processor(proc))
+      continue;
+    const unsigned local_index = strategy->find_local_offset(proc);
+    values[itr.p] = TaskArgument(args + local_index, sizeof(LinearArgs));
+    if (local_index < first_index)
+      first_index = local_index;
+  }
+  argmaps[instance_index] = runtime->construct_future_map(
+      ctx, launch_space, values, true /*collective*/, shardfn->sharding_id);
+
+  // Create logical regions for the weights and output data
+  assert(outputs.size() == 1);
+  LogicalRegion output_region = instance->create_tensor_region(outputs[0]);
+  assert(!weights.empty() && (weights.size() <= 2));
+  LogicalRegion weight_region = instance->create_tensor_region(weights[0]);
+  LogicalRegion bias_region = LogicalRegion::NO_REGION;
+  if (use_bias)
+    bias_region = instance->create_tensor_region(weights[1]);
+
+  // Create partitions for the input and output regions
+  assert(inputs.size() == 1);
+  assert(inputs[0]->region[instance_index].exists());
+  LogicalRegion input_region = inputs[0]->region[instance_index];
+  IndexPartition part = instance->find_or_create_partition(
+      input_region.get_index_space(), launch_space, input_transform,
+      input_extent, LEGION_DISJOINT_COMPLETE_KIND);
+  LogicalPartition input_part = runtime->get_logical_partition_by_tree(
+      ctx, part, input_region.get_field_space(), input_region.get_tree_id());
+  LogicalPartition output_part =
+      instance->find_or_create_tiled_partition(outputs[0], strategy);
+
+  // The weight and bias have the same bounds across all the processors
+  // so we just attach the copy of one of them and let legion move it
+  assert(first_index < MAX_LOCAL_PROCS);
+  const std::vector<FieldID> attach_field(1, FID_DATA);
+  AttachLauncher weight_attach_launcher(
+      LEGION_EXTERNAL_INSTANCE, weight_region, weight_region,
+      false /*restricted*/, false /*mapped*/);
+  weight_attach_launcher.attach_array_soa(
+      weights[0]->local_allocation[first_index], false /*column major*/,
+      attach_field, weights[0]->local_memory[first_index]);
+  weight_attachments[instance_index] =
+      runtime->attach_external_resource(ctx, weight_attach_launcher);
+  if (use_bias) {
+    AttachLauncher bias_attach_launcher(
+        LEGION_EXTERNAL_INSTANCE, bias_region, bias_region,
+        false /*restricted*/, false /*mapped*/);
+    bias_attach_launcher.attach_array_soa(
+        weights[1]->local_allocation[first_index], false /*column major*/,
+        attach_field, weights[1]->local_memory[first_index]);
+    bias_attachments[instance_index] =
+        runtime->attach_external_resource(ctx, bias_attach_launcher);
+  }
+
+  // Construct a launcher for running the inference task
+  IndexTaskLauncher& launcher = launchers[instance_index];
+  launcher = IndexTaskLauncher(
+      LINEAR_TASK_ID, launch_space, TaskArgument(NULL, 0),
+      ArgumentMap(argmaps[instance_index]), Predicate::TRUE_PRED,
+      false /*must*/, mapper, strategy->tag);
+  launcher.add_region_requirement(RegionRequirement(
+      input_part, 0 /*projection id*/, LEGION_READ_ONLY, LEGION_EXCLUSIVE,
+      input_region));
+  launcher.add_field(0, FID_DATA);
+  launcher.add_region_requirement(RegionRequirement(
+      output_part, 0 /*projection id*/, LEGION_WRITE_DISCARD, LEGION_EXCLUSIVE,
+      output_region));
+  launcher.add_field(1, FID_DATA);
+  launcher.add_region_requirement(RegionRequirement(
+      weight_region, 0 /*projection id*/, LEGION_READ_ONLY, LEGION_EXCLUSIVE,
+      weight_region));
+  launcher.add_field(2, FID_DATA);
+  if (use_bias) {
+    launcher.add_region_requirement(RegionRequirement(
+        bias_region, 0 /*projection id*/, LEGION_READ_ONLY, LEGION_EXCLUSIVE,
+        bias_region));
+    launcher.add_field(3, FID_DATA);
+  }
+}
+
+void
+Linear::forward(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Runtime* runtime, Context ctx, MapperID mapper)
+{
+  runtime->execute_index_space(ctx, launchers[instance_index]);
+}
+
+void
+Linear::finalize(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Runtime* runtime, Context ctx, MapperID mapper)
+{
+  runtime->detach_external_resource(ctx, weight_attachments[instance_index]);
+  if (use_bias)
+    runtime->detach_external_resource(ctx, bias_attachments[instance_index]);
+  argmaps[instance_index] = FutureMap();
+}
+
+void
+Linear::Free(Processor proc)
+{
+  assert(proc.kind() == strategy->kind);
+  // If this processor is not used for this layer there is nothing to do
+  if (!strategy->is_local_processor(proc))
+    return;
+  const unsigned local_index = strategy->find_local_offset(proc);
+#ifdef LEGION_USE_CUDA
+  LinearArgs& proc_args = args[local_index];
+  if ((proc.kind() == Processor::TOC_PROC) && use_bias) {
+    CHECK_CUDNN(cudnnDestroyTensorDescriptor(proc_args.biasTensor));
+    CHECK_CUDNN(cudnnDestroyTensorDescriptor(proc_args.outputTensor));
+  }
+#endif
+  for (Weights* wts : weights) wts->ReleaseLocalAllocation(local_index);
+}
+
+/*static*/ void
+Linear::PreregisterTaskVariants(void)
+{
+  {
+    TaskVariantRegistrar cpu_registrar(LINEAR_TASK_ID, "Linear CPU");
+    cpu_registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    cpu_registrar.set_leaf();
+    Runtime::preregister_task_variant<forward_cpu>(
+        cpu_registrar, "Linear Operator");
+  }
+#ifdef LEGION_USE_CUDA
+  {
+    TaskVariantRegistrar gpu_registrar(LINEAR_TASK_ID, "Linear GPU");
+    gpu_registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
+    gpu_registrar.set_leaf();
+    Runtime::preregister_task_variant<forward_gpu>(
+        gpu_registrar, "Linear Operator");
+  }
+#endif
+}
+
+/*static*/ void
+Linear::forward_cpu(
+    const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
+    Runtime* runtime)
+{
+  // TODO: implement this with OpenBLAS or something like it
+  abort();
+}
+
+#ifdef LEGION_USE_CUDA
+/*static*/ void
+Linear::forward_gpu(
+    const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
+    Runtime* runtime)
+{
+  assert(task->local_arglen == sizeof(LinearArgs));
+  const LinearArgs* args = (const LinearArgs*)task->local_args;
+  assert(regions.size() == (3 + int(args->use_bias)));
+  assert(task->regions.size() == (3 + int(args->use_bias)));
+
+  const void* input_ptr = nullptr;
+  switch (args->input_bounds.get_dim()) {
+#define DIMFUNC(DIM)                                              \
+  case DIM: {                                                     \
+    const Rect<DIM> bounds = args->input_bounds;                  \
+    input_ptr = TensorAccessor<LEGION_READ_ONLY, DIM>::access(    \
+        args->input_datatype, bounds, regions[0]);                \
+    break;                                                        \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+  void* output_ptr = nullptr;
+  switch (args->output_bounds.get_dim()) {
+#define DIMFUNC(DIM)                                                \
+  case DIM: {                                                       \
+    const Rect<DIM> bounds = args->output_bounds;                   \
+    output_ptr = TensorAccessor<LEGION_WRITE_DISCARD, DIM>::access( \
+        args->output_datatype, bounds, regions[1]);                 \
+    break;                                                          \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+  const void* weight_ptr = TensorAccessor<LEGION_READ_ONLY, 2>::access(
+      args->weight_datatype, args->weight_bounds, regions[2]);
+  const void* bias_ptr = nullptr;
+  if (args->use_bias)
+    bias_ptr = TensorAccessor<LEGION_READ_ONLY, 1>::access(
+        args->bias_datatype, args->bias_bounds, regions[3]);
+  const size_t rows =
+      args->output_bounds.get_volume() / args->owner->out_dim;
+#ifndef DISABLE_LEGION_CUDA_HIJACK
+  ::cudaStream_t stream;
+  CHECK_CUDA(cudaStreamCreate(&stream));
+  CHECK_CUBLAS(cublasSetStream(args->cublas, stream));
+  CHECK_CUDNN(cudnnSetStream(args->cudnn, stream));
+#endif
+  ::cudaEvent_t t_start, t_end;
+  if (args->profiling) {
+    CHECK_CUDA(cudaEventCreate(&t_start));
+    CHECK_CUDA(cudaEventCreate(&t_end));
+#ifdef DISABLE_LEGION_CUDA_HIJACK
+    CHECK_CUDA(cudaEventRecord(t_start));
+#else
+    CHECK_CUDA(cudaEventRecord(t_start, stream));
+#endif
+  }
+  Linear::forward_kernel(
+      args, input_ptr, output_ptr, weight_ptr, bias_ptr, rows);
+  if (args->profiling) {
+#ifdef DISABLE_LEGION_CUDA_HIJACK
+    CHECK_CUDA(cudaEventRecord(t_end));
+#else
+    CHECK_CUDA(cudaEventRecord(t_end, stream));
+#endif
+    CHECK_CUDA(cudaEventSynchronize(t_end));
+    float elapsed = 0;
+    CHECK_CUDA(cudaEventElapsedTime(&elapsed, t_start, t_end));
+    CHECK_CUDA(cudaEventDestroy(t_start));
+    CHECK_CUDA(cudaEventDestroy(t_end));
+    printf(
+        "%s [Linear] forward time (CF) = %.2fms\n",
+        args->owner->op_name.c_str(), elapsed);
+  }
+}
+
+/*static*/ void
+Linear::forward_kernel(
+    const LinearArgs* args, const void* input_ptr, void* output_ptr,
+    const void* weight_ptr, const void* bias_ptr, size_t rows)
+{
+  // cublas is column-major, so compute output^T = weight^T * input^T
+  // which reads and writes the row-major buffers directly
+  const int m = args->owner->out_dim;
+  const int k = args->owner->in_dim;
+  const int n = rows;
+  const cublasOperation_t trans =
+      args->transposed_weight ? CUBLAS_OP_T : CUBLAS_OP_N;
+  const int ldw = args->transposed_weight ? k : m;
+  switch (args->output_datatype) {
+    // Use 32-bit intermediate for 16-bit float
+    case DT_HALF:
+    case DT_FLOAT: {
+      float alpha = 1.f, beta = 0.f;
+      CHECK_CUBLAS(cublasGemmEx(
+          args->cublas, trans, CUBLAS_OP_N, m, n, k, &alpha, weight_ptr,
+          to_cuda_datatype(args->weight_datatype), ldw, input_ptr,
+          to_cuda_datatype(args->input_datatype), k, &beta, output_ptr,
+          to_cuda_datatype(args->output_datatype), m, CUBLAS_COMPUTE_32F,
+          CUBLAS_GEMM_DEFAULT_TENSOR_OP));
+      if (bias_ptr != nullptr) {
+        CHECK_CUDNN(cudnnAddTensor(
+            args->cudnn, &alpha, args->biasTensor, bias_ptr, &alpha,
+            args->outputTensor, output_ptr));
+      }
+      break;
+    }
+    case DT_DOUBLE: {
+      double alpha = 1.0, beta = 0.0;
+      CHECK_CUBLAS(cublasGemmEx(
+          args->cublas, trans, CUBLAS_OP_N, m, n, k, &alpha, weight_ptr,
+          to_cuda_datatype(args->weight_datatype), ldw, input_ptr,
+          to_cuda_datatype(args->input_datatype), k, &beta, output_ptr,
+          to_cuda_datatype(DT_DOUBLE), m, CUBLAS_COMPUTE_64F,
+          CUBLAS_GEMM_DEFAULT_TENSOR_OP));
+      if (bias_ptr != nullptr) {
+        CHECK_CUDNN(cudnnAddTensor(
+            args->cudnn, &alpha, args->biasTensor, bias_ptr, &alpha,
+            args->outputTensor, output_ptr));
+      }
+      break;
+    }
+    default:
+      fprintf(
+          stderr, "Unsupported cublas type for linear %d\n",
+          args->output_datatype);
+      abort();
+  }
+}
+#endif
+
+}}}  // namespace triton::backend::legion
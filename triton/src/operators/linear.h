@@ -18,48 +18,99 @@
 
 #include "operator.h"
 #include "tensor.h"
+#ifdef LEGION_USE_CUDA
+#include "cudahelp.h"
+#endif
 
 namespace triton { namespace backend { namespace legion {
 
+class Linear;
+
 struct LinearArgs : public OperatorArgs {
  public:
-  LinearArgs(size_t batch_size);
-  cudnnTensorDescriptor_t outputTensor;
-  cudnnActivationDescriptor_t actiDesc;
-  ActivationMode activation;
-  bool use_bias;
+  LinearArgs(void);
+  Linear* owner;
+#ifdef LEGION_USE_CUDA
+  cublasHandle_t cublas;
+  cudnnHandle_t cudnn;
+  cudnnTensorDescriptor_t biasTensor, outputTensor;
+#endif
+  Legion::Domain input_bounds, output_bounds;
+  Legion::Rect<2> weight_bounds;
+  Legion::Rect<1> bias_bounds;
+  DataType input_datatype;
+  DataType output_datatype;
+  DataType weight_datatype;
+  DataType bias_datatype;
+  bool use_bias, transposed_weight;
 };
 
+// Fully connected layer over the last dimension of its input, the weight
+// is a (in_dim, out_dim) matrix, or (out_dim, in_dim) if transposed, that
+// every processor holds in full; the leading dimensions can be partitioned
 class Linear : public Operator {
  public:
   Linear(
-      LegionModelState* model, unsigned out_dim, ActivationMode activation,
-      bool use_bias, const char* name);
+      LegionModelState* model, const LayerStrategy* strategy, size_t in_dim,
+      size_t out_dim, bool transposed_weight, bool use_bias,
+      const char* name);
+  virtual ~Linear(void);
 
-  void configure(
+ public:
+  void Configure(
       Tensor* input, Weights* weights, Tensor* output, Weights* bias = NULL);
+  Legion::Domain GetInputBounds(Realm::Processor proc);
+  Legion::Domain GetOutputBounds(Realm::Processor proc);
+  Legion::Rect<2> GetWeightBounds(Realm::Processor proc);
+  Legion::Rect<1> GetBiasBounds(Realm::Processor proc);
 
-  virtual void initialize(LegionModelInstance* instance);
-  virtual void forward(LegionModelInstance* instance);
-  virtual void finalize(LegionModelInstance* instance);
+ public:
+  virtual void Load(Realm::Processor processor) override;
+  virtual void initialize(
+      LegionModelInstance* instance, const unsigned instance_index,
+      Legion::Runtime* runtime, Legion::Context ctx,
+      Legion::MapperID mapper) override;
+  virtual void forward(
+      LegionModelInstance* instance, const unsigned instance_index,
+      Legion::Runtime* runtime, Legion::Context ctx,
+      Legion::MapperID mapper) override;
+  virtual void finalize(
+      LegionModelInstance* instance, const unsigned instance_index,
+      Legion::Runtime* runtime, Legion::Context ctx,
+      Legion::MapperID mapper) override;
+  virtual void Free(Realm::Processor processor) override;
 
-  static LinearArgs initialize_gpu(
+ public:
+  static void PreregisterTaskVariants(void);
+  static void forward_cpu(
       const Legion::Task* task,
       const std::vector<Legion::PhysicalRegion>& regions, Legion::Context ctx,
       Legion::Runtime* runtime);
+#ifdef LEGION_USE_CUDA
+ public:
+  // Forward task for the GPU
   static void forward_gpu(
       const Legion::Task* task,
       const std::vector<Legion::PhysicalRegion>& regions, Legion::Context ctx,
       Legion::Runtime* runtime);
+
+ protected:
   static void forward_kernel(
       const LinearArgs* args, const void* input_ptr, void* output_ptr,
-      const void* filter_ptr, const void* bias_ptr, unsigned in_dim,
-      unsigned out_dim, size_t batch_size);
-
+      const void* weight_ptr, const void* bias_ptr, size_t rows);
+#endif
  public:
-  LegionModelState* const model;
-  const unsigned in_channels, out_channels;
-  const bool use_bias;
+  const size_t in_dim, out_dim;
+  const bool transposed_weight, use_bias;
+
+ protected:
+  Legion::DomainTransform input_transform;
+  Legion::Domain input_extent;
+  LinearArgs args[MAX_LOCAL_PROCS];
+  Legion::FutureMap argmaps[MAX_NUM_INSTANCES];
+  Legion::IndexTaskLauncher launchers[MAX_NUM_INSTANCES];
+  Legion::PhysicalRegion weight_attachments[MAX_NUM_INSTANCES];
+  Legion::PhysicalRegion bias_attachments[MAX_NUM_INSTANCES];
 };
 
 }}}  // namespace triton::backend::legion
@@ -637,6 +637,8 @@ LegionTritonRuntime::PackRunModel(
     rez.serialize<size_t>(tensor.buffers_.size());
     for (auto ptr : tensor.buffers_) rez.serialize(ptr);
     assert(tensor.buffers_.size() == tensor.buffer_locations_.size());
+    assert(tensor.buffers_.size() == tensor.buffer_byte_sizes_.size());
+    for (auto size : tensor.buffer_byte_sizes_) rez.serialize(size);
     for (auto& loc : tensor.buffer_locations_) {
       rez.serialize(loc.first);
       rez.serialize(loc.second);
@@ -696,6 +698,9 @@ LegionTritonRuntime::RunModelInferenceTask(
     tensor.buffers_.resize(num_buffers);
     for (unsigned idx2 = 0; idx2 < num_buffers; idx2++)
       derez.deserialize(tensor.buffers_[idx2]);
+    tensor.buffer_byte_sizes_.resize(num_buffers);
+    for (unsigned idx2 = 0; idx2 < num_buffers; idx2++)
+      derez.deserialize(tensor.buffer_byte_sizes_[idx2]);
     tensor.buffer_locations_.resize(num_buffers);
     for (unsigned idx2 = 0; idx2 < num_buffers; idx2++) {
       auto& pair = tensor.buffer_locations_[idx2];
@@ -14,10 +14,17 @@
  */
 
 #include "strategy.h"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
 #include <string>
 #include "model.h"
+#include "onnx/onnx-ml.pb.h"
+#include "onnx_parser.h"
 #include "runtime.h"
 
 using namespace Legion;
@@ -146,7 +153,15 @@ PartitionStrategy::LoadStrategy(
     std::cerr << "Failed to open strategy file for reading" << std::endl;
     abort();
   }
+  PartitionStrategy* strategy = LoadStrategy(input, filename, model);
+  input.close();
+  return strategy;
+}
 
+/*static*/ PartitionStrategy*
+PartitionStrategy::LoadStrategy(
+    std::istream& input, const std::string& source, LegionModelState* model)
+{
   int ops_size = 0;
   input >> ops_size;
 
@@ -203,7 +218,7 @@ PartitionStrategy::LoadStrategy(
 #undef MEM_NAMES
         };
         std::cerr << "Insufficient " << proc_names[layer->kind]
-                  << " processors for partitioning strategy " << filename
+                  << " processors for partitioning strategy " << source
                   << std::endl;
         abort();
       }
@@ -239,10 +254,415 @@ PartitionStrategy::LoadStrategy(
     assert(found_count == layer->nProcs);
     layers[i] = layer;
   }
-  input.close();
   return new PartitionStrategy(model, std::move(layers));
 }
 
+namespace {
+
+// Rough throughput of the processors and links of a machine, only the ratios
+// between them matter when comparing strategies
+struct ProcessorModel {
+  double flops_per_second;
+  double bytes_per_second;
+  double launch_seconds;
+};
+const ProcessorModel gpu_model = {10e12, 500e9, 10e-6};
+const ProcessorModel cpu_model = {50e9, 10e9, 2e-6};
+const double intra_node_bytes_per_second = 20e9;
+const double inter_node_bytes_per_second = 10e9;
+// Tensors are costed as 32-bit elements whatever their actual type
+const double bytes_per_element = 4;
+
+// Partitioning of one node: the kind of processors it runs on and the number
+// of pieces its outermost (batch) dimension is split into
+struct NodeChoice {
+  int device_type;  // 0 for GPUs and 1 for CPUs, as in strategy files
+  size_t pieces;
+};
+
+// Whether the layers of the backend have a kernel for 'device_type'. Their
+// CPU variants are placeholders that abort, so only GPU placements are
+// generated until CPU kernels exist.
+bool
+HasKernel(int device_type)
+{
+  return device_type == 0;
+}
+
+struct NodeEstimate {
+  std::vector<size_t> output_dims;
+  double flops;
+  // Bytes of activations read and written, divided among the pieces
+  double activation_bytes;
+  // Bytes of weights, which every piece reads in full
+  double weight_bytes;
+  // Whether the outermost dimension can be split across processors
+  bool batch_parallel;
+  // Node producing the first activation input, and the size of that input
+  int producer;
+  double input_bytes;
+};
+
+size_t
+Volume(const std::vector<size_t>& dims)
+{
+  size_t volume = 1;
+  for (const auto dim : dims) volume *= dim;
+  return volume;
+}
+
+std::vector<size_t>
+ShapeDims(const onnx::TypeProto& type, size_t max_batch_size)
+{
+  std::vector<size_t> dims;
+  if (!type.has_tensor_type())
+    return dims;
+  // Symbolic extents are unknown until a request arrives: a symbolic
+  // outermost extent is the batch, so plan for the largest batch, and count
+  // any other as 1
+  for (const auto& dim : type.tensor_type().shape().dim()) {
+    if (dim.has_dim_value())
+      dims.emplace_back(dim.dim_value());
+    else
+      dims.emplace_back(dims.empty() ? max_batch_size : 1);
+  }
+  return dims;
+}
+
+std::vector<int64_t>
+IntsAttribute(
+    const onnx::NodeProto& node, const std::string& name,
+    const std::vector<int64_t>& default_value)
+{
+  for (const auto& attribute : node.attribute()) {
+    if (attribute.name() == name)
+      return std::vector<int64_t>(
+          attribute.ints().begin(), attribute.ints().end());
+  }
+  return default_value;
+}
+
+int64_t
+IntAttribute(
+    const onnx::NodeProto& node, const std::string& name,
+    int64_t default_value)
+{
+  for (const auto& attribute : node.attribute()) {
+    if (attribute.name() == name)
+      return attribute.i();
+  }
+  return default_value;
+}
+
+// Estimate the output shape and the work of 'node' from the shapes of its
+// inputs, falling back to an elementwise operation for unknown layers
+NodeEstimate
+EstimateNode(
+    const onnx::NodeProto& node,
+    const std::map<std::string, std::vector<size_t>>& shapes,
+    const std::map<std::string, const onnx::TensorProto*>& initializers,
+    const std::map<std::string, int>& producers)
+{
+  NodeEstimate estimate;
+  estimate.weight_bytes = 0;
+  estimate.activation_bytes = 0;
+  estimate.producer = -1;
+  estimate.input_bytes = 0;
+  std::vector<std::vector<size_t>> inputs;
+  size_t largest = 0;
+  for (const auto& input : node.input()) {
+    auto shape = shapes.find(input);
+    std::vector<size_t> dims;
+    if (shape != shapes.end())
+      dims = shape->second;
+    inputs.emplace_back(dims);
+    const double bytes = Volume(dims) * bytes_per_element;
+    if (input.empty())
+      continue;
+    if (initializers.find(input) != initializers.end()) {
+      estimate.weight_bytes += bytes;
+      continue;
+    }
+    estimate.activation_bytes += bytes;
+    if (Volume(dims) > Volume(inputs[largest]))
+      largest = inputs.size() - 1;
+    if (estimate.producer < 0) {
+      auto producer = producers.find(input);
+      if (producer != producers.end()) {
+        estimate.producer = producer->second;
+        estimate.input_bytes = bytes;
+      }
+    }
+  }
+  const std::vector<size_t> none;
+  const std::vector<size_t>& in0 = inputs.empty() ? none : inputs[0];
+  const std::vector<size_t>& in1 = (inputs.size() > 1) ? inputs[1] : none;
+
+  std::vector<size_t>& out = estimate.output_dims;
+  auto known = shapes.find((node.output_size() > 0) ? node.output(0) : "");
+  const std::string& op = node.op_type();
+  // Work per output element
+  double output_flops = 1;
+  if ((op == "Conv") || (op == "MaxPool") || (op == "AveragePool")) {
+    const bool conv = (op == "Conv");
+    std::vector<int64_t> kernel = IntsAttribute(node, "kernel_shape", {});
+    if (kernel.empty() && conv && (in1.size() == 4))
+      kernel = {int64_t(in1[2]), int64_t(in1[3])};
+    if (kernel.size() != 2)
+      kernel = {1, 1};
+    const std::vector<int64_t> pads = IntsAttribute(node, "pads", {0, 0, 0, 0});
+    const std::vector<int64_t> strides = IntsAttribute(node, "strides", {1, 1});
+    if (in0.size() == 4) {
+      out = {in0[0], (conv && (in1.size() == 4)) ? in1[0] : in0[1], 1, 1};
+      for (int idx = 0; idx < 2; ++idx) {
+        const int64_t padded = int64_t(in0[idx + 2]) + pads[idx] +
+                               pads[idx + (pads.size() / 2)] - kernel[idx];
+        out[idx + 2] = std::max<int64_t>(padded / strides[idx] + 1, 1);
+      }
+    }
+    output_flops = kernel[0] * kernel[1];
+    if (conv)
+      output_flops *= 2 * ((in1.size() == 4) ? in1[1] : 1);
+  } else if (op == "GlobalAveragePool") {
+    if (in0.size() >= 2)
+      out = {in0[0], in0[1], 1, 1};
+    output_flops = Volume(in0) / std::max<size_t>(Volume(out), 1);
+  } else if ((op == "MatMul") || (op == "Gemm")) {
+    const bool trans_b = (IntAttribute(node, "transB", 0) != 0);
+    if ((in0.size() >= 2) && (in1.size() >= 2)) {
+      // The batch dimensions broadcast, so the output has the larger rank
+      std::vector<size_t> rhs(in1);
+      if (trans_b)
+        std::swap(rhs[rhs.size() - 2], rhs.back());
+      if (!MatMulDims(in0, rhs, &out))
+        out.clear();
+    }
+    output_flops = 2 * (in0.empty() ? 1 : in0.back());
+  } else if (op == "Reshape") {
+    // The parser only accepts a constant target shape, so it is known here
+    std::vector<int64_t> shape;
+    auto target = (node.input_size() > 1) ? initializers.find(node.input(1))
+                                          : initializers.end();
+    if ((target != initializers.end()) &&
+        ReadInt64Data(*target->second, &shape) &&
+        !ReshapeDims(
+            in0, shape, (IntAttribute(node, "allowzero", 0) != 0), &out))
+      out.clear();
+  } else if (op == "Flatten") {
+    int64_t axis = IntAttribute(node, "axis", 1);
+    if (axis < 0)
+      axis += in0.size();
+    out = {1, 1};
+    for (size_t idx = 0; idx < in0.size(); ++idx)
+      out[(int64_t(idx) < axis) ? 0 : 1] *= in0[idx];
+  } else if (op == "Concat") {
+    int64_t axis = IntAttribute(node, "axis", 0);
+    out = in0;
+    if (axis < 0)
+      axis += out.size();
+    if ((axis >= 0) && (size_t(axis) < out.size())) {
+      out[axis] = 0;
+      for (const auto& dims : inputs)
+        out[axis] += (size_t(axis) < dims.size()) ? dims[axis] : 0;
+    }
+  } else if (!inputs.empty()) {
+    // Elementwise, with broadcasting to the largest input
+    out = inputs[largest];
+  }
+  // Shapes recorded in the model take precedence
+  if ((known != shapes.end()) && !known->second.empty())
+    out = known->second;
+
+  const double output_volume = Volume(out);
+  estimate.flops = output_volume * output_flops;
+  estimate.activation_bytes += output_volume * bytes_per_element;
+  // Splitting the outermost dimension is only valid if every activation
+  // keeps it and the layer doesn't operate along it
+  estimate.batch_parallel = !out.empty() && (out[0] > 1);
+  for (int idx = 0; idx < node.input_size(); ++idx) {
+    if (node.input(idx).empty() ||
+        (initializers.find(node.input(idx)) != initializers.end()))
+      continue;
+    if (inputs[idx].empty() || (inputs[idx][0] != out[0]))
+      estimate.batch_parallel = false;
+  }
+  for (const auto& attribute : node.attribute()) {
+    if ((attribute.name() == "axis") &&
+        ((attribute.i() == 0) || ((attribute.i() + int64_t(out.size())) == 0)))
+      estimate.batch_parallel = false;
+  }
+  return estimate;
+}
+
+double
+NodeCost(const NodeEstimate& estimate, const NodeChoice& choice)
+{
+  const ProcessorModel& proc = (choice.device_type == 0) ? gpu_model
+                                                         : cpu_model;
+  // Launching more pieces fans out a wider index task
+  return proc.launch_seconds * (1 + std::log2(double(choice.pieces))) +
+         estimate.flops / (choice.pieces * proc.flops_per_second) +
+         (estimate.activation_bytes / choice.pieces + estimate.weight_bytes) /
+             proc.bytes_per_second;
+}
+
+double
+RepartitionCost(
+    const NodeChoice& from, const NodeChoice& to, double bytes,
+    const size_t procs_per_node[2])
+{
+  if ((from.device_type == to.device_type) && (from.pieces == to.pieces))
+    return 0;
+  // Between different processor kinds everything moves, otherwise the pieces
+  // that overlap stay in place
+  const double moved =
+      (from.device_type != to.device_type)
+          ? bytes
+          : bytes * (1 - 1.0 / std::max(from.pieces, to.pieces));
+  const bool remote =
+      (from.pieces > procs_per_node[from.device_type]) ||
+      (to.pieces > procs_per_node[to.device_type]);
+  return moved / (remote ? inter_node_bytes_per_second
+                         : intra_node_bytes_per_second);
+}
+
+}  // namespace
+
+/*static*/ TRITONSERVER_Error*
+PartitionStrategy::GenerateStrategy(
+    const std::string& onnx_file, LegionModelState* model,
+    std::string* strategy)
+{
+  onnx::ModelProto onnx_model;
+  {
+    std::ifstream input(onnx_file, std::ios::in | std::ios::binary);
+    std::stringstream contents;
+    contents << input.rdbuf();
+    if (!input || !onnx_model.ParseFromString(contents.str())) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL,
+          (std::string("failed to parse ONNX model protobuf from ") +
+           onnx_file + " to generate a partition strategy")
+              .c_str());
+    }
+  }
+  const onnx::GraphProto& graph = onnx_model.graph();
+
+  LegionTritonRuntime* runtime = model->runtime_;
+  // Processors of each device type, in the order of the strategy format
+  const size_t total_procs[2] = {
+      runtime->FindAllProcessors(Processor::TOC_PROC).size(),
+      runtime->FindAllProcessors(Processor::LOC_PROC).size()};
+  const size_t procs_per_node[2] = {
+      std::max<size_t>(total_procs[0] / runtime->total_ranks_, 1),
+      std::max<size_t>(total_procs[1] / runtime->total_ranks_, 1)};
+
+  // Propagate the shapes through the graph to estimate each node
+  std::map<std::string, std::vector<size_t>> shapes;
+  std::map<std::string, const onnx::TensorProto*> initializers;
+  std::map<std::string, int> producers;
+  for (const auto& initializer : graph.initializer()) {
+    initializers.emplace(initializer.name(), &initializer);
+    shapes[initializer.name()] = std::vector<size_t>(
+        initializer.dims().begin(), initializer.dims().end());
+  }
+  const size_t max_batch_size = std::max(model->MaxBatchSize(), 1);
+  for (const auto& input : graph.input()) {
+    if (initializers.find(input.name()) == initializers.end())
+      shapes[input.name()] = ShapeDims(input.type(), max_batch_size);
+  }
+  for (const auto& info : graph.value_info())
+    shapes[info.name()] = ShapeDims(info.type(), max_batch_size);
+  for (const auto& output : graph.output())
+    shapes[output.name()] = ShapeDims(output.type(), max_batch_size);
+
+  const int num_nodes = graph.node_size();
+  std::vector<NodeEstimate> estimates;
+  for (int idx = 0; idx < num_nodes; ++idx) {
+    const auto& node = graph.node(idx);
+    estimates.emplace_back(
+        EstimateNode(node, shapes, initializers, producers));
+    for (const auto& output : node.output()) {
+      producers[output] = idx;
+      if (shapes[output].empty())
+        shapes[output] = estimates.back().output_dims;
+    }
+  }
+
+  // Choose the partitioning of every node by dynamic programming along the
+  // topological order of the nodes. Repartitioning is charged between a node
+  // and the node before it when that one produces its input, which captures
+  // chains of layers exactly and ignores the cost on other edges of the graph.
+  std::vector<std::vector<NodeChoice>> choices(num_nodes);
+  std::vector<std::vector<double>> costs(num_nodes);
+  std::vector<std::vector<size_t>> previous(num_nodes);
+  for (int idx = 0; idx < num_nodes; ++idx) {
+    const NodeEstimate& estimate = estimates[idx];
+    for (int device_type = 0; device_type < 2; ++device_type) {
+      if (!HasKernel(device_type))
+        continue;
+      const size_t max_pieces =
+          estimate.batch_parallel
+              ? std::min(total_procs[device_type], estimate.output_dims[0])
+              : std::min<size_t>(total_procs[device_type], 1);
+      for (size_t pieces = 1; pieces <= max_pieces;
+           pieces = (pieces == max_pieces) ? (max_pieces + 1)
+                                           : std::min(pieces * 2, max_pieces))
+        choices[idx].push_back(NodeChoice{device_type, pieces});
+    }
+    if (choices[idx].empty()) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL,
+          "no GPUs available to generate a partition strategy");
+    }
+    for (const auto& choice : choices[idx]) {
+      double best = 0;
+      size_t best_previous = 0;
+      if (idx > 0) {
+        best = std::numeric_limits<double>::max();
+        for (size_t prev = 0; prev < choices[idx - 1].size(); ++prev) {
+          double cost = costs[idx - 1][prev];
+          if (estimate.producer == (idx - 1))
+            cost += RepartitionCost(
+                choices[idx - 1][prev], choice, estimate.input_bytes,
+                procs_per_node);
+          if (cost < best) {
+            best = cost;
+            best_previous = prev;
+          }
+        }
+      }
+      costs[idx].push_back(best + NodeCost(estimate, choice));
+      previous[idx].push_back(best_previous);
+    }
+  }
+  std::vector<size_t> selected(num_nodes, 0);
+  if (num_nodes > 0) {
+    const auto& last = costs[num_nodes - 1];
+    selected[num_nodes - 1] =
+        std::min_element(last.begin(), last.end()) - last.begin();
+    for (int idx = num_nodes - 1; idx > 0; --idx)
+      selected[idx - 1] = previous[idx][selected[idx]];
+  }
+
+  // Emit the strategy, the dimensions are listed innermost first
+  std::stringstream output;
+  output << num_nodes << std::endl;
+  for (int idx = 0; idx < num_nodes; ++idx) {
+    const NodeChoice& choice = choices[idx][selected[idx]];
+    const size_t dims = std::max<size_t>(estimates[idx].output_dims.size(), 1);
+    output << graph.node(idx).op_type() << "_" << idx << " "
+           << choice.device_type << " " << dims;
+    for (size_t dim = dims - 1; dim > 0; --dim) output << " 1";
+    output << " " << choice.pieces << " " << choice.pieces;
+    for (size_t piece = 0; piece < choice.pieces; ++piece)
+      output << " " << piece;
+    output << std::endl;
+  }
+  *strategy = output.str();
+  return nullptr;  // success
+}
+
 PartitionStrategy::~PartitionStrategy(void)
 {
   for (auto layer : layers) delete layer;
@@ -16,10 +16,13 @@
 #ifndef __LEGION_TRITON_STRATEGY_H__
 #define __LEGION_TRITON_STRATEGY_H__
 
+#include <iosfwd>
+#include <string>
 #include "config.h"
 #include "legion.h"
 #include "legion/legion_mapping.h"
 #include "mappers/null_mapper.h"
+#include "triton/core/tritonserver.h"
 #include "types.h"
 
 namespace triton { namespace backend { namespace legion {
@@ -86,6 +89,18 @@ struct PartitionStrategy {
  public:
   static PartitionStrategy* LoadStrategy(
       const std::string& filename, LegionModelState* model);
+  // Same as above with the strategy read from 'input', 'source' names the
+  // strategy in error messages
+  static PartitionStrategy* LoadStrategy(
+      std::istream& input, const std::string& source,
+      LegionModelState* model);
+  // Search a partitioning of every node of an ONNX model for the processors
+  // of the machine, trading the estimated cost of each node against the cost
+  // of repartitioning tensors between nodes. The result is written to
+  // 'strategy' in the format read by LoadStrategy.
+  static TRITONSERVER_Error* GenerateStrategy(
+      const std::string& onnx_file, LegionModelState* model,
+      std::string* strategy);
 };
 
 class StrategyMapper : public Legion::Mapping::Mapper {
@@ -67,4 +67,15 @@ Weights::~Weights(void)
   }
 }
 
+void
+Weights::ReleaseLocalAllocation(size_t local_index)
+{
+  assert(local_index < MAX_LOCAL_PROCS);
+  if (local_storage[local_index] != nullptr)
+    local_storage[local_index].reset();
+  else
+    std::free(local_allocation[local_index]);
+  local_allocation[local_index] = nullptr;
+}
+
 }}}  // namespace triton::backend::legion
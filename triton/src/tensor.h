@@ -16,6 +16,7 @@
 #ifndef __LEGION_TRITON_TENSOR_H__
 #define __LEGION_TRITON_TENSOR_H__
 
+#include <memory>
 #include "config.h"
 #include "legion.h"
 #include "types.h"
@@ -44,11 +45,17 @@ class Weights : public Tensor {
   Weights(Operator* op, DataType type, const std::vector<size_t>& dims);
   virtual ~Weights(void);
 
+  // Release the host memory holding the weights of a local processor,
+  // which may be shared with other processors or mapped from a file
+  void ReleaseLocalAllocation(size_t local_index);
+
  public:
   Legion::Domain local_bounds[MAX_LOCAL_PROCS];
   Legion::Memory local_memory[MAX_LOCAL_PROCS];
   void* local_allocation[MAX_LOCAL_PROCS];
   size_t local_strides[MAX_LOCAL_PROCS][LEGION_MAX_DIM];
+  // Owner of 'local_allocation' when it is not a private malloc
+  std::shared_ptr<void> local_storage[MAX_LOCAL_PROCS];
 };
 
 }}}  // namespace triton::backend::legion
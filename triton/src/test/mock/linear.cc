@@ -0,0 +1,132 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "operators/linear.h"
+
+using namespace Legion;
+
+namespace triton { namespace backend { namespace legion {
+
+Linear::Linear(
+    LegionModelState* model, const LayerStrategy* strategy, size_t inDim,
+    size_t outDim, bool transposed, bool bias, const char* name)
+    : Operator(
+          model, strategy, OP_LINEAR, name, 1 /*inputs*/,
+          bias ? 2 : 1 /*weights*/, 1 /*outputs*/),
+      in_dim(inDim), out_dim(outDim), transposed_weight(transposed),
+      use_bias(bias)
+{
+}
+
+Linear::~Linear() {}
+
+void
+Linear::Configure(Tensor* input, Weights* wts, Tensor* output, Weights* bias)
+{
+  assert(input != nullptr);
+  assert(in_dim == input->bounds.back());
+  assert(wts != nullptr);
+  assert(output != nullptr);
+  if (use_bias)
+    assert(bias != nullptr);
+  else
+    assert(bias == nullptr);
+  inputs.push_back(input);
+  outputs.push_back(output);
+  weights.push_back(wts);
+  if (use_bias)
+    weights.push_back(bias);
+  // Hack so that we can access the tensors in the tests
+  auto vec_ptr = reinterpret_cast<std::vector<Tensor*>*>(model);
+  vec_ptr->emplace_back(input);
+  vec_ptr->emplace_back(wts);
+  if (use_bias) {
+    vec_ptr->emplace_back(bias);
+  }
+  vec_ptr->emplace_back(output);
+}
+
+Rect<2>
+Linear::GetWeightBounds(Realm::Processor proc)
+{
+  if ((weights.size() < 1) || (weights.size() > 2)) {
+    throw std::invalid_argument("Weight is not configured for Linear operator");
+  }
+  // Always return the whole weight bound
+  return Rect<2>(
+      Point<2>(0, 0),
+      Point<2>(weights[0]->bounds[0] - 1, weights[0]->bounds[1] - 1));
+}
+
+Rect<1>
+Linear::GetBiasBounds(Realm::Processor proc)
+{
+  if (weights.size() != 2) {
+    throw std::invalid_argument("Bias is not configured for Linear operator");
+  }
+  // Always return the whole bias bound
+  DomainPoint lo, hi;
+  lo.dim = 1;
+  lo[0] = 0;
+  hi.dim = 1;
+  hi[0] = weights[1]->bounds[0] - 1;
+  return Rect<1>(lo, hi);
+}
+
+void
+Linear::Load(Realm::Processor processor)
+{
+  throw std::invalid_argument(
+      "This function shouldn't be called in parser unit test");
+}
+void
+Linear::initialize(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+{
+  throw std::invalid_argument(
+      "This function shouldn't be called in parser unit test");
+}
+void
+Linear::forward(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+{
+  throw std::invalid_argument(
+      "This function shouldn't be called in parser unit test");
+}
+void
+Linear::finalize(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+{
+  throw std::invalid_argument(
+      "This function shouldn't be called in parser unit test");
+}
+void
+Linear::Free(Realm::Processor processor)
+{
+  throw std::invalid_argument(
+      "This function shouldn't be called in parser unit test");
+}
+
+void
+Linear::PreregisterTaskVariants()
+{
+  throw std::invalid_argument(
+      "This function shouldn't be called in parser unit test");
+}
+
+}}}  // namespace triton::backend::legion
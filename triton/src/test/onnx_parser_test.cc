@@ -13,11 +13,16 @@
  * limitations under the License.
  */
 
+#include <cstring>
+#include <map>
+
 #include "gtest/gtest.h"
 
 #include "onnx_parser.h"
 #include "operators/binary.h"
 #include "operators/conv2d.h"
+#include "operators/linear.h"
+#include "operators/matmul.h"
 #include "operators/pool2d.h"
 #include "operators/softmax.h"
 #include "operators/unary.h"
@@ -537,6 +542,271 @@ TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseConv2D)
       std::vector<size_t>({4, 2, 3, 3}));
 }
 
+TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseConv2DFoldBatchNorm)
+{
+  // Data section, the batch normalization scales the output channels by
+  // {0.5, 2} and the Identity between the layers is bypassed
+  std::vector<float> bias_data = {0, -2.5};
+  std::vector<float> channel_scale = {0.5, 2};
+  std::vector<tbl::Tensor*> model_stub;
+  // Constant, Conv, Identity and BatchNormalization nodes
+  tbl::PartitionStrategy strategy(
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub),
+      std::vector<const tbl::LayerStrategy*>(4, &layer_strategy_));
+  std::vector<std::pair<std::string, tbl::Tensor*>> inputs;
+  std::vector<std::pair<std::string, tbl::Tensor*>> outputs;
+  std::vector<tbl::Operator*> layers;
+
+  auto err = tbl::OnnxParser::LoadModel(
+      find_local_processor_fn_,
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub), &strategy,
+      "data/conv2d_bn.onnx", &inputs, &outputs, &layers);
+  ASSERT_TRUE(err == nullptr) << TRITONSERVER_ErrorMessage(err);
+
+  ASSERT_EQ(model_stub.size(), 4) << "Expect 4 tensors are parsed";
+  ASSERT_EQ(layers.size(), 1) << "Expect 1 layer is parsed";
+  auto generated_op = dynamic_cast<tbl::Conv2D*>(layers[0]);
+  ASSERT_TRUE(generated_op != nullptr)
+      << "Expect the operator to be a Conv2D instance";
+
+  CHECK_GENERAL_OPERATOR_ATTRIBUTES(
+      generated_op, tbl::OperatorType::OP_CONV2D, &model_stub, &layer_strategy_,
+      1, 2, 1);
+  EXPECT_EQ(generated_op->use_bias, true);
+
+  {
+    auto weight = model_stub[1];
+    CHECK_GENERAL_TENSOR_ATTRIBUTES(
+        weight, generated_op, true, tbl::DataType::DT_FLOAT,
+        std::vector<size_t>({2, 1, 3, 3}));
+    auto bound =
+        generated_op->GetWeightBounds(layer_strategy_.local_processors[0]);
+    const float* data_allocation = reinterpret_cast<const float*>(
+        dynamic_cast<tbl::Weights*>(weight)->local_allocation[0]);
+    for (size_t oc = bound.lo[0]; oc <= bound.hi[0]; ++oc) {
+      for (size_t idx = 0; idx < 9; ++idx) {
+        EXPECT_EQ((oc * 9 + idx) * channel_scale[oc], *data_allocation)
+            << "Mismatched value at weight entry (" << oc << ", " << idx
+            << ")";
+        ++data_allocation;
+      }
+    }
+  }
+
+  {
+    auto bias = model_stub[2];
+    CHECK_GENERAL_TENSOR_ATTRIBUTES(
+        bias, generated_op, true, tbl::DataType::DT_FLOAT,
+        std::vector<size_t>({2}));
+    auto bound =
+        generated_op->GetBiasBounds(layer_strategy_.local_processors[0]);
+    const float* data_allocation = reinterpret_cast<const float*>(
+        dynamic_cast<tbl::Weights*>(bias)->local_allocation[0]);
+    for (size_t idx = bound.lo[0]; idx <= bound.hi[0]; ++idx) {
+      EXPECT_EQ(bias_data[idx], *data_allocation)
+          << "Mismatched value at weight entry (" << idx << ")";
+      ++data_allocation;
+    }
+  }
+
+  ASSERT_EQ(outputs.size(), 1) << "Expect 1 output is parsed";
+  EXPECT_EQ(outputs[0].first, "output");
+  EXPECT_TRUE(outputs[0].second == model_stub[3]);
+  CHECK_GENERAL_TENSOR_ATTRIBUTES(
+      model_stub[3], generated_op, false, tbl::DataType::DT_FLOAT,
+      std::vector<size_t>({4, 2, 3, 3}));
+}
+
+TEST(OnnxParserFoldConstantTest, FoldBinaryShapes)
+{
+  auto make_tensor = [](const std::string& name,
+                        const std::vector<int64_t>& dims,
+                        const std::vector<float>& values) {
+    onnx::TensorProto tensor;
+    tensor.set_name(name);
+    tensor.set_data_type(onnx::TensorProto::FLOAT);
+    for (const auto dim : dims) tensor.add_dims(dim);
+    for (const auto value : values) tensor.add_float_data(value);
+    return tensor;
+  };
+  auto make_node = [](const std::string& op_type, const std::string& lhs,
+                      const std::string& rhs, const std::string& output) {
+    onnx::NodeProto node;
+    node.set_op_type(op_type);
+    node.add_input(lhs);
+    node.add_input(rhs);
+    node.add_output(output);
+    return node;
+  };
+  auto read_values = [](const onnx::TensorProto& tensor) {
+    std::vector<float> values(tensor.raw_data().size() / sizeof(float));
+    std::memcpy(
+        values.data(), tensor.raw_data().data(), tensor.raw_data().size());
+    return values;
+  };
+  const auto row = make_tensor("row", {1, 3}, {1, 2, 3});
+  const auto column = make_tensor("column", {3, 1}, {10, 20, 30});
+  const auto scalar = make_tensor("scalar", {}, {2});
+  std::map<std::string, const onnx::TensorProto*> constants = {
+      {"row", &row}, {"column", &column}, {"scalar", &scalar}};
+  onnx::GraphProto graph;
+
+  // [1, 3] + [3, 1] broadcasts to [3, 3], not an element-wise sum
+  EXPECT_FALSE(tbl::FoldConstantNode(
+      make_node("Add", "row", "column", "outer"), &constants, &graph));
+  EXPECT_EQ(graph.initializer_size(), 0);
+  EXPECT_EQ(constants.count("outer"), 0);
+
+  ASSERT_TRUE(tbl::FoldConstantNode(
+      make_node("Mul", "scalar", "row", "scaled"), &constants, &graph));
+  const auto* scaled = constants.at("scaled");
+  EXPECT_EQ(
+      std::vector<int64_t>(scaled->dims().begin(), scaled->dims().end()),
+      std::vector<int64_t>({1, 3}));
+  EXPECT_EQ(read_values(*scaled), std::vector<float>({2, 4, 6}));
+
+  ASSERT_TRUE(tbl::FoldConstantNode(
+      make_node("Sub", "row", "scaled", "diff"), &constants, &graph));
+  const auto* diff = constants.at("diff");
+  EXPECT_EQ(diff->dims_size(), 2);
+  EXPECT_EQ(read_values(*diff), std::vector<float>({-1, -2, -3}));
+}
+
+TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseGemm)
+{
+  layer_strategy_.nDims = 2;
+  layer_strategy_.dim[0] = layer_strategy_.dim[1] = 1;
+  std::vector<tbl::Tensor*> model_stub;
+  tbl::PartitionStrategy strategy(
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub),
+      {reinterpret_cast<const tbl::LayerStrategy*>(&layer_strategy_)});
+  std::vector<std::pair<std::string, tbl::Tensor*>> inputs;
+  std::vector<std::pair<std::string, tbl::Tensor*>> outputs;
+  std::vector<tbl::Operator*> layers;
+
+  auto err = tbl::OnnxParser::LoadModel(
+      find_local_processor_fn_,
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub), &strategy,
+      "data/gemm.onnx", &inputs, &outputs, &layers);
+  ASSERT_TRUE(err == nullptr) << TRITONSERVER_ErrorMessage(err);
+
+  // A * B is computed by a MatMul layer and C added by a binary layer, both
+  // following the strategy of the Gemm node
+  ASSERT_EQ(model_stub.size(), 6) << "Expect 6 tensors are recorded";
+  ASSERT_EQ(layers.size(), 2) << "Expect 2 layers are parsed";
+  auto matmul_op = dynamic_cast<tbl::MatMul*>(layers[0]);
+  ASSERT_TRUE(matmul_op != nullptr)
+      << "Expect the first operator to be a MatMul instance";
+  CHECK_GENERAL_OPERATOR_ATTRIBUTES(
+      matmul_op, tbl::OperatorType::OP_MATMUL, &model_stub, &layer_strategy_,
+      2, 0, 1);
+  auto add_op = dynamic_cast<tbl::BinaryOperator*>(layers[1]);
+  ASSERT_TRUE(add_op != nullptr)
+      << "Expect the second operator to be a Binary instance";
+  CHECK_GENERAL_OPERATOR_ATTRIBUTES(
+      add_op, tbl::OperatorType::OP_EW_ADD, &model_stub, &layer_strategy_, 2,
+      0, 1);
+
+  ASSERT_EQ(inputs.size(), 3) << "Expect 3 inputs are parsed";
+  EXPECT_TRUE(inputs[0].second == model_stub[0]);
+  EXPECT_TRUE(inputs[1].second == model_stub[1]);
+  EXPECT_TRUE(inputs[2].second == model_stub[4]);
+  auto product = model_stub[2];
+  CHECK_GENERAL_TENSOR_ATTRIBUTES(
+      product, matmul_op, false, tbl::DataType::DT_FLOAT,
+      std::vector<size_t>({4, 2}));
+  EXPECT_TRUE(model_stub[3] == product);
+  ASSERT_EQ(outputs.size(), 1) << "Expect 1 output is parsed";
+  EXPECT_TRUE(outputs[0].second == model_stub[5]);
+  CHECK_GENERAL_TENSOR_ATTRIBUTES(
+      model_stub[5], add_op, false, tbl::DataType::DT_FLOAT,
+      std::vector<size_t>({4, 2}));
+}
+
+TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseGemmLinear)
+{
+  // Data section
+  std::vector<std::vector<float>> weight_data = {{0, 1, 2}, {3, 4, 5}};
+  std::vector<float> bias_data = {1, 2};
+  layer_strategy_.nDims = 2;
+  layer_strategy_.dim[0] = layer_strategy_.dim[1] = 1;
+  std::vector<tbl::Tensor*> model_stub;
+  tbl::PartitionStrategy strategy(
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub),
+      {reinterpret_cast<const tbl::LayerStrategy*>(&layer_strategy_)});
+  std::vector<std::pair<std::string, tbl::Tensor*>> inputs;
+  std::vector<std::pair<std::string, tbl::Tensor*>> outputs;
+  std::vector<tbl::Operator*> layers;
+
+  auto err = tbl::OnnxParser::LoadModel(
+      find_local_processor_fn_,
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub), &strategy,
+      "data/gemm_linear.onnx", &inputs, &outputs, &layers);
+  ASSERT_TRUE(err == nullptr) << TRITONSERVER_ErrorMessage(err);
+
+  // A constant B and C become the weight and bias of a single Linear layer
+  ASSERT_EQ(model_stub.size(), 4) << "Expect 4 tensors are parsed";
+  ASSERT_EQ(layers.size(), 1) << "Expect 1 layer is parsed";
+  auto generated_op = dynamic_cast<tbl::Linear*>(layers[0]);
+  ASSERT_TRUE(generated_op != nullptr)
+      << "Expect the operator to be a Linear instance";
+  CHECK_GENERAL_OPERATOR_ATTRIBUTES(
+      generated_op, tbl::OperatorType::OP_LINEAR, &model_stub,
+      &layer_strategy_, 1, 2, 1);
+  EXPECT_EQ(generated_op->in_dim, 3);
+  EXPECT_EQ(generated_op->out_dim, 2);
+  EXPECT_EQ(generated_op->transposed_weight, true);
+  EXPECT_EQ(generated_op->use_bias, true);
+
+  ASSERT_EQ(inputs.size(), 1) << "Expect 1 input is parsed";
+  ASSERT_TRUE(inputs[0].second == model_stub[0]);
+  CHECK_GENERAL_TENSOR_ATTRIBUTES(
+      inputs[0].second, nullptr, false, tbl::DataType::DT_FLOAT,
+      std::vector<size_t>({4, 3}));
+
+  {
+    auto weight = model_stub[1];
+    CHECK_GENERAL_TENSOR_ATTRIBUTES(
+        weight, generated_op, true, tbl::DataType::DT_FLOAT,
+        std::vector<size_t>({2, 3}));
+    auto bound =
+        generated_op->GetWeightBounds(layer_strategy_.local_processors[0]);
+    const float* data_allocation = reinterpret_cast<const float*>(
+        dynamic_cast<tbl::Weights*>(weight)->local_allocation[0]);
+    for (size_t row = bound.lo[0]; row <= bound.hi[0]; ++row) {
+      for (size_t col = bound.lo[1]; col <= bound.hi[1]; ++col) {
+        EXPECT_EQ(weight_data[row][col], *data_allocation)
+            << "Mismatched value at weight entry (" << row << ", " << col
+            << ")";
+        ++data_allocation;
+      }
+    }
+  }
+
+  {
+    auto bias = model_stub[2];
+    CHECK_GENERAL_TENSOR_ATTRIBUTES(
+        bias, generated_op, true, tbl::DataType::DT_FLOAT,
+        std::vector<size_t>({2}));
+    auto bound =
+        generated_op->GetBiasBounds(layer_strategy_.local_processors[0]);
+    const float* data_allocation = reinterpret_cast<const float*>(
+        dynamic_cast<tbl::Weights*>(bias)->local_allocation[0]);
+    for (size_t idx = bound.lo[0]; idx <= bound.hi[0]; ++idx) {
+      EXPECT_EQ(bias_data[idx], *data_allocation)
+          << "Mismatched value at weight entry (" << idx << ")";
+      ++data_allocation;
+    }
+  }
+
+  ASSERT_EQ(outputs.size(), 1) << "Expect 1 output is parsed";
+  EXPECT_EQ(outputs[0].first, "output");
+  EXPECT_TRUE(outputs[0].second == model_stub[3]);
+  CHECK_GENERAL_TENSOR_ATTRIBUTES(
+      model_stub[3], generated_op, false, tbl::DataType::DT_FLOAT,
+      std::vector<size_t>({4, 2}));
+}
+
 TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseIdentity)
 {
   std::vector<tbl::Tensor*> model_stub;
@@ -580,6 +850,47 @@ TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseIdentity)
       std::vector<size_t>({4, 1, 5, 5}));
 }
 
+TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseMatMul)
+{
+  layer_strategy_.nDims = 3;
+  layer_strategy_.dim[0] = layer_strategy_.dim[1] = layer_strategy_.dim[2] = 1;
+  std::vector<tbl::Tensor*> model_stub;
+  tbl::PartitionStrategy strategy(
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub),
+      {reinterpret_cast<const tbl::LayerStrategy*>(&layer_strategy_)});
+  std::vector<std::pair<std::string, tbl::Tensor*>> inputs;
+  std::vector<std::pair<std::string, tbl::Tensor*>> outputs;
+  std::vector<tbl::Operator*> layers;
+
+  auto err = tbl::OnnxParser::LoadModel(
+      find_local_processor_fn_,
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub), &strategy,
+      "data/matmul.onnx", &inputs, &outputs, &layers);
+  ASSERT_TRUE(err == nullptr) << TRITONSERVER_ErrorMessage(err);
+
+  ASSERT_EQ(model_stub.size(), 3) << "Expect 3 tensors are parsed";
+  ASSERT_EQ(layers.size(), 1) << "Expect 1 layer is parsed";
+  auto generated_op = dynamic_cast<tbl::MatMul*>(layers[0]);
+  ASSERT_TRUE(generated_op != nullptr)
+      << "Expect the operator to be a MatMul instance";
+
+  CHECK_GENERAL_OPERATOR_ATTRIBUTES(
+      generated_op, tbl::OperatorType::OP_MATMUL, &model_stub,
+      &layer_strategy_, 2, 0, 1);
+
+  // Check associated tensors, the second input is broadcast over the batch
+  ASSERT_EQ(inputs.size(), 2) << "Expect 2 inputs are parsed";
+  CHECK_GENERAL_TENSOR_ATTRIBUTES(
+      model_stub[0], nullptr, false, tbl::DataType::DT_FLOAT,
+      std::vector<size_t>({2, 4, 3}));
+  CHECK_GENERAL_TENSOR_ATTRIBUTES(
+      model_stub[1], nullptr, false, tbl::DataType::DT_FLOAT,
+      std::vector<size_t>({3, 5}));
+  CHECK_GENERAL_TENSOR_ATTRIBUTES(
+      model_stub[2], generated_op, false, tbl::DataType::DT_FLOAT,
+      std::vector<size_t>({2, 4, 5}));
+}
+
 TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseMaxPool)
 {
   std::vector<tbl::Tensor*> model_stub;
@@ -163,6 +163,7 @@ def cast(path):
 def conv_models(path):
     conv(path)
     conv_strides(path)
+    conv_bn(path)
 
 
 def conv(path):
@@ -218,6 +219,52 @@ def conv_autopad(path):
     save(model, os.path.join(path, 'conv_autopad.onnx'))
 
 
+def conv_bn(path):
+    # Conv -> Identity -> BatchNormalization with the bias of the convolution
+    # produced by a Constant node, the importer folds all of it into a single
+    # convolution
+    bias = helper.make_node(
+        'Constant',
+        inputs=[],
+        outputs=['bias'],
+        value=helper.make_tensor('value', tp.FLOAT, [2], [0, 1]),
+    )
+    conv = helper.make_node(
+        'Conv',
+        inputs=['input', 'weight', 'bias'],
+        outputs=['conv_output'],
+        kernel_shape=[3, 3],
+    )
+    identity = helper.make_node(
+        'Identity',
+        inputs=['conv_output'],
+        outputs=['identity_output'],
+    )
+    bn = helper.make_node(
+        'BatchNormalization',
+        inputs=['identity_output', 'scale', 'beta', 'mean', 'var'],
+        outputs=['output'],
+        epsilon=1.0,
+    )
+    initializers = [
+        helper.make_tensor('weight', tp.FLOAT, [2, 1, 3, 3],
+                           [float(i) for i in range(18)]),
+        helper.make_tensor('scale', tp.FLOAT, [2], [1, 2]),
+        helper.make_tensor('beta', tp.FLOAT, [2], [0.5, -0.5]),
+        helper.make_tensor('mean', tp.FLOAT, [2], [1, 2]),
+        helper.make_tensor('var', tp.FLOAT, [2], [3, 0]),
+    ]
+    graph = helper.make_graph(
+        [bias, conv, identity, bn],
+        'test_graph',
+        [helper.make_tensor_value_info('input', tp.FLOAT, [4, 1, 5, 5])],
+        [helper.make_tensor_value_info('output', tp.FLOAT, [4, 2, 3, 3])],
+        initializer=initializers)
+    model = helper.make_model(graph, producer_name='model')
+    checker.check_model(model)
+    save(model, os.path.join(path, 'conv2d_bn.onnx'))
+
+
 ## Flatten
 
 
@@ -296,6 +343,69 @@ def identity(path):
     save(model, os.path.join(path, 'identity.onnx'))
 
 
+## MatMul
+
+
+def matmul_models(path):
+    matmul(path)
+    gemm(path)
+    gemm_linear(path)
+
+
+def matmul(path):
+    node = helper.make_node(
+        'MatMul',
+        inputs=['input0', 'input1'],
+        outputs=['output'],
+    )
+    graph = helper.make_graph([node], 'test_graph', [
+        helper.make_tensor_value_info('input0', tp.FLOAT, [2, 4, 3]),
+        helper.make_tensor_value_info('input1', tp.FLOAT, [3, 5])
+    ], [helper.make_tensor_value_info('output', tp.FLOAT, [2, 4, 5])])
+    model = helper.make_model(graph, producer_name='model')
+    checker.check_model(model)
+    save(model, os.path.join(path, 'matmul.onnx'))
+
+
+def gemm(path):
+    node = helper.make_node(
+        'Gemm',
+        inputs=['input0', 'input1', 'input2'],
+        outputs=['output'],
+    )
+    graph = helper.make_graph([node], 'test_graph', [
+        helper.make_tensor_value_info('input0', tp.FLOAT, [4, 3]),
+        helper.make_tensor_value_info('input1', tp.FLOAT, [3, 2]),
+        helper.make_tensor_value_info('input2', tp.FLOAT, [4, 2])
+    ], [helper.make_tensor_value_info('output', tp.FLOAT, [4, 2])])
+    model = helper.make_model(graph, producer_name='model')
+    checker.check_model(model)
+    save(model, os.path.join(path, 'gemm.onnx'))
+
+
+def gemm_linear(path):
+    node = helper.make_node(
+        'Gemm',
+        inputs=['input0', 'weight', 'bias'],
+        outputs=['output'],
+        transB=1,
+    )
+    initializers = [
+        helper.make_tensor('weight', tp.FLOAT, [2, 3],
+                           [float(i) for i in range(6)]),
+        helper.make_tensor('bias', tp.FLOAT, [2], [1, 2]),
+    ]
+    graph = helper.make_graph(
+        [node],
+        'test_graph',
+        [helper.make_tensor_value_info('input0', tp.FLOAT, [4, 3])],
+        [helper.make_tensor_value_info('output', tp.FLOAT, [4, 2])],
+        initializer=initializers)
+    model = helper.make_model(graph, producer_name='model')
+    checker.check_model(model)
+    save(model, os.path.join(path, 'gemm_linear.onnx'))
+
+
 ## Max Pool
 
 
@@ -604,6 +714,7 @@ if __name__ == '__main__':
     conv_models(path)
     flatten_models(path)
     identity_models(path)
+    matmul_models(path)
     max_pool_models(path)
     reciprocal_models(path)
     reshape_models(path)
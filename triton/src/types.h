@@ -165,6 +165,7 @@ enum LayerTaskID {
   BINARY_TASK_ID,
   CONCAT_TASK_ID,
   CONV2D_TASK_ID,
+  LINEAR_TASK_ID,
   MATMUL_TASK_ID,
   RESHAPE_TASK_ID,
   SOFTMAX_TASK_ID,